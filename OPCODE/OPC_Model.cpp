@@ -209,6 +209,59 @@ bool Model::Build(const OPCODECREATE& create)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Sets up a collision model over the node array of a tree built earlier.
+ *	\param		imesh			[in] mesh interface the tree has been built for
+ *	\param		model_code		[in] model code of the original model
+ *	\param		nodes			[in] node array of the original tree
+ *	\param		nb_nodes		[in] number of nodes
+ *	\param		center_coeff	[in] center dequantization coeffs for quantized trees
+ *	\param		extents_coeff	[in] extents dequantization coeffs for quantized trees
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Model::Attach(const MeshInterface* imesh, udword model_code, const void* nodes, udword nb_nodes, const Point& center_coeff, const Point& extents_coeff)
+{
+	if(!imesh || !imesh->IsValid())	return false;
+
+	Release();
+	mModelCode &= ~OPC_SINGLE_NODE;
+
+	SetMeshInterface(imesh);
+
+	// Single triangle meshes have no tree
+	if(model_code & OPC_SINGLE_NODE)
+	{
+		if(imesh->GetNbTriangles()!=1)	return false;
+		mModelCode |= OPC_SINGLE_NODE;
+		return true;
+	}
+
+	if(!CreateTree((model_code & OPC_NO_LEAF)!=0, (model_code & OPC_QUANTIZED)!=0))	return false;
+
+	if(model_code & OPC_NO_LEAF)
+	{
+		if(model_code & OPC_QUANTIZED)
+		{
+			AABBQuantizedNoLeafTree* Tree = static_cast<AABBQuantizedNoLeafTree*>(mTree);
+			Tree->mCenterCoeff.Set(center_coeff);
+			Tree->mExtentsCoeff.Set(extents_coeff);
+			return Tree->Attach((const AABBQuantizedNoLeafNode*)nodes, nb_nodes);
+		}
+		return static_cast<AABBNoLeafTree*>(mTree)->Attach((const AABBNoLeafNode*)nodes, nb_nodes);
+	}
+
+	if(model_code & OPC_QUANTIZED)
+	{
+		AABBQuantizedTree* Tree = static_cast<AABBQuantizedTree*>(mTree);
+		Tree->mCenterCoeff.Set(center_coeff);
+		Tree->mExtentsCoeff.Set(extents_coeff);
+		return Tree->Attach((const AABBQuantizedNode*)nodes, nb_nodes);
+	}
+	return static_cast<AABBCollisionTree*>(mTree)->Attach((const AABBCollisionNode*)nodes, nb_nodes);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
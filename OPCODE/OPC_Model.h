@@ -36,6 +36,21 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Sets up a collision model over the node array of a tree built earlier (ODE). The nodes are used in place
+		 *	without being copied and must stay valid for the lifetime of the model or until it is rebuilt.
+		 *	\param		imesh			[in] mesh interface the tree has been built for
+		 *	\param		model_code		[in] model code of the original model
+		 *	\param		nodes			[in] node array of the original tree
+		 *	\param		nb_nodes		[in] number of nodes
+		 *	\param		center_coeff	[in] center dequantization coeffs for quantized trees
+		 *	\param		extents_coeff	[in] extents dequantization coeffs for quantized trees
+		 *	eturn		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool				Attach(const MeshInterface* imesh, udword model_code, const void* nodes, udword nb_nodes, const Point& center_coeff, const Point& extents_coeff);
+
 #ifdef __MESHMERIZER_H__
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
@@ -118,8 +118,8 @@ static void _BuildCollisionTree(AABBCollisionNode* linear, const udword box_id,
 		// To make the negative one implicit, we must store P and N in successive order
 		udword PosID = current_id++;	// Get a new id for positive child
 		udword NegID = current_id++;	// Get a new id for negative child
-		// Setup box data as the forthcoming new P pointer
-		linear[box_id].mData = (size_t)&linear[PosID];
+		// Setup box data as the forthcoming new P offset
+		linear[box_id].mData = (PosID-box_id)*sizeof(AABBCollisionNode);
 		// Make sure it's not marked as leaf
 		ASSERT(!(linear[box_id].mData&1));
 		// Recurse with new IDs
@@ -136,8 +136,8 @@ static void _BuildCollisionTree(AABBCollisionNode* linear, const udword box_id,
  *
  *	Node:
  *			- box
- *			- P pointer => a node (LSB=0) or a primitive (LSB=1)
- *			- N pointer => a node (LSB=0) or a primitive (LSB=1)
+ *			- P offset => a node (LSB=0) or a primitive (LSB=1)
+ *			- N offset => a node (LSB=0) or a primitive (LSB=1)
  *
  *	\relates	AABBNoLeafNode
  *	\fn			_BuildNoLeafTree(AABBNoLeafNode* linear, const udword box_id, udword& current_id, const AABBTreeNode* current_node)
@@ -172,7 +172,7 @@ static void _BuildNoLeafTree(AABBNoLeafNode* linear, const udword box_id, udword
 		// Get a new id for positive child
 		udword PosID = current_id++;
 		// Setup box data
-		linear[box_id].mPosData = (size_t)&linear[PosID];
+		linear[box_id].mPosData = (PosID-box_id)*sizeof(AABBNoLeafNode);
 		// Make sure it's not marked as leaf
 		ASSERT(!(linear[box_id].mPosData&1));
 		// Recurse
@@ -193,7 +193,7 @@ static void _BuildNoLeafTree(AABBNoLeafNode* linear, const udword box_id, udword
 		// Get a new id for negative child
 		udword NegID = current_id++;
 		// Setup box data
-		linear[box_id].mNegData = (size_t)&linear[NegID];
+		linear[box_id].mNegData = (NegID-box_id)*sizeof(AABBNoLeafNode);
 		// Make sure it's not marked as leaf
 		ASSERT(!(linear[box_id].mNegData&1));
 		// Recurse
@@ -201,12 +201,44 @@ static void _BuildNoLeafTree(AABBNoLeafNode* linear, const udword box_id, udword
 	}
 }
 
+// ODE: a tree may use an external node array attached with Attach() (e.g. from a mapped file). Such an array is never
+// freed by the tree and is copied into an owned one before being modified. As node links are relative, the copy is
+// a plain memory copy.
+#define IMPLEMENT_NODES_OWNERSHIP(base_class, node)								\
+bool base_class::Attach(const node* nodes, udword nb_nodes)						\
+{																				\
+	if(!nodes || !nb_nodes)	return false;										\
+	ReleaseNodes();																\
+	mNodes = const_cast<node*>(nodes);											\
+	mNbNodes = nb_nodes;														\
+	mAttached = true;															\
+	return true;																\
+}																				\
+																				\
+void base_class::ReleaseNodes()													\
+{																				\
+	if(mAttached)	mNodes = null;												\
+	else			DELETEARRAY(mNodes);										\
+	mAttached = false;															\
+}																				\
+																				\
+bool base_class::DetachNodes()													\
+{																				\
+	if(!mAttached)	return true;												\
+	node* Nodes = new node[mNbNodes];											\
+	CHECKALLOC(Nodes);															\
+	CopyMemory(Nodes, mNodes, mNbNodes*sizeof(node));							\
+	mNodes = Nodes;																\
+	mAttached = false;															\
+	return true;																\
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Constructor.
  */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-AABBCollisionTree::AABBCollisionTree() : mNodes(null)
+AABBCollisionTree::AABBCollisionTree() : mNodes(null), mAttached(false)
 {
 }
 
@@ -217,9 +249,11 @@ AABBCollisionTree::AABBCollisionTree() : mNodes(null)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 AABBCollisionTree::~AABBCollisionTree()
 {
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 }
 
+IMPLEMENT_NODES_OWNERSHIP(AABBCollisionTree, AABBCollisionNode)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Builds the collision tree from a generic AABB tree.
@@ -237,10 +271,10 @@ bool AABBCollisionTree::Build(AABBTree* tree)
 	if(NbNodes!=NbTriangles*2-1)	return false;
 
 	// Get nodes
-	if(mNbNodes!=NbNodes)	// Same number of nodes => keep moving
+	if(mNbNodes!=NbNodes || mAttached)	// Same number of owned nodes => keep moving
 	{
+		ReleaseNodes();
 		mNbNodes = NbNodes;
-		DELETEARRAY(mNodes);
 		mNodes = new AABBCollisionNode[NbNodes];
 		CHECKALLOC(mNodes);
 	}
@@ -301,7 +335,7 @@ bool AABBCollisionTree::Walk(GenericWalkingCallback callback, void* user_data) c
  *	Constructor.
  */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-AABBNoLeafTree::AABBNoLeafTree() : mNodes(null)
+AABBNoLeafTree::AABBNoLeafTree() : mNodes(null), mAttached(false)
 {
 }
 
@@ -312,9 +346,11 @@ AABBNoLeafTree::AABBNoLeafTree() : mNodes(null)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 AABBNoLeafTree::~AABBNoLeafTree()
 {
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 }
 
+IMPLEMENT_NODES_OWNERSHIP(AABBNoLeafTree, AABBNoLeafNode)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Builds the collision tree from a generic AABB tree.
@@ -333,10 +369,10 @@ bool AABBNoLeafTree::Build(AABBTree* tree)
 
 	udword NbNodes = NbTriangles-1;
 	// Get nodes
-	if(mNbNodes!=NbNodes)	// Same number of nodes => keep moving
+	if(mNbNodes!=NbNodes || mAttached)	// Same number of owned nodes => keep moving
 	{
+		ReleaseNodes();
 		mNbNodes = NbNodes;
-		DELETEARRAY(mNodes);
 		mNodes = new AABBNoLeafNode[NbNodes];
 		CHECKALLOC(mNodes);
 	}
@@ -371,6 +407,48 @@ inline_ void ComputeMinMax(Point& min, Point& max, const VertexPointers& vp)
 #endif
 }
 
+static inline_ void _RefitNoLeafNode(AABBNoLeafNode& current, const MeshInterface* mesh_interface, VertexPointers& VP, ConversionArea& VC)
+{
+	Point Min,Max;
+	Point Min_,Max_;
+
+	if(current.HasPosLeaf())
+	{
+		mesh_interface->GetTriangle(VP, current.GetPosPrimitive(), VC);
+		ComputeMinMax(Min, Max, VP);
+	}
+	else
+	{
+		const CollisionAABB& CurrentBox = current.GetPos()->mAABB;
+		CurrentBox.GetMin(Min);
+		CurrentBox.GetMax(Max);
+	}
+
+	if(current.HasNegLeaf())
+	{
+		mesh_interface->GetTriangle(VP, current.GetNegPrimitive(), VC);
+		ComputeMinMax(Min_, Max_, VP);
+	}
+	else
+	{
+		const CollisionAABB& CurrentBox = current.GetNeg()->mAABB;
+		CurrentBox.GetMin(Min_);
+		CurrentBox.GetMax(Max_);
+	}
+#ifdef OPC_USE_FCOMI
+	Min.x = FCMin2(Min.x, Min_.x);
+	Max.x = FCMax2(Max.x, Max_.x);
+	Min.y = FCMin2(Min.y, Min_.y);
+	Max.y = FCMax2(Max.y, Max_.y);
+	Min.z = FCMin2(Min.z, Min_.z);
+	Max.z = FCMax2(Max.z, Max_.z);
+#else
+	Min.Min(Min_);
+	Max.Max(Max_);
+#endif
+	current.mAABB.SetMinMax(Min, Max);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Refits the collision tree after vertices have been modified.
@@ -383,55 +461,69 @@ bool AABBNoLeafTree::Refit(const MeshInterface* mesh_interface)
 	// Checkings
 	if(!mesh_interface)	return false;
 
+	// Attached nodes may be read-only
+	if(!DetachNodes())	return false;
+
 	// Bottom-up update
 	VertexPointers VP;
 	ConversionArea VC;
-	Point Min,Max;
-	Point Min_,Max_;
 	udword Index = mNbNodes;
 	while(Index--)
 	{
-		AABBNoLeafNode& Current = mNodes[Index];
+		_RefitNoLeafNode(mNodes[Index], mesh_interface, VP, VC);
+	}
+	return true;
+}
 
-		if(Current.HasPosLeaf())
-		{
-			mesh_interface->GetTriangle(VP, Current.GetPosPrimitive(), VC);
-			ComputeMinMax(Min, Max, VP);
-		}
-		else
-		{
-			const CollisionAABB& CurrentBox = Current.GetPos()->mAABB;
-			CurrentBox.GetMin(Min);
-			CurrentBox.GetMax(Max);
-		}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Refits some nodes of the collision tree after the vertices of their triangles have been modified.
+ *	\param		mesh_interface	[in] mesh interface for current model
+ *	\param		indices			[in] indices of the nodes to refit, descendants first
+ *	\param		nb_indices		[in] number of indices
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBNoLeafTree::RefitNodes(const MeshInterface* mesh_interface, const udword* indices, udword nb_indices)
+{
+	// Checkings
+	if(!mesh_interface)	return false;
 
-		if(Current.HasNegLeaf())
-		{
-			mesh_interface->GetTriangle(VP, Current.GetNegPrimitive(), VC);
-			ComputeMinMax(Min_, Max_, VP);
-		}
-		else
-		{
-			const CollisionAABB& CurrentBox = Current.GetNeg()->mAABB;
-			CurrentBox.GetMin(Min_);
-			CurrentBox.GetMax(Max_);
-		}
-#ifdef OPC_USE_FCOMI
-		Min.x = FCMin2(Min.x, Min_.x);
-		Max.x = FCMax2(Max.x, Max_.x);
-		Min.y = FCMin2(Min.y, Min_.y);
-		Max.y = FCMax2(Max.y, Max_.y);
-		Min.z = FCMin2(Min.z, Min_.z);
-		Max.z = FCMax2(Max.z, Max_.z);
-#else
-		Min.Min(Min_);
-		Max.Max(Max_);
-#endif
-		Current.mAABB.SetMinMax(Min, Max);
+	// Attached nodes may be read-only
+	if(!DetachNodes())	return false;
+
+	VertexPointers VP;
+	ConversionArea VC;
+	for(udword i=0;i<nb_indices;i++)
+	{
+		ASSERT(indices[i]<mNbNodes);
+		_RefitNoLeafNode(mNodes[indices[i]], mesh_interface, VP, VC);
 	}
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Replaces a subtree with another one built for the same primitives, e.g. a better fitting one built from their
+ *	current positions. As links are relative, the nodes are copied as they are.
+ *	\param		root_index		[in] index of the subtree root, the first of its nb_nodes nodes
+ *	\param		nodes			[in] new subtree nodes, root first
+ *	\param		nb_nodes		[in] number of nodes, the same as in the replaced subtree
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBNoLeafTree::ReplaceSubtree(udword root_index, const AABBNoLeafNode* nodes, udword nb_nodes)
+{
+	// Checkings
+	if(!nodes || !nb_nodes || root_index>=mNbNodes || nb_nodes>mNbNodes-root_index)	return false;
+
+	// Attached nodes may be read-only
+	if(!DetachNodes())	return false;
+
+	CopyMemory(mNodes+root_index, nodes, nb_nodes*sizeof(AABBNoLeafNode));
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Walks the tree and call the user back for each node.
@@ -555,9 +647,9 @@ bool AABBNoLeafTree::Walk(GenericWalkingCallback callback, void* user_data) cons
 	Data = Nodes[i].member;											\
 	if(!(Data&1))													\
 	{																\
-		/* Compute box number */									\
-		size_t Nb = ((NodeType *)(Data) - (Nodes));	                \
-		Data = (size_t) &mNodes[Nb];                                \
+		/* Compute box offset */									\
+		udword Nb = Data / sizeof(NodeType);		                \
+		Data = Nb * sizeof(mNodes[0]);                              \
 	}                                                               \
 	/* ...remapped */												\
 	mNodes[i].member = Data;
@@ -567,7 +659,7 @@ bool AABBNoLeafTree::Walk(GenericWalkingCallback callback, void* user_data) cons
  *	Constructor.
  */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-AABBQuantizedTree::AABBQuantizedTree() : mNodes(null)
+AABBQuantizedTree::AABBQuantizedTree() : mNodes(null), mAttached(false)
 {
 }
 
@@ -578,9 +670,11 @@ AABBQuantizedTree::AABBQuantizedTree() : mNodes(null)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 AABBQuantizedTree::~AABBQuantizedTree()
 {
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 }
 
+IMPLEMENT_NODES_OWNERSHIP(AABBQuantizedTree, AABBQuantizedNode)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Builds the collision tree from a generic AABB tree.
@@ -599,7 +693,7 @@ bool AABBQuantizedTree::Build(AABBTree* tree)
 
 	// Get nodes
 	mNbNodes = NbNodes;
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 	AABBCollisionNode* Nodes = new AABBCollisionNode[NbNodes];
 	CHECKALLOC(Nodes);
 
@@ -620,7 +714,7 @@ bool AABBQuantizedTree::Build(AABBTree* tree)
 			INIT_QUANTIZATION
 
 			// Quantize
-			size_t Data;
+			udword Data;
 			for(udword i=0;i<NbNodes;i++)
 			{
 				PERFORM_QUANTIZATION
@@ -684,7 +778,7 @@ bool AABBQuantizedTree::Walk(GenericWalkingCallback callback, void* user_data) c
  *	Constructor.
  */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-AABBQuantizedNoLeafTree::AABBQuantizedNoLeafTree() : mNodes(null)
+AABBQuantizedNoLeafTree::AABBQuantizedNoLeafTree() : mNodes(null), mAttached(false)
 {
 }
 
@@ -695,9 +789,11 @@ AABBQuantizedNoLeafTree::AABBQuantizedNoLeafTree() : mNodes(null)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 AABBQuantizedNoLeafTree::~AABBQuantizedNoLeafTree()
 {
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 }
 
+IMPLEMENT_NODES_OWNERSHIP(AABBQuantizedNoLeafTree, AABBQuantizedNoLeafNode)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Builds the collision tree from a generic AABB tree.
@@ -717,7 +813,7 @@ bool AABBQuantizedNoLeafTree::Build(AABBTree* tree)
 	// Get nodes
 	udword NbNodes = NbTriangles-1;
 	mNbNodes = NbNodes;
-	DELETEARRAY(mNodes);
+	ReleaseNodes();
 	AABBNoLeafNode* Nodes = new AABBNoLeafNode[NbNodes];
 	CHECKALLOC(Nodes);
 
@@ -739,7 +835,7 @@ bool AABBQuantizedNoLeafTree::Build(AABBTree* tree)
 			INIT_QUANTIZATION
 
 			// Quantize
-			size_t Data;
+			udword Data;
 			for(udword i=0;i<NbNodes;i++)
 			{
 				PERFORM_QUANTIZATION
@@ -20,6 +20,10 @@
 #ifndef __OPC_OPTIMIZEDTREE_H__
 #define __OPC_OPTIMIZEDTREE_H__
 
+	// ODE: node links are stored as byte offsets from the node to its child (children always follow their parents),
+	// rather than as absolute pointers. Node arrays are thus position independent: they can be copied with memcpy()
+	// or used directly from a read-only memory-mapped file, and the links take 4 bytes on 64-bit targets as well.
+
 	//! Common interface for a node of an implicit tree
 	#define IMPLEMENT_IMPLICIT_NODE(base_class, volume)														\
 		public:																								\
@@ -29,14 +33,14 @@
 		/* Leaf test */																						\
 		inline_			BOOL				IsLeaf()		const	{ return (mData&1)!=0;					}	\
 		/* Data access */																					\
-		inline_			const base_class*	GetPos()		const	{ return (base_class*)mData;		}	\
-		inline_			const base_class*	GetNeg()		const	{ return ((base_class*)mData)+1;	}	\
+		inline_			const base_class*	GetPos()		const	{ return (const base_class*)((const ubyte*)this+mData);		}	\
+		inline_			const base_class*	GetNeg()		const	{ return GetPos()+1;				}	\
 		inline_			size_t				GetPrimitive()	const	{ return (mData>>1);				}	\
 		/* Stats */																							\
 		inline_			udword				GetNodeSize()	const	{ return SIZEOFOBJECT;				}	\
 																											\
 						volume				mAABB;															\
-						size_t				mData;
+						udword				mData;
 
 	//! Common interface for a node of a no-leaf tree
 	#define IMPLEMENT_NOLEAF_NODE(base_class, volume)														\
@@ -48,16 +52,16 @@
 		inline_			BOOL				HasPosLeaf()		const	{ return (mPosData&1)!=0;			}	\
 		inline_			BOOL				HasNegLeaf()		const	{ return (mNegData&1)!=0;			}	\
 		/* Data access */																					\
-		inline_			const base_class*	GetPos()			const	{ return (base_class*)mPosData;	}	\
-		inline_			const base_class*	GetNeg()			const	{ return (base_class*)mNegData;	}	\
+		inline_			const base_class*	GetPos()			const	{ return (const base_class*)((const ubyte*)this+mPosData);	}	\
+		inline_			const base_class*	GetNeg()			const	{ return (const base_class*)((const ubyte*)this+mNegData);	}	\
 		inline_			size_t				GetPosPrimitive()	const	{ return (mPosData>>1);			}	\
 		inline_			size_t				GetNegPrimitive()	const	{ return (mNegData>>1);			}	\
 		/* Stats */																							\
 		inline_			udword				GetNodeSize()		const	{ return SIZEOFOBJECT;			}	\
 																											\
 						volume				mAABB;															\
-						size_t				mPosData;														\
-						size_t				mNegData;
+						udword				mPosData;														\
+						udword				mNegData;
 
 	class OPCODE_API AABBCollisionNode
 	{
@@ -121,12 +125,18 @@
 		override(AABBOptimizedTree)	bool			Refit(const MeshInterface* mesh_interface);						\
 		/* Walks the tree */																						\
 		override(AABBOptimizedTree)	bool			Walk(GenericWalkingCallback callback, void* user_data) const;	\
+		/* Uses an external node array (e.g. a mapped file) without copying or owning it */							\
+									bool			Attach(const node* nodes, udword nb_nodes);						\
 		/* Data access */																							\
 		inline_						const node*		GetNodes()		const	{ return mNodes;					}	\
+		inline_						bool			IsAttached()	const	{ return mAttached;					}	\
 		/* Stats */																									\
 		override(AABBOptimizedTree)	udword			GetUsedBytes()	const	{ return mNbNodes*sizeof(node);		}	\
 		private:																									\
-									node*			mNodes;
+									void			ReleaseNodes();													\
+									bool			DetachNodes();													\
+									node*			mNodes;															\
+									bool			mAttached;
 
 	typedef		bool				(*GenericWalkingCallback)	(const void* current, void* user_data);
 
@@ -183,6 +193,13 @@
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBNoLeafTree, AABBNoLeafNode)
+
+		public:
+		// ODE: partial updates of deforming meshes. The nodes of a subtree occupy a contiguous range starting at its root.
+		/* Refits the listed nodes only, in the list order (descendants must come before their ancestors) */
+									bool			RefitNodes(const MeshInterface* mesh_interface, const udword* indices, udword nb_indices);
+		/* Replaces the nodes of the subtree rooted at root_index with a subtree of the same size built separately */
+									bool			ReplaceSubtree(udword root_index, const AABBNoLeafNode* nodes, udword nb_nodes);
 	};
 
 	class OPCODE_API AABBQuantizedTree : public AABBOptimizedTree
@@ -297,6 +297,7 @@ ODE_API dSpaceID dGeomGetSpace (dGeomID);
  *  @li dQuadTreeSpaceClass
  *  @li dFirstUserClass
  *  @li dLastUserClass
+ *  @li dDynamicTreeSpaceClass
  *
  * User-defined class will return their own number.
  *
@@ -792,6 +793,101 @@ ODE_API void dGeomGetOffsetQuaternion (dGeomID geom, dQuaternion result);
 ODE_API int dCollide (dGeomID o1, dGeomID o2, int flags, dContactGeom *contact,
 	      int skip);
 
+/**
+ * @brief Given an array of geom pairs, generates contact information for 
+ * all of them at once.
+ *
+ * Each pair is collided as with dCollide. The pairs are processed grouped 
+ * by their geom classes and, if a world is given, split among up to 
+ * @a max_thread_count threads of the threading implementation assigned to it 
+ * with dWorldSetStepThreadingImplementation. The calling thread takes part.
+ *
+ * @param world The world whose threading implementation is to be used or 
+ * NULL to collide all the pairs on the calling thread.
+ * @param max_thread_count The maximal number of threads to use.
+ * @param pairs The geom pairs as an o1,o2 sequence of 2 * @a pair_count geoms.
+ * @param pair_count The number of pairs.
+ * @param flags The same as in dCollide. The lower 16 bits are the maximal 
+ * contact count per pair.
+ * @param contacts Points to an array of at least @a pair_count times the 
+ * maximal contact count dContactGeom structures. The array is used as 
+ * a scratch pad as well so all of it may be modified.
+ * @param pair_offsets Points to an array of @a pair_count + 1 elements. 
+ * On return, the contacts of the pair i are the elements 
+ * contacts[pair_offsets[i]] to contacts[pair_offsets[i + 1] - 1].
+ *
+ * @returns The total number of the contacts generated, the same as
+ * pair_offsets[pair_count].
+ *
+ * @remarks The threads of the pool must have collision data allocated 
+ * (see dAllocateFlagCollisionData) for the geom classes that need it.
+ * The geoms must not be modified until the function returns. A geom, 
+ * a heightfield included, may be in several pairs as the pairs sharing 
+ * it may be collided concurrently. The exception are the trimeshes with 
+ * temporal coherence enabled (see dGeomTriMeshEnableTC): their colliders 
+ * update the caches of the trimesh, so all the pairs with such a trimesh 
+ * are collided by the calling thread.
+ *
+ * @sa dCollide
+ * @ingroup collide
+ */
+ODE_API unsigned dCollideBatch (dWorldID world, unsigned max_thread_count, 
+                                const dGeomID *pairs, unsigned pair_count, int flags, 
+                                dContactGeom *contacts, unsigned *pair_offsets);
+
+/**
+ * @brief The closest hit of a ray cast with dSpaceRaycastBatch.
+ * @ingroup collide
+ */
+typedef struct dRaycastHit {
+  dGeomID geom;     /**< The geom hit or NULL if the ray hit nothing */
+  dVector3 pos;     /**< The hit point */
+  dVector3 normal;  /**< The normal as a ray collision with dCollide gives it */
+  dReal depth;      /**< The distance of the hit point from the ray origin */
+} dRaycastHit;
+
+/**
+ * @brief Casts an array of rays against all the geoms of a space and 
+ * finds the closest hit of every ray.
+ *
+ * The result of a ray is the same as colliding a ray geom with the 
+ * "closest hit" flag set (see dGeomRaySetClosestHit) with every geom of the 
+ * space and keeping the contact of the smallest depth. The enabled geoms 
+ * of the nested spaces are included too while the ray geoms are not. 
+ * Consecutive rays are traversed together so the rays should be ordered 
+ * by their origins and directions (e.g. by the scan lines of a sensor) 
+ * for the best performance. If a world is given, the rays are split among 
+ * up to @a max_thread_count threads of the threading implementation 
+ * assigned to it with dWorldSetStepThreadingImplementation. The calling 
+ * thread takes part.
+ *
+ * @param world The world whose threading implementation is to be used or 
+ * NULL to cast all the rays on the calling thread.
+ * @param max_thread_count The maximal number of threads to use.
+ * @param space The space whose geoms are to be tested.
+ * @param origins The ray origins as 3 values per ray.
+ * @param directions The ray directions as 3 values per ray. They do not 
+ * need to be normalized. A ray with a zero direction hits nothing.
+ * @param lengths The ray lengths.
+ * @param ray_count The number of rays.
+ * @param collide_bits Only the geoms whose category bits have any of 
+ * these bits set are tested.
+ * @param hits Points to an array of @a ray_count structures for the results.
+ *
+ * @returns The number of the rays that hit a geom.
+ *
+ * @remarks The threads of the pool must have collision data allocated 
+ * (see dAllocateFlagCollisionData) for the geom classes that need it.
+ * The geoms must not be modified until the function returns.
+ *
+ * @sa dCollide
+ * @sa dCollideBatch
+ * @ingroup collide
+ */
+ODE_API unsigned dSpaceRaycastBatch (dWorldID world, unsigned max_thread_count, dSpaceID space, 
+                                     const dReal *origins, const dReal *directions, const dReal *lengths, 
+                                     unsigned ray_count, unsigned long collide_bits, dRaycastHit *hits);
+
 /**
  * @brief Determines which pairs of geoms in a space may potentially intersect,
  * and calls the callback function for each candidate pair.
@@ -821,6 +917,47 @@ ODE_API int dCollide (dGeomID o1, dGeomID o2, int flags, dContactGeom *contact,
  */
 ODE_API void dSpaceCollide (dSpaceID space, void *data, dNearCallback *callback);
 
+/**
+ * @brief Determines which pairs of geoms in a space may potentially intersect
+ * and calls the callback function for each candidate pair from the threads 
+ * of the world's threading implementation.
+ *
+ * The candidate pairs are collected on the calling thread first. Then the callback 
+ * calls are split among up to @a max_thread_count threads, the calling thread 
+ * included, of the threading implementation assigned to the world with 
+ * dWorldSetStepThreadingImplementation. If the world has no multi-threaded 
+ * implementation assigned, all the calls are made on the calling thread with 
+ * thread index 0. The function returns after all the callbacks complete.
+ *
+ * @param space The space to test.
+ * @param world The world whose threading implementation is to be used.
+ * @param max_thread_count The maximal number of threads to use. The thread 
+ * indices passed to the callback are less than this value.
+ * @param data Passed directly to the callback function.
+ * @param callback A callback function is of type @ref dThreadedNearCallback.
+ *
+ * @remarks The threads of the pool must have collision data allocated 
+ * (see dAllocateFlagCollisionData) for dCollide to be called from the callback.
+ *
+ * @remarks The same geom may be passed to the callback from several threads 
+ * at once. The heightfield collisions leave both geoms untouched so the pairs 
+ * sharing a heightfield or the geom colliding it may be collided concurrently.
+ * The trimeshes with temporal coherence enabled (see dGeomTriMeshEnableTC) 
+ * are an exception as their colliders update the caches of the trimesh. All 
+ * the pairs with such a trimesh are passed to the callback on the calling 
+ * thread with thread index 0. This does not extend to the trimeshes within 
+ * the contained spaces passed to the callback: the callback must not collide 
+ * these from several threads at once.
+ *
+ * @remarks The space must not be modified until the function returns.
+ *
+ * @sa dSpaceCollide
+ * @sa dWorldSetStepThreadingImplementation
+ * @ingroup collide
+ */
+ODE_API void dSpaceCollideThreaded (dSpaceID space, dWorldID world, unsigned max_thread_count, 
+                                    void *data, dThreadedNearCallback *callback);
+
 
 /**
  * @brief Determines which geoms from one space may potentially intersect with 
@@ -895,6 +1032,10 @@ enum {
 
   dFirstUserClass,
   dLastUserClass = dFirstUserClass + dMaxUserClasses - 1,
+
+  /* the classes added later follow the user ones to keep the numbers above */
+  dDynamicTreeSpaceClass,
+
   dGeomNumClasses
 };
 
@@ -1124,6 +1265,26 @@ typedef struct dxHeightfieldData* dHeightfieldDataID;
 typedef dReal dHeightfieldGetHeight( void* p_user_data, int x, int z );
 
 
+/**
+ * @brief Tile callback prototype
+ *
+ * Used by the tiled heightfield data type to load the samples of a tile
+ * when it is first needed or after it has been evicted from the tile cache.
+ *
+ * @param p_user_data User data specified when creating the dHeightfieldDataID
+ * @param tile_x The index of the tile along the local x axis. The tile 
+ * holds the samples from tile_x * tileSamples along the x axis.
+ * @param tile_z The index of the tile along the local z axis.
+ * @param tile_heights The array of tileSamples * tileSamples sample heights 
+ * to be filled, by rows along the z axis (the sample x, z of the tile goes 
+ * to tile_heights[z * tileSamples + x]). The samples beyond the heightfield 
+ * edges are not used.
+ *
+ * @ingroup collide
+ */
+typedef void dHeightfieldGetTile( void* p_user_data, int tile_x, int tile_z, dReal* tile_heights );
+
+
 
 /**
  * @brief Creates a heightfield geom.
@@ -1220,6 +1381,71 @@ ODE_API void dGeomHeightfieldDataBuildCallback( dHeightfieldDataID d,
 				dReal width, dReal depth, int widthSamples, int depthSamples,
 				dReal scale, dReal offset, dReal thickness, int bWrap );
 
+/**
+ * @brief Configures a dHeightfieldDataID to load the height data 
+ * by tiles through a callback.
+ *
+ * The samples are split into square tiles which are loaded with the 
+ * callback when they are first needed. Up to @a maxCachedTiles tiles are 
+ * kept in a cache and the least recently used one is replaced when another 
+ * tile has to be loaded, so the memory used does not depend on the size 
+ * of the heightfield.
+ *
+ * @remarks The height bounds are +/- infinity as for the callback 
+ * heightfields until set with dGeomHeightfieldDataSetBounds. The tile 
+ * cache is shared by the threads colliding the heightfields using the 
+ * data and the callback is never called by two of them at once. The tiles 
+ * being read by collisions in progress are not replaced, so when all the 
+ * cached tiles are in use a thread loads the tile it needs aside and 
+ * more than @a maxCachedTiles tiles may be in memory for a while.
+ *
+ * @param d A new dHeightfieldDataID created by dGeomHeightfieldDataCreate
+ * @param pUserData The value passed to the callback.
+ * @param pTileCallback The function to load a tile.
+ * @param tileSamples The tile side in samples.
+ * @param maxCachedTiles The maximal number of tiles kept in memory; 
+ * at least one.
+ *
+ * The other parameters are the same as for dGeomHeightfieldDataBuildCallback.
+ *
+ * @ingroup collide
+ */
+ODE_API void dGeomHeightfieldDataBuildTiled( dHeightfieldDataID d,
+				void* pUserData, dHeightfieldGetTile* pTileCallback, 
+				int tileSamples, int maxCachedTiles,
+				dReal width, dReal depth, int widthSamples, int depthSamples,
+				dReal scale, dReal offset, dReal thickness, int bWrap );
+
+/**
+ * @brief Configures a dHeightfieldDataID to read the height data 
+ * by tiles from a memory mapped file.
+ *
+ * The file holds the samples as single precision floats in the native 
+ * byte order, tile after tile by tile rows along the local z axis, each 
+ * tile being laid out as for the dHeightfieldGetTile callback. The tiles 
+ * at the far edges are padded to the full size. The file is mapped 
+ * into memory and the system loads the pages of the tiles as they are 
+ * accessed.
+ *
+ * @remarks The height bounds are +/- infinity as for the callback 
+ * heightfields until set with dGeomHeightfieldDataSetBounds.
+ *
+ * @param d A new dHeightfieldDataID created by dGeomHeightfieldDataCreate
+ * @param fileName The name of the tile file.
+ * @param tileSamples The tile side in samples.
+ *
+ * The other parameters are the same as for dGeomHeightfieldDataBuildCallback.
+ *
+ * @return Non-zero on success or zero if the file could not be mapped or 
+ * is too small for the given sample counts. The data are not changed then.
+ *
+ * @ingroup collide
+ */
+ODE_API int dGeomHeightfieldDataBuildTiledFile( dHeightfieldDataID d,
+				const char* fileName, int tileSamples,
+				dReal width, dReal depth, int widthSamples, int depthSamples,
+				dReal scale, dReal offset, dReal thickness, int bWrap );
+
 /**
  * @brief Configures a dHeightfieldDataID to use height data in byte format.
  *
@@ -1428,6 +1654,11 @@ ODE_API void dGeomHeightfieldDataBuildDouble( dHeightfieldDataID d,
  * for the heightfield which is used for early rejection of collisions.
  * A close fit will yield a more efficient collision check.
  *
+ * @remarks The sample heightfields keep a hierarchy of the sample height 
+ * bounds built with the data to skip the cells that cannot touch a geom. 
+ * As this call indicates that the samples may have been changed, the 
+ * hierarchy is discarded then and such collisions test all the cells.
+ *
  * @param d A dHeightfieldDataID created by dGeomHeightfieldDataCreate
  * @param min_height The new minimum height value. Scale, offset and thickness is then applied.
  * @param max_height The new maximum height value. Scale and offset is then applied.
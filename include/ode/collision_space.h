@@ -48,6 +48,24 @@ struct dContactGeom;
  */
 typedef void dNearCallback (void *data, dGeomID o1, dGeomID o2);
 
+/**
+ * @brief User callback for geom-geom collision testing in multiple threads.
+ *
+ * @param data         The user data object, as passed to dSpaceCollideThreaded.
+ * @param thread_index The index of the calling thread, less than the thread count 
+ *                     passed to dSpaceCollideThreaded. No two callbacks with the 
+ *                     same index are ever executed simultaneously.
+ * @param o1           The first geom being tested.
+ * @param o2           The second geom being tested.
+ *
+ * @remarks The thread index can be used to select per-thread contact buffers.
+ * The contact joints must not be created in the callback unless the access to 
+ * the world and the joint group is serialized.
+ *
+ * @ingroup collide
+ */
+typedef void dThreadedNearCallback (void *data, unsigned thread_index, dGeomID o1, dGeomID o2);
+
 
 ODE_API dSpaceID dSimpleSpaceCreate (dSpaceID space);
 ODE_API dSpaceID dHashSpaceCreate (dSpaceID space);
@@ -65,6 +83,52 @@ ODE_API dSpaceID dQuadTreeSpaceCreate (dSpaceID space, const dVector3 Center, co
 
 ODE_API dSpaceID dSweepAndPruneSpaceCreate( dSpaceID space, int axisorder );
 
+/**
+ * @brief Switches the incremental mode of a sweep and prune space.
+ *
+ * By default the space sorts all the geoms anew at every collide call.
+ * In the incremental mode it keeps the boxes sorted on all three axes 
+ * and the overlapping pairs between the calls and updates them by 
+ * insertion sort as the geoms move. This is cheaper for the scenes where 
+ * few geoms move far between the steps and more expensive for the ones 
+ * with fast moving geoms.
+ *
+ * @param space A sweep and prune space.
+ * @param incremental Non-zero to enable the incremental mode.
+ * @ingroup collide
+ */
+ODE_API void dSweepAndPruneSpaceSetIncremental( dSpaceID space, int incremental );
+ODE_API int dSweepAndPruneSpaceGetIncremental( dSpaceID space );
+
+/**
+ * @brief Creates a dynamic AABB tree space.
+ *
+ * The space keeps its geoms in a balanced bounding box tree. The boxes
+ * of the tree leaves are enlarged by a margin and a geom is only 
+ * reinserted into the tree when it leaves its enlarged box. This makes 
+ * the space suitable for large scenes with few moving geoms and it does 
+ * not need any extents to be specified in advance.
+ *
+ * @param space The parent space or 0.
+ * @sa dDynamicTreeSpaceSetMargin
+ * @ingroup collide
+ */
+ODE_API dSpaceID dDynamicTreeSpaceCreate (dSpaceID space);
+
+/**
+ * @brief Sets the margin the tree leaf boxes are enlarged by at each side.
+ *
+ * Larger margins reduce the number of reinsertions of the moving geoms 
+ * at the cost of more candidate pairs to be tested. The value affects the 
+ * geoms reinserted after the call. The default is 0.1.
+ *
+ * @param space A dynamic tree space.
+ * @param margin The margin value, not negative.
+ * @ingroup collide
+ */
+ODE_API void dDynamicTreeSpaceSetMargin (dSpaceID space, dReal margin);
+ODE_API dReal dDynamicTreeSpaceGetMargin (dSpaceID space);
+
 
 
 ODE_API void dSpaceDestroy (dSpaceID);
@@ -146,6 +210,52 @@ ODE_API void dSpaceSetManualCleanup (dSpaceID space, int mode);
 */
 ODE_API int dSpaceGetManualCleanup (dSpaceID space);
 
+/**
+* @brief Pair cache modes of a space.
+* @see dSpaceSetPairCacheMode
+*/
+enum
+{
+    dSpacePairCacheDisabled = 0,    /* No pair cache, each dSpaceCollide finds the pairs from scratch */
+    dSpacePairCacheAllPairs = 1,    /* The cached pairs are all reported */
+    dSpacePairCacheMovingPairs = 2  /* Only the cached pairs with at least one geom moved are reported */
+};
+
+/**
+* @brief Sets the broadphase pair cache mode of a space.
+*
+* With the pair cache enabled the space keeps the pairs of its geoms with 
+* overlapping AABBs between the @c dSpaceCollide calls. On each call only the 
+* geoms that have moved (or have been added) since the previous call are 
+* tested against the space and their pairs are updated. The cost of the 
+* broadphase then depends on the number of geoms moved rather than on the 
+* total number of geoms in the space.
+*
+* In @c dSpacePairCacheMovingPairs mode the callback is only called for the 
+* pairs with at least one geom moved since the previous call. The contacts 
+* of the pairs of geoms at rest should be retained by the user then.
+*
+* Geom enabled state, category/collide bits and body assignment are checked 
+* at the time the pairs are reported and may change freely.
+*
+* @param space the space to modify
+* @param mode one of dSpacePairCache... constants
+* @ingroup collide
+* @see dSpaceGetPairCacheMode
+* @see dSpaceCollide
+*/
+ODE_API void dSpaceSetPairCacheMode (dSpaceID space, int mode);
+
+/**
+* @brief Gets the broadphase pair cache mode of a space.
+*
+* @param space the space to query
+* @returns the pair cache mode (one of dSpacePairCache... constants)
+* @ingroup collide
+* @see dSpaceSetPairCacheMode
+*/
+ODE_API int dSpaceGetPairCacheMode (dSpaceID space);
+
 ODE_API void dSpaceAdd (dSpaceID, dGeomID);
 ODE_API void dSpaceRemove (dSpaceID, dGeomID);
 ODE_API int dSpaceQuery (dSpaceID, dGeomID);
@@ -163,9 +273,12 @@ ODE_API dGeomID dSpaceGetGeom (dSpaceID, int i);
  *  @li dQuadTreeSpaceClass
  *  @li dFirstUserClass
  *  @li dLastUserClass
+ *  @li dDynamicTreeSpaceClass
  *
  * The class id not defined by the user should be between
- * dFirstSpaceClass and dLastSpaceClass.
+ * dFirstSpaceClass and dLastSpaceClass, or be dDynamicTreeSpaceClass 
+ * (which follows the user classes so that their numbers are kept).
+ * dGeomIsSpace tells the spaces from the other geoms for all the classes.
  *
  * User-defined class will return their own number.
  *
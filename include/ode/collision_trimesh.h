@@ -201,6 +201,44 @@ ODE_API int dGeomTriMeshDataPreprocess(dTriMeshDataID g);
 
 
 
+/*
+ * Serialize the collision tree of the data together with the preprocessed data
+ * (the concave edge flags and the face angles, if built) into a relocatable 
+ * binary image. The vertices, the indices and the normals are not included.
+ *
+ * The image is only written if buffer_size is large enough; pass a NULL buffer
+ * to query the size. The function returns the image size or zero if the data 
+ * has not been built or the collider does not support serialization (GIMPACT).
+ */
+ODE_API dsizeint dGeomTriMeshDataSerialize(dTriMeshDataID g, void *buffer, dsizeint buffer_size);
+
+/*
+ * Build a TriMesh data object using an image written by dGeomTriMeshDataSerialize()
+ * instead of building the collision tree and preprocessing the data anew.
+ * The vertices and the indices must be the same the image has been written for;
+ * the vertex precision is the one the original data has been built with.
+ *
+ * The image is used in place, neither copied nor modified, and must stay valid and 
+ * unchanged for the lifetime of the data. It must be aligned at 8 bytes at least.
+ * dGeomTriMeshDataUpdate() makes a private copy of the tree before refitting it.
+ *
+ * The function returns 0 and leaves the data unbuilt if the image has a different 
+ * version or byte order or does not match the vertex and the triangle counts. 
+ * The tree nodes are not verified: images must come from trusted storage.
+ */
+ODE_API int dGeomTriMeshDataBuildFromImage(dTriMeshDataID g,
+                                  const void* Vertices, int VertexStride, int VertexCount, 
+                                  const void* Indices, int IndexCount, int TriStride,
+                                  const void* Normals,
+                                  const void *image, dsizeint image_size);
+/* same again with the image memory-mapped read-only from a file (shared by the processes mapping it) */
+ODE_API int dGeomTriMeshDataBuildFromImageFile(dTriMeshDataID g,
+                                  const void* Vertices, int VertexStride, int VertexCount, 
+                                  const void* Indices, int IndexCount, int TriStride,
+                                  const void* Normals,
+                                  const char *file_name);
+
+
 /*
  * Get and set the internal preprocessed trimesh data buffer (see the enumerated type above), for loading and saving 
  * These functions are deprecated. Use dGeomTriMeshDataSet/dGeomTriMeshDataGet2 with dTRIMESHDATA_USE_FLAGS instead.
@@ -308,6 +346,45 @@ ODE_API int dGeomTriMeshGetTriangleCount (dGeomID g);
 
 ODE_API void dGeomTriMeshDataUpdate(dTriMeshDataID g);
 
+/*
+ * Switch the data to the deformable mode, for meshes whose vertices move every 
+ * frame (cloth, soft terrain patches). The data must have been built with 
+ * dGeomTriMeshDataBuild...(); building it again turns the mode off.
+ *
+ * The collision tree is split into subtrees of up to subtree_triangle_count 
+ * triangles (zero selects the default of 256). dGeomTriMeshDataUpdateDeformable() 
+ * refits only the subtrees of the triangles using the vertices marked with 
+ * dGeomTriMeshDataMarkVerticesDirty() and tracks the quality of every subtree 
+ * as its surface area heuristic cost. A subtree whose cost has grown more than 
+ * rebuild_cost_ratio times since it was built is rebuilt; pass dInfinity to 
+ * never rebuild the subtrees.
+ *
+ * The function returns 0 if the tree cannot be updated partially: GIMPACT trees, 
+ * single triangle meshes and data built from an image with a quantized tree.
+ */
+ODE_API int dGeomTriMeshDataEnableDeformable(dTriMeshDataID g, int subtree_triangle_count, dReal rebuild_cost_ratio);
+ODE_API void dGeomTriMeshDataDisableDeformable(dTriMeshDataID g);
+
+/* Mark the vertices changed since the last update of a deformable data */
+ODE_API void dGeomTriMeshDataMarkVerticesDirty(dTriMeshDataID g, int first_vertex, int vertex_count);
+
+/*
+ * Update a deformable data after the vertices marked have changed. The subtree 
+ * rebuilds started are run by the threading implementation of the world given 
+ * (see dWorldSetStepThreadingImplementation) while the old subtrees stay in use, 
+ * and are put in place by one of the next calls once they have completed. 
+ * With a NULL world they are run and put in place at once.
+ *
+ * The world must not be destroyed while rebuilds started with it are pending; 
+ * dGeomTriMeshDataDisableDeformable() and dGeomTriMeshDataDestroy() wait for them.
+ * dGeomTriMeshDataUpdate() updates a deformable data as this function does with 
+ * a NULL world, with all the vertices assumed changed if none have been marked.
+ *
+ * The function returns the number of rebuilt subtrees put in place.
+ * It falls back to dGeomTriMeshDataUpdate() for data that is not deformable.
+ */
+ODE_API int dGeomTriMeshDataUpdateDeformable(dTriMeshDataID g, dWorldID world);
+
 #ifdef __cplusplus
 }
 #endif
@@ -427,6 +427,128 @@ ODE_API int dWorldStep (dWorldID w, dReal stepsize);
 ODE_API int dWorldQuickStep (dWorldID w, dReal stepsize);
 
 
+/**
+ * @brief The parts of a step timed by the step profiler.
+ *
+ * The stages form a tree: the comment of each stage names its parent.
+ * The island stepper stages are numbered as they are in the sources
+ * (quickstep.cpp and step.cpp).
+ * @ingroup world
+ * @see dWorldSetStepProfiling
+ */
+enum
+{
+    dStepProfileStageTotal = 0,           /*< the whole dWorldStep or dWorldQuickStep call */
+    dStepProfileStageAutoDisable,         /*< sampling and disabling the idle bodies; part of Total */
+    dStepProfileStageIslandBuild,         /*< finding the islands; part of Total */
+    dStepProfileStageIslandStepping,      /*< handing the islands to the stepper; part of Total */
+    dStepProfileStageQuickStep0,          /*< body and joint preprocessing; part of IslandStepping */
+    dStepProfileStageQuickStep1,          /*< joint information and memory setup; part of IslandStepping */
+    dStepProfileStageQuickStep2,          /*< Jacobian and right hand side; part of IslandStepping */
+    dStepProfileStageQuickStep3,          /*< LCP setup; part of IslandStepping */
+    dStepProfileStageQuickStep4,          /*< SOR LCP iterations; part of IslandStepping */
+    dStepProfileStageQuickStep5,          /*< velocity update setup; part of IslandStepping */
+    dStepProfileStageQuickStep6,          /*< velocity update; part of IslandStepping */
+    dStepProfileStageStep0,               /*< body and joint preprocessing; part of IslandStepping */
+    dStepProfileStageStep1,               /*< joint information and memory setup; part of IslandStepping */
+    dStepProfileStageStep2,               /*< Jacobian, LCP matrix and right hand side; part of IslandStepping */
+    dStepProfileStageStep3,               /*< LCP solving; part of IslandStepping */
+    dStepProfileStageStep4,               /*< constraint forces, velocity and position update; part of IslandStepping */
+    dStepProfileStageBodyIntegration,     /*< QuickStep position update; part of IslandStepping */
+
+    dStepProfileStage__MAX
+};
+
+/**
+ * @brief Timings of a step profiler stage.
+ * @ingroup world
+ * @see dWorldGetStepProfileStage
+ */
+typedef struct dStepProfileStageInfo {
+  int parent;           /* the parent stage or -1 for dStepProfileStageTotal */
+  unsigned callCount;   /* the number of times a thread entered the stage */
+  double wallTime;      /* seconds from the first entry into the stage to the last exit from it */
+  double selfTime;      /* seconds spent in the stage but not in its nested stages, summed over the threads */
+  double totalTime;     /* selfTime plus the totalTime of the child stages */
+} dStepProfileStageInfo;
+
+/**
+ * @brief Enable or disable the step profiler of a world.
+ *
+ * When enabled, dWorldStep and dWorldQuickStep record the time spent in each
+ * of their stages (see dStepProfileStageTotal and the following values) by
+ * each thread that works on the step. The results of the latest step can be
+ * retrieved with dWorldGetStepProfileStage and dWorldGetStepProfileThreadTime.
+ *
+ * Time spent by a thread in a stage nested into another one (e.g. the auto
+ * disabling done while the islands are built) is only counted for the inner
+ * stage. The time the calling thread waits for the workers is counted for
+ * dStepProfileStageTotal.
+ *
+ * The profiler does not cost anything but a pointer check when disabled.
+ * When enabled, the thread time stamps are taken on every stage entry and
+ * exit. The threads are told apart by their system identifiers, and up to
+ * dSTEP_PROFILE_MAX_THREADS threads are recorded at a time. If more threads
+ * enter the stages of a step, the ones beyond that are not recorded for it
+ * and the threads that did not work on it are forgotten before the next
+ * step to make room. Re-enabling the profiler forgets the threads seen so far.
+ * @ingroup world
+ * @param enabled Nonzero to enable the profiler. It is disabled by default.
+ * @see dWorldGetStepProfiling
+ */
+ODE_API void dWorldSetStepProfiling (dWorldID w, int enabled);
+
+/**
+ * @brief Check whether the step profiler of a world is enabled.
+ * @ingroup world
+ * @see dWorldSetStepProfiling
+ */
+ODE_API int dWorldGetStepProfiling (dWorldID w);
+
+#define dSTEP_PROFILE_MAX_THREADS 64
+
+/**
+ * @brief Get the timings of a stage of the latest profiled step.
+ * @ingroup world
+ * @param stage One of dStepProfileStage... values
+ * @param info The structure to be filled.
+ * @returns 1 if the timings are available or 0 if the profiler is disabled
+ * or no step has completed since it was enabled.
+ * @see dWorldSetStepProfiling
+ */
+ODE_API int dWorldGetStepProfileStage (dWorldID w, int stage, dStepProfileStageInfo *info);
+
+/**
+ * @brief Get the number of threads the step profiler has seen.
+ *
+ * The threads keep their indices for as long as the profiler stays enabled
+ * and they are not forgotten (see dWorldSetStepProfiling), so values of the
+ * same thread can be tracked over steps. The indices of the forgotten threads
+ * report zero times until other threads take them.
+ * @ingroup world
+ * @see dWorldGetStepProfileThreadTime
+ */
+ODE_API unsigned dWorldGetStepProfileThreadCount (dWorldID w);
+
+/**
+ * @brief Get the time a thread spent in a stage during the latest profiled step.
+ * @ingroup world
+ * @param thread_index The thread index, less than dWorldGetStepProfileThreadCount().
+ * @param stage One of dStepProfileStage... values
+ * @returns The self time of the stage in seconds (see dStepProfileStageInfo).
+ * @see dWorldSetStepProfiling
+ */
+ODE_API double dWorldGetStepProfileThreadTime (dWorldID w, unsigned thread_index, int stage);
+
+/**
+ * @brief Get a name of a step profiler stage for reports.
+ * @ingroup world
+ * @param stage One of dStepProfileStage... values
+ * @returns A static string.
+ */
+ODE_API const char *dStepProfileStageName (int stage);
+
+
 /**
 * @brief Converts an impulse to a force.
 * @ingroup world
@@ -448,6 +570,92 @@ ODE_API void dWorldImpulseToForce
  );
 
 
+/**
+ * @brief Per-body state arrays for the bulk body state functions.
+ *
+ * Every member that is not NULL points to an array holding the given 
+ * number of values per body, for the bodies in the order they are passed. 
+ * The NULL members are skipped.
+ * @ingroup world
+ */
+typedef struct dBodyStates {
+  dReal *pos;     /* 3 per body, the position */
+  dReal *q;       /* 4 per body, the quaternion */
+  dReal *R;       /* 12 per body, the rotation as a dMatrix3 */
+  dReal *lvel;    /* 3 per body, the linear velocity */
+  dReal *avel;    /* 3 per body, the angular velocity */
+  dReal *force;   /* 3 per body, the accumulated force */
+  dReal *torque;  /* 3 per body, the accumulated torque */
+  dReal *invMass; /* 1 per body, the inverse mass */
+  dReal *invI;    /* 12 per body, the body frame inverse inertia as a dMatrix3 */
+} dBodyStates;
+
+/**
+ * @brief Get the IDs of the bodies of a world.
+ *
+ * The order is the same as long as no bodies are created or destroyed so 
+ * the list may be kept for use with the bulk body state functions.
+ * @ingroup world
+ * @param bodies The array to receive the IDs, may be NULL if 
+ * @a max_count is zero.
+ * @param max_count The size of the array.
+ * @returns The number of bodies in the world. Only the first 
+ * @a max_count of them are stored if there are more.
+ */
+ODE_API int dWorldGetBodies (dWorldID, dBodyID *bodies, int max_count);
+
+/**
+ * @brief Get the states of many bodies of a world at once.
+ *
+ * This is equivalent to calling dBodyGetPosition, dBodyGetQuaternion, 
+ * etc. for every body and copying the results, only faster.
+ * @ingroup world
+ * @param bodies The bodies, all in the world.
+ * @param count The number of the bodies.
+ * @param states The arrays to store the states to.
+ */
+ODE_API void dWorldGetBodyStates (dWorldID, const dBodyID *bodies, int count, const dBodyStates *states);
+
+/**
+ * @brief Set the accumulated forces and torques of many bodies at once.
+ *
+ * This is equivalent to calling dBodySetForce and dBodySetTorque for 
+ * every body.
+ * @ingroup world
+ * @param bodies The bodies, all in the world.
+ * @param count The number of the bodies.
+ * @param forces 3 values per body or NULL to leave the forces as they are.
+ * @param torques 3 values per body or NULL to leave the torques as they are.
+ */
+ODE_API void dWorldSetBodyForces (dWorldID, const dBodyID *bodies, int count, const dReal *forces, const dReal *torques);
+
+/**
+ * @brief Add forces and torques to many bodies at once.
+ *
+ * This is equivalent to calling dBodyAddForce and dBodyAddTorque for 
+ * every body.
+ * @ingroup world
+ * @param bodies The bodies, all in the world.
+ * @param count The number of the bodies.
+ * @param forces 3 values per body or NULL to add no forces.
+ * @param torques 3 values per body or NULL to add no torques.
+ */
+ODE_API void dWorldAddBodyForces (dWorldID, const dBodyID *bodies, int count, const dReal *forces, const dReal *torques);
+
+/**
+ * @brief Set the linear and angular velocities of many bodies at once.
+ *
+ * This is equivalent to calling dBodySetLinearVel and dBodySetAngularVel 
+ * for every body.
+ * @ingroup world
+ * @param bodies The bodies, all in the world.
+ * @param count The number of the bodies.
+ * @param lvels 3 values per body or NULL to leave the linear velocities as they are.
+ * @param avels 3 values per body or NULL to leave the angular velocities as they are.
+ */
+ODE_API void dWorldSetBodyVelocities (dWorldID, const dBodyID *bodies, int count, const dReal *lvels, const dReal *avels);
+
+
 #define dWORLDQUICKSTEP_ITERATION_COUNT_DEFAULT                     20U
 
 /**
@@ -590,6 +798,140 @@ ODE_API void dWorldSetQuickStepW (dWorldID, dReal over_relaxation);
  */
 ODE_API dReal dWorldGetQuickStepW (dWorldID);
 
+
+/**
+ * @brief QuickStep warm starting modes.
+ * @ingroup world
+ * @see dWorldSetQuickStepWarmStarting
+ */
+enum
+{
+    dWorldQuickStepWarmStartNone      = 0x0, /*< every step starts from zero impulses (the default) */
+    dWorldQuickStepWarmStartJoints    = 0x1, /*< joints start from the impulses of the previous step */
+    dWorldQuickStepWarmStartContacts  = 0x2, /*< contacts start from the impulses of the matching contacts of the previous step */
+
+    dWorldQuickStepWarmStartAll       = dWorldQuickStepWarmStartJoints | dWorldQuickStepWarmStartContacts
+};
+
+#define dWORLDQUICKSTEP_WARM_STARTING_FACTOR_DEFAULT                0.9f
+#define dWORLDQUICKSTEP_WARM_STARTING_CONTACT_TOLERANCE_DEFAULT     0.01f
+
+/**
+ * @brief Select QuickStep warm starting mode.
+ * @ingroup world
+ * @remarks
+ * With warm starting, SOR iterations of QuickStep start from the constraint
+ * impulses of the previous step (scaled by the warm starting factor) rather 
+ * than from zero. For persistent contacts and joints this lets the solver 
+ * reach the same accuracy with fewer iterations.
+ *
+ * Contact joints are normally re-created on every step. For them the world
+ * keeps a cache of the impulses of the contacts solved at the last step.
+ * A new contact is matched to a cached one by the geom pair (in the same order)
+ * and the contact position within the distance set with
+ * @fn dWorldSetQuickStepWarmStartingContactTolerance. If there are several 
+ * candidates, the one with the same contact features (side1/side2) is preferred
+ * and then the nearest one. The impulses of a destroyed geom are not matched
+ * to a new geom even if it reuses the same memory. For that the contact geoms
+ * (g1/g2) must be valid or NULL when the contact joints are created while
+ * the contact warm starting is enabled.
+ *
+ * Warm starting definitely helps for motor-driven joints and stacks of objects.
+ * With high-friction contacts it may hurt though. Use with care.
+ *
+ * @param mode A combination of dWorldQuickStepWarmStart... flags. 
+ * The default is dWorldQuickStepWarmStartNone.
+ * @see dWorldGetQuickStepWarmStarting
+ */
+ODE_API void dWorldSetQuickStepWarmStarting (dWorldID w, int mode);
+
+/**
+ * @brief Get QuickStep warm starting mode.
+ * @ingroup world
+ * @returns the combination of dWorldQuickStepWarmStart... flags in effect
+ * @see dWorldSetQuickStepWarmStarting
+ */
+ODE_API int dWorldGetQuickStepWarmStarting (dWorldID w);
+
+/**
+ * @brief Set the factor the previous step impulses are multiplied by for QuickStep warm starting.
+ * @ingroup world
+ * @remarks
+ * Using a factor slightly less than one prevents jerkiness in motor-driven joints.
+ * @param factor A non-negative value. 
+ * The default is dWORLDQUICKSTEP_WARM_STARTING_FACTOR_DEFAULT.
+ * @see dWorldSetQuickStepWarmStarting
+ */
+ODE_API void dWorldSetQuickStepWarmStartingFactor (dWorldID w, dReal factor);
+
+/**
+ * @brief Get the QuickStep warm starting impulse factor.
+ * @ingroup world
+ * @returns the warm starting factor
+ */
+ODE_API dReal dWorldGetQuickStepWarmStartingFactor (dWorldID w);
+
+/**
+ * @brief Set the maximal distance between contact positions at consecutive steps
+ * for the contacts to be considered the same for QuickStep warm starting.
+ * @ingroup world
+ * @param tolerance A non-negative distance. 
+ * The default is dWORLDQUICKSTEP_WARM_STARTING_CONTACT_TOLERANCE_DEFAULT.
+ * @see dWorldSetQuickStepWarmStarting
+ */
+ODE_API void dWorldSetQuickStepWarmStartingContactTolerance (dWorldID w, dReal tolerance);
+
+/**
+ * @brief Get the QuickStep warm starting contact matching tolerance.
+ * @ingroup world
+ * @returns the contact matching distance
+ */
+ODE_API dReal dWorldGetQuickStepWarmStartingContactTolerance (dWorldID w);
+
+
+/**
+ * @brief QuickStep multithreaded iteration scheduling methods.
+ * @ingroup world
+ * @see dWorldSetQuickStepIterationScheduling
+ */
+enum
+{
+    dWorldQuickStepIterationSchedulingDependencyMap = 0, /*< rows are released in the solving order as the rows they depend on complete (the default) */
+    dWorldQuickStepIterationSchedulingColoring      = 1, /*< rows are grouped into colors of rows with no common bodies and each color is solved in parallel */
+
+    dWorldQuickStepIterationScheduling__MAX
+};
+
+/**
+ * @brief Select how QuickStep distributes SOR iterations among threads.
+ * @ingroup world
+ * @remarks
+ * With the default dWorldQuickStepIterationSchedulingDependencyMap a row
+ * can be solved after all the preceding rows sharing a body with it. The map
+ * follows the solving order closely and is rebuilt each time the order is
+ * shuffled, so the results match single-threaded ones well, but large
+ * contact piles, where most rows depend on each other,
+ * do not scale beyond a few threads.
+ *
+ * With dWorldQuickStepIterationSchedulingColoring the rows are colored
+ * once per step so that the rows of a color have no common bodies. Colors are
+ * then solved one after another with each color's rows solved by all
+ * the threads at once. The solving order is not shuffled between iterations.
+ *
+ * The setting only has effect if QuickStep is run with multiple threads.
+ * @param scheduling One of dWorldQuickStepIterationScheduling... values.
+ * @see dWorldGetQuickStepIterationScheduling
+ */
+ODE_API void dWorldSetQuickStepIterationScheduling (dWorldID w, int scheduling);
+
+/**
+ * @brief Get QuickStep multithreaded iteration scheduling method.
+ * @ingroup world
+ * @returns the dWorldQuickStepIterationScheduling... value in effect
+ * @see dWorldSetQuickStepIterationScheduling
+ */
+ODE_API int dWorldGetQuickStepIterationScheduling (dWorldID w);
+
 /* World contact parameter functions */
 
 /**
@@ -1716,6 +2058,29 @@ ODE_API dJointID dJointCreateSlider (dWorldID, dJointGroupID);
  */
 ODE_API dJointID dJointCreateContact (dWorldID, dJointGroupID, const dContact *);
 
+/**
+ * @brief Create contact joints for an array of contacts and attach them 
+ * at once.
+ *
+ * The result is the same as of calling dJointCreateContact and dJointAttach 
+ * for every contact, but the joints of a group are allocated many at a time 
+ * and the attachment checks for the joints being new are skipped.
+ *
+ * @ingroup joints
+ * @param dJointGroupID set to 0 to allocate the joints normally.
+ * If it is nonzero the joints are allocated in the given joint group.
+ * @param contacts The contacts to create the joints for.
+ * @param contact_count The number of the contacts.
+ * @param body_pairs The bodies to attach the joints to, two per contact 
+ * (either may be 0), or NULL to attach each joint to the bodies of its 
+ * contact's geoms.
+ * @param joints An array of @a contact_count elements to receive the joint 
+ * IDs or NULL if they are not needed.
+ */
+ODE_API void dJointCreateContactBatch (dWorldID, dJointGroupID, 
+                                       const dContact *contacts, unsigned contact_count, 
+                                       const dBodyID *body_pairs, dJointID *joints);
+
 /**
  * @brief Create a new joint of the hinge2 type.
  * @ingroup joints
@@ -220,6 +220,26 @@ public:
 };
 
 
+class dDynamicTreeSpace : public dSpace {
+  // intentionally undefined, don't use these
+  dDynamicTreeSpace (dDynamicTreeSpace &);
+  void operator= (dDynamicTreeSpace &);
+
+public:
+  dDynamicTreeSpace ()
+    { _id = (dGeomID) dDynamicTreeSpaceCreate (0); }
+  dDynamicTreeSpace (dSpace &space)
+    { _id = (dGeomID) dDynamicTreeSpaceCreate (space.id()); }
+  dDynamicTreeSpace (dSpaceID space)
+    { _id = (dGeomID) dDynamicTreeSpaceCreate (space); }
+
+  void setMargin (dReal margin)
+    { dDynamicTreeSpaceSetMargin (id(), margin); }
+  dReal getMargin() const
+    { return dDynamicTreeSpaceGetMargin (id()); }
+};
+
+
 class dSphere : public dGeom {
   // intentionally undefined, don't use these
   dSphere (dSphere &);
@@ -91,6 +91,26 @@ ODE_API dThreadingImplementationID dThreadingAllocateSelfThreadedImplementation(
  */
 ODE_API dThreadingImplementationID dThreadingAllocateMultiThreadedImplementation();
 
+/**
+ * @brief Allocates built-in work-stealing multi-threaded threading implementation object.
+ *
+ * The implementation is served the same way as the one returned by 
+ * @c dThreadingAllocateMultiThreadedImplementation and can be used in its place. 
+ * Instead of a single mutex protected job list, each serving thread keeps 
+ * the jobs that become ready in it in a lock-free deque of its own 
+ * and the idle threads steal jobs from the other threads' deques.
+ * This reduces contention when many short jobs are posted from many threads.
+ * 
+ * @returns ID of object allocated or NULL on failure
+ * 
+ * @ingroup threading
+ * @see dThreadingAllocateMultiThreadedImplementation
+ * @see dThreadingThreadPoolServeMultiThreadedImplementation
+ * @see dExternalThreadingServeMultiThreadedImplementation
+ * @see dThreadingFreeImplementation
+ */
+ODE_API dThreadingImplementationID dThreadingAllocateWorkStealingMultiThreadedImplementation();
+
 /**
  * @brief Retrieves the functions record of a built-in threading implementation.
  *
@@ -166,6 +186,57 @@ ODE_API void dThreadingImplementationCleanupForRestart(dThreadingImplementationI
  */
 ODE_API void dThreadingFreeImplementation(dThreadingImplementationID impl);
 
+/**
+ * @brief Enables or disables call tracing of a built-in threading implementation.
+ *
+ * While tracing is enabled, the implementation records an event for every
+ * posted call it executes, every call completion wait, every period a serving
+ * thread is blocked for the lack of ready calls and every wait for a call
+ * information structure to become free. The events have the thread, the
+ * beginning and end times and, for the calls and the waits, the names given 
+ * to them when posting or waiting (the stepper stage names for the calls 
+ * posted by ODE). They can be saved with @c dThreadingImplementationWriteTrace.
+ *
+ * The events are kept in an array allocated when tracing is enabled. The events
+ * that do not fit in it are dropped and only counted. Each call to the function
+ * discards the events recorded so far.
+ *
+ * The function must not be called while the implementation has calls
+ * scheduled or executing (e.g. during a step of a world it is assigned to).
+ * Tracing is disabled by default.
+ *
+ * @param impl Threading implementation ID
+ * @param max_event_count The number of events to keep or zero to disable tracing
+ * @returns 1 on success or 0 if the event array could not be allocated 
+ * (tracing is disabled in that case)
+ * 
+ * @ingroup threading
+ * @see dThreadingImplementationWriteTrace
+ */
+ODE_API int dThreadingImplementationSetTracing(dThreadingImplementationID impl, unsigned max_event_count);
+
+/**
+ * @brief Writes the recorded trace of a built-in threading implementation.
+ *
+ * The events are written in Chrome trace event JSON format, which can be 
+ * loaded in chrome://tracing or Perfetto UI. The times are in microseconds
+ * from the moment tracing was enabled, and each call has the time it waited 
+ * in the queue after being posted. The threads are numbered in the order of 
+ * their first events. The call and wait names must remain valid until
+ * the trace is written.
+ *
+ * The function must not be called while the implementation has calls
+ * scheduled or executing.
+ *
+ * @param impl Threading implementation ID
+ * @param file The file to write to
+ * @returns The number of events written, zero if tracing is not enabled or -1 on an output error
+ * 
+ * @ingroup threading
+ * @see dThreadingImplementationSetTracing
+ */
+ODE_API int dThreadingImplementationWriteTrace(dThreadingImplementationID impl, FILE *file);
+
 
 typedef void (dThreadReadyToServeCallback)(void *callback_context);
 
@@ -0,0 +1,788 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+ *  Dynamic AABB tree space.
+ *
+ *  The geoms are kept in the leaves of a binary tree of bounding boxes
+ *  that is balanced with AVL-like rotations as the leaves are inserted 
+ *  and removed. The leaf boxes are enlarged by a margin so that a geom 
+ *  moving within its enlarged ("fat") box does not need to be reinserted.
+ *  The candidate pairs are found with a traversal of the tree against itself.
+ *
+ *  The geoms with infinite AABBs (planes and alike) are not put in the tree.
+ *  They are kept in a separate list and are tested against the tree 
+ *  with a box query instead.
+ */
+
+#include <ode/common.h>
+#include <ode/collision_space.h>
+#include <ode/collision.h>
+
+#include "config.h"
+#include "matrix.h"
+#include "collision_kernel.h"
+#include "collision_space_internal.h"
+
+
+#define dDYNAMIC_TREE_DEFAULT_MARGIN REAL(0.1)
+
+
+// --------------------------------------------------------------------------
+//  Dynamic tree space code
+// --------------------------------------------------------------------------
+
+struct dxDynamicTreeSpace : public dxSpace
+{
+    // Constructor / Destructor
+    dxDynamicTreeSpace( dSpaceID _space );
+    ~dxDynamicTreeSpace();
+
+    // dxSpace
+    virtual void add(dxGeom* g);
+    virtual void remove(dxGeom* g);
+    virtual void cleanGeoms();
+    virtual void collide( void *data, dNearCallback *callback );
+    virtual void collide2( void *data, dxGeom *geom, dNearCallback *callback );
+    virtual void queryAABBOverlaps( dxGeom *geom, void *data, dxGeomOverlapCallback *callback );
+
+    void setMargin( dReal value ) { dUASSERT(value >= 0, "margin must not be negative"); margin = value; }
+    dReal getMargin() const { return margin; }
+
+private:
+
+    //--------------------------------------------------------------------------
+    // Local Declarations
+    //--------------------------------------------------------------------------
+
+    enum { NULL_NODE = -1 };
+
+    struct Node
+    {
+        dReal aabb[6];      // fat box for leaves, union of the children for the internal nodes
+        dxGeom *geom;       // leaves only
+        int parent;         // next free node for the nodes in the free list
+        int child1;
+        int child2;
+        int height;         // 0 for leaves, -1 for the free nodes
+
+        bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    //--------------------------------------------------------------------------
+    // Helpers
+    //--------------------------------------------------------------------------
+
+    int allocateNode();
+    void freeNode( int node );
+
+    void insertLeaf( int leaf );
+    void removeLeaf( int leaf );
+    int balance( int node );
+    void refitNode( int node );
+
+    void placeGeom( dxGeom *g );
+    void unplaceGeom( dxGeom *g );
+
+    void collideTreeWithItself( void *data, dNearCallback *callback );
+    void collideTreeWithGeom( dxGeom *geom, void *data, dNearCallback *callback );
+
+    //--------------------------------------------------------------------------
+    // Implementation Data
+    //--------------------------------------------------------------------------
+
+    dArray<Node> nodes;
+    int root;
+    int freeList;
+
+    // Geoms with infinite AABBs
+    dArray<dxGeom*> InfGeomList;
+
+    // The fat box enlargement at each side
+    dReal margin;
+};
+
+// Creation
+dSpaceID dDynamicTreeSpaceCreate( dxSpace* space ) {
+    return new dxDynamicTreeSpace( space );
+}
+
+void dDynamicTreeSpaceSetMargin( dxSpace* space, dReal margin )
+{
+    dAASSERT(space);
+    dUASSERT(space->type == dDynamicTreeSpaceClass, "argument must be a dynamic tree space");
+    ((dxDynamicTreeSpace*)space)->setMargin( margin );
+}
+
+dReal dDynamicTreeSpaceGetMargin( dxSpace* space )
+{
+    dAASSERT(space);
+    dUASSERT(space->type == dDynamicTreeSpaceClass, "argument must be a dynamic tree space");
+    return ((dxDynamicTreeSpace*)space)->getMargin();
+}
+
+
+//==============================================================================
+
+#define GEOM_ENABLED(g) (((g)->gflags & GEOM_ENABLE_TEST_MASK) == GEOM_ENABLE_TEST_VALUE)
+
+// HACK: We abuse 'next_ex' and 'tome_ex' members of dxGeom to store the tree leaf and infinite list indices.
+// The indices are stored incremented by one so that the zeros that the geoms are created with mean "not placed".
+#define GEOM_SET_LEAF_IDX(g,idx) { (g)->tome_ex = (dxGeom**)(sizeint)((idx) + 1); }
+#define GEOM_SET_INF_IDX(g,idx) { (g)->next_ex = (dxGeom*)(sizeint)((idx) + 1); }
+#define GEOM_GET_LEAF_IDX(g) ((int)(sizeint)(g)->tome_ex - 1)
+#define GEOM_GET_INF_IDX(g) ((int)(sizeint)(g)->next_ex - 1)
+#define GEOM_INVALID_IDX (-1)
+
+
+static inline bool aabbsOverlap( const dReal *a, const dReal *b )
+{
+    return a[0] <= b[1] && a[1] >= b[0] 
+        && a[2] <= b[3] && a[3] >= b[2] 
+        && a[4] <= b[5] && a[5] >= b[4];
+}
+
+static inline bool aabbContains( const dReal *outer, const dReal *inner )
+{
+    return outer[0] <= inner[0] && outer[1] >= inner[1] 
+        && outer[2] <= inner[2] && outer[3] >= inner[3] 
+        && outer[4] <= inner[4] && outer[5] >= inner[5];
+}
+
+static inline bool aabbIsInfinite( const dReal *aabb )
+{
+    return aabb[0] == -dInfinity || aabb[1] == dInfinity 
+        || aabb[2] == -dInfinity || aabb[3] == dInfinity 
+        || aabb[4] == -dInfinity || aabb[5] == dInfinity;
+}
+
+static inline void aabbCombine( dReal *out, const dReal *a, const dReal *b )
+{
+    for ( int i = 0; i < 6; i += 2 ) {
+        out[i] = dMin( a[i], b[i] );
+        out[i+1] = dMax( a[i+1], b[i+1] );
+    }
+}
+
+// Half of the surface area -- the insertion cost metric
+static inline dReal aabbCost( const dReal *aabb )
+{
+    dReal dx = aabb[1] - aabb[0], dy = aabb[3] - aabb[2], dz = aabb[5] - aabb[4];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+
+// The node indices still to be visited by a traversal. The tree is kept 
+// balanced, so the stack rarely outgrows the local buffer and the traversals 
+// do not touch the heap; a deeper one moves the stack to a heap block.
+class dxTreeNodeStack
+{
+public:
+    dxTreeNodeStack(): m_data(m_local), m_size(0), m_capacity(LOCAL_CAPACITY) {}
+    ~dxTreeNodeStack() { if ( m_data != m_local ) dFree( m_data, m_capacity * sizeof(int) ); }
+
+    bool empty() const { return m_size == 0; }
+    void push( int index ) { if ( m_size == m_capacity ) grow(); m_data[ m_size++ ] = index; }
+    int pop() { return m_data[ --m_size ]; }
+
+private:
+    void grow()
+    {
+        int newCapacity = m_capacity * 2;
+        int *newData = (int *)dAlloc( newCapacity * sizeof(int) );
+        memcpy( newData, m_data, m_size * sizeof(int) );
+        if ( m_data != m_local ) dFree( m_data, m_capacity * sizeof(int) );
+        m_data = newData;
+        m_capacity = newCapacity;
+    }
+
+    enum { LOCAL_CAPACITY = 128 };
+
+    int m_local[ LOCAL_CAPACITY ];
+    int *m_data;
+    int m_size;
+    int m_capacity;
+};
+
+
+dxDynamicTreeSpace::dxDynamicTreeSpace( dSpaceID _space ) : dxSpace( _space )
+{
+    type = dDynamicTreeSpaceClass;
+
+    root = NULL_NODE;
+    freeList = NULL_NODE;
+    margin = dDYNAMIC_TREE_DEFAULT_MARGIN;
+}
+
+dxDynamicTreeSpace::~dxDynamicTreeSpace()
+{
+    CHECK_NOT_LOCKED(this);
+    if ( cleanup ) {
+        // note that destroying each geom will call remove()
+        for ( ; first; dGeomDestroy( first ) ) {}
+    }
+    else {
+        // just unhook them
+        for ( ; first; remove( first ) ) {}
+    }
+}
+
+void dxDynamicTreeSpace::add( dxGeom* g )
+{
+    CHECK_NOT_LOCKED (this);
+    dAASSERT(g);
+    dUASSERT(g->tome_ex == 0 && g->next_ex == 0, "geom is already in a space");
+
+    dxSpace::add(g);
+
+    // The geom could be a clean one taken from another space. 
+    // It must be seen as dirty to get placed into the tree.
+    g->markAABBBad();
+}
+
+void dxDynamicTreeSpace::remove( dxGeom* g )
+{
+    CHECK_NOT_LOCKED(this);
+    dAASSERT(g);
+    dUASSERT(g->parent_space == this,"object is not in this space");
+
+    unplaceGeom( g );
+
+    dxSpace::remove(g);
+}
+
+void dxDynamicTreeSpace::cleanGeoms()
+{
+    // compute the AABBs of all dirty geoms, clear the dirty flags 
+    // and reinsert the geoms that have left their fat boxes
+    lock_count++;
+    for ( dxGeom *g = first; g && (g->gflags & GEOM_DIRTY); g = g->next ) {
+        if ( IS_SPACE(g) ) {
+            ((dxSpace*)g)->cleanGeoms();
+        }
+
+        g->recomputeAABB();
+        dIASSERT((g->gflags & GEOM_AABB_BAD) == 0);
+
+        g->gflags &= ~GEOM_DIRTY;
+
+        placeGeom( g );
+    }
+    lock_count--;
+}
+
+void dxDynamicTreeSpace::collide( void *data, dNearCallback *callback )
+{
+    dAASSERT (callback);
+
+    lock_count++;
+
+    cleanGeoms();
+
+    collideTreeWithItself( data, callback );
+
+    int infSize = InfGeomList.size();
+    for ( int m = 0; m < infSize; ++m ) {
+        dxGeom* g1 = InfGeomList[ m ];
+        if ( !GEOM_ENABLED(g1) )
+            continue;
+
+        // collide infinite ones
+        for ( int n = m + 1; n < infSize; ++n ) {
+            dxGeom* g2 = InfGeomList[ n ];
+            if ( GEOM_ENABLED(g2) )
+                collideAABBs( g1, g2, data, callback );
+        }
+
+        // collide infinite ones with the tree
+        collideTreeWithGeom( g1, data, callback );
+    }
+
+    lock_count--;
+}
+
+void dxDynamicTreeSpace::collide2( void *data, dxGeom *geom, dNearCallback *callback )
+{
+    dAASSERT (geom && callback);
+
+    lock_count++;
+
+    cleanGeoms();
+    geom->recomputeAABB();
+
+    collideTreeWithGeom( geom, data, callback );
+
+    int infSize = InfGeomList.size();
+    for ( int i = 0; i < infSize; ++i ) {
+        dxGeom* g = InfGeomList[ i ];
+        if ( GEOM_ENABLED(g) )
+            collideAABBs( g, geom, data, callback );
+    }
+
+    lock_count--;
+}
+
+void dxDynamicTreeSpace::queryAABBOverlaps( dxGeom *geom, void *data, dxGeomOverlapCallback *callback )
+{
+    dAASSERT (geom && callback);
+
+    const dReal *bounds = geom->aabb;
+
+    if ( root != NULL_NODE ) {
+        dxTreeNodeStack stack;
+        stack.push( root );
+
+        while ( !stack.empty() ) {
+            int index = stack.pop();
+
+            const Node &node = nodes[ index ];
+            if ( !aabbsOverlap( node.aabb, bounds ) )
+                continue;
+
+            if ( node.isLeaf() ) {
+                // The leaf box is a fat one -- check the geom's own box too
+                dxGeom *g = node.geom;
+                if ( g != geom && aabbsOverlap( g->aabb, bounds ) )
+                    callback( data, g );
+            }
+            else {
+                stack.push( node.child1 );
+                stack.push( node.child2 );
+            }
+        }
+    }
+
+    int infSize = InfGeomList.size();
+    for ( int i = 0; i < infSize; ++i ) {
+        dxGeom* g = InfGeomList[ i ];
+        if ( g != geom && aabbsOverlap( g->aabb, bounds ) )
+            callback( data, g );
+    }
+}
+
+
+void dxDynamicTreeSpace::placeGeom( dxGeom *g )
+{
+    int leaf = GEOM_GET_LEAF_IDX(g);
+
+    if ( aabbIsInfinite( g->aabb ) ) {
+        if ( leaf != GEOM_INVALID_IDX ) {
+            removeLeaf( leaf );
+            freeNode( leaf );
+            g->tome_ex = 0;
+        }
+
+        if ( GEOM_GET_INF_IDX(g) == GEOM_INVALID_IDX ) {
+            GEOM_SET_INF_IDX( g, InfGeomList.size() );
+            InfGeomList.push( g );
+        }
+        return;
+    }
+
+    if ( GEOM_GET_INF_IDX(g) != GEOM_INVALID_IDX ) {
+        unplaceGeom( g );
+        leaf = GEOM_INVALID_IDX;
+    }
+
+    if ( leaf != GEOM_INVALID_IDX ) {
+        // The geom is still within its fat box -- nothing to be done
+        if ( aabbContains( nodes[ leaf ].aabb, g->aabb ) )
+            return;
+
+        removeLeaf( leaf );
+    }
+    else {
+        leaf = allocateNode();
+        nodes[ leaf ].geom = g;
+        nodes[ leaf ].height = 0;
+        GEOM_SET_LEAF_IDX( g, leaf );
+    }
+
+    Node &leafNode = nodes[ leaf ];
+    for ( int i = 0; i < 6; i += 2 ) {
+        leafNode.aabb[i] = g->aabb[i] - margin;
+        leafNode.aabb[i+1] = g->aabb[i+1] + margin;
+    }
+
+    insertLeaf( leaf );
+}
+
+void dxDynamicTreeSpace::unplaceGeom( dxGeom *g )
+{
+    int leaf = GEOM_GET_LEAF_IDX(g);
+    if ( leaf != GEOM_INVALID_IDX ) {
+        removeLeaf( leaf );
+        freeNode( leaf );
+    }
+
+    int infIdx = GEOM_GET_INF_IDX(g);
+    if ( infIdx != GEOM_INVALID_IDX ) {
+        int infSize = InfGeomList.size();
+        if ( infIdx != infSize-1 ) {
+            dxGeom* lastG = InfGeomList[ infSize-1 ];
+            InfGeomList[ infIdx ] = lastG;
+            GEOM_SET_INF_IDX( lastG, infIdx );
+        }
+        InfGeomList.setSize( infSize-1 );
+    }
+
+    g->tome_ex = 0;
+    g->next_ex = 0;
+}
+
+
+int dxDynamicTreeSpace::allocateNode()
+{
+    int node = freeList;
+
+    if ( node != NULL_NODE ) {
+        freeList = nodes[ node ].parent;
+    }
+    else {
+        node = nodes.size();
+        nodes.setSize( node + 1 );
+    }
+
+    Node &newNode = nodes[ node ];
+    newNode.geom = NULL;
+    newNode.parent = NULL_NODE;
+    newNode.child1 = NULL_NODE;
+    newNode.child2 = NULL_NODE;
+    newNode.height = 0;
+    return node;
+}
+
+void dxDynamicTreeSpace::freeNode( int node )
+{
+    dIASSERT( node >= 0 && node < nodes.size() );
+    nodes[ node ].parent = freeList;
+    nodes[ node ].height = -1;
+    freeList = node;
+}
+
+void dxDynamicTreeSpace::refitNode( int node )
+{
+    Node &refitted = nodes[ node ];
+    const Node &child1 = nodes[ refitted.child1 ];
+    const Node &child2 = nodes[ refitted.child2 ];
+
+    aabbCombine( refitted.aabb, child1.aabb, child2.aabb );
+    refitted.height = 1 + dMACRO_MAX( child1.height, child2.height );
+}
+
+void dxDynamicTreeSpace::insertLeaf( int leaf )
+{
+    if ( root == NULL_NODE ) {
+        root = leaf;
+        nodes[ root ].parent = NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling for the leaf descending towards the lesser cost
+    dReal leafAABB[6];
+    memcpy( leafAABB, nodes[ leaf ].aabb, sizeof(leafAABB) );
+
+    int index = root;
+    while ( !nodes[ index ].isLeaf() ) {
+        const Node &current = nodes[ index ];
+        int child1 = current.child1;
+        int child2 = current.child2;
+
+        dReal combinedAABB[6];
+        aabbCombine( combinedAABB, current.aabb, leafAABB );
+        dReal combinedCost = aabbCost( combinedAABB );
+
+        // Cost of creating a new parent for this node and the new leaf
+        dReal cost = 2 * combinedCost;
+        // Minimum cost of pushing the leaf further down the tree
+        dReal inheritanceCost = 2 * (combinedCost - aabbCost( current.aabb ));
+
+        dReal cost1, cost2;
+        aabbCombine( combinedAABB, nodes[ child1 ].aabb, leafAABB );
+        cost1 = nodes[ child1 ].isLeaf() 
+            ? aabbCost( combinedAABB ) + inheritanceCost 
+            : aabbCost( combinedAABB ) - aabbCost( nodes[ child1 ].aabb ) + inheritanceCost;
+        aabbCombine( combinedAABB, nodes[ child2 ].aabb, leafAABB );
+        cost2 = nodes[ child2 ].isLeaf() 
+            ? aabbCost( combinedAABB ) + inheritanceCost 
+            : aabbCost( combinedAABB ) - aabbCost( nodes[ child2 ].aabb ) + inheritanceCost;
+
+        if ( cost < cost1 && cost < cost2 )
+            break;
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+
+    // Create a new parent (the node array may get reallocated here)
+    int newParent = allocateNode();
+    int oldParent = nodes[ sibling ].parent;
+
+    Node &parentNode = nodes[ newParent ];
+    parentNode.parent = oldParent;
+    parentNode.child1 = sibling;
+    parentNode.child2 = leaf;
+    nodes[ sibling ].parent = newParent;
+    nodes[ leaf ].parent = newParent;
+
+    if ( oldParent != NULL_NODE ) {
+        if ( nodes[ oldParent ].child1 == sibling )
+            nodes[ oldParent ].child1 = newParent;
+        else
+            nodes[ oldParent ].child2 = newParent;
+    }
+    else {
+        root = newParent;
+    }
+
+    // Walk back up the tree fixing heights and boxes
+    for ( index = newParent; index != NULL_NODE; index = nodes[ index ].parent ) {
+        index = balance( index );
+        refitNode( index );
+    }
+}
+
+void dxDynamicTreeSpace::removeLeaf( int leaf )
+{
+    if ( leaf == root ) {
+        root = NULL_NODE;
+        return;
+    }
+
+    int parent = nodes[ leaf ].parent;
+    int grandParent = nodes[ parent ].parent;
+    int sibling = nodes[ parent ].child1 == leaf ? nodes[ parent ].child2 : nodes[ parent ].child1;
+
+    if ( grandParent != NULL_NODE ) {
+        // Destroy the parent and connect the sibling to the grand parent
+        if ( nodes[ grandParent ].child1 == parent )
+            nodes[ grandParent ].child1 = sibling;
+        else
+            nodes[ grandParent ].child2 = sibling;
+        nodes[ sibling ].parent = grandParent;
+        freeNode( parent );
+
+        for ( int index = grandParent; index != NULL_NODE; index = nodes[ index ].parent ) {
+            index = balance( index );
+            refitNode( index );
+        }
+    }
+    else {
+        root = sibling;
+        nodes[ sibling ].parent = NULL_NODE;
+        freeNode( parent );
+    }
+}
+
+// Performs a left or right rotation if the node is imbalanced.
+// Returns the index of the node that has taken its place.
+int dxDynamicTreeSpace::balance( int iA )
+{
+    Node &A = nodes[ iA ];
+    if ( A.isLeaf() || A.height < 2 )
+        return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+    Node &B = nodes[ iB ];
+    Node &C = nodes[ iC ];
+
+    int heightDifference = C.height - B.height;
+
+    // Rotate C up
+    if ( heightDifference > 1 ) {
+        int iF = C.child1;
+        int iG = C.child2;
+        Node &F = nodes[ iF ];
+        Node &G = nodes[ iG ];
+
+        // Swap A and C
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if ( C.parent != NULL_NODE ) {
+            if ( nodes[ C.parent ].child1 == iA )
+                nodes[ C.parent ].child1 = iC;
+            else
+                nodes[ C.parent ].child2 = iC;
+        }
+        else {
+            root = iC;
+        }
+
+        // Rotate the taller of C's children up and make the other A's child
+        if ( F.height > G.height ) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            aabbCombine( A.aabb, B.aabb, G.aabb );
+            aabbCombine( C.aabb, A.aabb, F.aabb );
+            A.height = 1 + dMACRO_MAX( B.height, G.height );
+            C.height = 1 + dMACRO_MAX( A.height, F.height );
+        }
+        else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            aabbCombine( A.aabb, B.aabb, F.aabb );
+            aabbCombine( C.aabb, A.aabb, G.aabb );
+            A.height = 1 + dMACRO_MAX( B.height, F.height );
+            C.height = 1 + dMACRO_MAX( A.height, G.height );
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if ( heightDifference < -1 ) {
+        int iD = B.child1;
+        int iE = B.child2;
+        Node &D = nodes[ iD ];
+        Node &E = nodes[ iE ];
+
+        // Swap A and B
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if ( B.parent != NULL_NODE ) {
+            if ( nodes[ B.parent ].child1 == iA )
+                nodes[ B.parent ].child1 = iB;
+            else
+                nodes[ B.parent ].child2 = iB;
+        }
+        else {
+            root = iB;
+        }
+
+        // Rotate the taller of B's children up and make the other A's child
+        if ( D.height > E.height ) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            aabbCombine( A.aabb, C.aabb, E.aabb );
+            aabbCombine( B.aabb, A.aabb, D.aabb );
+            A.height = 1 + dMACRO_MAX( C.height, E.height );
+            B.height = 1 + dMACRO_MAX( A.height, D.height );
+        }
+        else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            aabbCombine( A.aabb, C.aabb, D.aabb );
+            aabbCombine( B.aabb, A.aabb, E.aabb );
+            A.height = 1 + dMACRO_MAX( C.height, D.height );
+            B.height = 1 + dMACRO_MAX( A.height, E.height );
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+
+void dxDynamicTreeSpace::collideTreeWithItself( void *data, dNearCallback *callback )
+{
+    if ( root == NULL_NODE )
+        return;
+
+    // A stack of node pairs to be tested. A pair of the same node stands 
+    // for the test of the node's subtree against itself.
+    dxTreeNodeStack stack;
+    stack.push( root );
+    stack.push( root );
+
+    while ( !stack.empty() ) {
+        int index2 = stack.pop();
+        int index1 = stack.pop();
+
+        const Node &node1 = nodes[ index1 ];
+        const Node &node2 = nodes[ index2 ];
+
+        if ( index1 == index2 ) {
+            if ( !node1.isLeaf() ) {
+                stack.push( node1.child1 ); stack.push( node1.child1 );
+                stack.push( node1.child2 ); stack.push( node1.child2 );
+                stack.push( node1.child1 ); stack.push( node1.child2 );
+            }
+            continue;
+        }
+
+        if ( !aabbsOverlap( node1.aabb, node2.aabb ) )
+            continue;
+
+        if ( node1.isLeaf() ) {
+            if ( node2.isLeaf() ) {
+                dxGeom *g1 = node1.geom;
+                dxGeom *g2 = node2.geom;
+                if ( GEOM_ENABLED(g1) && GEOM_ENABLED(g2) )
+                    collideAABBs( g1, g2, data, callback );
+            }
+            else {
+                stack.push( index1 ); stack.push( node2.child1 );
+                stack.push( index1 ); stack.push( node2.child2 );
+            }
+        }
+        else if ( node2.isLeaf() || node1.height >= node2.height ) {
+            // Descend into the taller subtree first
+            stack.push( node1.child1 ); stack.push( index2 );
+            stack.push( node1.child2 ); stack.push( index2 );
+        }
+        else {
+            stack.push( index1 ); stack.push( node2.child1 );
+            stack.push( index1 ); stack.push( node2.child2 );
+        }
+    }
+}
+
+void dxDynamicTreeSpace::collideTreeWithGeom( dxGeom *geom, void *data, dNearCallback *callback )
+{
+    if ( root == NULL_NODE )
+        return;
+
+    const dReal *bounds = geom->aabb;
+
+    dxTreeNodeStack stack;
+    stack.push( root );
+
+    while ( !stack.empty() ) {
+        int index = stack.pop();
+
+        const Node &node = nodes[ index ];
+        if ( !aabbsOverlap( node.aabb, bounds ) )
+            continue;
+
+        if ( node.isLeaf() ) {
+            dxGeom *g = node.geom;
+            if ( g != geom && GEOM_ENABLED(g) )
+                collideAABBs( g, geom, data, callback );
+        }
+        else {
+            stack.push( node.child1 );
+            stack.push( node.child2 );
+        }
+    }
+}
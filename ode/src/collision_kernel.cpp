@@ -40,6 +40,8 @@ for geometry objects
 #include "collision_trimesh_internal.h"
 #include "collision_space_internal.h"
 #include "odeou.h"
+#include "util.h"
+#include "threadingutils.h"
 
 #ifdef dLIBCCD_ENABLED
 # include "collision_libccd.h"
@@ -59,6 +61,8 @@ for geometry objects
 static volatile atomicptr s_cachedPosR = 0; // dxPosR *
 #endif // dATOMICS_ENABLED
 
+static volatile atomicord32 s_geomSerialCounter = 0;
+
 static inline dxPosR* dAllocPosr()
 {
     dxPosR *retPosR;
@@ -173,7 +177,8 @@ static void setAllColliders (int i, dColliderFn *fn)
     int i,j;
 
     // setup space colliders
-    for (i=dFirstSpaceClass; i <= dLastSpaceClass; i++) {
+    for (i=0; i < dGeomNumClasses; i++) {
+        if (!IS_SPACE_CLASS(i)) continue;
         for (j=0; j < dGeomNumClasses; j++) {
             setCollider (i,j,&dCollideSpaceGeom);
         }
@@ -337,6 +342,187 @@ int dCollide (dxGeom *o1, dxGeom *o2, int flags, dContactGeom *contact, int skip
     return count;
 }
 
+
+bool dxGeomNeedsSerialCollision(const dxGeom *g)
+{
+    bool result = false;
+
+#if dTRIMESH_ENABLED
+    if (g->type == dTriMeshClass) {
+        // The trimesh colliders add the geoms to the temporal coherence caches without any locking
+        const dxMeshBase *mesh = static_cast<const dxMeshBase *>(g);
+        for (int tc = dxMeshBase::TTC__MIN; tc != dxMeshBase::TTC__MAX; ++tc) {
+            if (mesh->getDoTC((dxMeshBase::TRIMESHTC)tc)) {
+                result = true;
+                break;
+            }
+        }
+    }
+#else
+    (void)g; // unused
+#endif
+
+    return result;
+}
+
+
+#define dCOLLIDE_BATCH_PAIR_BLOCK_SIZE 16
+
+struct dxCollideBatchContext {
+    dxGeom *const *pairs;       // o1,o2 sequence
+    const unsigned *order;      // pair indices grouped by the collider, the serial ones last
+    unsigned pair_count;
+    unsigned parallel_pair_count;
+    unsigned pair_block_count;
+    volatile atomicord32 pair_block_progress;
+    int flags;
+    dContactGeom *contacts;
+    unsigned *pair_counts;      // contact counts by pair index
+};
+
+static inline void collideBatchPair (dxCollideBatchContext *context, unsigned order_index)
+{
+    const unsigned max_contacts = (unsigned)(context->flags & NUMC_MASK);
+
+    // every pair has its own slot of max_contacts entries until the results are packed
+    unsigned pair_index = context->order[order_index];
+    context->pair_counts[pair_index] = (unsigned)dCollide (context->pairs[2 * pair_index], context->pairs[2 * pair_index + 1], 
+        context->flags, context->contacts + (sizeint)pair_index * max_contacts, sizeof(dContactGeom));
+}
+
+static void collideBatchPairBlocks (dxCollideBatchContext *context)
+{
+    const unsigned parallel_pair_count = context->parallel_pair_count;
+    const unsigned pair_block_count = context->pair_block_count;
+
+    unsigned block_index;
+    while ((block_index = ThrsafeIncrementIntUpToLimit(&context->pair_block_progress, pair_block_count)) != pair_block_count) {
+        unsigned order_index = block_index * dCOLLIDE_BATCH_PAIR_BLOCK_SIZE;
+        unsigned order_limit = dMACRO_MIN(order_index + dCOLLIDE_BATCH_PAIR_BLOCK_SIZE, parallel_pair_count);
+        for (; order_index != order_limit; ++order_index) {
+            collideBatchPair (context, order_index);
+        }
+    }
+}
+
+// The pairs of the geoms that can't be collided concurrently are all collided by the calling thread
+static void collideBatchSerialPairs (dxCollideBatchContext *context)
+{
+    for (unsigned order_index = context->parallel_pair_count; order_index != context->pair_count; ++order_index) {
+        collideBatchPair (context, order_index);
+    }
+}
+
+static 
+int collideBatchWorkerCallback (void *call_context, dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    collideBatchPairBlocks ((dxCollideBatchContext *)call_context);
+    return 1;
+}
+
+static 
+int collideBatchCompletionCallback (void *dUNUSED(call_context), dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    return 1;
+}
+
+unsigned dCollideBatch (dxWorld *world, unsigned max_thread_count, dxGeom *const *pairs, unsigned pair_count,
+                        int flags, dContactGeom *contacts, unsigned *pair_offsets)
+{
+    dAASSERT ((pairs && contacts) || pair_count == 0);
+    dAASSERT (pair_offsets);
+    dUASSERT (world == NULL || max_thread_count != 0, "no threads allowed");
+    dUASSERT ((flags & NUMC_MASK) > 0, "no contacts requested");
+
+    const unsigned max_contacts = (unsigned)(flags & NUMC_MASK);
+
+    // Group the pairs by the collider to be called so that the same code runs in a row.
+    // The class pairs are ordered as the reverse colliders run the same functions.
+    // The pairs that must be collided serially get an extra key after all the class pairs.
+    const int class_pair_count = dGeomNumClasses * dGeomNumClasses;
+    const unsigned serial_key = class_pair_count;
+    dArray<unsigned> keys;
+    keys.setSize (pair_count);
+    dArray<unsigned> class_pair_starts;
+    class_pair_starts.setSize (class_pair_count + 2);
+    memset (class_pair_starts.data(), 0, (class_pair_count + 2) * sizeof(unsigned));
+
+    for (unsigned i = 0; i != pair_count; ++i) {
+        dAASSERT (pairs[2 * i] && pairs[2 * i + 1]);
+        // the lazy positions and AABBs of the geoms shared among the pairs must not be computed from several threads
+        pairs[2 * i]->recomputeAABB();
+        pairs[2 * i + 1]->recomputeAABB();
+
+        unsigned key;
+        if (dxGeomNeedsSerialCollision(pairs[2 * i]) || dxGeomNeedsSerialCollision(pairs[2 * i + 1])) {
+            key = serial_key;
+        }
+        else {
+            int class1 = pairs[2 * i]->type, class2 = pairs[2 * i + 1]->type;
+            key = class1 < class2 ? class1 * dGeomNumClasses + class2 : class2 * dGeomNumClasses + class1;
+        }
+        keys[i] = key;
+        class_pair_starts[key + 1]++;
+    }
+    for (int k = 0; k != class_pair_count + 1; ++k) {
+        class_pair_starts[k + 1] += class_pair_starts[k];
+    }
+    const unsigned parallel_pair_count = class_pair_starts[serial_key];
+
+    dArray<unsigned> order;
+    order.setSize (pair_count);
+    for (unsigned i = 0; i != pair_count; ++i) {
+        order[class_pair_starts[keys[i]]++] = i;
+    }
+
+    dxCollideBatchContext context;
+    context.pairs = pairs;
+    context.order = order.data();
+    context.pair_count = pair_count;
+    context.parallel_pair_count = parallel_pair_count;
+    context.pair_block_count = (parallel_pair_count + (dCOLLIDE_BATCH_PAIR_BLOCK_SIZE - 1)) / dCOLLIDE_BATCH_PAIR_BLOCK_SIZE;
+    context.pair_block_progress = 0;
+    context.flags = flags;
+    context.contacts = contacts;
+    context.pair_counts = pair_offsets; // the counts are replaced with the offsets below
+
+    unsigned thread_count = world != NULL ? world->calculateThreadingLimitedThreadCount(max_thread_count, true) : 1;
+    thread_count = dMACRO_MIN(thread_count, context.pair_block_count);
+
+    dCallWaitID completion_wait = thread_count > 1 ? world->AllocateOrRetrieveStockCallWaitID() : NULL;
+
+    if (completion_wait != NULL && world->PreallocateResourcesForThreadedCalls(thread_count)) {
+        dCallReleaseeID completion_releasee;
+        world->PostThreadedCall(NULL, &completion_releasee, thread_count - 1, NULL, completion_wait, 
+            &collideBatchCompletionCallback, NULL, 0, "CollideBatch Completion");
+        world->PostThreadedCallsGroup(NULL, thread_count - 1, completion_releasee, 
+            &collideBatchWorkerCallback, &context, "CollideBatch Pairs");
+
+        collideBatchSerialPairs (&context);
+        collideBatchPairBlocks (&context);
+
+        world->WaitThreadedCallExclusively(NULL, completion_wait, NULL, "CollideBatch End Wait");
+    }
+    else {
+        collideBatchSerialPairs (&context);
+        collideBatchPairBlocks (&context);
+    }
+
+    // Pack the contacts. A pair's contacts never move past their own slot so the moves are safe in order.
+    unsigned offset = 0;
+    for (unsigned i = 0; i != pair_count; ++i) {
+        unsigned count = pair_offsets[i];
+        pair_offsets[i] = offset;
+        if (count != 0 && (sizeint)offset != (sizeint)i * max_contacts) {
+            memmove (contacts + offset, contacts + (sizeint)i * max_contacts, count * sizeof(dContactGeom));
+        }
+        offset += count;
+    }
+    pair_offsets[pair_count] = offset;
+
+    return offset;
+}
+
 //****************************************************************************
 // dxGeom
 
@@ -368,6 +554,7 @@ dxGeom::dxGeom (dSpaceID _space, int is_placeable)
     dSetZero (aabb,6);
     category_bits = ~0;
     collide_bits = ~0;
+    serial = (unsigned)ThrsafeIncrement(&s_geomSerialCounter);
 
     // put this geom in a space if required
     if (_space) dSpaceAdd (_space,this);
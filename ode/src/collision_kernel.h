@@ -43,8 +43,11 @@ internal data structures and functions for collision detection.
 // mask for the number-of-contacts field in the dCollide() flags parameter
 #define NUMC_MASK (0xffff)
 
+#define IS_SPACE_CLASS(type) \
+    (dIN_RANGE((type), dFirstSpaceClass, dLastSpaceClass + 1) || (type) == dDynamicTreeSpaceClass)
+
 #define IS_SPACE(geom) \
-    dIN_RANGE((geom)->type, dFirstSpaceClass, dLastSpaceClass + 1)
+    IS_SPACE_CLASS((geom)->type)
 
 #define CHECK_NOT_LOCKED(space) \
     dUASSERT ((space) == NULL || (space)->lock_count == 0, \
@@ -78,6 +81,7 @@ enum {
     GEOM_PLACEABLE = 8,   // geom is placeable
     GEOM_ENABLED = 16,    // geom is enabled
     GEOM_ZERO_SIZED = 32, // geom is zero sized
+    GEOM_PAIR_CACHE_MOVED = 64, // geom is in the moved list of its space's pair cache
 
     GEOM_ENABLE_TEST_MASK = GEOM_ENABLED | GEOM_ZERO_SIZED,
     GEOM_ENABLE_TEST_VALUE = GEOM_ENABLED,
@@ -117,6 +121,7 @@ struct dxGeom : public dBase {
     dxSpace *parent_space;// the space this geom is contained in, 0 if none
     dReal aabb[6];	// cached AABB for this space
     unsigned long category_bits,collide_bits;
+    unsigned serial;	// creation number telling the geom from the destroyed ones at the same address
 
     dxGeom (dSpaceID _space, int is_placeable);
     virtual ~dxGeom();
@@ -216,6 +221,10 @@ struct dxGeom : public dBase {
 // their AABBs may not be valid. the two types are distinguished by the
 // GEOM_DIRTY flag. all dirty geoms come *before* all clean geoms in the list.
 
+struct dxSpacePairCache;
+
+typedef void dxGeomOverlapCallback (void *data, dxGeom *geom);
+
 #if dTLS_ENABLED
 #define dSPACE_TLS_KIND_INIT_VALUE OTK__DEFAULT
 #define dSPACE_TLS_KIND_MANUAL_VALUE OTK_MANUALCLEANUP
@@ -241,6 +250,9 @@ struct dxSpace : public dxGeom {
     // is locked.
     int lock_count;
 
+    // the broadphase pair cache, 0 if not enabled (see collision_space_paircache.h)
+    dxSpacePairCache *pair_cache;
+
     dxSpace (dSpaceID _space);
     ~dxSpace();
 
@@ -268,6 +280,11 @@ struct dxSpace : public dxGeom {
 
     virtual void collide (void *data, dNearCallback *callback)=0;
     virtual void collide2 (void *data, dxGeom *geom, dNearCallback *callback)=0;
+
+    virtual void queryAABBOverlaps (dxGeom *geom, void *data, dxGeomOverlapCallback *callback)=0;
+    // call the callback for every geom in the space (except the geom itself)
+    // whose AABB overlaps the geom's one. the space must be clean. no
+    // enabled state or category filtering is done.
 };
 
 
@@ -290,4 +307,12 @@ void dClearPosrCache(void);
 void dFinitUserClasses();
 
 
+//****************************************************************************
+// Threaded collision support
+
+// Whether colliding the geom modifies the geom's own state (e.g. the temporal 
+// coherence caches of a trimesh), so that its pairs must not be collided concurrently
+bool dxGeomNeedsSerialCollision(const dxGeom *g);
+
+
 #endif
@@ -62,6 +62,8 @@ public:
 
     void CollideLocal(dGeomID g2, void* UserData, dNearCallback* Callback);
 
+    void QueryOverlaps(dxGeom* g1, void* UserData, dxGeomOverlapCallback* Callback);
+
     void AddObject(dGeomID Object);
     void DelObject(dGeomID Object);
     void Traverse(dGeomID Object);
@@ -248,6 +250,28 @@ void Block::CollideLocal(dxGeom* g2, void* UserData, dNearCallback* Callback){
     }
 }
 
+void Block::QueryOverlaps(dxGeom* g1, void* UserData, dxGeomOverlapCallback* Callback){
+    // Check the local list
+    for (dxGeom* g2 = mFirst; g2; g2 = g2->next_ex){
+        if (g2 != g1 && overlapAABBs(g2->aabb, g1->aabb)){
+            Callback(UserData, g2);
+        }
+    }
+
+    // Check the children the geom's AABB reaches
+    if (mChildren){
+        for (int i = 0; i < SPLITS; i++){
+            Block &CurrentChild = mChildren[i];
+            if (CurrentChild.mGeomCount == 0 ||
+                g1->aabb[AXIS0 * 2 + 0] >= CurrentChild.mMaxX ||
+                g1->aabb[AXIS0 * 2 + 1] < CurrentChild.mMinX ||
+                g1->aabb[AXIS1 * 2 + 0] >= CurrentChild.mMaxZ ||
+                g1->aabb[AXIS1 * 2 + 1] < CurrentChild.mMinZ) continue;
+            CurrentChild.QueryOverlaps(g1, UserData, Callback);
+        }
+    }
+}
+
 void Block::AddObject(dGeomID Object){
     // Add the geom
     Object->next_ex = mFirst;
@@ -357,6 +381,7 @@ struct dxQuadTreeSpace : public dxSpace{
     void cleanGeoms();
     void collide(void* UserData, dNearCallback* Callback);
     void collide2(void* UserData, dxGeom* g1, dNearCallback* Callback);
+    void queryAABBOverlaps(dxGeom* g1, void* UserData, dxGeomOverlapCallback* Callback);
 
     // Temp data
     Block* CurrentBlock;	// Only used while enumerating
@@ -611,6 +636,12 @@ void dxQuadTreeSpace::collide2(void* UserData, dxGeom* g2, dNearCallback* Callba
     lock_count--;
 }
 
+void dxQuadTreeSpace::queryAABBOverlaps(dxGeom* g1, void* UserData, dxGeomOverlapCallback* Callback){
+    dAASSERT(g1 && Callback);
+
+    Blocks[0].QueryOverlaps(g1, UserData, Callback);
+}
+
 dSpaceID dQuadTreeSpaceCreate(dxSpace* space, const dVector3 Center, const dVector3 Extents, int Depth){
     return new dxQuadTreeSpace(space, Center, Extents, Depth);
 }
@@ -31,8 +31,18 @@
  *  This version does complete radix sort, not "classical" SAP. So, we
  *  have no temporal coherence, but are able to handle any movement
  *  velocities equally well.
+ *
+ *  The incremental mode (see dSweepAndPruneSpaceSetIncremental) is the
+ *  "classical" SAP instead: the box endpoints are kept sorted on all three
+ *  axes between the calls and are resorted by insertion sort as the geoms
+ *  move. The overlapping pairs are maintained as the endpoints swap.
+ *  The removed boxes leave their endpoints and pairs in place until these
+ *  are compacted at once by the next collision (or by a later removal as
+ *  the removed boxes outnumber the others).
  */
 
+#include <algorithm>
+
 #include <ode/common.h>
 #include <ode/collision_space.h>
 #include <ode/collision.h>
@@ -128,6 +138,126 @@ void RaixSortContext::ReallocateRanksIfNecessary(sizeint nNewSize)
     }
 }
 
+// --------------------------------------------------------------------------
+//  Pair set for the incremental mode
+// --------------------------------------------------------------------------
+
+// An open addressing hash set of box index pairs
+struct SAPPairSet
+{
+public:
+    struct Slot
+    {
+        uint32 id0;	//!< Smaller box index of the pair or EMPTY_ID
+        uint32 id1;	//!< Larger box index of the pair
+    };
+
+    enum { EMPTY_ID = 0xFFFFFFFF };
+
+    SAPPairSet(): mPairCount(0) {}
+
+    void Add( uint32 id0, uint32 id1 );
+    void Remove( uint32 id0, uint32 id1 );
+    void Clear() { mSlots.setSize( 0 ); mPairCount = 0; }
+
+    // The pairs are enumerated by scanning the slots and skipping the empty ones
+    int GetSlotCount() const { return mSlots.size(); }
+    const Slot& GetSlot( int i ) const { return mSlots[ i ]; }
+
+private:
+    static uint32 HashPair( uint32 id0, uint32 id1 )
+    {
+        uint32 h = id0 * 0x9E3779B1U + id1;
+        h ^= h >> 16;
+        h *= 0x85EBCA6BU;
+        h ^= h >> 13;
+        return h;
+    }
+
+    void Grow();
+
+private:
+    dArray< Slot > mSlots;	//!< Power of two sized, at most half full
+    int mPairCount;
+};
+
+void SAPPairSet::Add( uint32 id0, uint32 id1 )
+{
+    if ( id0 > id1 ) { uint32 tmp = id0; id0 = id1; id1 = tmp; }
+
+    if ( ( mPairCount + 1 ) * 2 > mSlots.size() )
+        Grow();
+
+    uint32 mask = (uint32)mSlots.size() - 1;
+    for ( uint32 i = HashPair( id0, id1 ) & mask; ; i = ( i + 1 ) & mask )
+    {
+        Slot& slot = mSlots[ i ];
+        if ( slot.id0 == EMPTY_ID )
+        {
+            slot.id0 = id0;
+            slot.id1 = id1;
+            ++mPairCount;
+            break;
+        }
+        if ( slot.id0 == id0 && slot.id1 == id1 )
+            break;
+    }
+}
+
+void SAPPairSet::Remove( uint32 id0, uint32 id1 )
+{
+    if ( id0 > id1 ) { uint32 tmp = id0; id0 = id1; id1 = tmp; }
+
+    if ( mPairCount == 0 )
+        return;
+
+    uint32 mask = (uint32)mSlots.size() - 1;
+    uint32 i = HashPair( id0, id1 ) & mask;
+    for ( ; ; i = ( i + 1 ) & mask )
+    {
+        const Slot& slot = mSlots[ i ];
+        if ( slot.id0 == EMPTY_ID )
+            return;
+        if ( slot.id0 == id0 && slot.id1 == id1 )
+            break;
+    }
+
+    // Shift the following slots of the probe sequence back to keep the lookups working
+    for ( uint32 j = ( i + 1 ) & mask; mSlots[ j ].id0 != EMPTY_ID; j = ( j + 1 ) & mask )
+    {
+        uint32 home = HashPair( mSlots[ j ].id0, mSlots[ j ].id1 ) & mask;
+        bool movable = j > i ? ( home <= i || home > j ) : ( home <= i && home > j );
+        if ( movable )
+        {
+            mSlots[ i ] = mSlots[ j ];
+            i = j;
+        }
+    }
+
+    mSlots[ i ].id0 = EMPTY_ID;
+    --mPairCount;
+}
+
+void SAPPairSet::Grow()
+{
+    dArray< Slot > oldSlots;
+    oldSlots.swap( mSlots );
+
+    int oldSize = oldSlots.size();
+    int newSize = oldSize != 0 ? oldSize * 2 : 64;
+    mSlots.setSize( newSize );
+    for ( int i = 0; i < newSize; ++i )
+        mSlots[ i ].id0 = EMPTY_ID;
+
+    mPairCount = 0;
+    for ( int i = 0; i < oldSize; ++i )
+    {
+        const Slot& slot = oldSlots[ i ];
+        if ( slot.id0 != EMPTY_ID )
+            Add( slot.id0, slot.id1 );
+    }
+}
+
 // --------------------------------------------------------------------------
 //  SAP space code
 // --------------------------------------------------------------------------
@@ -147,6 +277,10 @@ struct dxSAPSpace : public dxSpace
     virtual void cleanGeoms();
     virtual void collide( void *data, dNearCallback *callback );
     virtual void collide2( void *data, dxGeom *geom, dNearCallback *callback );
+    virtual void queryAABBOverlaps( dxGeom *geom, void *data, dxGeomOverlapCallback *callback );
+
+    void setIncremental( bool incremental );
+    bool getIncremental() const { return Incremental; }
 
 private:
 
@@ -180,6 +314,37 @@ private:
     */
     void BoxPruning( int count, const dxGeom** geoms, dArray< Pair >& pairs );
 
+    //! An endpoint of a box on a sorting axis
+    struct Endpoint
+    {
+        dReal value;
+        uint32 data;	//!< Box index << 1, ored with 1 for the maximum endpoint
+    };
+
+    //! A box of the incremental mode
+    struct Box
+    {
+        dxGeom* geom;	//!< NULL if the box is removed or free
+        uint32 pos[3][2];	//!< Minimum and maximum endpoint positions on each axis
+    };
+
+    // Incremental mode helpers
+    int IncrementalPlaceGeom( dxGeom* g, int box );
+    int IncrementalInsertBox( dxGeom* g );
+    void IncrementalUpdateBox( int box );
+    void IncrementalRemoveBox( int box );
+    void IncrementalCompact();
+    void IncrementalRemoveInfGeom( dxGeom* g );
+    void IncrementalRebuild();
+    void IncrementalClear();
+    void IncrementalSortDown( int axis, uint32 pos );
+    void IncrementalSortUp( int axis, uint32 pos );
+    bool IncrementalBoxesOverlap( uint32 box0, uint32 box1 ) const;
+    void IncrementalCollide( void *data, dNearCallback *callback );
+
+    // AABB query helpers
+    void QueryUpdate();
+
 
     //--------------------------------------------------------------------------
     // Implementation Data
@@ -207,6 +372,32 @@ private:
     // NOTE: this is float not dReal because of the OPCODE radix sorter
     dArray< float > poslist;
     RaixSortContext	sortContext;
+
+    // Incremental mode data. The box indices are kept in parallel with the
+    // dirty and clean geom lists (the geoms have no more room for them).
+    bool Incremental;
+    dArray<int> DirtyBoxList;	// box indices of the dirty geoms
+    dArray<int> GeomBoxList;	// box indices of the clean geoms
+    dArray<Box> Boxes;
+    dArray<int> FreeBoxes;
+    dArray<int> RemovedBoxes;	// boxes with the endpoints and pairs still in place, free after the compaction
+    int BoxCount;	// number of used boxes
+    dArray<Endpoint> Endpoints[3];	// sorted endpoints of the boxes on X, Y and Z
+    SAPPairSet OverlapPairs;	// pairs of boxes overlapping on all axes
+    dArray<dxGeom*> InfGeomList;	// geoms with infinite AABBs, not in the boxes
+
+    // The AABB queries go through the geoms sorted by their minima on the
+    // first sorting axis: the endpoints in the incremental mode, otherwise
+    // a list sorted by the first query after the geoms change.
+    struct QueryEntry
+    {
+        dReal value;	//!< Minimum on the first sorting axis
+        dxGeom* geom;
+    };
+    dArray<QueryEntry> QueryList;
+    dArray<dxGeom*> QueryInfGeomList;	// geoms infinite on the axis, not in the list
+    dReal QueryMaxExtent;	// the largest extent on the axis of the sorted geoms
+    bool QueryValid;
 };
 
 // Creation
@@ -214,6 +405,20 @@ dSpaceID dSweepAndPruneSpaceCreate( dxSpace* space, int axisorder ) {
     return new dxSAPSpace( space, axisorder );
 }
 
+void dSweepAndPruneSpaceSetIncremental( dxSpace* space, int incremental )
+{
+    dAASSERT(space);
+    dUASSERT(space->type == dSweepAndPruneSpaceClass, "argument must be a sweep and prune space");
+    ((dxSAPSpace*)space)->setIncremental( incremental != 0 );
+}
+
+int dSweepAndPruneSpaceGetIncremental( dxSpace* space )
+{
+    dAASSERT(space);
+    dUASSERT(space->type == dSweepAndPruneSpaceClass, "argument must be a sweep and prune space");
+    return ((dxSAPSpace*)space)->getIncremental() ? 1 : 0;
+}
+
 
 //==============================================================================
 
@@ -226,6 +431,10 @@ dSpaceID dSweepAndPruneSpaceCreate( dxSpace* space, int axisorder ) {
 #define GEOM_GET_GEOM_IDX(g) ((int)(sizeint)(g)->tome_ex)
 #define GEOM_INVALID_IDX (-1)
 
+// Box indices of the geoms without a box in the incremental mode
+#define SAP_NO_BOX (-1)     // not placed yet (or not in the incremental mode)
+#define SAP_INF_BOX (-2)    // in the infinite AABB list
+
 
 /*
 *  A bit of repetitive work - similar to collideAABBs, but doesn't check
@@ -273,11 +482,19 @@ dxSAPSpace::dxSAPSpace( dSpaceID _space, int axisorder ) : dxSpace( _space )
     ax0idx = ( ( axisorder ) & 3 ) << 1;
     ax1idx = ( ( axisorder >> 2 ) & 3 ) << 1;
     ax2idx = ( ( axisorder >> 4 ) & 3 ) << 1;
+
+    Incremental = false;
+    BoxCount = 0;
+
+    QueryMaxExtent = 0;
+    QueryValid = false;
 }
 
 dxSAPSpace::~dxSAPSpace()
 {
     CHECK_NOT_LOCKED(this);
+    // drop the incremental mode data at once rather than box by box
+    IncrementalClear();
     if ( cleanup ) {
         // note that destroying each geom will call remove()
         for ( ; DirtyList.size(); dGeomDestroy( DirtyList[ 0 ] ) ) {}
@@ -311,6 +528,8 @@ void dxSAPSpace::add( dxGeom* g )
     GEOM_SET_DIRTY_IDX( g, DirtyList.size() );
     GEOM_SET_GEOM_IDX( g, GEOM_INVALID_IDX );
     DirtyList.push( g );
+    DirtyBoxList.push( SAP_NO_BOX );
+    QueryValid = false;
 
     dxSpace::add(g);
 }
@@ -329,30 +548,44 @@ void dxSAPSpace::remove( dxGeom* g )
         (dirtyIdx==GEOM_INVALID_IDX && geomIdx>=0 && geomIdx<GeomList.size()) ||
         (geomIdx==GEOM_INVALID_IDX && dirtyIdx>=0 && dirtyIdx<DirtyList.size()),
         "geom indices messed up" );
+    int box;
     if( dirtyIdx != GEOM_INVALID_IDX ) {
         // we're in dirty list, remove
+        box = DirtyBoxList[dirtyIdx];
         int dirtySize = DirtyList.size();
         if (dirtyIdx != dirtySize-1) {
             dxGeom* lastG = DirtyList[dirtySize-1];
             DirtyList[dirtyIdx] = lastG;
+            DirtyBoxList[dirtyIdx] = DirtyBoxList[dirtySize-1];
             GEOM_SET_DIRTY_IDX(lastG,dirtyIdx);
         }
         GEOM_SET_DIRTY_IDX(g,GEOM_INVALID_IDX);
         DirtyList.setSize( dirtySize-1 );
+        DirtyBoxList.setSize( dirtySize-1 );
     } else {
         // we're in geom list, remove
+        box = GeomBoxList[geomIdx];
         int geomSize = GeomList.size();
         if (geomIdx != geomSize-1) {
             dxGeom* lastG = GeomList[geomSize-1];
             GeomList[geomIdx] = lastG;
+            GeomBoxList[geomIdx] = GeomBoxList[geomSize-1];
             GEOM_SET_GEOM_IDX(lastG,geomIdx);
         }
         GEOM_SET_GEOM_IDX(g,GEOM_INVALID_IDX);
         GeomList.setSize( geomSize-1 );
+        GeomBoxList.setSize( geomSize-1 );
+    }
+
+    if( box >= 0 ) {
+        IncrementalRemoveBox( box );
+    } else if( box == SAP_INF_BOX ) {
+        IncrementalRemoveInfGeom( g );
     }
 
     g->tome_ex = 0;
     dUASSERT((g->next_ex = 0, true), "Needed for an assertion check only");
+    QueryValid = false;
 
     dxSpace::remove(g);
 }
@@ -362,6 +595,8 @@ void dxSAPSpace::dirty( dxGeom* g )
     dAASSERT(g);
     dUASSERT(g->parent_space == this, "object is not in this space");
 
+    QueryValid = false;
+
     // check if already dirtied
     int dirtyIdx = GEOM_GET_DIRTY_IDX(g);
     if( dirtyIdx != GEOM_INVALID_IDX )
@@ -371,18 +606,22 @@ void dxSAPSpace::dirty( dxGeom* g )
     dUASSERT( geomIdx>=0 && geomIdx<GeomList.size(), "geom indices messed up" );
 
     // remove from geom list, place last in place of this
+    int box = GeomBoxList[geomIdx];
     int geomSize = GeomList.size();
     if (geomIdx != geomSize-1) {
         dxGeom* lastG = GeomList[geomSize-1];
         GeomList[geomIdx] = lastG;
+        GeomBoxList[geomIdx] = GeomBoxList[geomSize-1];
         GEOM_SET_GEOM_IDX(lastG,geomIdx);
     }
     GeomList.setSize( geomSize-1 );
+    GeomBoxList.setSize( geomSize-1 );
 
     // add to dirty list
     GEOM_SET_GEOM_IDX( g, GEOM_INVALID_IDX );
     GEOM_SET_DIRTY_IDX( g, DirtyList.size() );
     DirtyList.push( g );
+    DirtyBoxList.push( box );
 }
 
 void dxSAPSpace::computeAABB()
@@ -402,6 +641,18 @@ void dxSAPSpace::cleanGeoms()
 
     int geomSize = GeomList.size();
     GeomList.setSize( geomSize + dirtySize ); // ensure space in geom list
+    GeomBoxList.setSize( geomSize + dirtySize );
+
+    // Placing many new boxes one by one would cost O(n) each -- sort all of them at once instead
+    bool rebuild = false;
+    if( Incremental ) {
+        int newCount = 0;
+        for( int i = 0; i < dirtySize; ++i ) {
+            if( DirtyBoxList[i] == SAP_NO_BOX )
+                ++newCount;
+        }
+        rebuild = newCount > 16 && newCount * 4 > BoxCount;
+    }
 
     for( int i = 0; i < dirtySize; ++i ) {
         dxGeom* g = DirtyList[i];
@@ -418,9 +669,14 @@ void dxSAPSpace::cleanGeoms()
         GEOM_SET_DIRTY_IDX( g, GEOM_INVALID_IDX );
         GEOM_SET_GEOM_IDX( g, geomSize + i );
         GeomList[geomSize+i] = g;
+        GeomBoxList[geomSize+i] = Incremental && !rebuild ? IncrementalPlaceGeom( g, DirtyBoxList[i] ) : DirtyBoxList[i];
     }
     // clear dirty list
     DirtyList.setSize( 0 );
+    DirtyBoxList.setSize( 0 );
+
+    if( rebuild )
+        IncrementalRebuild();
 
     lock_count--;
 }
@@ -429,6 +685,11 @@ void dxSAPSpace::collide( void *data, dNearCallback *callback )
 {
     dAASSERT (callback);
 
+    if( Incremental ) {
+        IncrementalCollide( data, callback );
+        return;
+    }
+
     lock_count++;
 
     cleanGeoms();
@@ -517,6 +778,105 @@ void dxSAPSpace::collide2( void *data, dxGeom *geom, dNearCallback *callback )
     lock_count--;
 }
 
+void dxSAPSpace::QueryUpdate()
+{
+    QueryMaxExtent = 0;
+
+    if ( Incremental ) {
+        int boxSize = Boxes.size();
+        for ( int i = 0; i < boxSize; ++i ) {
+            const dxGeom* g = Boxes[ i ].geom;
+            if ( g != NULL )
+                QueryMaxExtent = dMax( QueryMaxExtent, g->aabb[ ax0idx + 1 ] - g->aabb[ ax0idx ] );
+        }
+    }
+    else {
+        QueryList.setSize( 0 );
+        QueryInfGeomList.setSize( 0 );
+        int geom_count = GeomList.size();
+        for ( int i = 0; i < geom_count; ++i ) {
+            dxGeom* g = GeomList[ i ];
+            const dReal amin = g->aabb[ ax0idx ], amax = g->aabb[ ax0idx + 1 ];
+            if ( amin == -dInfinity || amax == dInfinity ) {
+                QueryInfGeomList.push( g );
+                continue;
+            }
+            QueryEntry entry;
+            entry.value = amin;
+            entry.geom = g;
+            QueryList.push( entry );
+            QueryMaxExtent = dMax( QueryMaxExtent, amax - amin );
+        }
+
+        struct QueryEntryCompare
+        {
+            bool operator ()( const QueryEntry& e0, const QueryEntry& e1 ) const { return e0.value < e1.value; }
+        };
+        std::sort( QueryList.data(), QueryList.data() + QueryList.size(), QueryEntryCompare() );
+    }
+
+    QueryValid = true;
+}
+
+void dxSAPSpace::queryAABBOverlaps( dxGeom *geom, void *data, dxGeomOverlapCallback *callback )
+{
+    dAASSERT (geom && callback);
+    dIASSERT( DirtyList.size() == 0 );
+
+    if ( !QueryValid )
+        QueryUpdate();
+
+    // A geom overlapping on the axis starts at most the largest extent before
+    // the query geom (a few ulps more as the extents are rounded)
+    const dReal *bounds = geom->aabb;
+    dReal lower = bounds[ ax0idx ] - QueryMaxExtent;
+    lower -= ( dFabs( lower ) + QueryMaxExtent ) * ( 4 * dEpsilon );
+    const dReal upper = bounds[ ax0idx + 1 ];
+
+    const dArray<dxGeom*>* infGeoms;
+    if ( Incremental ) {
+        const dArray<Endpoint>& endpoints = Endpoints[ ax0idx >> 1 ];
+        int endpointCount = endpoints.size();
+        int first = 0;
+        for ( int last = endpointCount; first < last; ) {
+            int middle = ( first + last ) / 2;
+            if ( endpoints[ middle ].value < lower ) first = middle + 1;
+            else last = middle;
+        }
+        for ( int i = first; i < endpointCount && endpoints[ i ].value <= upper; ++i ) {
+            uint32 endpointData = endpoints[ i ].data;
+            if ( endpointData & 1 )
+                continue;
+            dxGeom* g = Boxes[ endpointData >> 1 ].geom;
+            if ( g != NULL && g != geom && overlapAABBs( g->aabb, bounds ) )
+                callback( data, g );
+        }
+        infGeoms = &InfGeomList;
+    }
+    else {
+        int entryCount = QueryList.size();
+        int first = 0;
+        for ( int last = entryCount; first < last; ) {
+            int middle = ( first + last ) / 2;
+            if ( QueryList[ middle ].value < lower ) first = middle + 1;
+            else last = middle;
+        }
+        for ( int i = first; i < entryCount && QueryList[ i ].value <= upper; ++i ) {
+            dxGeom* g = QueryList[ i ].geom;
+            if ( g != geom && overlapAABBs( g->aabb, bounds ) )
+                callback( data, g );
+        }
+        infGeoms = &QueryInfGeomList;
+    }
+
+    int infSize = infGeoms->size();
+    for ( int i = 0; i < infSize; ++i ) {
+        dxGeom* g = (*infGeoms)[ i ];
+        if ( g != geom && overlapAABBs( g->aabb, bounds ) )
+            callback( data, g );
+    }
+}
+
 
 void dxSAPSpace::BoxPruning( int count, const dxGeom** geoms, dArray< Pair >& pairs )
 {
@@ -582,6 +942,426 @@ void dxSAPSpace::BoxPruning( int count, const dxGeom** geoms, dArray< Pair >& pa
 }
 
 
+//==============================================================================
+
+//------------------------------------------------------------------------------
+// Incremental mode
+//------------------------------------------------------------------------------
+
+// Minimums go before maximums at equal values so that touching boxes overlap as in BoxPruning
+static inline bool EndpointLess( dReal value0, uint32 data0, dReal value1, uint32 data1 )
+{
+    return value0 < value1 || ( value0 == value1 && ( data0 & 1 ) < ( data1 & 1 ) );
+}
+
+void dxSAPSpace::setIncremental( bool incremental )
+{
+    CHECK_NOT_LOCKED(this);
+
+    if ( incremental == Incremental )
+        return;
+
+    Incremental = incremental;
+    QueryValid = false;
+    if ( incremental )
+    {
+        // The clean geoms are placed now, the dirty ones will be by cleanGeoms()
+        IncrementalRebuild();
+    }
+    else
+    {
+        IncrementalClear();
+    }
+}
+
+void dxSAPSpace::IncrementalClear()
+{
+    Boxes.setSize( 0 );
+    FreeBoxes.setSize( 0 );
+    RemovedBoxes.setSize( 0 );
+    BoxCount = 0;
+    for ( int axis = 0; axis < 3; ++axis )
+        Endpoints[ axis ].setSize( 0 );
+    OverlapPairs.Clear();
+    InfGeomList.setSize( 0 );
+
+    for ( int i = 0; i < DirtyBoxList.size(); ++i )
+        DirtyBoxList[ i ] = SAP_NO_BOX;
+    for ( int i = 0; i < GeomBoxList.size(); ++i )
+        GeomBoxList[ i ] = SAP_NO_BOX;
+}
+
+void dxSAPSpace::IncrementalRebuild()
+{
+    IncrementalClear();
+
+    // Collect the endpoints of the clean geoms unsorted...
+    int geomSize = GeomList.size();
+    for ( int i = 0; i < geomSize; ++i )
+    {
+        dxGeom* g = GeomList[ i ];
+        if ( g->aabb[ ax0idx + 1 ] == dInfinity )
+        {
+            InfGeomList.push( g );
+            GeomBoxList[ i ] = SAP_INF_BOX;
+            continue;
+        }
+
+        Box box;
+        box.geom = g;
+        uint32 data = (uint32)Boxes.size() << 1;
+        for ( int axis = 0; axis < 3; ++axis )
+        {
+            Endpoint endpoint;
+            endpoint.value = g->aabb[ axis * 2 ];
+            endpoint.data = data;
+            Endpoints[ axis ].push( endpoint );
+            endpoint.value = g->aabb[ axis * 2 + 1 ];
+            endpoint.data = data | 1;
+            Endpoints[ axis ].push( endpoint );
+        }
+        GeomBoxList[ i ] = Boxes.size();
+        Boxes.push( box );
+    }
+    BoxCount = Boxes.size();
+
+    // ...sort them...
+    struct EndpointCompare
+    {
+        bool operator ()( const Endpoint& e0, const Endpoint& e1 ) const { return EndpointLess( e0.value, e0.data, e1.value, e1.data ); }
+    };
+    int endpointCount = BoxCount * 2;
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        Endpoint* endpoints = Endpoints[ axis ].data();
+        std::sort( endpoints, endpoints + endpointCount, EndpointCompare() );
+        for ( int i = 0; i < endpointCount; ++i )
+            Boxes[ endpoints[ i ].data >> 1 ].pos[ axis ][ endpoints[ i ].data & 1 ] = i;
+    }
+
+    // ...and sweep the X axis for the initial pairs
+    const Endpoint* endpoints = Endpoints[ 0 ].data();
+    for ( int i = 0; i < endpointCount; ++i )
+    {
+        uint32 data = endpoints[ i ].data;
+        if ( data & 1 )
+            continue;
+
+        uint32 box0 = data >> 1;
+        for ( int j = i + 1; endpoints[ j ].data != ( data | 1 ); ++j )
+        {
+            uint32 other = endpoints[ j ].data;
+            if ( !( other & 1 ) && IncrementalBoxesOverlap( box0, other >> 1 ) )
+                OverlapPairs.Add( box0, other >> 1 );
+        }
+    }
+}
+
+int dxSAPSpace::IncrementalPlaceGeom( dxGeom* g, int box )
+{
+    bool infinite = g->aabb[ ax0idx + 1 ] == dInfinity;
+
+    if ( box >= 0 )
+    {
+        if ( !infinite )
+        {
+            IncrementalUpdateBox( box );
+            return box;
+        }
+        IncrementalRemoveBox( box );
+    }
+    else if ( box == SAP_INF_BOX )
+    {
+        if ( infinite )
+            return SAP_INF_BOX;
+        IncrementalRemoveInfGeom( g );
+    }
+
+    if ( infinite )
+    {
+        InfGeomList.push( g );
+        return SAP_INF_BOX;
+    }
+    return IncrementalInsertBox( g );
+}
+
+int dxSAPSpace::IncrementalInsertBox( dxGeom* g )
+{
+    int box;
+    int freeCount = FreeBoxes.size();
+    if ( freeCount != 0 )
+    {
+        box = FreeBoxes[ freeCount - 1 ];
+        FreeBoxes.setSize( freeCount - 1 );
+    }
+    else
+    {
+        box = Boxes.size();
+        Boxes.setSize( box + 1 );
+    }
+    ++BoxCount;
+
+    // Append the endpoints past all the others (that is, not overlapping anything yet)...
+    Box& newBox = Boxes[ box ];
+    newBox.geom = g;
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        dArray<Endpoint>& endpoints = Endpoints[ axis ];
+        uint32 pos = endpoints.size();
+        Endpoint endpoint;
+        endpoint.value = g->aabb[ axis * 2 ];
+        endpoint.data = (uint32)box << 1;
+        endpoints.push( endpoint );
+        endpoint.value = g->aabb[ axis * 2 + 1 ];
+        endpoint.data = ( (uint32)box << 1 ) | 1;
+        endpoints.push( endpoint );
+        newBox.pos[ axis ][ 0 ] = pos;
+        newBox.pos[ axis ][ 1 ] = pos + 1;
+    }
+
+    // ...and sort them down to their places
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        IncrementalSortDown( axis, Boxes[ box ].pos[ axis ][ 0 ] );
+        IncrementalSortDown( axis, Boxes[ box ].pos[ axis ][ 1 ] );
+    }
+
+    return box;
+}
+
+void dxSAPSpace::IncrementalUpdateBox( int box )
+{
+    const dReal* aabb = Boxes[ box ].geom->aabb;
+
+    // All the values are set before sorting so that the overlap checks see the new box
+    dReal oldValues[3][2];
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        for ( int side = 0; side < 2; ++side )
+        {
+            Endpoint& endpoint = Endpoints[ axis ][ Boxes[ box ].pos[ axis ][ side ] ];
+            oldValues[ axis ][ side ] = endpoint.value;
+            endpoint.value = aabb[ axis * 2 + side ];
+        }
+    }
+
+    // Expand first so that a minimum moving up never passes its own maximum
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        const Box& b = Boxes[ box ];
+        dReal newMin = aabb[ axis * 2 ], newMax = aabb[ axis * 2 + 1 ];
+        if ( newMin < oldValues[ axis ][ 0 ] )
+            IncrementalSortDown( axis, b.pos[ axis ][ 0 ] );
+        if ( newMax > oldValues[ axis ][ 1 ] )
+            IncrementalSortUp( axis, b.pos[ axis ][ 1 ] );
+        if ( newMin > oldValues[ axis ][ 0 ] )
+            IncrementalSortUp( axis, b.pos[ axis ][ 0 ] );
+        if ( newMax < oldValues[ axis ][ 1 ] )
+            IncrementalSortDown( axis, b.pos[ axis ][ 1 ] );
+    }
+}
+
+void dxSAPSpace::IncrementalRemoveBox( int box )
+{
+    // The endpoints stay sorted where they are and the box's pairs are left
+    // for the compaction. The box must not be reused until then.
+    Boxes[ box ].geom = NULL;
+    RemovedBoxes.push( box );
+    --BoxCount;
+
+    // Bound the dead entries so that the sorts do not slow down in the meantime
+    if ( RemovedBoxes.size() > BoxCount )
+        IncrementalCompact();
+}
+
+void dxSAPSpace::IncrementalCompact()
+{
+    int removedCount = RemovedBoxes.size();
+    if ( removedCount == 0 )
+        return;
+
+    // Drop the pairs of the removed boxes...
+    dArray<SAPPairSet::Slot> deadPairs;
+    int slotCount = OverlapPairs.GetSlotCount();
+    for ( int i = 0; i < slotCount; ++i )
+    {
+        const SAPPairSet::Slot& slot = OverlapPairs.GetSlot( i );
+        if ( slot.id0 != SAPPairSet::EMPTY_ID && ( Boxes[ slot.id0 ].geom == NULL || Boxes[ slot.id1 ].geom == NULL ) )
+            deadPairs.push( slot );
+    }
+    for ( int i = 0; i < deadPairs.size(); ++i )
+        OverlapPairs.Remove( deadPairs[ i ].id0, deadPairs[ i ].id1 );
+
+    // ...close the gaps of their endpoints in the sorted arrays...
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        dArray<Endpoint>& endpoints = Endpoints[ axis ];
+        int endpointCount = endpoints.size();
+        int dst = 0;
+        for ( int src = 0; src < endpointCount; ++src )
+        {
+            const Endpoint endpoint = endpoints[ src ];
+            if ( Boxes[ endpoint.data >> 1 ].geom == NULL )
+                continue;
+            endpoints[ dst ] = endpoint;
+            Boxes[ endpoint.data >> 1 ].pos[ axis ][ endpoint.data & 1 ] = dst;
+            ++dst;
+        }
+        endpoints.setSize( dst );
+    }
+
+    // ...and free them for reuse
+    for ( int i = 0; i < removedCount; ++i )
+        FreeBoxes.push( RemovedBoxes[ i ] );
+    RemovedBoxes.setSize( 0 );
+}
+
+void dxSAPSpace::IncrementalRemoveInfGeom( dxGeom* g )
+{
+    int infSize = InfGeomList.size();
+    for ( int i = 0; i < infSize; ++i )
+    {
+        if ( InfGeomList[ i ] == g )
+        {
+            InfGeomList[ i ] = InfGeomList[ infSize - 1 ];
+            InfGeomList.setSize( infSize - 1 );
+            break;
+        }
+    }
+}
+
+bool dxSAPSpace::IncrementalBoxesOverlap( uint32 box0, uint32 box1 ) const
+{
+    const Box& b0 = Boxes[ box0 ];
+    const Box& b1 = Boxes[ box1 ];
+    for ( int axis = 0; axis < 3; ++axis )
+    {
+        const Endpoint* endpoints = Endpoints[ axis ].data();
+        if ( endpoints[ b0.pos[ axis ][ 0 ] ].value > endpoints[ b1.pos[ axis ][ 1 ] ].value
+            || endpoints[ b1.pos[ axis ][ 0 ] ].value > endpoints[ b0.pos[ axis ][ 1 ] ].value )
+            return false;
+    }
+    return true;
+}
+
+/*
+*  The overlap status of two boxes only changes as a minimum of one of them
+*  passes a maximum of the other. A pair is added when the boxes start to
+*  overlap on the axis (and do on the others) and removed when they stop.
+*/
+void dxSAPSpace::IncrementalSortDown( int axis, uint32 pos )
+{
+    Endpoint* endpoints = Endpoints[ axis ].data();
+    const Endpoint moving = endpoints[ pos ];
+    uint32 movingBox = moving.data >> 1;
+
+    for ( ; pos > 0 && EndpointLess( moving.value, moving.data, endpoints[ pos - 1 ].value, endpoints[ pos - 1 ].data ); --pos )
+    {
+        const Endpoint prev = endpoints[ pos - 1 ];
+        uint32 prevBox = prev.data >> 1;
+
+        if ( prevBox != movingBox && ( moving.data & 1 ) != ( prev.data & 1 ) && Boxes[ prevBox ].geom != NULL )
+        {
+            if ( prev.data & 1 )
+            {
+                // A minimum passes a maximum -- the boxes start overlapping on the axis
+                if ( IncrementalBoxesOverlap( movingBox, prevBox ) )
+                    OverlapPairs.Add( movingBox, prevBox );
+            }
+            else
+            {
+                OverlapPairs.Remove( movingBox, prevBox );
+            }
+        }
+
+        endpoints[ pos ] = prev;
+        endpoints[ pos - 1 ] = moving;
+        Boxes[ prevBox ].pos[ axis ][ prev.data & 1 ] = pos;
+        Boxes[ movingBox ].pos[ axis ][ moving.data & 1 ] = pos - 1;
+    }
+}
+
+void dxSAPSpace::IncrementalSortUp( int axis, uint32 pos )
+{
+    Endpoint* endpoints = Endpoints[ axis ].data();
+    uint32 last = Endpoints[ axis ].size() - 1;
+    const Endpoint moving = endpoints[ pos ];
+    uint32 movingBox = moving.data >> 1;
+
+    for ( ; pos < last && EndpointLess( endpoints[ pos + 1 ].value, endpoints[ pos + 1 ].data, moving.value, moving.data ); ++pos )
+    {
+        const Endpoint next = endpoints[ pos + 1 ];
+        uint32 nextBox = next.data >> 1;
+
+        if ( nextBox != movingBox && ( moving.data & 1 ) != ( next.data & 1 ) && Boxes[ nextBox ].geom != NULL )
+        {
+            if ( moving.data & 1 )
+            {
+                // A maximum passes a minimum -- the boxes start overlapping on the axis
+                if ( IncrementalBoxesOverlap( movingBox, nextBox ) )
+                    OverlapPairs.Add( movingBox, nextBox );
+            }
+            else
+            {
+                OverlapPairs.Remove( movingBox, nextBox );
+            }
+        }
+
+        endpoints[ pos ] = next;
+        endpoints[ pos + 1 ] = moving;
+        Boxes[ nextBox ].pos[ axis ][ next.data & 1 ] = pos;
+        Boxes[ movingBox ].pos[ axis ][ moving.data & 1 ] = pos + 1;
+    }
+}
+
+void dxSAPSpace::IncrementalCollide( void *data, dNearCallback *callback )
+{
+    lock_count++;
+
+    // brings the boxes and the pairs up to date
+    cleanGeoms();
+    IncrementalCompact();
+
+    int slotCount = OverlapPairs.GetSlotCount();
+    for ( int i = 0; i < slotCount; ++i )
+    {
+        const SAPPairSet::Slot& slot = OverlapPairs.GetSlot( i );
+        if ( slot.id0 == SAPPairSet::EMPTY_ID )
+            continue;
+
+        dxGeom* g1 = Boxes[ slot.id0 ].geom;
+        dxGeom* g2 = Boxes[ slot.id1 ].geom;
+        if ( GEOM_ENABLED(g1) && GEOM_ENABLED(g2) )
+            collideGeomsNoAABBs( g1, g2, data, callback );
+    }
+
+    int infSize = InfGeomList.size();
+    int boxSize = Boxes.size();
+    for ( int m = 0; m < infSize; ++m )
+    {
+        dxGeom* g1 = InfGeomList[ m ];
+        if ( !GEOM_ENABLED(g1) )
+            continue;
+
+        // collide infinite ones
+        for ( int n = m + 1; n < infSize; ++n ) {
+            dxGeom* g2 = InfGeomList[ n ];
+            if ( GEOM_ENABLED(g2) )
+                collideGeomsNoAABBs( g1, g2, data, callback );
+        }
+
+        // collide infinite ones with normal ones
+        for ( int n = 0; n < boxSize; ++n ) {
+            dxGeom* g2 = Boxes[ n ].geom;
+            if ( g2 != NULL && GEOM_ENABLED(g2) )
+                collideGeomsNoAABBs( g1, g2, data, callback );
+        }
+    }
+
+    lock_count--;
+}
+
+
 //==============================================================================
 
 //------------------------------------------------------------------------------
@@ -35,7 +35,9 @@ spaces
 #include "matrix.h"
 #include "collision_kernel.h"
 #include "collision_space_internal.h"
+#include "collision_space_paircache.h"
 #include "util.h"
+#include "threadingutils.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable:4291)  // for VC++, no complaints about "no matching operator delete found"
@@ -62,6 +64,7 @@ void dGeomMoved (dxGeom *geom)
     while (parent && (geom->gflags & GEOM_DIRTY)==0) {
         geom->markAABBBad();
         parent->dirty (geom);
+        if (parent->pair_cache) parent->pair_cache->geomMoved (geom);
         geom = parent;
         parent = parent->parent_space;
     }
@@ -89,6 +92,7 @@ dxSpace::dxSpace (dSpaceID _space) : dxGeom (_space,0)
     current_index = 0;
     current_geom = 0;
     lock_count = 0;
+    pair_cache = 0;
 }
 
 
@@ -110,6 +114,8 @@ dxSpace::~dxSpace()
             remove (g);
         }
     }
+
+    delete pair_cache;
 }
 
 
@@ -171,6 +177,8 @@ void dxSpace::add (dxGeom *geom)
     geom->spaceAdd (&first);
     count++;
 
+    if (pair_cache) pair_cache->geomMoved (geom);
+
     // enumerator has been invalidated
     current_geom = 0;
 
@@ -184,6 +192,8 @@ void dxSpace::remove (dxGeom *geom)
     dAASSERT (geom);
     dUASSERT (geom->parent_space == this,"object is not in this space");
 
+    if (pair_cache) pair_cache->geomRemoved (geom);
+
     // remove
     geom->spaceRemove();
     count--;
@@ -208,6 +218,7 @@ void dxSpace::dirty (dxGeom *geom)
     geom->spaceAdd (&first);
 }
 
+
 //****************************************************************************
 // simple space - reports all n^2 object intersections
 
@@ -216,6 +227,7 @@ struct dxSimpleSpace : public dxSpace {
     void cleanGeoms();
     void collide (void *data, dNearCallback *callback);
     void collide2 (void *data, dxGeom *geom, dNearCallback *callback);
+    void queryAABBOverlaps (dxGeom *geom, void *data, dxGeomOverlapCallback *callback);
 };
 
 
@@ -284,6 +296,17 @@ void dxSimpleSpace::collide2 (void *data, dxGeom *geom,
     lock_count--;
 }
 
+
+void dxSimpleSpace::queryAABBOverlaps (dxGeom *geom, void *data,
+                                       dxGeomOverlapCallback *callback)
+{
+    dAASSERT (geom && callback);
+
+    for (dxGeom *g=first; g; g=g->next) {
+        if (g != geom && overlapAABBs (g->aabb,geom->aabb)) callback (data,g);
+    }
+}
+
 //****************************************************************************
 // utility stuff for hash table space
 
@@ -363,17 +386,77 @@ static unsigned long getVirtualAddressBase (unsigned int level, unsigned int x,
 //****************************************************************************
 // hash space
 
+// a cell of the hash table kept for the AABB queries. the AABBs are put in
+// the cells of their own level and of all the levels above, so that a query
+// finds the smaller AABBs at its own level and the larger ones going up.
+struct dxQueryNode {
+    int next;		// next node in hash table collision list (or in the free list), -1 if none
+    int box_next;	// next node of the same AABB, -1 if none
+    int level;		// the level of the cell
+    int x,y,z;		// cell position in space, discretized to cell size
+    int index;		// index of the AABB in query_boxes
+};
+
+
+// an AABB kept for the queries. the boxes of the geoms that change are
+// updated by the next query rather than rebuilding the whole table.
+struct dxQueryBox {
+    dxGeom *geom;		// the geom, 0 if the box is free
+    int level;		// the level of the cells, larger than global_maxlevel for the big geoms
+    int dbounds[6];	// AABB bounds, discretized to cell size
+    int first_node;	// first node of the box, -1 if none
+    int big_index;	// index in query_big_boxes if the geom is big
+    bool pending;	// the box is to be (re)placed by the next query
+};
+
+
+// the query box of a geom in a hash space is kept in the geom's extra link
+// (which only the other space kinds use)
+#define GEOM_SET_QUERY_BOX(g,b) { (g)->next_ex = (dxGeom*)(sizeint)((b) + 1); }
+#define GEOM_CLEAR_QUERY_BOX(g) { (g)->next_ex = 0; }
+#define GEOM_GET_QUERY_BOX(g) ((int)(sizeint)(g)->next_ex - 1)
+
+
 struct dxHashSpace : public dxSpace {
     int global_minlevel;	// smallest hash table level to put AABBs in
     int global_maxlevel;	// objects that need a level larger than this will be
     // put in a "big objects" list instead of a hash table
 
+    // the hash table for the AABB queries, built by the first query. the
+    // geoms added, removed or moved afterwards only have their own boxes
+    // updated by the next query.
+    bool query_table_valid;
+    int query_maxlevel;			// the largest level of the cells in the table
+    unsigned query_mark;		// the mark of the AABBs found by the current query
+    std::vector<dxQueryBox> query_boxes;
+    std::vector<unsigned> query_box_marks;
+    std::vector<int> query_free_boxes;
+    std::vector<int> query_pending_boxes;
+    std::vector<int> query_big_boxes;
+    std::vector<dxQueryNode> query_nodes;
+    int query_free_node;		// first of the free nodes chained by next, -1 if none
+    int query_node_count;		// the number of the nodes in the table
+    std::vector<int> query_table;
+
     dxHashSpace (dSpaceID _space);
+    ~dxHashSpace();
     void setLevels (int minlevel, int maxlevel);
     void getLevels (int *minlevel, int *maxlevel);
+    void add (dxGeom *geom);
+    void remove (dxGeom *geom);
+    void dirty (dxGeom *geom);
     void cleanGeoms();
     void collide (void *data, dNearCallback *callback);
     void collide2 (void *data, dxGeom *geom, dNearCallback *callback);
+    void queryAABBOverlaps (dxGeom *geom, void *data, dxGeomOverlapCallback *callback);
+
+private:
+    int clampLevel (int level) const { return level < global_minlevel ? global_minlevel : level; }
+    void buildQueryTable();
+    void updateQueryTable();
+    void placeQueryBox (int b, bool link);
+    void unplaceQueryBox (int b);
+    int allocQueryNode();
 };
 
 
@@ -382,6 +465,20 @@ dxHashSpace::dxHashSpace (dSpaceID _space) : dxSpace (_space)
     type = dHashSpaceClass;
     global_minlevel = -3;
     global_maxlevel = 10;
+    query_table_valid = false;
+    query_maxlevel = 0;
+    query_mark = 0;
+    query_free_node = -1;
+    query_node_count = 0;
+}
+
+
+dxHashSpace::~dxHashSpace()
+{
+    // the geoms left to the base destructor must not keep their query boxes
+    for (dxGeom *g = first; g; g = g->next) {
+        GEOM_CLEAR_QUERY_BOX(g);
+    }
 }
 
 
@@ -390,6 +487,61 @@ void dxHashSpace::setLevels (int minlevel, int maxlevel)
     dAASSERT (minlevel <= maxlevel);
     global_minlevel = minlevel;
     global_maxlevel = maxlevel;
+    query_table_valid = false;
+}
+
+
+void dxHashSpace::add (dxGeom *geom)
+{
+    if (query_table_valid) {
+        int b;
+        if (!query_free_boxes.empty()) {
+            b = query_free_boxes.back();
+            query_free_boxes.pop_back();
+        }
+        else {
+            b = (int)query_boxes.size();
+            query_boxes.push_back(dxQueryBox());
+            query_box_marks.push_back(0);
+        }
+        dxQueryBox &box = query_boxes[b];
+        box.geom = geom;
+        box.level = global_minlevel - 1; // not placed yet
+        box.first_node = -1;
+        box.pending = true;
+        query_pending_boxes.push_back(b);
+        GEOM_SET_QUERY_BOX(geom,b);
+    }
+    dxSpace::add (geom);
+}
+
+
+void dxHashSpace::remove (dxGeom *geom)
+{
+    if (query_table_valid) {
+        int b = GEOM_GET_QUERY_BOX(geom);
+        dIASSERT(b >= 0 && query_boxes[b].geom == geom);
+        unplaceQueryBox (b);
+        query_boxes[b].geom = 0;
+        query_boxes[b].pending = false;
+        query_free_boxes.push_back(b);
+    }
+    GEOM_CLEAR_QUERY_BOX(geom);
+    dxSpace::remove (geom);
+}
+
+
+void dxHashSpace::dirty (dxGeom *geom)
+{
+    if (query_table_valid) {
+        int b = GEOM_GET_QUERY_BOX(geom);
+        dIASSERT(b >= 0 && query_boxes[b].geom == geom);
+        if (!query_boxes[b].pending) {
+            query_boxes[b].pending = true;
+            query_pending_boxes.push_back(b);
+        }
+    }
+    dxSpace::dirty (geom);
 }
 
 
@@ -634,6 +786,251 @@ void dxHashSpace::collide2 (void *data, dxGeom *geom,
     lock_count--;
 }
 
+static void discretizeAABB (int dbounds[6], const dReal aabb[6], int level)
+{
+    // cellsize = 2^level
+    dReal cellSizeRecip = dRecip(ldexp(REAL(1.0), level)); // No computational errors here!
+    for (int i=0; i < 6; i++) {
+        dReal aabbBound = aabb[i] * cellSizeRecip;
+        dICHECK(aabbBound >= dMinIntExact && aabbBound </*=*/ dMaxIntExact); // Otherwise the scene is too large for integer types used 
+
+        dbounds[i] = (int) dFloor(aabbBound);
+    }
+}
+
+
+int dxHashSpace::allocQueryNode()
+{
+    int ni = query_free_node;
+    if (ni != -1) {
+        query_free_node = query_nodes[ni].next;
+    }
+    else {
+        ni = (int)query_nodes.size();
+        query_nodes.push_back(dxQueryNode());
+    }
+    query_node_count++;
+    return ni;
+}
+
+
+// put the AABB of the box in the cells of its level and of the levels above
+// (or in the big geoms list). the nodes are chained in the table if `link'
+// is set, the table build chains all of them at once otherwise.
+void dxHashSpace::placeQueryBox (int b, bool link)
+{
+    dxGeom *geom = query_boxes[b].geom;
+    int level = clampLevel (findLevel (geom->aabb));
+    query_boxes[b].level = level;
+    query_boxes[b].first_node = -1;
+    if (level > global_maxlevel) {
+        query_boxes[b].big_index = (int)query_big_boxes.size();
+        query_big_boxes.push_back(b);
+        return;
+    }
+
+    dIASSERT(level <= query_maxlevel);
+    discretizeAABB (query_boxes[b].dbounds,geom->aabb,level);
+    int db[6];
+    for (int i=0; i<6; i++) db[i] = query_boxes[b].dbounds[i];
+    const unsigned long sz = (unsigned long)query_table.size();
+    for (; level <= query_maxlevel; level++) {
+        for (int xi = db[0]; xi <= db[1]; xi++) {
+            for (int yi = db[2]; yi <= db[3]; yi++) {
+                for (int zi = db[4]; zi <= db[5]; zi++) {
+                    int ni = allocQueryNode();
+                    dxQueryNode &node = query_nodes[ni];
+                    node.level = level;
+                    node.x = xi;
+                    node.y = yi;
+                    node.z = zi;
+                    node.index = b;
+                    node.box_next = query_boxes[b].first_node;
+                    query_boxes[b].first_node = ni;
+                    if (link) {
+                        unsigned long hi = (getVirtualAddressBase(level,xi,yi) + zi) % sz;
+                        node.next = query_table[hi];
+                        query_table[hi] = ni;
+                    }
+                }
+            }
+        }
+        for (int i=0; i<6; i++) db[i] >>= 1;
+    }
+}
+
+
+void dxHashSpace::unplaceQueryBox (int b)
+{
+    dxQueryBox &box = query_boxes[b];
+    if (box.level < global_minlevel) {
+        // not placed yet
+        return;
+    }
+
+    if (box.level > global_maxlevel) {
+        int last = query_big_boxes.back();
+        query_big_boxes[box.big_index] = last;
+        query_boxes[last].big_index = box.big_index;
+        query_big_boxes.pop_back();
+    }
+    else {
+        const unsigned long sz = (unsigned long)query_table.size();
+        for (int ni = box.first_node; ni != -1; ) {
+            dxQueryNode &node = query_nodes[ni];
+            unsigned long hi = (getVirtualAddressBase(node.level,node.x,node.y) + node.z) % sz;
+            int *link = &query_table[hi];
+            while (*link != ni) link = &query_nodes[*link].next;
+            *link = node.next;
+
+            int next = node.box_next;
+            node.next = query_free_node;
+            query_free_node = ni;
+            query_node_count--;
+            ni = next;
+        }
+        box.first_node = -1;
+    }
+    box.level = global_minlevel - 1;
+}
+
+
+void dxHashSpace::buildQueryTable()
+{
+    query_boxes.clear();
+    query_free_boxes.clear();
+    query_pending_boxes.clear();
+    query_big_boxes.clear();
+    query_nodes.clear();
+    query_free_node = -1;
+    query_node_count = 0;
+    query_maxlevel = global_minlevel;
+
+    for (dxGeom *geom = first; geom; geom=geom->next) {
+        int level = clampLevel (findLevel (geom->aabb));
+        if (level <= global_maxlevel && level > query_maxlevel) query_maxlevel = level;
+        dxQueryBox box;
+        box.geom = geom;
+        box.pending = false;
+        GEOM_SET_QUERY_BOX(geom,(int)query_boxes.size());
+        query_boxes.push_back(box);
+    }
+    query_box_marks.assign(query_boxes.size(),0);
+    query_mark = 0;
+
+    const int n = (int)query_boxes.size();
+    for (int b = 0; b != n; b++) {
+        placeQueryBox (b,false);
+    }
+
+    // compute hash table size to be a prime > 2*nodes and chain the nodes
+    int i;
+    for (i=0; i<NUM_PRIMES; i++) {
+        if ((sizeint)prime[i] >= 2 * query_nodes.size()) break;
+    }
+    if (i >= NUM_PRIMES) {
+        i = NUM_PRIMES-1;
+    }
+    const unsigned long sz = prime[i];
+    query_table.assign(sz,-1);
+
+    const int nodeCount = (int)query_nodes.size();
+    for (int ni = 0; ni != nodeCount; ni++) {
+        dxQueryNode &node = query_nodes[ni];
+        unsigned long hi = (getVirtualAddressBase(node.level,node.x,node.y) + node.z) % sz;
+        node.next = query_table[hi];
+        query_table[hi] = ni;
+    }
+
+    query_table_valid = true;
+}
+
+
+void dxHashSpace::updateQueryTable()
+{
+    const sizeint pendingCount = query_pending_boxes.size();
+    for (sizeint p = 0; p != pendingCount; p++) {
+        int b = query_pending_boxes[p];
+        if (!query_boxes[b].pending) {
+            // removed (or listed twice)
+            continue;
+        }
+        query_boxes[b].pending = false;
+        unplaceQueryBox (b);
+
+        // the cells of all the boxes would have to go up to the new level
+        int level = clampLevel (findLevel (query_boxes[b].geom->aabb));
+        if (level <= global_maxlevel && level > query_maxlevel) {
+            buildQueryTable();
+            return;
+        }
+        placeQueryBox (b,true);
+    }
+    query_pending_boxes.clear();
+
+    // keep the chains short as the table fills up
+    if ((sizeint)query_node_count > query_table.size()) {
+        buildQueryTable();
+    }
+}
+
+
+void dxHashSpace::queryAABBOverlaps (dxGeom *geom, void *data,
+                                     dxGeomOverlapCallback *callback)
+{
+    dAASSERT (geom && callback);
+
+    if (!query_table_valid) buildQueryTable();
+    else if (!query_pending_boxes.empty()) updateQueryTable();
+
+    const dReal *bounds = geom->aabb;
+    int level = clampLevel (findLevel (geom->aabb));
+    if (level > query_maxlevel) {
+        // the geom is larger than all the AABBs in the table
+        const sizeint n = query_boxes.size();
+        for (sizeint b = 0; b != n; b++) {
+            dxGeom *g = query_boxes[b].geom;
+            if (g != 0 && query_boxes[b].level <= global_maxlevel && 
+                g != geom && overlapAABBs (g->aabb,bounds)) callback (data,g);
+        }
+    }
+    else {
+        if (++query_mark == 0) {
+            query_box_marks.assign(query_box_marks.size(),0);
+            query_mark = 1;
+        }
+
+        const unsigned long sz = (unsigned long)query_table.size();
+        int db[6];
+        discretizeAABB (db,bounds,level);
+        for (; level <= query_maxlevel; level++) {
+            for (int xi = db[0]; xi <= db[1]; xi++) {
+                for (int yi = db[2]; yi <= db[3]; yi++) {
+                    for (int zi = db[4]; zi <= db[5]; zi++) {
+                        unsigned long hi = (getVirtualAddressBase(level,xi,yi) + zi) % sz;
+                        for (int ni = query_table[hi]; ni != -1; ni = query_nodes[ni].next) {
+                            const dxQueryNode &node = query_nodes[ni];
+                            if (node.level == level && node.x == xi && node.y == yi && node.z == zi &&
+                                query_box_marks[node.index] != query_mark) {
+                                query_box_marks[node.index] = query_mark;
+                                dxGeom *g = query_boxes[node.index].geom;
+                                if (g != geom && overlapAABBs (g->aabb,bounds)) callback (data,g);
+                            }
+                        }
+                    }
+                }
+            }
+            for (int i=0; i<6; i++) db[i] >>= 1;
+        }
+    }
+
+    const sizeint bigCount = query_big_boxes.size();
+    for (sizeint b = 0; b != bigCount; b++) {
+        dxGeom *g = query_boxes[query_big_boxes[b]].geom;
+        if (g != geom && overlapAABBs (g->aabb,bounds)) callback (data,g);
+    }
+}
+
 //****************************************************************************
 // space functions
 
@@ -714,6 +1111,32 @@ void dSpaceSetManualCleanup (dSpaceID space, int mode)
     space->setManulCleanup(mode);
 }
 
+void dSpaceSetPairCacheMode (dSpaceID space, int mode)
+{
+    dAASSERT (space);
+    dUASSERT (dGeomIsSpace(space),"argument not a space");
+    dUASSERT (mode >= dSpacePairCacheDisabled && mode <= dSpacePairCacheMovingPairs,"invalid pair cache mode");
+    CHECK_NOT_LOCKED (space);
+
+    if (mode == dSpacePairCacheDisabled) {
+        delete space->pair_cache;
+        space->pair_cache = 0;
+    }
+    else if (space->pair_cache) {
+        space->pair_cache->setMode (mode);
+    }
+    else {
+        space->pair_cache = new dxSpacePairCache (mode);
+    }
+}
+
+int dSpaceGetPairCacheMode (dSpaceID space)
+{
+    dAASSERT (space);
+    dUASSERT (dGeomIsSpace(space),"argument not a space");
+    return space->pair_cache ? space->pair_cache->getMode() : dSpacePairCacheDisabled;
+}
+
 int dSpaceGetManualCleanup (dSpaceID space)
 {
     dAASSERT (space);
@@ -776,11 +1199,133 @@ int dSpaceGetClass (dxSpace *space)
 }
 
 
+static void collideSpace (dxSpace *space, void *data, dNearCallback *callback)
+{
+    if (space->pair_cache) {
+        space->pair_cache->collide (space,data,callback);
+    }
+    else {
+        space->collide (data,callback);
+    }
+}
+
+
 void dSpaceCollide (dxSpace *space, void *data, dNearCallback *callback)
 {
     dAASSERT (space && callback);
     dUASSERT (dGeomIsSpace(space),"argument not a space");
-    space->collide (data,callback);
+    collideSpace (space,data,callback);
+}
+
+
+// Candidate pairs are collected on the calling thread and the near callbacks
+// are then dispatched in blocks to the threads of the world's threading implementation.
+// The pairs of the geoms that can't be collided concurrently are all dispatched
+// on the calling thread.
+
+#define dCOLLIDE_THREADED_PAIR_BLOCK_SIZE 16
+
+struct dxThreadedCollideContext {
+    dArray<dxGeom *> pairs;     // candidate pairs as o1,o2 sequence
+    dArray<dxGeom *> serial_pairs;
+    volatile atomicord32 pair_block_progress;
+    unsigned pair_block_count;
+    void *data;
+    dThreadedNearCallback *callback;
+};
+
+static void collectPairCallback (void *data, dxGeom *o1, dxGeom *o2)
+{
+    dxThreadedCollideContext *context = (dxThreadedCollideContext *)data;
+    dArray<dxGeom *> &pairs = dxGeomNeedsSerialCollision(o1) || dxGeomNeedsSerialCollision(o2) 
+        ? context->serial_pairs : context->pairs;
+    pairs.push (o1);
+    pairs.push (o2);
+}
+
+static void dispatchSerialPairs (dxThreadedCollideContext *context)
+{
+    dxGeom *const *pairs = context->serial_pairs.data();
+    const unsigned pair_count = (unsigned)context->serial_pairs.size() / 2;
+
+    for (unsigned pair_index = 0; pair_index != pair_count; ++pair_index) {
+        context->callback (context->data, 0, pairs[2 * pair_index], pairs[2 * pair_index + 1]);
+    }
+}
+
+static void dispatchCollectedPairs (dxThreadedCollideContext *context, unsigned thread_index)
+{
+    dxGeom *const *pairs = context->pairs.data();
+    const unsigned pair_count = (unsigned)context->pairs.size() / 2;
+    const unsigned pair_block_count = context->pair_block_count;
+
+    unsigned block_index;
+    while ((block_index = ThrsafeIncrementIntUpToLimit(&context->pair_block_progress, pair_block_count)) != pair_block_count) {
+        unsigned pair_index = block_index * dCOLLIDE_THREADED_PAIR_BLOCK_SIZE;
+        unsigned pair_limit = dMACRO_MIN(pair_index + dCOLLIDE_THREADED_PAIR_BLOCK_SIZE, pair_count);
+        for (; pair_index != pair_limit; ++pair_index) {
+            context->callback (context->data, thread_index, pairs[2 * pair_index], pairs[2 * pair_index + 1]);
+        }
+    }
+}
+
+static 
+int collideThreadedWorkerCallback (void *call_context, dcallindex_t instance_index, dCallReleaseeID dUNUSED(this_releasee))
+{
+    dxThreadedCollideContext *context = (dxThreadedCollideContext *)call_context;
+    // The calling thread takes index 0
+    dispatchCollectedPairs (context, (unsigned)instance_index + 1);
+    return 1;
+}
+
+static 
+int collideThreadedCompletionCallback (void *dUNUSED(call_context), dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    return 1;
+}
+
+
+void dSpaceCollideThreaded (dxSpace *space, dxWorld *world, unsigned max_thread_count, 
+                            void *data, dThreadedNearCallback *callback)
+{
+    dAASSERT (space && world && callback && max_thread_count != 0);
+    dUASSERT (dGeomIsSpace(space),"argument not a space");
+
+    dxThreadedCollideContext context;
+    context.data = data;
+    context.callback = callback;
+
+    // The space stays locked until all the callbacks complete (just as in collide())
+    space->lock_count++;
+    collideSpace (space,&context,&collectPairCallback);
+
+    const unsigned pair_count = (unsigned)context.pairs.size() / 2;
+    context.pair_block_count = (pair_count + (dCOLLIDE_THREADED_PAIR_BLOCK_SIZE - 1)) / dCOLLIDE_THREADED_PAIR_BLOCK_SIZE;
+    context.pair_block_progress = 0;
+
+    unsigned thread_count = world->calculateThreadingLimitedThreadCount(max_thread_count, true);
+    thread_count = dMACRO_MIN(thread_count, context.pair_block_count);
+
+    dCallWaitID completion_wait = thread_count > 1 ? world->AllocateOrRetrieveStockCallWaitID() : NULL;
+
+    if (completion_wait != NULL && world->PreallocateResourcesForThreadedCalls(thread_count)) {
+        dCallReleaseeID completion_releasee;
+        world->PostThreadedCall(NULL, &completion_releasee, thread_count - 1, NULL, completion_wait, 
+            &collideThreadedCompletionCallback, NULL, 0, "SpaceCollide Completion");
+        world->PostThreadedCallsGroup(NULL, thread_count - 1, completion_releasee, 
+            &collideThreadedWorkerCallback, &context, "SpaceCollide Dispatch");
+
+        dispatchSerialPairs (&context);
+        dispatchCollectedPairs (&context, 0);
+
+        world->WaitThreadedCallExclusively(NULL, completion_wait, NULL, "SpaceCollide End Wait");
+    }
+    else {
+        dispatchSerialPairs (&context);
+        dispatchCollectedPairs (&context, 0);
+    }
+
+    space->lock_count--;
 }
 
 
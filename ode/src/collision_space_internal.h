@@ -77,4 +77,14 @@ static inline void collideAABBs (dxGeom *g1, dxGeom *g2,
     callback (data,g1,g2);
 }
 
+
+// test if two AABBs overlap, for the queryAABBOverlaps() implementations
+
+static inline bool overlapAABBs (const dReal *bounds1, const dReal *bounds2)
+{
+    return bounds1[0] <= bounds2[1] && bounds1[1] >= bounds2[0] &&
+        bounds1[2] <= bounds2[3] && bounds1[3] >= bounds2[2] &&
+        bounds1[4] <= bounds2[5] && bounds1[5] >= bounds2[4];
+}
+
 #endif
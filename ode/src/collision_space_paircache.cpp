@@ -0,0 +1,308 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+#include <ode/common.h>
+#include <ode/collision_space.h>
+#include <ode/collision.h>
+#include "config.h"
+#include "collision_kernel.h"
+#include "collision_space_internal.h"
+#include "collision_space_paircache.h"
+
+
+#define GEOM_ENABLED(g) (((g)->gflags & GEOM_ENABLE_TEST_MASK) == GEOM_ENABLE_TEST_VALUE)
+#define GEOM_MOVED(g) (((g)->gflags & GEOM_PAIR_CACHE_MOVED) != 0)
+
+
+dxSpacePairCache::dxSpacePairCache (int _mode)
+{
+    geomSlotCount = 0;
+    queryGeom = 0;
+    mode = _mode;
+    valid = false;
+}
+
+
+dxSpacePairCache::~dxSpacePairCache()
+{
+    int movedCount = movedGeoms.size();
+    for (int i = 0; i < movedCount; ++i) {
+        movedGeoms[i]->gflags &= ~GEOM_PAIR_CACHE_MOVED;
+    }
+}
+
+
+sizeint dxSpacePairCache::hashGeom (dxGeom *g)
+{
+    sizeint h = (sizeint)g;
+    h ^= h >> 4;
+    h *= (sizeint)0x9E3779B1U;
+    h ^= h >> 15;
+    return h;
+}
+
+
+// returns the slot of the geom or the empty slot it would go to, -1 if there are no slots
+int dxSpacePairCache::findGeomSlot (dxGeom *g) const
+{
+    int slotCount = geomSlots.size();
+    if (slotCount == 0) return -1;
+
+    sizeint mask = (sizeint)slotCount - 1;
+    sizeint i = hashGeom (g) & mask;
+    while (geomSlots[(int)i].geom != 0 && geomSlots[(int)i].geom != g) {
+        i = (i + 1) & mask;
+    }
+    return (int)i;
+}
+
+
+// returns the head of the pair list of the geom, adding an empty one if there is none
+int &dxSpacePairCache::firstPair (dxGeom *g)
+{
+    int slot = findGeomSlot (g);
+    if (slot == -1 || geomSlots[slot].geom == 0) {
+        if ((geomSlotCount + 1) * 2 > geomSlots.size()) {
+            growGeomSlots();
+            slot = findGeomSlot (g);
+        }
+        geomSlots[slot].geom = g;
+        geomSlots[slot].first = -1;
+        ++geomSlotCount;
+    }
+    return geomSlots[slot].first;
+}
+
+
+void dxSpacePairCache::growGeomSlots()
+{
+    dArray<GeomPairs> oldSlots;
+    oldSlots.swap (geomSlots);
+
+    int oldSize = oldSlots.size();
+    int newSize = oldSize != 0 ? oldSize * 2 : 64;
+    geomSlots.setSize (newSize);
+    for (int i = 0; i < newSize; ++i) {
+        geomSlots[i].geom = 0;
+    }
+
+    for (int i = 0; i < oldSize; ++i) {
+        const GeomPairs &old = oldSlots[i];
+        if (old.geom != 0) {
+            geomSlots[findGeomSlot (old.geom)] = old;
+        }
+    }
+}
+
+
+void dxSpacePairCache::eraseGeomSlot (int slot)
+{
+    // shift the following slots of the probe sequence back to keep the lookups working
+    sizeint mask = (sizeint)geomSlots.size() - 1;
+    sizeint i = (sizeint)slot;
+    for (sizeint j = (i + 1) & mask; geomSlots[(int)j].geom != 0; j = (j + 1) & mask) {
+        sizeint home = hashGeom (geomSlots[(int)j].geom) & mask;
+        bool movable = j > i ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            geomSlots[(int)i] = geomSlots[(int)j];
+            i = j;
+        }
+    }
+
+    geomSlots[(int)i].geom = 0;
+    --geomSlotCount;
+}
+
+
+void dxSpacePairCache::addPair (dxGeom *g1, dxGeom *g2)
+{
+    int pairIndex;
+    int freeCount = freePairs.size();
+    if (freeCount != 0) {
+        pairIndex = freePairs[freeCount - 1];
+        freePairs.setSize (freeCount - 1);
+    }
+    else {
+        pairIndex = pairs.size();
+        pairs.setSize (pairIndex + 1);
+    }
+
+    Pair &pair = pairs[pairIndex];
+    pair.g1 = g1;
+    pair.g2 = g2;
+    int &first1 = firstPair (g1);
+    pair.next1 = first1;
+    first1 = pairIndex;
+    int &first2 = firstPair (g2);
+    pair.next2 = first2;
+    first2 = pairIndex;
+}
+
+
+// removes the pair from the list of the geom
+void dxSpacePairCache::unlinkPair (dxGeom *g, int pairIndex)
+{
+    int *link = &geomSlots[findGeomSlot (g)].first;
+    while (*link != pairIndex) {
+        link = &nextPair (pairs[*link], g);
+    }
+    *link = nextPair (pairs[pairIndex], g);
+}
+
+
+void dxSpacePairCache::dropGeomPairs (dxGeom *g)
+{
+    int slot = findGeomSlot (g);
+    if (slot == -1 || geomSlots[slot].geom == 0) return;
+
+    for (int pairIndex = geomSlots[slot].first; pairIndex != -1; ) {
+        Pair &pair = pairs[pairIndex];
+        int nextIndex = nextPair (pair, g);
+        unlinkPair (pair.g1 == g ? pair.g2 : pair.g1, pairIndex);
+        pair.g1 = 0;
+        pair.g2 = 0;
+        freePairs.push (pairIndex);
+        pairIndex = nextIndex;
+    }
+    geomSlots[slot].first = -1;
+}
+
+
+void dxSpacePairCache::clearPairs()
+{
+    pairs.setSize (0);
+    freePairs.setSize (0);
+    geomSlots.setSize (0);
+    geomSlotCount = 0;
+}
+
+
+void dxSpacePairCache::geomMoved (dxGeom *g)
+{
+    if (!GEOM_MOVED(g)) {
+        g->gflags |= GEOM_PAIR_CACHE_MOVED;
+        movedGeoms.push (g);
+    }
+}
+
+
+void dxSpacePairCache::geomRemoved (dxGeom *g)
+{
+    // the geom may be destroyed next and its address reused -- its pairs must go now
+    dropGeomPairs (g);
+    int slot = findGeomSlot (g);
+    if (slot != -1 && geomSlots[slot].geom != 0) {
+        eraseGeomSlot (slot);
+    }
+
+    if (GEOM_MOVED(g)) {
+        int movedCount = movedGeoms.size();
+        for (int i = 0; i < movedCount; ++i) {
+            if (movedGeoms[i] == g) {
+                movedGeoms[i] = movedGeoms[movedCount - 1];
+                movedGeoms.setSize (movedCount - 1);
+                break;
+            }
+        }
+        g->gflags &= ~GEOM_PAIR_CACHE_MOVED;
+    }
+}
+
+
+void dxSpacePairCache::addOverlapCallback (void *data, dxGeom *g)
+{
+    dxSpacePairCache *cache = (dxSpacePairCache *)data;
+    dxGeom *queryGeom = cache->queryGeom;
+
+    // a pair of two moved geoms is found twice -- keep one of them
+    if (!GEOM_MOVED(g) || queryGeom < g) {
+        cache->addPair (queryGeom, g);
+    }
+}
+
+
+void dxSpacePairCache::updateMovedGeomPairs (dxSpace *space)
+{
+    // drop the pairs of the moved geoms...
+    int movedCount = movedGeoms.size();
+    for (int i = 0; i < movedCount; ++i) {
+        dropGeomPairs (movedGeoms[i]);
+    }
+
+    // ...and find them anew
+    for (int i = 0; i < movedCount; ++i) {
+        queryGeom = movedGeoms[i];
+        space->queryAABBOverlaps (queryGeom, this, &addOverlapCallback);
+    }
+    queryGeom = 0;
+}
+
+
+void dxSpacePairCache::collide (dxSpace *space, void *data, dNearCallback *callback)
+{
+    dAASSERT (space && callback);
+
+    space->lock_count++;
+    space->cleanGeoms();
+
+    if (!valid) {
+        // the geoms may have moved before the cache was enabled
+        clearPairs();
+        for (dxGeom *g = space->first; g; g = g->next) {
+            geomMoved (g);
+        }
+        valid = true;
+    }
+
+    if (movedGeoms.size() != 0) {
+        updateMovedGeomPairs (space);
+    }
+
+    bool movingOnly = mode == dSpacePairCacheMovingPairs;
+
+    int pairCount = pairs.size();
+    for (int i = 0; i < pairCount; ++i) {
+        const Pair &pair = pairs[i];
+        dxGeom *g1 = pair.g1, *g2 = pair.g2;
+
+        if (g1 == 0) {
+            continue;
+        }
+
+        if (movingOnly && !GEOM_MOVED(g1) && !GEOM_MOVED(g2)) {
+            continue;
+        }
+
+        if (GEOM_ENABLED(g1) && GEOM_ENABLED(g2)) {
+            collideAABBs (g1, g2, data, callback);
+        }
+    }
+
+    int movedCount = movedGeoms.size();
+    for (int i = 0; i < movedCount; ++i) {
+        movedGeoms[i]->gflags &= ~GEOM_PAIR_CACHE_MOVED;
+    }
+    movedGeoms.setSize (0);
+
+    space->lock_count--;
+}
@@ -0,0 +1,102 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+ *  Broadphase pair cache of a space.
+ *
+ *  The cache keeps the pairs of geoms with overlapping AABBs between the 
+ *  dSpaceCollide calls. The geoms reported by dGeomMoved() and the ones 
+ *  added to the space are collected in a moved list. On collision the pairs 
+ *  of the moved geoms are dropped and the moved geoms are queried against 
+ *  the space to find their new pairs. The other pairs are kept intact.
+ *
+ *  The pairs of each geom are linked in a list found through a hash table 
+ *  by the geom address, so dropping them costs as much as the geom has pairs.
+ */
+
+#ifndef _ODE_COLLISION_SPACE_PAIRCACHE_H_
+#define _ODE_COLLISION_SPACE_PAIRCACHE_H_
+
+
+#include <ode/common.h>
+#include "array.h"
+#include "collision_kernel.h"
+
+
+struct dxSpacePairCache : public dBase
+{
+    dxSpacePairCache (int mode);
+    ~dxSpacePairCache();
+
+    int getMode() const { return mode; }
+    void setMode (int value) { mode = value; }
+
+    // Notifications from the space
+    void geomMoved (dxGeom *g);
+    void geomRemoved (dxGeom *g);
+
+    void collide (dxSpace *space, void *data, dNearCallback *callback);
+
+private:
+    struct Pair
+    {
+        dxGeom *g1;         // 0 if the pair is free
+        dxGeom *g2;
+        int next1;          // the next pair in the list of g1, -1 if none
+        int next2;          // the next pair in the list of g2, -1 if none
+    };
+
+    struct GeomPairs
+    {
+        dxGeom *geom;       // 0 if the slot is empty
+        int first;          // the first pair of the geom, -1 if none
+    };
+
+    static int &nextPair (Pair &pair, dxGeom *g) { return pair.g1 == g ? pair.next1 : pair.next2; }
+    static sizeint hashGeom (dxGeom *g);
+
+    int findGeomSlot (dxGeom *g) const;
+    int &firstPair (dxGeom *g);
+    void growGeomSlots();
+    void eraseGeomSlot (int slot);
+
+    void addPair (dxGeom *g1, dxGeom *g2);
+    void unlinkPair (dxGeom *g, int pairIndex);
+    void dropGeomPairs (dxGeom *g);
+    void clearPairs();
+
+    void updateMovedGeomPairs (dxSpace *space);
+    static void addOverlapCallback (void *data, dxGeom *g);
+
+    dArray<Pair> pairs;
+    dArray<int> freePairs;
+    dArray<GeomPairs> geomSlots;    // power of two sized, at most half full
+    int geomSlotCount;              // number of the slots used
+    dArray<dxGeom*> movedGeoms;
+    dxGeom *queryGeom;     // the moved geom being queried
+    int mode;
+    bool valid;             // false until the first collide() has collected all the geoms
+};
+
+
+#endif // _ODE_COLLISION_SPACE_PAIRCACHE_H_
@@ -0,0 +1,414 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+
+batched closest-hit ray casts against all the geoms of a space
+
+The enabled geoms of the space and its subspaces are gathered into a temporary
+AABB tree. The rays are traversed through the tree in packets of consecutive
+rays. The box tests are done for all the packet lanes at once and only the
+lanes whose rays reach a geom's box are collided with it by the standard ray
+colliders. Every ray is shortened to its closest hit so far as it goes.
+
+*/
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include <ode/objects.h>
+#include "config.h"
+#include "odemath.h"
+#include "collision_kernel.h"
+#include "collision_std.h"
+#include "util.h"
+#include "threadingutils.h"
+
+#include <algorithm>
+
+
+// the lane loops are written for the compiler to fill a vector register
+#ifdef dSINGLE
+#define dRAYCAST_PACKET_SIZE 8
+#else
+#define dRAYCAST_PACKET_SIZE 4
+#endif
+
+#define dRAYCAST_LEAF_SIZE 4
+#define dRAYCAST_STACK_SIZE 64
+#define dRAYCAST_PACKET_BLOCK_SIZE 16
+
+// the reciprocal used for the zero direction components keeps the slab products free of NaNs
+#define dRAYCAST_HUGE_RECIP ((dReal)1e30)
+
+
+struct dxRaycastNode {
+    dReal aabb[6];
+    unsigned first;     // the right child for inner nodes or the first geom for leaves
+    unsigned count;     // the geom count for leaves or 0 for inner nodes
+    unsigned axis;      // the split axis of inner nodes
+};
+
+struct dxRaycastTree {
+    dArray<dxGeom *> geoms;         // the bounded geoms in the leaf order
+    dArray<dxGeom *> unbounded;     // the geoms with infinite boxes tested against every ray
+    dArray<dxRaycastNode> nodes;    // the left child of an inner node follows it
+    unsigned node_count;
+
+    dxRaycastTree() : node_count(0) {}
+
+    void gather (dxSpace *space, unsigned long collide_bits);
+    void build();
+
+private:
+    unsigned buildNode (unsigned begin, unsigned end);
+};
+
+struct dxRaycastPacket {
+    dReal origin[3][dRAYCAST_PACKET_SIZE];
+    dReal dir[3][dRAYCAST_PACKET_SIZE];
+    dReal recip[3][dRAYCAST_PACKET_SIZE];
+    dReal best[dRAYCAST_PACKET_SIZE];   // the ray lengths cut to the closest hits; negative for the unused lanes
+};
+
+struct dxRaycastBatchContext {
+    const dxRaycastTree *tree;
+    const dReal *origins;
+    const dReal *directions;
+    const dReal *lengths;
+    dRaycastHit *hits;
+    unsigned ray_count;
+    unsigned packet_count;
+    unsigned packet_block_count;
+    volatile atomicord32 packet_block_progress;
+    dxGeom *const *rays;            // a ray geom per thread
+};
+
+
+static inline bool isUnboundedAABB (const dReal *aabb)
+{
+    return aabb[0] == -dInfinity || aabb[1] == dInfinity || aabb[2] == -dInfinity 
+        || aabb[3] == dInfinity || aabb[4] == -dInfinity || aabb[5] == dInfinity;
+}
+
+void dxRaycastTree::gather (dxSpace *space, unsigned long collide_bits)
+{
+    space->cleanGeoms();
+
+    for (dxGeom *g = space->first; g != NULL; g = g->next) {
+        if ((g->gflags & GEOM_ENABLE_TEST_MASK) != GEOM_ENABLE_TEST_VALUE) continue;
+
+        if (IS_SPACE(g)) {
+            gather ((dxSpace *)g, collide_bits);
+        }
+        else if ((g->category_bits & collide_bits) != 0 && g->type != dRayClass) {
+            // the lazy positions of the geoms must not be computed from several threads
+            g->recomputePosr();
+            if (isUnboundedAABB (g->aabb)) unbounded.push (g);
+            else geoms.push (g);
+        }
+    }
+}
+
+void dxRaycastTree::build()
+{
+    const unsigned geom_count = geoms.size();
+    if (geom_count != 0) {
+        nodes.setSize (2 * geom_count - 1);
+        buildNode (0, geom_count);
+    }
+}
+
+struct dxRaycastCenterLess {
+    unsigned axis;
+    dxRaycastCenterLess (unsigned _axis) : axis(_axis) {}
+    bool operator() (const dxGeom *g1, const dxGeom *g2) const {
+        return g1->aabb[2 * axis] + g1->aabb[2 * axis + 1] < g2->aabb[2 * axis] + g2->aabb[2 * axis + 1];
+    }
+};
+
+unsigned dxRaycastTree::buildNode (unsigned begin, unsigned end)
+{
+    const unsigned node_index = node_count++;
+    dxRaycastNode &node = nodes[node_index];
+
+    dReal center_bounds[6];
+    for (unsigned k = 0; k != 3; ++k) {
+        node.aabb[2 * k] = center_bounds[2 * k] = dInfinity;
+        node.aabb[2 * k + 1] = center_bounds[2 * k + 1] = -dInfinity;
+    }
+    for (unsigned i = begin; i != end; ++i) {
+        const dReal *aabb = geoms[i]->aabb;
+        for (unsigned k = 0; k != 3; ++k) {
+            node.aabb[2 * k] = dMACRO_MIN (node.aabb[2 * k], aabb[2 * k]);
+            node.aabb[2 * k + 1] = dMACRO_MAX (node.aabb[2 * k + 1], aabb[2 * k + 1]);
+            dReal center = (aabb[2 * k] + aabb[2 * k + 1]) * REAL(0.5);
+            center_bounds[2 * k] = dMACRO_MIN (center_bounds[2 * k], center);
+            center_bounds[2 * k + 1] = dMACRO_MAX (center_bounds[2 * k + 1], center);
+        }
+    }
+
+    if (end - begin <= dRAYCAST_LEAF_SIZE) {
+        node.first = begin;
+        node.count = end - begin;
+        node.axis = 0;
+    }
+    else {
+        // median split along the largest extent of the geom centers
+        unsigned axis = 0;
+        for (unsigned k = 1; k != 3; ++k) {
+            if (center_bounds[2 * k + 1] - center_bounds[2 * k] > center_bounds[2 * axis + 1] - center_bounds[2 * axis]) axis = k;
+        }
+        const unsigned middle = begin + (end - begin) / 2;
+        std::nth_element (geoms.data() + begin, geoms.data() + middle, geoms.data() + end, dxRaycastCenterLess (axis));
+
+        node.count = 0;
+        node.axis = axis;
+        buildNode (begin, middle);
+        node.first = buildNode (middle, end);
+    }
+    return node_index;
+}
+
+
+// Loads the rays starting at first_ray into the packet and returns the mask of the lanes in use.
+static unsigned loadRaycastPacket (dxRaycastPacket *packet, const dxRaycastBatchContext *context, unsigned first_ray)
+{
+    unsigned active = 0;
+    for (unsigned lane = 0; lane != dRAYCAST_PACKET_SIZE; ++lane) {
+        const unsigned ray_index = first_ray + lane;
+        dVector3 dir = { 0, 0, 0 };
+        bool used = false;
+        if (ray_index < context->ray_count) {
+            context->hits[ray_index].geom = NULL;
+            dCopyVector3 (dir, context->directions + (sizeint)ray_index * 3);
+            used = context->lengths[ray_index] >= 0 && dSafeNormalize3 (dir);
+        }
+
+        for (unsigned k = 0; k != 3; ++k) {
+            packet->origin[k][lane] = used ? context->origins[(sizeint)ray_index * 3 + k] : REAL(0.0);
+            packet->dir[k][lane] = used ? dir[k] : REAL(0.0);
+            packet->recip[k][lane] = used && dir[k] != 0 ? dRecip (dir[k]) : dRAYCAST_HUGE_RECIP;
+        }
+        packet->best[lane] = used ? context->lengths[ray_index] : REAL(-1.0);
+        active |= (used ? 1U : 0U) << lane;
+    }
+    return active;
+}
+
+// Returns the mask of the lanes whose rays reach the box within their current lengths.
+static inline unsigned testRaycastPacketAABB (const dxRaycastPacket *packet, const dReal *aabb)
+{
+    int lane_hits[dRAYCAST_PACKET_SIZE];
+    for (unsigned lane = 0; lane != dRAYCAST_PACKET_SIZE; ++lane) {
+        dReal tx0 = (aabb[0] - packet->origin[0][lane]) * packet->recip[0][lane];
+        dReal tx1 = (aabb[1] - packet->origin[0][lane]) * packet->recip[0][lane];
+        dReal ty0 = (aabb[2] - packet->origin[1][lane]) * packet->recip[1][lane];
+        dReal ty1 = (aabb[3] - packet->origin[1][lane]) * packet->recip[1][lane];
+        dReal tz0 = (aabb[4] - packet->origin[2][lane]) * packet->recip[2][lane];
+        dReal tz1 = (aabb[5] - packet->origin[2][lane]) * packet->recip[2][lane];
+        dReal tnear = dMACRO_MAX (dMACRO_MAX (dMACRO_MIN (tx0, tx1), dMACRO_MIN (ty0, ty1)), dMACRO_MAX (dMACRO_MIN (tz0, tz1), REAL(0.0)));
+        dReal tfar = dMACRO_MIN (dMACRO_MIN (dMACRO_MAX (tx0, tx1), dMACRO_MAX (ty0, ty1)), dMACRO_MIN (dMACRO_MAX (tz0, tz1), packet->best[lane]));
+        lane_hits[lane] = tnear <= tfar;
+    }
+
+    unsigned mask = 0;
+    for (unsigned lane = 0; lane != dRAYCAST_PACKET_SIZE; ++lane) {
+        mask |= (unsigned)lane_hits[lane] << lane;
+    }
+    return mask;
+}
+
+static void collideRaycastLanes (dxRaycastPacket *packet, unsigned mask, dxGeom *ray, dxGeom *g, dRaycastHit *hits)
+{
+    for (unsigned lane = 0; mask != 0; mask >>= 1, ++lane) {
+        if ((mask & 1) == 0) continue;
+
+        dxPosR *posr = ray->final_posr;
+        for (unsigned k = 0; k != 3; ++k) {
+            posr->pos[k] = packet->origin[k][lane];
+            posr->R[k * 4 + 2] = packet->dir[k][lane];
+        }
+        ((dxRay *)ray)->length = packet->best[lane];
+        // some colliders (e.g. the heightfield one) use the box of the other geom
+        ray->computeAABB();
+
+        dContactGeom contact;
+        dRaycastHit *hit = hits + lane;
+        if (dCollide (ray, g, 1, &contact, sizeof(dContactGeom)) != 0 
+            && (hit->geom == NULL || contact.depth < packet->best[lane])) {
+            hit->geom = g;
+            dCopyVector3 (hit->pos, contact.pos);
+            dCopyVector3 (hit->normal, contact.normal);
+            hit->depth = contact.depth;
+            packet->best[lane] = contact.depth;
+        }
+    }
+}
+
+static void traceRaycastPacket (const dxRaycastTree *tree, dxRaycastPacket *packet, unsigned active, dxGeom *ray, dRaycastHit *hits)
+{
+    const unsigned unbounded_count = tree->unbounded.size();
+    for (unsigned i = 0; i != unbounded_count; ++i) {
+        collideRaycastLanes (packet, active, ray, tree->unbounded[i], hits);
+    }
+
+    if (tree->node_count == 0) return;
+
+    // the children are visited nearer first along the direction of the leading ray
+    unsigned lead_lane = 0;
+    while ((active & (1U << lead_lane)) == 0) ++lead_lane;
+
+    unsigned stack[dRAYCAST_STACK_SIZE];
+    unsigned stack_size = 0;
+    unsigned node_index = 0;
+    while (true) {
+        const dxRaycastNode &node = tree->nodes[node_index];
+        const unsigned mask = testRaycastPacketAABB (packet, node.aabb);
+        if (mask != 0) {
+            if (node.count == 0) {
+                unsigned near_child = node_index + 1, far_child = node.first;
+                if (packet->dir[node.axis][lead_lane] < 0) {
+                    near_child = node.first; far_child = node_index + 1;
+                }
+                dIASSERT (stack_size != dRAYCAST_STACK_SIZE);
+                stack[stack_size++] = far_child;
+                node_index = near_child;
+                continue;
+            }
+
+            dxGeom *const *leaf_geoms = tree->geoms.data() + node.first;
+            for (unsigned i = 0; i != node.count; ++i) {
+                unsigned geom_mask = testRaycastPacketAABB (packet, leaf_geoms[i]->aabb) & mask;
+                if (geom_mask != 0) {
+                    collideRaycastLanes (packet, geom_mask, ray, leaf_geoms[i], hits);
+                }
+            }
+        }
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
+    }
+}
+
+static void raycastBatchPacketBlocks (dxRaycastBatchContext *context, dxGeom *ray)
+{
+    const unsigned packet_count = context->packet_count;
+    const unsigned packet_block_count = context->packet_block_count;
+
+    dxRaycastPacket packet;
+    unsigned block_index;
+    while ((block_index = ThrsafeIncrementIntUpToLimit(&context->packet_block_progress, packet_block_count)) != packet_block_count) {
+        unsigned packet_index = block_index * dRAYCAST_PACKET_BLOCK_SIZE;
+        unsigned packet_limit = dMACRO_MIN(packet_index + dRAYCAST_PACKET_BLOCK_SIZE, packet_count);
+        for (; packet_index != packet_limit; ++packet_index) {
+            const unsigned first_ray = packet_index * dRAYCAST_PACKET_SIZE;
+            unsigned active = loadRaycastPacket (&packet, context, first_ray);
+            if (active != 0) {
+                traceRaycastPacket (context->tree, &packet, active, ray, context->hits + first_ray);
+            }
+        }
+    }
+}
+
+static 
+int raycastBatchWorkerCallback (void *call_context, dcallindex_t instance_index, dCallReleaseeID dUNUSED(this_releasee))
+{
+    dxRaycastBatchContext *context = (dxRaycastBatchContext *)call_context;
+    raycastBatchPacketBlocks (context, context->rays[instance_index]);
+    return 1;
+}
+
+static 
+int raycastBatchCompletionCallback (void *dUNUSED(call_context), dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    return 1;
+}
+
+unsigned dSpaceRaycastBatch (dxWorld *world, unsigned max_thread_count, dxSpace *space, 
+                             const dReal *origins, const dReal *directions, const dReal *lengths, unsigned ray_count, 
+                             unsigned long collide_bits, dRaycastHit *hits)
+{
+    dAASSERT (space);
+    dAASSERT ((origins && directions && lengths && hits) || ray_count == 0);
+    dUASSERT (world == NULL || max_thread_count != 0, "no threads allowed");
+
+    if (ray_count == 0) return 0;
+
+    space->lock_count++;
+
+    dxRaycastTree tree;
+    tree.gather (space, collide_bits);
+    tree.build();
+
+    dxRaycastBatchContext context;
+    context.tree = &tree;
+    context.origins = origins;
+    context.directions = directions;
+    context.lengths = lengths;
+    context.hits = hits;
+    context.ray_count = ray_count;
+    context.packet_count = (ray_count + (dRAYCAST_PACKET_SIZE - 1)) / dRAYCAST_PACKET_SIZE;
+    context.packet_block_count = (context.packet_count + (dRAYCAST_PACKET_BLOCK_SIZE - 1)) / dRAYCAST_PACKET_BLOCK_SIZE;
+    context.packet_block_progress = 0;
+
+    unsigned thread_count = world != NULL ? world->calculateThreadingLimitedThreadCount(max_thread_count, true) : 1;
+    thread_count = dMACRO_MIN(thread_count, context.packet_block_count);
+
+    // the colliders take the ray parameters from a geom so every thread needs its own one
+    dArray<dxGeom *> rays;
+    rays.setSize (thread_count);
+    for (unsigned i = 0; i != thread_count; ++i) {
+        rays[i] = dCreateRay (NULL, 0);
+        dGeomRaySetClosestHit (rays[i], 1);
+    }
+    context.rays = rays.data();
+
+    dCallWaitID completion_wait = thread_count > 1 ? world->AllocateOrRetrieveStockCallWaitID() : NULL;
+
+    if (completion_wait != NULL && world->PreallocateResourcesForThreadedCalls(thread_count)) {
+        dCallReleaseeID completion_releasee;
+        world->PostThreadedCall(NULL, &completion_releasee, thread_count - 1, NULL, completion_wait, 
+            &raycastBatchCompletionCallback, NULL, 0, "RaycastBatch Completion");
+        world->PostThreadedCallsGroup(NULL, thread_count - 1, completion_releasee, 
+            &raycastBatchWorkerCallback, &context, "RaycastBatch Packets");
+
+        raycastBatchPacketBlocks (&context, rays[thread_count - 1]);
+
+        world->WaitThreadedCallExclusively(NULL, completion_wait, NULL, "RaycastBatch End Wait");
+    }
+    else {
+        raycastBatchPacketBlocks (&context, rays[0]);
+    }
+
+    for (unsigned i = 0; i != thread_count; ++i) {
+        dGeomDestroy (rays[i]);
+    }
+
+    space->lock_count--;
+
+    unsigned hit_count = 0;
+    for (unsigned i = 0; i != ray_count; ++i) {
+        hit_count += hits[i].geom != NULL ? 1 : 0;
+    }
+    return hit_count;
+}
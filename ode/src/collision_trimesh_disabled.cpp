@@ -191,6 +191,57 @@ void dGeomTriMeshDataBuildSimple1(dTriMeshDataID g,
 }
 
 
+/*extern */
+dsizeint dGeomTriMeshDataSerialize(dTriMeshDataID g, void *buffer, dsizeint buffer_size)
+{
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImage(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount, 
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const void *image, dsizeint image_size)
+{
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImageFile(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount, 
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const char *file_name)
+{
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataEnableDeformable(dTriMeshDataID g, int subtree_triangle_count, dReal rebuild_cost_ratio)
+{
+    return 0;
+}
+
+/*extern */
+void dGeomTriMeshDataDisableDeformable(dTriMeshDataID g)
+{
+    // Do nothing
+}
+
+/*extern */
+void dGeomTriMeshDataMarkVerticesDirty(dTriMeshDataID g, int first_vertex, int vertex_count)
+{
+    // Do nothing
+}
+
+/*extern */
+int dGeomTriMeshDataUpdateDeformable(dTriMeshDataID g, dWorldID world)
+{
+    return 0;
+}
+
+
 /*extern ODE_API */
 int dGeomTriMeshDataPreprocess(dTriMeshDataID g)
 {
@@ -386,6 +386,71 @@ void dGeomTriMeshDataBuildDouble1(dTriMeshDataID g,
         false);
 }
 
+/*extern */
+dsizeint dGeomTriMeshDataSerialize(dTriMeshDataID g, void *buffer, dsizeint buffer_size)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    // GIMPACT trees are not serialized
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImage(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount,
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const void *image, dsizeint image_size)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImageFile(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount,
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const char *file_name)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    return 0;
+}
+
+/*extern */
+int dGeomTriMeshDataEnableDeformable(dTriMeshDataID g, int subtree_triangle_count, dReal rebuild_cost_ratio)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    // GIMPACT trees are refitted as a whole
+    return 0;
+}
+
+/*extern */
+void dGeomTriMeshDataDisableDeformable(dTriMeshDataID g)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+}
+
+/*extern */
+void dGeomTriMeshDataMarkVerticesDirty(dTriMeshDataID g, int first_vertex, int vertex_count)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+    dUASSERT(false, "The trimesh data is not deformable");
+}
+
+/*extern */
+int dGeomTriMeshDataUpdateDeformable(dTriMeshDataID g, dWorldID world)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    dxTriMeshData *data = g;
+    data->updateData();
+    return 0;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -196,6 +196,8 @@ private: // IFaceAngleStorageControl
 
     virtual void assignFacesAngleIntoStorage(unsigned triangleIndex, dMeshTriangleVertex vertexIndex, dReal dAngleValue);
 
+    virtual const void *retrieveStorageData() const;
+
 private: // IFaceAngleStorageView
     virtual FaceAngleDomain retrieveFacesAngleFromStorage(dReal &out_angleValue, unsigned triangleIndex, dMeshTriangleVertex vertexIndex);
 
@@ -322,6 +324,13 @@ void FaceAnglesWrapper<TStorageCodec>::assignFacesAngleIntoStorage(unsigned tria
     setFaceAngle(triangleIndex, vertexIndex, dAngleValue);
 }
 
+template<class TStorageCodec>
+/*virtual */
+const void *FaceAnglesWrapper<TStorageCodec>::retrieveStorageData() const
+{
+    return m_record.m_triangleFaceAngles;
+}
+
 template<class TStorageCodec>
 /*virtual */
 FaceAngleDomain FaceAnglesWrapper<TStorageCodec>::retrieveFacesAngleFromStorage(dReal &out_angleValue, unsigned triangleIndex, dMeshTriangleVertex vertexIndex)
@@ -330,6 +339,92 @@ FaceAngleDomain FaceAnglesWrapper<TStorageCodec>::retrieveFacesAngleFromStorage(
 }
 
 
+// A read-only view of the values stored by a FaceAnglesWrapper elsewhere (e.g. in a mapped trimesh data image)
+template<class TStorageCodec>
+class FaceAnglesAttachedView:
+    public IFaceAngleStorageControl,
+    public IFaceAngleStorageView
+{
+protected:
+    typedef typename TStorageCodec::storage_type storage_type;
+    typedef storage_type TriangleFaceAngles[dMTV__MAX];
+
+    FaceAnglesAttachedView(unsigned triangleCount, const void *storageData):
+        m_triangleCount(triangleCount),
+        m_triangleFaceAngles((const TriangleFaceAngles *)storageData)
+    {
+    }
+
+public:
+    virtual ~FaceAnglesAttachedView() {}
+
+    static IFaceAngleStorageControl *attachInstance(unsigned triangleCount, const void *storageData, IFaceAngleStorageView *&out_storageView);
+
+private: // IFaceAngleStorageControl
+    virtual void disposeStorage();
+
+    virtual bool areNegativeAnglesStored() const { return TStorageCodec::areNegativeAnglesCoded(); }
+
+    virtual void assignFacesAngleIntoStorage(unsigned triangleIndex, dMeshTriangleVertex vertexIndex, dReal dAngleValue);
+
+    virtual const void *retrieveStorageData() const { return m_triangleFaceAngles; }
+
+private: // IFaceAngleStorageView
+    virtual FaceAngleDomain retrieveFacesAngleFromStorage(dReal &out_angleValue, unsigned triangleIndex, dMeshTriangleVertex vertexIndex);
+
+private:
+    unsigned                    m_triangleCount;
+    const TriangleFaceAngles    *m_triangleFaceAngles;
+};
+
+
+template<class TStorageCodec>
+/*static */
+IFaceAngleStorageControl *FaceAnglesAttachedView<TStorageCodec>::attachInstance(unsigned triangleCount, const void *storageData, IFaceAngleStorageView *&out_storageView)
+{
+    FaceAnglesAttachedView<TStorageCodec> *result = (FaceAnglesAttachedView<TStorageCodec> *)dAlloc(sizeof(FaceAnglesAttachedView<TStorageCodec>));
+
+    if (result != NULL)
+    {
+        new(result) FaceAnglesAttachedView<TStorageCodec>(triangleCount, storageData);
+
+        out_storageView = result;
+    }
+
+    return result;
+}
+
+template<class TStorageCodec>
+/*virtual */
+void FaceAnglesAttachedView<TStorageCodec>::disposeStorage()
+{
+    this->FaceAnglesAttachedView<TStorageCodec>::~FaceAnglesAttachedView();
+
+    dFree(this, sizeof(FaceAnglesAttachedView<TStorageCodec>));
+}
+
+template<class TStorageCodec>
+/*virtual */
+void FaceAnglesAttachedView<TStorageCodec>::assignFacesAngleIntoStorage(unsigned dUNUSED(triangleIndex), dMeshTriangleVertex dUNUSED(vertexIndex), dReal dUNUSED(dAngleValue))
+{
+    dICHECK(false); // The attached storage is read-only and the angles are never rebuilt
+}
+
+template<class TStorageCodec>
+/*virtual */
+FaceAngleDomain FaceAnglesAttachedView<TStorageCodec>::retrieveFacesAngleFromStorage(dReal &out_angleValue, unsigned triangleIndex, dMeshTriangleVertex vertexIndex)
+{
+    dIASSERT(dTMPL_IN_RANGE(triangleIndex, 0, m_triangleCount));
+    dIASSERT(dTMPL_IN_RANGE(vertexIndex, dMTV__MIN, dMTV__MAX));
+
+    storage_type storedValue = m_triangleFaceAngles[triangleIndex][vertexIndex];
+    FaceAngleDomain resultDomain = TStorageCodec::classifyStorageValue(storedValue);
+
+    out_angleValue = TStorageCodec::isAngleDomainStored(resultDomain) ? TStorageCodec::decodeStorageValue(storedValue) : REAL(0.0);
+    return resultDomain;
+}
+
+
 typedef IFaceAngleStorageControl *(FAngleStorageAllocProc)(unsigned triangleCount, IFaceAngleStorageView *&out_storageView);
 
 BEGIN_NAMESPACE_OU();
@@ -343,6 +438,30 @@ FAngleStorageAllocProc *const CEnumUnsortedElementArray<FaceAngleStorageMethod,
 END_NAMESPACE_OU();
 static const CEnumUnsortedElementArray<FaceAngleStorageMethod, ASM__MAX, FAngleStorageAllocProc *, 0x161211AD> g_AngleStorageAllocProcs;
 
+typedef IFaceAngleStorageControl *(FAngleStorageAttachProc)(unsigned triangleCount, const void *storageData, IFaceAngleStorageView *&out_storageView);
+
+BEGIN_NAMESPACE_OU();
+template<>
+FAngleStorageAttachProc *const CEnumUnsortedElementArray<FaceAngleStorageMethod, ASM__MAX, FAngleStorageAttachProc *, 0x1A0C1015>::m_aetElementArray[] =
+{
+    &FaceAnglesAttachedView<FaceAngleStorageCodec<uint8, SSI_SIGNED_STORED> >::attachInstance, // ASM_BYTE_SIGNED,
+    &FaceAnglesAttachedView<FaceAngleStorageCodec<uint8, SSI_POSITIVE_STORED> >::attachInstance, // ASM_BYTE_POSITIVE,
+    &FaceAnglesAttachedView<FaceAngleStorageCodec<uint16, SSI_SIGNED_STORED> >::attachInstance, // ASM_WORD_SIGNED,
+};
+END_NAMESPACE_OU();
+static const CEnumUnsortedElementArray<FaceAngleStorageMethod, ASM__MAX, FAngleStorageAttachProc *, 0x1A0C1015> g_AngleStorageAttachProcs;
+
+BEGIN_NAMESPACE_OU();
+template<>
+const sizeint CEnumUnsortedElementArray<FaceAngleStorageMethod, ASM__MAX, sizeint, 0x1A0C1016>::m_aetElementArray[] =
+{
+    sizeof(uint8), // ASM_BYTE_SIGNED,
+    sizeof(uint8), // ASM_BYTE_POSITIVE,
+    sizeof(uint16), // ASM_WORD_SIGNED,
+};
+END_NAMESPACE_OU();
+static const CEnumUnsortedElementArray<FaceAngleStorageMethod, ASM__MAX, sizeint, 0x1A0C1016> g_AngleStorageValueSizes;
+
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -393,6 +512,31 @@ bool dxTriDataBase::allocateFaceAngles(FaceAngleStorageMethod storageMethod)
     {
         m_faceAngles = storageInstance;
         m_faceAngleView = storageView;
+        m_faceAnglesStorageMethod = storageMethod;
+        result = true;
+    }
+
+    return result;
+}
+
+bool dxTriDataBase::attachFaceAngles(FaceAngleStorageMethod storageMethod, const void *storageData)
+{
+    bool result = false;
+
+    dIASSERT(m_faceAngles == NULL);
+
+    IFaceAngleStorageView *storageView;
+
+    unsigned triangleCount = m_triangleCount;
+
+    FAngleStorageAttachProc *attachProc = g_AngleStorageAttachProcs.Encode(storageMethod);
+    IFaceAngleStorageControl *storageInstance = attachProc(triangleCount, storageData, storageView);
+
+    if (storageInstance != NULL)
+    {
+        m_faceAngles = storageInstance;
+        m_faceAngleView = storageView;
+        m_faceAnglesStorageMethod = storageMethod;
         result = true;
     }
 
@@ -406,9 +550,15 @@ void dxTriDataBase::freeFaceAngles()
         m_faceAngles->disposeStorage();
         m_faceAngles = NULL;
         m_faceAngleView = NULL;
+        m_faceAnglesStorageMethod = ASM__INVALID;
     }
 }
 
+sizeint dxTriDataBase::calculateFaceAnglesStorageDataSize(FaceAngleStorageMethod storageMethod) const
+{
+    return (sizeint)m_triangleCount * dMTV__MAX * g_AngleStorageValueSizes.Encode(storageMethod);
+}
+
 
 void dxTriDataBase::EdgeRecord::setupEdge(dMeshTriangleVertex edgeIdx, int triIdx, const unsigned vertexIndices[dMTV__MAX])
 {
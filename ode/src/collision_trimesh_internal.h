@@ -105,6 +105,9 @@ public:
 
     // This is to store angles between neighbor triangle normals as positive value for convex and negative for concave edges
     virtual void assignFacesAngleIntoStorage(unsigned triangleIndex, dMeshTriangleVertex vertexIndex, dReal dAngleValue) = 0;
+
+    // The raw stored values (for serialization)
+    virtual const void *retrieveStorageData() const = 0;
 };
 
 class IFaceAngleStorageView
@@ -130,7 +133,8 @@ public:
         m_single(false),
         m_normals(NULL),
         m_faceAngles(NULL),
-        m_faceAngleView(NULL)
+        m_faceAngleView(NULL),
+        m_faceAnglesStorageMethod(ASM__INVALID)
     {
 #if !dTRIMESH_ENABLED
         dUASSERT(false, "dTRIMESH_ENABLED is not defined. Trimesh geoms will not work");
@@ -168,9 +172,13 @@ public:
 
     IFaceAngleStorageControl *retrieveFaceAngles() const { return m_faceAngles; }
     IFaceAngleStorageView *retrieveFaceAngleView() const { return m_faceAngleView; }
+    FaceAngleStorageMethod retrieveFaceAnglesStorageMethod() const { return m_faceAnglesStorageMethod; }
+    sizeint calculateFaceAnglesStorageDataSize(FaceAngleStorageMethod storageMethod) const;
 
 protected:
     bool allocateFaceAngles(FaceAngleStorageMethod storageMethod);
+    // Uses the values stored by an instance of the same method elsewhere (e.g. in a mapped file) without copying them
+    bool attachFaceAngles(FaceAngleStorageMethod storageMethod, const void *storageData);
     void freeFaceAngles();
 
     bool haveFaceAnglesBeenBuilt() const { return m_faceAngles != NULL; }
@@ -297,6 +305,7 @@ private:
     const void *m_normals;
     IFaceAngleStorageControl *m_faceAngles;
     IFaceAngleStorageView *m_faceAngleView; 
+    FaceAngleStorageMethod m_faceAnglesStorageMethod;
 };
 
 
@@ -87,8 +87,13 @@ void TrimeshCollidersCache::clearOPCODECaches()
 //////////////////////////////////////////////////////////////////////////
 // Trimesh data
 
+// The splitting rules of the tree builds
+#define TMD_TREE_SPLIT_RULES (SPLIT_BEST_AXIS | SPLIT_SPLATTER_POINTS | SPLIT_GEOM_CENTER)
+
 dxTriMeshData::~dxTriMeshData()
 {
+    disableDeformable();
+
     if ( m_InternalUseFlags != NULL )
     {
         sizeint flagsMemoryRequired = calculateUseFlagsMemoryRequirement();
@@ -96,11 +101,14 @@ dxTriMeshData::~dxTriMeshData()
     }
 }
 
-void dxTriMeshData::buildData(const Point *Vertices, int VertexStide, unsigned VertexCount,
+void dxTriMeshData::setupMeshData(const Point *Vertices, int VertexStide, unsigned VertexCount,
     const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
     const dReal *in_Normals,
     bool Single)
 {
+    // The subtrees of the deformable mode are those of the previous tree
+    disableDeformable();
+
     dxTriMeshData_Parent::buildData(Vertices, VertexStide, VertexCount, Indices, IndexCount, TriStride, in_Normals, Single);
     dAASSERT(IndexCount % dMTV__MAX == 0);
 
@@ -109,6 +117,14 @@ void dxTriMeshData::buildData(const Point *Vertices, int VertexStide, unsigned V
     m_Mesh.SetPointers(Indices, Vertices);
     m_Mesh.SetStrides(TriStride, VertexStide);
     m_Mesh.SetSingle(Single);
+}
+
+void dxTriMeshData::buildData(const Point *Vertices, int VertexStide, unsigned VertexCount,
+    const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+    const dReal *in_Normals,
+    bool Single)
+{
+    setupMeshData(Vertices, VertexStide, VertexCount, Indices, IndexCount, TriStride, in_Normals, Single);
 
     // Build tree
     // recommended in Opcode User Manual
@@ -116,7 +132,7 @@ void dxTriMeshData::buildData(const Point *Vertices, int VertexStide, unsigned V
     // used in ODE, why?
     //Settings.mRules = SPLIT_BEST_AXIS;
     // best compromise?
-    BuildSettings Settings(SPLIT_BEST_AXIS | SPLIT_SPLATTER_POINTS | SPLIT_GEOM_CENTER);
+    BuildSettings Settings(TMD_TREE_SPLIT_RULES);
 
     OPCODECREATE TreeBuilder(&m_Mesh, Settings, true, false);
 
@@ -125,14 +141,43 @@ void dxTriMeshData::buildData(const Point *Vertices, int VertexStide, unsigned V
     // compute model space AABB
     dVector3 AABBMax, AABBMin;
     calculateDataAABB(AABBMax, AABBMin);
+    assignDataAABB(AABBMax, AABBMin);
+
+    // user data (not used by OPCODE)
+    dIASSERT(m_InternalUseFlags == NULL);
+}
 
+void dxTriMeshData::assignDataAABB(const dVector3 AABBMax, const dVector3 AABBMin)
+{
     dAddVectors3(m_AABBCenter, AABBMin, AABBMax);
     dScaleVector3(m_AABBCenter, REAL(0.5));
 
     dSubtractVectors3(m_AABBExtents, AABBMax, m_AABBCenter);
+}
 
-    // user data (not used by OPCODE)
-    dIASSERT(m_InternalUseFlags == NULL);
+void dxTriMeshData::updateDataAABBFromTree()
+{
+    const AABBOptimizedTree *tree = m_BVTree.GetTree();
+
+    if (tree != NULL && !m_BVTree.HasLeafNodes() && !m_BVTree.IsQuantized() && tree->GetNbNodes() != 0)
+    {
+        // The root box is the union of the triangle boxes. It is stored as single precision center 
+        // and extents and is enlarged by their rounding errors not to cut the vertices off.
+        const CollisionAABB &rootBox = ((const AABBNoLeafTree *)tree)->GetNodes()[0].mAABB;
+
+        for (unsigned axis = dV3E__AXES_MIN; axis != dV3E__AXES_MAX; ++axis)
+        {
+            const dReal center = (dReal)rootBox.mCenter[axis], extents = (dReal)rootBox.mExtents[axis];
+            m_AABBCenter[axis] = center;
+            m_AABBExtents[axis] = extents + (dFabs(center) + extents) * (REAL(4.0) * FLT_EPSILON);
+        }
+    }
+    else
+    {
+        dVector3 AABBMax, AABBMin;
+        calculateDataAABB(AABBMax, AABBMin);
+        assignDataAABB(AABBMax, AABBMin);
+    }
 }
 
 
@@ -175,199 +220,1113 @@ void dxTriMeshData::templateCalculateDataAABB(dVector3 &AABBMax, dVector3 &AABBM
     }
 }
 
-
-bool dxTriMeshData::preprocessData(bool buildUseFlags/*=false*/, FaceAngleStorageMethod faceAndgesRequirement/*=ASM__INVALID*/)
+
+bool dxTriMeshData::preprocessData(bool buildUseFlags/*=false*/, FaceAngleStorageMethod faceAndgesRequirement/*=ASM__INVALID*/)
+{
+    bool buildUseFlagsToUse = buildUseFlags;
+    FaceAngleStorageMethod faceAndgesRequirementToUse = faceAndgesRequirement;
+
+    if (buildUseFlags && haveUseFlagsBeenBuilt())
+    {
+        dUASSERT(false, "Another request to build edge/vertex use flags after they had already been built");
+
+        buildUseFlagsToUse = false;
+    }
+
+    if (faceAndgesRequirement != ASM__INVALID && haveFaceAnglesBeenBuilt())
+    {
+        dUASSERT(false, "Another request to build face angles after they had already been built");
+
+        faceAndgesRequirementToUse = ASM__INVALID;
+    }
+
+    // If this mesh has already been preprocessed, exit
+    bool result = (!buildUseFlagsToUse && faceAndgesRequirementToUse == ASM__INVALID) || m_Mesh.GetNbTriangles() == 0 
+        || meaningfulPreprocessData(buildUseFlagsToUse, faceAndgesRequirementToUse);
+    return result;
+}
+
+struct TrimeshDataVertexIndexAccessor_OPCODE
+{
+    TrimeshDataVertexIndexAccessor_OPCODE(const IndexedTriangle *triIndicesBegin, unsigned triStride):
+        m_TriIndicesBegin(triIndicesBegin),
+        m_TriStride(triStride)
+    {
+    }
+
+    void getTriangleVertexIndices(unsigned out_VertexIndices[dMTV__MAX], unsigned triangleIdx) const
+    {
+        const IndexedTriangle *triIndicesBegin = m_TriIndicesBegin;
+        const unsigned triStride = m_TriStride;
+
+        const IndexedTriangle *triIndicesOfInterest = (const IndexedTriangle *)((const uint8 *)triIndicesBegin + triangleIdx * (sizeint)triStride);
+        std::copy(triIndicesOfInterest->mVRef, triIndicesOfInterest->mVRef + dMTV__MAX, out_VertexIndices);
+        dSASSERT(dMTV__MAX == dARRAY_SIZE(triIndicesOfInterest->mVRef));
+        dSASSERT(dMTV_FIRST == 0);
+        dSASSERT(dMTV_SECOND == 1);
+        dSASSERT(dMTV_THIRD == 2);
+        dSASSERT(dMTV__MAX == 3);
+    }
+
+
+    const IndexedTriangle   *m_TriIndicesBegin;
+    unsigned                m_TriStride;
+};
+
+struct TrimeshDataTrianglePointAccessor_OPCODE
+{
+    TrimeshDataTrianglePointAccessor_OPCODE(const MeshInterface &mesh):
+        m_Mesh(mesh)
+    {
+    }
+
+    void getTriangleVertexPoints(dVector3 out_Points[dMTV__MAX], unsigned triangleIndex) const
+    {
+        VertexPointers vpTriangle;
+        ConversionArea vc;
+        m_Mesh.GetTriangle(vpTriangle, triangleIndex, vc);
+
+        for (unsigned pointIndex = 0; pointIndex != 3; ++pointIndex)
+        {
+            dAssignVector3(out_Points[pointIndex], vpTriangle.Vertex[pointIndex]->x, vpTriangle.Vertex[pointIndex]->y, vpTriangle.Vertex[pointIndex]->z);
+        }
+        dSASSERT(dMTV_FIRST == 0);
+        dSASSERT(dMTV_SECOND == 1);
+        dSASSERT(dMTV_THIRD == 2);
+        dSASSERT(dMTV__MAX == 3);
+    }
+
+    const MeshInterface     &m_Mesh;
+};
+
+bool dxTriMeshData::meaningfulPreprocessData(bool buildUseFlags/*=false*/, FaceAngleStorageMethod faceAndgesRequirement/*=ASM__INVALID*/)
+{
+    const bool buildFaceAngles = faceAndgesRequirement != ASM__INVALID;
+    dIASSERT(buildUseFlags || buildFaceAngles);
+    dIASSERT(!buildUseFlags || !haveUseFlagsBeenBuilt());
+    dIASSERT(!buildFaceAngles || !haveFaceAnglesBeenBuilt());
+
+    bool result = false;
+
+    uint8 *useFlags = NULL;
+    sizeint flagsMemoryRequired = 0;
+    bool flagsAllocated = false, anglesAllocated = false;
+
+    do 
+    {
+        if (buildUseFlags)
+        {
+            flagsMemoryRequired = calculateUseFlagsMemoryRequirement();
+            useFlags = (uint8 *)dAlloc(flagsMemoryRequired);
+
+            if (useFlags == NULL)
+            {
+                break;
+            }
+        }
+
+        flagsAllocated = true;
+
+        if (buildFaceAngles)
+        {
+            if (!allocateFaceAngles(faceAndgesRequirement))
+            {
+                break;
+            }
+        }
+
+        anglesAllocated = true;
+
+        const unsigned int numTris = m_Mesh.GetNbTriangles();
+        const unsigned int numVertices = m_Mesh.GetNbVertices();
+        sizeint numEdges = (sizeint)numTris * dMTV__MAX;
+        dIASSERT(numVertices <= numEdges); // Edge records are going to be used for vertex data as well
+
+        const sizeint recordsMemoryRequired = dEFFICIENT_SIZE(numEdges * sizeof(EdgeRecord));
+        const sizeint verticesMemoryRequired = /*dEFFICIENT_SIZE*/(numVertices * sizeof(VertexRecord)); // Skip alignment for the last chunk
+        const sizeint totalTempMemoryRequired = recordsMemoryRequired + verticesMemoryRequired;
+        void *tempBuffer = dAlloc(totalTempMemoryRequired);
+        
+        if (tempBuffer == NULL)
+        {
+            break;
+        }
+
+        EdgeRecord *edges = (EdgeRecord *)tempBuffer;
+        VertexRecord *vertices = (VertexRecord *)((uint8 *)tempBuffer + recordsMemoryRequired);
+
+        // Delay zero-filling until all the allocations succeed
+        if (useFlags != NULL)
+        {
+            memset(useFlags, 0, flagsMemoryRequired);
+        }
+
+        const IndexedTriangle *triIndicesBegin = m_Mesh.GetTris();
+        unsigned triStride = m_Mesh.GetTriStride();
+        TrimeshDataVertexIndexAccessor_OPCODE indexAccessor(triIndicesBegin, triStride);
+        meaningfulPreprocess_SetupEdgeRecords(edges, numEdges, indexAccessor);
+
+        // Sort the edges, so the ones sharing the same verts are beside each other
+        std::sort(edges, edges + numEdges);
+
+        TrimeshDataTrianglePointAccessor_OPCODE pointAccessor(m_Mesh);
+        const dReal *const externalNormals = retrieveNormals();
+        IFaceAngleStorageControl *faceAngles = retrieveFaceAngles();
+        meaningfulPreprocess_buildEdgeFlags(useFlags, faceAngles, edges, numEdges, vertices, externalNormals, pointAccessor);
+
+        dFree(tempBuffer, totalTempMemoryRequired);
+    	
+        if (buildUseFlags)
+        {
+            m_InternalUseFlags = useFlags;
+        }
+
+        result = true;
+    }
+    while (false);
+
+    if (!result)
+    {
+        if (flagsAllocated)
+        {
+            if (anglesAllocated)
+            {
+                if (buildFaceAngles)
+                {
+                    freeFaceAngles();
+                }
+            }
+
+            if (buildUseFlags)
+            {
+                dFree(useFlags, flagsMemoryRequired);
+            }
+        }
+    }
+
+    return result;
+}
+
+
+void dxTriMeshData::updateData()
+{
+    if (m_Deformable != NULL)
+    {
+        // Without any vertices marked, all of them may have changed
+        if (!m_Deformable->isAnyDirty())
+        {
+            m_Deformable->markAllDirty();
+        }
+
+        updateDeformable(NULL);
+    }
+    else
+    {
+        // A tree used from an image is copied by OPCODE before being refitted
+        m_BVTree.Refit();
+        updateDataAABBFromTree();
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Trimesh data image
+//
+// The image holds the OPCODE tree nodes (whose links are relative and thus
+// position independent) and the preprocessed data in a single block that is
+// used in place when loaded, typically straight from a mapped file shared by
+// all the processes using the same static meshes. The vertices and the indices
+// are not included: the image is only valid for the data it was built from.
+// All the values are stored in the native byte order; an image written on a
+// platform with a different one fails the signature check.
+
+enum
+{
+    TDI_SIGNATURE           = 0x4D54444F, // "ODTM" when stored little-endian
+    TDI_VERSION             = 1,
+
+    TDI_IMAGE_ALIGNMENT     = 8,
+    TDI_NODES_ALIGNMENT     = 64, // A cache line, so that the nodes do not straddle them
+    TDI_DATA_ALIGNMENT      = 16,
+};
+
+enum
+{
+    TDIF_SINGLE_PRECISION   = 0x01,
+};
+
+struct dxTriMeshDataImageHeader
+{
+    uint32      m_signature;
+    uint32      m_version;
+    uint32      m_headerSize;
+    uint32      m_flags;
+    uint32      m_vertexCount;
+    uint32      m_triangleCount;
+    uint32      m_modelCode;
+    uint32      m_nodeCount;
+    uint32      m_nodeSize;
+    uint32      m_faceAnglesMethod;     // ASM__INVALID if the angles are not stored
+    uint64      m_nodesOffset;
+    uint64      m_faceAnglesOffset;
+    uint64      m_useFlagsOffset;       // Zero if the flags are not stored
+    uint64      m_imageSize;
+    float       m_centerCoeff[dSA__MAX];    // Dequantization coefficients of quantized trees
+    float       m_extentsCoeff[dSA__MAX];
+    double      m_AABBCenter[dSA__MAX];
+    double      m_AABBExtents[dSA__MAX];
+};
+
+
+static 
+sizeint calculateModelNodeSize(udword modelCode)
+{
+    return (modelCode & OPC_NO_LEAF) != 0
+        ? ((modelCode & OPC_QUANTIZED) != 0 ? sizeof(AABBQuantizedNoLeafNode) : sizeof(AABBNoLeafNode))
+        : ((modelCode & OPC_QUANTIZED) != 0 ? sizeof(AABBQuantizedNode) : sizeof(AABBCollisionNode));
+}
+
+static 
+uint64 calculateModelNodeCount(udword modelCode, unsigned triangleCount)
+{
+    return (modelCode & OPC_SINGLE_NODE) != 0 ? 0 
+        : (modelCode & OPC_NO_LEAF) != 0 ? (uint64)triangleCount - 1 : (uint64)triangleCount * 2 - 1;
+}
+
+static 
+const void *retrieveModelNodes(const Model &model, Point &out_centerCoeff, Point &out_extentsCoeff)
+{
+    const AABBOptimizedTree *tree = model.GetTree();
+    const void *result = NULL;
+
+    out_centerCoeff.Zero();
+    out_extentsCoeff.Zero();
+
+    if (tree != NULL)
+    {
+        if (model.HasLeafNodes())
+        {
+            if (model.IsQuantized())
+            {
+                const AABBQuantizedTree *quantizedTree = static_cast<const AABBQuantizedTree *>(tree);
+                out_centerCoeff.Set(quantizedTree->mCenterCoeff);
+                out_extentsCoeff.Set(quantizedTree->mExtentsCoeff);
+                result = quantizedTree->GetNodes();
+            }
+            else
+            {
+                result = static_cast<const AABBCollisionTree *>(tree)->GetNodes();
+            }
+        }
+        else
+        {
+            if (model.IsQuantized())
+            {
+                const AABBQuantizedNoLeafTree *quantizedTree = static_cast<const AABBQuantizedNoLeafTree *>(tree);
+                out_centerCoeff.Set(quantizedTree->mCenterCoeff);
+                out_extentsCoeff.Set(quantizedTree->mExtentsCoeff);
+                result = quantizedTree->GetNodes();
+            }
+            else
+            {
+                result = static_cast<const AABBNoLeafTree *>(tree)->GetNodes();
+            }
+        }
+    }
+
+    return result;
+}
+
+static 
+bool isImageBlockValid(const dxTriMeshDataImageHeader *header, uint64 blockOffset, uint64 blockSize, unsigned blockAlignment)
+{
+    return blockOffset >= header->m_headerSize && blockOffset % blockAlignment == 0
+        && blockOffset <= header->m_imageSize && blockSize <= header->m_imageSize - blockOffset;
+}
+
+// Checks the image header is consistent and matches the mesh; the tree nodes themselves are trusted
+static 
+const dxTriMeshDataImageHeader *validateImage(const void *image, sizeint imageSize, unsigned vertexCount, unsigned triangleCount)
+{
+    const dxTriMeshDataImageHeader *result = NULL;
+
+    do
+    {
+        if (image == NULL || (uintptr)image % TDI_IMAGE_ALIGNMENT != 0 || imageSize < sizeof(dxTriMeshDataImageHeader))
+        {
+            break;
+        }
+
+        const dxTriMeshDataImageHeader *header = (const dxTriMeshDataImageHeader *)image;
+
+        if (header->m_signature != TDI_SIGNATURE || header->m_version != TDI_VERSION || header->m_headerSize != sizeof(dxTriMeshDataImageHeader)
+            || header->m_imageSize > imageSize)
+        {
+            break;
+        }
+
+        if (header->m_vertexCount != vertexCount || header->m_triangleCount != triangleCount || triangleCount == 0)
+        {
+            break;
+        }
+
+        const udword modelCode = header->m_modelCode;
+        if ((modelCode & ~(udword)(OPC_NO_LEAF | OPC_QUANTIZED | OPC_SINGLE_NODE)) != 0 || ((modelCode & OPC_SINGLE_NODE) != 0) != (triangleCount == 1)
+            || header->m_nodeCount != calculateModelNodeCount(modelCode, triangleCount) || header->m_nodeSize != calculateModelNodeSize(modelCode)
+            || !isImageBlockValid(header, header->m_nodesOffset, (uint64)header->m_nodeCount * header->m_nodeSize, TDI_DATA_ALIGNMENT))
+        {
+            break;
+        }
+
+        if (header->m_faceAnglesMethod != ASM__INVALID)
+        {
+            const sizeint angleValueSize = header->m_faceAnglesMethod == ASM_WORD_SIGNED ? sizeof(uint16) : sizeof(uint8);
+
+            if (!dIN_RANGE(header->m_faceAnglesMethod, ASM__MIN, ASM__MAX) 
+                || !isImageBlockValid(header, header->m_faceAnglesOffset, (uint64)triangleCount * dMTV__MAX * angleValueSize, TDI_DATA_ALIGNMENT))
+            {
+                break;
+            }
+        }
+
+        if (header->m_useFlagsOffset != 0 && !isImageBlockValid(header, header->m_useFlagsOffset, (uint64)triangleCount * sizeof(uint8), TDI_DATA_ALIGNMENT))
+        {
+            break;
+        }
+
+        result = header;
+    }
+    while (false);
+
+    return result;
+}
+
+
+sizeint dxTriMeshData::serializeData(void *buffer, sizeint bufferSize) const
+{
+    const unsigned triangleCount = m_Mesh.GetNbTriangles();
+
+    if (triangleCount == 0)
+    {
+        return 0;
+    }
+
+    const udword modelCode = m_BVTree.GetModelCode() & (OPC_NO_LEAF | OPC_QUANTIZED | OPC_SINGLE_NODE);
+    const unsigned nodeCount = !m_BVTree.HasSingleNode() ? m_BVTree.GetNbNodes() : 0;
+    const sizeint nodeSize = calculateModelNodeSize(modelCode);
+    dIASSERT(nodeCount == calculateModelNodeCount(modelCode, triangleCount));
+
+    const FaceAngleStorageMethod faceAnglesMethod = retrieveFaceAnglesStorageMethod();
+    const uint8 *useFlags = smartRetrieveUseFlags();
+
+    const sizeint nodesOffset = dALIGN_SIZE(sizeof(dxTriMeshDataImageHeader), TDI_NODES_ALIGNMENT);
+    const sizeint nodesSize = nodeCount * nodeSize;
+    sizeint imageSize = nodesOffset + nodesSize;
+
+    const sizeint faceAnglesOffset = faceAnglesMethod != ASM__INVALID ? dALIGN_SIZE(imageSize, TDI_DATA_ALIGNMENT) : 0;
+    const sizeint faceAnglesSize = faceAnglesMethod != ASM__INVALID ? calculateFaceAnglesStorageDataSize(faceAnglesMethod) : 0;
+    imageSize = faceAnglesMethod != ASM__INVALID ? faceAnglesOffset + faceAnglesSize : imageSize;
+
+    const sizeint useFlagsOffset = useFlags != NULL ? dALIGN_SIZE(imageSize, TDI_DATA_ALIGNMENT) : 0;
+    const sizeint useFlagsSize = useFlags != NULL ? calculateUseFlagsMemoryRequirement() : 0;
+    imageSize = useFlags != NULL ? useFlagsOffset + useFlagsSize : imageSize;
+
+    if (buffer != NULL && bufferSize >= imageSize)
+    {
+        uint8 *imageBytes = (uint8 *)buffer;
+        memset(imageBytes, 0, imageSize); // Keep the padding deterministic
+
+        dxTriMeshDataImageHeader *header = (dxTriMeshDataImageHeader *)imageBytes;
+        header->m_signature = TDI_SIGNATURE;
+        header->m_version = TDI_VERSION;
+        header->m_headerSize = sizeof(dxTriMeshDataImageHeader);
+        header->m_flags = isSingle() ? TDIF_SINGLE_PRECISION : 0;
+        header->m_vertexCount = m_Mesh.GetNbVertices();
+        header->m_triangleCount = triangleCount;
+        header->m_modelCode = modelCode;
+        header->m_nodeCount = nodeCount;
+        header->m_nodeSize = (uint32)nodeSize;
+        header->m_faceAnglesMethod = faceAnglesMethod;
+        header->m_nodesOffset = nodesOffset;
+        header->m_faceAnglesOffset = faceAnglesOffset;
+        header->m_useFlagsOffset = useFlagsOffset;
+        header->m_imageSize = imageSize;
+
+        Point centerCoeff, extentsCoeff;
+        const void *nodes = retrieveModelNodes(m_BVTree, centerCoeff, extentsCoeff);
+
+        for (unsigned axis = dSA__MIN; axis != dSA__MAX; ++axis)
+        {
+            header->m_centerCoeff[axis] = centerCoeff[axis];
+            header->m_extentsCoeff[axis] = extentsCoeff[axis];
+            header->m_AABBCenter[axis] = m_AABBCenter[axis];
+            header->m_AABBExtents[axis] = m_AABBExtents[axis];
+        }
+
+        if (nodesSize != 0)
+        {
+            memcpy(imageBytes + nodesOffset, nodes, nodesSize);
+        }
+
+        if (faceAnglesMethod != ASM__INVALID)
+        {
+            memcpy(imageBytes + faceAnglesOffset, retrieveFaceAngles()->retrieveStorageData(), faceAnglesSize);
+        }
+
+        if (useFlags != NULL)
+        {
+            memcpy(imageBytes + useFlagsOffset, useFlags, useFlagsSize);
+        }
+    }
+
+    return imageSize;
+}
+
+bool dxTriMeshData::buildDataFromImage(const Point *Vertices, int VertexStide, unsigned VertexCount,
+    const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+    const dReal *in_Normals,
+    const void *image, sizeint imageSize)
+{
+    dUASSERT(!haveFaceAnglesBeenBuilt() && !haveUseFlagsBeenBuilt(), "The data has already been preprocessed");
+
+    bool result = false;
+
+    do
+    {
+        const dxTriMeshDataImageHeader *header = validateImage(image, imageSize, VertexCount, IndexCount / dMTV__MAX);
+        if (header == NULL)
+        {
+            break;
+        }
+
+        const bool single = (header->m_flags & TDIF_SINGLE_PRECISION) != 0;
+        setupMeshData(Vertices, VertexStide, VertexCount, Indices, IndexCount, TriStride, in_Normals, single);
+
+        const uint8 *imageBytes = (const uint8 *)image;
+        const Point centerCoeff(header->m_centerCoeff), extentsCoeff(header->m_extentsCoeff);
+
+        if (!m_BVTree.Attach(&m_Mesh, header->m_modelCode, imageBytes + header->m_nodesOffset, header->m_nodeCount, centerCoeff, extentsCoeff))
+        {
+            break;
+        }
+
+        dAssignVector3(m_AABBCenter, (dReal)header->m_AABBCenter[dSA_X], (dReal)header->m_AABBCenter[dSA_Y], (dReal)header->m_AABBCenter[dSA_Z]);
+        dAssignVector3(m_AABBExtents, (dReal)header->m_AABBExtents[dSA_X], (dReal)header->m_AABBExtents[dSA_Y], (dReal)header->m_AABBExtents[dSA_Z]);
+
+        if (header->m_faceAnglesMethod != ASM__INVALID)
+        {
+            if (!attachFaceAngles((FaceAngleStorageMethod)header->m_faceAnglesMethod, imageBytes + header->m_faceAnglesOffset))
+            {
+                break;
+            }
+        }
+
+        if (header->m_useFlagsOffset != 0)
+        {
+            // The flags are only read by the colliders
+            assignExternalUseFlagsBuffer(const_cast<uint8 *>(imageBytes + header->m_useFlagsOffset));
+        }
+
+        result = true;
+    }
+    while (false);
+
+    return result;
+}
+
+bool dxTriMeshData::buildDataFromImageFile(const Point *Vertices, int VertexStide, unsigned VertexCount,
+    const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+    const dReal *in_Normals,
+    const char *fileName)
+{
+    bool result = false;
+
+    // The previous mapping may still be in use until the data is built from the new one
+    dxFileMapping imageMapping;
+
+    if (imageMapping.Open(fileName)
+        && buildDataFromImage(Vertices, VertexStide, VertexCount, Indices, IndexCount, TriStride, in_Normals, imageMapping.GetData(), imageMapping.GetSize()))
+    {
+        m_ImageMapping.Swap(imageMapping);
+        result = true;
+    }
+
+    return result;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////
+// Deformable mode
+//
+// The tree is split into subtrees of a limited triangle count whose nodes
+// occupy contiguous ranges. Marking a vertex flags the nodes on the paths
+// from the leaves of its triangles up to the root, and an update refits
+// just the flagged nodes of the flagged subtrees. The quality of every
+// subtree is tracked as its surface area heuristic cost: the sum of its
+// node box areas relative to the root box area, i.e. the expected number
+// of the subtree nodes a query entering it visits. When the cost grows
+// past the given ratio of the one after the last build, the subtree is
+// rebuilt from a snapshot of its triangle boxes, on the threads of a world
+// if one is given, and the new nodes replace the old ones at an update.
+
+enum
+{
+    TMD_DEFORMABLE_SUBTREE_TRIANGLES_DEFAULT    = 256,
+    TMD_DEFORMABLE_SUBTREE_TRIANGLES_MIN        = 2,
+    TMD_DEFORMABLE_REBUILD_NODES_MIN            = 3, // There is little to improve in smaller subtrees
+};
+
+static const unsigned TMD_NO_NODE = ~0U;
+static const unsigned TMD_NO_SUBTREE = ~0U;
+
+
+void dxTriMeshSubtreeRebuild::run()
+{
+    const unsigned triangleCount = m_triangles.size();
+
+    AABBTreeOfAABBsBuilder builder;
+    builder.mAABBArray = m_triangleBoxes.data();
+    builder.mNbPrimitives = triangleCount;
+    builder.mSettings = BuildSettings(TMD_TREE_SPLIT_RULES);
+
+    AABBTree sourceTree;
+    AABBNoLeafTree subtree;
+
+    if (sourceTree.Build(&builder) && subtree.Build(&sourceTree))
+    {
+        const unsigned nodeCount = subtree.GetNbNodes();
+        dIASSERT(nodeCount == triangleCount - 1);
+
+        m_nodes.setSize(nodeCount);
+        std::copy(subtree.GetNodes(), subtree.GetNodes() + nodeCount, m_nodes.data());
+
+        // Turn the primitive indices of the build into the mesh triangle ones
+        for (unsigned j = 0; j != nodeCount; ++j)
+        {
+            AABBNoLeafNode &node = m_nodes[j];
+
+            if (node.HasPosLeaf())
+            {
+                node.mPosData = (m_triangles[(int)node.GetPosPrimitive()] << 1) | 1;
+            }
+
+            if (node.HasNegLeaf())
+            {
+                node.mNegData = (m_triangles[(int)node.GetNegPrimitive()] << 1) | 1;
+            }
+        }
+
+        m_succeeded = true;
+    }
+}
+
+static
+int rebuildTriMeshSubtreeCallback(void *call_context, dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    dxTriMeshSubtreeRebuild *rebuild = (dxTriMeshSubtreeRebuild *)call_context;
+    rebuild->run();
+    return 1;
+}
+
+
+void dxTriMeshDeformableState::setup(const AABBNoLeafTree *tree, const IndexedTriangle *triangles, int triangleStride, unsigned triangleCount,
+    unsigned vertexCount, unsigned subtreeTriangleCount, dReal rebuildCostRatio)
+{
+    const AABBNoLeafNode *nodes = tree->GetNodes();
+    const unsigned nodeCount = tree->GetNbNodes();
+    dIASSERT(nodeCount == triangleCount - 1);
+
+    m_rebuildCostRatio = rebuildCostRatio;
+
+    // The triangles using each vertex
+    m_vertexTriangleStarts.setSize(vertexCount + 1);
+    memset(m_vertexTriangleStarts.data(), 0, (vertexCount + 1) * sizeof(unsigned));
+
+    const uint8 *triangleBytes = (const uint8 *)triangles;
+    for (unsigned t = 0; t != triangleCount; ++t)
+    {
+        const IndexedTriangle *triangle = (const IndexedTriangle *)(triangleBytes + (sizeint)t * triangleStride);
+        for (unsigned v = 0; v != dMTV__MAX; ++v)
+        {
+            dIASSERT(triangle->mVRef[v] < vertexCount);
+            m_vertexTriangleStarts[triangle->mVRef[v] + 1] += 1;
+        }
+    }
+
+    for (unsigned v = 0; v != vertexCount; ++v)
+    {
+        m_vertexTriangleStarts[v + 1] += m_vertexTriangleStarts[v];
+    }
+
+    m_vertexTriangles.setSize(triangleCount * dMTV__MAX);
+    for (unsigned t = 0; t != triangleCount; ++t)
+    {
+        const IndexedTriangle *triangle = (const IndexedTriangle *)(triangleBytes + (sizeint)t * triangleStride);
+        for (unsigned v = 0; v != dMTV__MAX; ++v)
+        {
+            m_vertexTriangles[m_vertexTriangleStarts[triangle->mVRef[v]]++] = t;
+        }
+    }
+
+    // The starts have advanced to the next vertex ones
+    for (unsigned v = vertexCount; v != 0; --v)
+    {
+        m_vertexTriangleStarts[v] = m_vertexTriangleStarts[v - 1];
+    }
+    m_vertexTriangleStarts[0] = 0;
+
+    m_triangleNodes.setSize(triangleCount);
+    m_nodeParents.setSize(nodeCount);
+    m_nodeParents[0] = TMD_NO_NODE;
+    assignSubtreeLinks(tree, 0, nodeCount);
+
+    // Split the tree into the largest subtrees not exceeding the triangle count
+    dArray<unsigned> subtreeSizes;
+    subtreeSizes.setSize(nodeCount);
+    for (unsigned j = nodeCount; j != 0; )
+    {
+        const AABBNoLeafNode &node = nodes[--j];
+        subtreeSizes[j] = 1
+            + (node.HasPosLeaf() ? 0 : subtreeSizes[(int)(node.GetPos() - nodes)])
+            + (node.HasNegLeaf() ? 0 : subtreeSizes[(int)(node.GetNeg() - nodes)]);
+    }
+
+    const unsigned subtreeNodeLimit = subtreeTriangleCount - 1;
+    m_nodeSubtrees.setSize(nodeCount);
+    m_subtrees.setSize(0);
+
+    dArray<unsigned> pendingNodes;
+    pendingNodes.push(0);
+    while (pendingNodes.size() != 0)
+    {
+        const unsigned j = pendingNodes[pendingNodes.size() - 1];
+        pendingNodes.setSize(pendingNodes.size() - 1);
+
+        if (subtreeSizes[j] <= subtreeNodeLimit)
+        {
+            const unsigned subtreeIndex = m_subtrees.size();
+            for (unsigned k = j; k != j + subtreeSizes[j]; ++k)
+            {
+                m_nodeSubtrees[k] = subtreeIndex;
+            }
+
+            dxTriMeshDeformableSubtree subtree;
+            subtree.m_rootIndex = j;
+            subtree.m_nodeCount = subtreeSizes[j];
+            subtree.m_areaSum = 0.0;
+            subtree.m_builtCost = 0.0;
+            subtree.m_dirty = false;
+            subtree.m_rebuildPending = false;
+            m_subtrees.push(subtree);
+        }
+        else
+        {
+            m_nodeSubtrees[j] = TMD_NO_SUBTREE;
+
+            const AABBNoLeafNode &node = nodes[j];
+            if (!node.HasPosLeaf())
+            {
+                pendingNodes.push((unsigned)(node.GetPos() - nodes));
+            }
+            if (!node.HasNegLeaf())
+            {
+                pendingNodes.push((unsigned)(node.GetNeg() - nodes));
+            }
+        }
+    }
+
+    m_topNodes.setSize(0);
+    for (unsigned j = nodeCount; j != 0; )
+    {
+        if (m_nodeSubtrees[--j] == TMD_NO_SUBTREE)
+        {
+            m_topNodes.push(j);
+        }
+    }
+
+    // The subtrees are taken as they have been built
+    for (int s = 0; s != m_subtrees.size(); ++s)
+    {
+        dxTriMeshDeformableSubtree &subtree = m_subtrees[s];
+
+        double areaSum = 0.0;
+        for (unsigned j = subtree.m_rootIndex; j != subtree.m_rootIndex + subtree.m_nodeCount; ++j)
+        {
+            areaSum += calculateNodeArea(nodes[j]);
+        }
+
+        subtree.m_areaSum = areaSum;
+        subtree.m_builtCost = calculateSubtreeCost(nodes, subtree);
+    }
+
+    m_nodeDirtyFlags.setSize(nodeCount);
+    memset(m_nodeDirtyFlags.data(), 0, nodeCount * sizeof(uint8));
+    m_anyDirty = false;
+}
+
+void dxTriMeshDeformableState::assignSubtreeLinks(const AABBNoLeafTree *tree, unsigned rootIndex, unsigned nodeCount)
+{
+    const AABBNoLeafNode *nodes = tree->GetNodes();
+
+    for (unsigned j = rootIndex; j != rootIndex + nodeCount; ++j)
+    {
+        const AABBNoLeafNode &node = nodes[j];
+
+        if (node.HasPosLeaf())
+        {
+            m_triangleNodes[(int)node.GetPosPrimitive()] = j;
+        }
+        else
+        {
+            m_nodeParents[(int)(node.GetPos() - nodes)] = j;
+        }
+
+        if (node.HasNegLeaf())
+        {
+            m_triangleNodes[(int)node.GetNegPrimitive()] = j;
+        }
+        else
+        {
+            m_nodeParents[(int)(node.GetNeg() - nodes)] = j;
+        }
+    }
+}
+
+void dxTriMeshDeformableState::markNodePath(unsigned nodeIndex)
+{
+    // A flagged node has its ancestors flagged already
+    for (unsigned j = nodeIndex; j != TMD_NO_NODE && m_nodeDirtyFlags[j] == 0; j = m_nodeParents[j])
+    {
+        m_nodeDirtyFlags[j] = 1;
+
+        const unsigned subtreeIndex = m_nodeSubtrees[j];
+        if (subtreeIndex != TMD_NO_SUBTREE)
+        {
+            m_subtrees[subtreeIndex].m_dirty = true;
+        }
+    }
+}
+
+void dxTriMeshDeformableState::markVerticesDirty(unsigned firstVertex, unsigned vertexCount)
+{
+    dIASSERT(firstVertex + vertexCount < (unsigned)m_vertexTriangleStarts.size());
+
+    for (unsigned v = firstVertex; v != firstVertex + vertexCount; ++v)
+    {
+        for (unsigned k = m_vertexTriangleStarts[v]; k != m_vertexTriangleStarts[v + 1]; ++k)
+        {
+            markNodePath(m_triangleNodes[m_vertexTriangles[k]]);
+        }
+    }
+
+    m_anyDirty = m_anyDirty || vertexCount != 0;
+}
+
+void dxTriMeshDeformableState::markAllDirty()
+{
+    memset(m_nodeDirtyFlags.data(), 1, m_nodeDirtyFlags.size() * sizeof(uint8));
+
+    for (int s = 0; s != m_subtrees.size(); ++s)
+    {
+        m_subtrees[s].m_dirty = true;
+    }
+
+    m_anyDirty = true;
+}
+
+/*static */
+double dxTriMeshDeformableState::calculateNodeArea(const AABBNoLeafNode &node)
+{
+    // A half of the box area over its extents, which are a half of its sizes; the scale does not matter
+    const Point &extents = node.mAABB.mExtents;
+    return (double)extents.x * extents.y + (double)extents.y * extents.z + (double)extents.z * extents.x;
+}
+
+double dxTriMeshDeformableState::sumNodeAreas(const AABBNoLeafNode *nodes, const unsigned *indices, unsigned indexCount) const
 {
-    bool buildUseFlagsToUse = buildUseFlags;
-    FaceAngleStorageMethod faceAndgesRequirementToUse = faceAndgesRequirement;
+    double areaSum = 0.0;
 
-    if (buildUseFlags && haveUseFlagsBeenBuilt())
+    for (unsigned i = 0; i != indexCount; ++i)
     {
-        dUASSERT(false, "Another request to build edge/vertex use flags after they had already been built");
-
-        buildUseFlagsToUse = false;
+        areaSum += calculateNodeArea(nodes[indices[i]]);
     }
 
-    if (faceAndgesRequirement != ASM__INVALID && haveFaceAnglesBeenBuilt())
-    {
-        dUASSERT(false, "Another request to build face angles after they had already been built");
-
-        faceAndgesRequirementToUse = ASM__INVALID;
-    }
+    return areaSum;
+}
 
-    // If this mesh has already been preprocessed, exit
-    bool result = (!buildUseFlagsToUse && faceAndgesRequirementToUse == ASM__INVALID) || m_Mesh.GetNbTriangles() == 0 
-        || meaningfulPreprocessData(buildUseFlagsToUse, faceAndgesRequirementToUse);
-    return result;
+/*static */
+double dxTriMeshDeformableState::calculateSubtreeCost(const AABBNoLeafNode *nodes, const dxTriMeshDeformableSubtree &subtree)
+{
+    const double rootArea = calculateNodeArea(nodes[subtree.m_rootIndex]);
+    return rootArea > 0.0 ? subtree.m_areaSum / rootArea : 1.0;
 }
 
-struct TrimeshDataVertexIndexAccessor_OPCODE
+void dxTriMeshDeformableState::refitDirtyNodes(AABBNoLeafTree *tree, const MeshInterface *mesh)
 {
-    TrimeshDataVertexIndexAccessor_OPCODE(const IndexedTriangle *triIndicesBegin, unsigned triStride):
-        m_TriIndicesBegin(triIndicesBegin),
-        m_TriStride(triStride)
+    if (!m_anyDirty)
     {
+        return;
     }
 
-    void getTriangleVertexIndices(unsigned out_VertexIndices[dMTV__MAX], unsigned triangleIdx) const
+    uint8 *dirtyFlags = m_nodeDirtyFlags.data();
+
+    for (int s = 0; s != m_subtrees.size(); ++s)
     {
-        const IndexedTriangle *triIndicesBegin = m_TriIndicesBegin;
-        const unsigned triStride = m_TriStride;
+        dxTriMeshDeformableSubtree &subtree = m_subtrees[s];
+        if (!subtree.m_dirty)
+        {
+            continue;
+        }
 
-        const IndexedTriangle *triIndicesOfInterest = (const IndexedTriangle *)((const uint8 *)triIndicesBegin + triangleIdx * (sizeint)triStride);
-        std::copy(triIndicesOfInterest->mVRef, triIndicesOfInterest->mVRef + dMTV__MAX, out_VertexIndices);
-        dSASSERT(dMTV__MAX == dARRAY_SIZE(triIndicesOfInterest->mVRef));
-        dSASSERT(dMTV_FIRST == 0);
-        dSASSERT(dMTV_SECOND == 1);
-        dSASSERT(dMTV_THIRD == 2);
-        dSASSERT(dMTV__MAX == 3);
-    }
+        // Children follow their parents and get refitted first in the descending order
+        m_refitIndices.setSize(0);
+        for (unsigned j = subtree.m_rootIndex + subtree.m_nodeCount; j != subtree.m_rootIndex; )
+        {
+            if (dirtyFlags[--j] != 0)
+            {
+                dirtyFlags[j] = 0;
+                m_refitIndices.push(j);
+            }
+        }
 
+        const unsigned *refitIndices = m_refitIndices.data();
+        const unsigned refitCount = m_refitIndices.size();
 
-    const IndexedTriangle   *m_TriIndicesBegin;
-    unsigned                m_TriStride;
-};
+        const double areaBefore = sumNodeAreas(tree->GetNodes(), refitIndices, refitCount);
+        tree->RefitNodes(mesh, refitIndices, refitCount);
 
-struct TrimeshDataTrianglePointAccessor_OPCODE
-{
-    TrimeshDataTrianglePointAccessor_OPCODE(const MeshInterface &mesh):
-        m_Mesh(mesh)
-    {
+        const AABBNoLeafNode *nodes = tree->GetNodes();
+        const double areaAfter = sumNodeAreas(nodes, refitIndices, refitCount);
+        subtree.m_dirty = false;
+
+        if (subtree.m_builtCost < 0.0)
+        {
+            // A rebuilt subtree has all its nodes refitted
+            dIASSERT(refitCount == subtree.m_nodeCount);
+            subtree.m_areaSum = areaAfter;
+            subtree.m_builtCost = calculateSubtreeCost(nodes, subtree);
+        }
+        else
+        {
+            subtree.m_areaSum += areaAfter - areaBefore;
+
+            if (!subtree.m_rebuildPending && subtree.m_nodeCount >= TMD_DEFORMABLE_REBUILD_NODES_MIN
+                && calculateSubtreeCost(nodes, subtree) > subtree.m_builtCost * m_rebuildCostRatio)
+            {
+                m_degradedSubtrees.push(s);
+            }
+        }
     }
 
-    void getTriangleVertexPoints(dVector3 out_Points[dMTV__MAX], unsigned triangleIndex) const
+    // The nodes above the subtrees
+    m_refitIndices.setSize(0);
+    for (int i = 0; i != m_topNodes.size(); ++i)
     {
-        VertexPointers vpTriangle;
-        ConversionArea vc;
-        m_Mesh.GetTriangle(vpTriangle, triangleIndex, vc);
-
-        for (unsigned pointIndex = 0; pointIndex != 3; ++pointIndex)
+        const unsigned j = m_topNodes[i];
+        if (dirtyFlags[j] != 0)
         {
-            dAssignVector3(out_Points[pointIndex], vpTriangle.Vertex[pointIndex]->x, vpTriangle.Vertex[pointIndex]->y, vpTriangle.Vertex[pointIndex]->z);
+            dirtyFlags[j] = 0;
+            m_refitIndices.push(j);
         }
-        dSASSERT(dMTV_FIRST == 0);
-        dSASSERT(dMTV_SECOND == 1);
-        dSASSERT(dMTV_THIRD == 2);
-        dSASSERT(dMTV__MAX == 3);
     }
+    tree->RefitNodes(mesh, m_refitIndices.data(), m_refitIndices.size());
 
-    const MeshInterface     &m_Mesh;
-};
+    m_anyDirty = false;
+}
 
-bool dxTriMeshData::meaningfulPreprocessData(bool buildUseFlags/*=false*/, FaceAngleStorageMethod faceAndgesRequirement/*=ASM__INVALID*/)
+void dxTriMeshDeformableState::startRebuilds(const AABBNoLeafTree *tree, const MeshInterface *mesh, const dxThreadingBase *threading)
 {
-    const bool buildFaceAngles = faceAndgesRequirement != ASM__INVALID;
-    dIASSERT(buildUseFlags || buildFaceAngles);
-    dIASSERT(!buildUseFlags || !haveUseFlagsBeenBuilt());
-    dIASSERT(!buildFaceAngles || !haveFaceAnglesBeenBuilt());
+    const AABBNoLeafNode *nodes = tree->GetNodes();
 
-    bool result = false;
+    for (int i = 0; i != m_degradedSubtrees.size(); ++i)
+    {
+        const unsigned subtreeIndex = m_degradedSubtrees[i];
+        dxTriMeshDeformableSubtree &subtree = m_subtrees[subtreeIndex];
 
-    uint8 *useFlags = NULL;
-    sizeint flagsMemoryRequired = 0;
-    bool flagsAllocated = false, anglesAllocated = false;
+        dxTriMeshSubtreeRebuild *rebuild = new dxTriMeshSubtreeRebuild(subtreeIndex);
 
-    do 
-    {
-        if (buildUseFlags)
+        const unsigned triangleCount = subtree.m_nodeCount + 1;
+        rebuild->m_triangles.setSize(triangleCount);
+        rebuild->m_triangleBoxes.setSize(triangleCount);
+
+        unsigned t = 0;
+        for (unsigned j = subtree.m_rootIndex; j != subtree.m_rootIndex + subtree.m_nodeCount; ++j)
         {
-            flagsMemoryRequired = calculateUseFlagsMemoryRequirement();
-            useFlags = (uint8 *)dAlloc(flagsMemoryRequired);
+            const AABBNoLeafNode &node = nodes[j];
 
-            if (useFlags == NULL)
+            if (node.HasPosLeaf())
             {
-                break;
+                rebuild->m_triangles[t++] = (unsigned)node.GetPosPrimitive();
+            }
+
+            if (node.HasNegLeaf())
+            {
+                rebuild->m_triangles[t++] = (unsigned)node.GetNegPrimitive();
             }
         }
+        dIASSERT(t == triangleCount);
 
-        flagsAllocated = true;
+        VertexPointers VP;
+        ConversionArea VC;
+        for (t = 0; t != triangleCount; ++t)
+        {
+            mesh->GetTriangle(VP, rebuild->m_triangles[t], VC);
+
+            Point triangleMin(*VP.Vertex[0]), triangleMax(*VP.Vertex[0]);
+            triangleMin.Min(*VP.Vertex[1]);
+            triangleMax.Max(*VP.Vertex[1]);
+            triangleMin.Min(*VP.Vertex[2]);
+            triangleMax.Max(*VP.Vertex[2]);
+            rebuild->m_triangleBoxes[t].SetMinMax(triangleMin, triangleMax);
+        }
 
-        if (buildFaceAngles)
+        subtree.m_rebuildPending = true;
+        m_rebuilds.push(rebuild);
+
+        dCallWaitID callWait = threading != NULL ? threading->AllocThreadedCallWait() : NULL;
+
+        if (callWait != NULL && threading->PreallocateResourcesForThreadedCalls(1))
         {
-            if (!allocateFaceAngles(faceAndgesRequirement))
+            rebuild->m_callWait = callWait;
+            rebuild->m_threading = threading;
+            threading->PostThreadedCall(NULL, NULL, 0, NULL, callWait,
+                &rebuildTriMeshSubtreeCallback, rebuild, 0, "TriMeshData Subtree Rebuild");
+        }
+        else
+        {
+            if (callWait != NULL)
             {
-                break;
+                threading->FreeThreadedCallWait(callWait);
             }
+
+            rebuild->run();
         }
+    }
 
-        anglesAllocated = true;
+    m_degradedSubtrees.setSize(0);
+}
 
-        const unsigned int numTris = m_Mesh.GetNbTriangles();
-        const unsigned int numVertices = m_Mesh.GetNbVertices();
-        sizeint numEdges = (sizeint)numTris * dMTV__MAX;
-        dIASSERT(numVertices <= numEdges); // Edge records are going to be used for vertex data as well
+unsigned dxTriMeshDeformableState::commitRebuilds(AABBNoLeafTree *tree, bool waitForPending)
+{
+    unsigned committedCount = 0;
 
-        const sizeint recordsMemoryRequired = dEFFICIENT_SIZE(numEdges * sizeof(EdgeRecord));
-        const sizeint verticesMemoryRequired = /*dEFFICIENT_SIZE*/(numVertices * sizeof(VertexRecord)); // Skip alignment for the last chunk
-        const sizeint totalTempMemoryRequired = recordsMemoryRequired + verticesMemoryRequired;
-        void *tempBuffer = dAlloc(totalTempMemoryRequired);
-        
-        if (tempBuffer == NULL)
+    for (int i = 0; i != m_rebuilds.size(); )
+    {
+        dxTriMeshSubtreeRebuild *rebuild = m_rebuilds[i];
+
+        if (rebuild->m_callWait != NULL)
         {
-            break;
-        }
+            const dThreadedWaitTime pollTime = { 0, 0 };
+            int waitStatus = 0;
+            rebuild->m_threading->WaitThreadedCallCollectively(&waitStatus, rebuild->m_callWait,
+                waitForPending ? NULL : &pollTime, "TriMeshData Subtree Rebuild Wait");
 
-        EdgeRecord *edges = (EdgeRecord *)tempBuffer;
-        VertexRecord *vertices = (VertexRecord *)((uint8 *)tempBuffer + recordsMemoryRequired);
+            if (waitStatus == 0)
+            {
+                ++i;
+                continue;
+            }
 
-        // Delay zero-filling until all the allocations succeed
-        if (useFlags != NULL)
-        {
-            memset(useFlags, 0, flagsMemoryRequired);
+            rebuild->m_threading->FreeThreadedCallWait(rebuild->m_callWait);
+            rebuild->m_callWait = NULL;
         }
 
-        const IndexedTriangle *triIndicesBegin = m_Mesh.GetTris();
-        unsigned triStride = m_Mesh.GetTriStride();
-        TrimeshDataVertexIndexAccessor_OPCODE indexAccessor(triIndicesBegin, triStride);
-        meaningfulPreprocess_SetupEdgeRecords(edges, numEdges, indexAccessor);
+        dxTriMeshDeformableSubtree &subtree = m_subtrees[rebuild->m_subtreeIndex];
 
-        // Sort the edges, so the ones sharing the same verts are beside each other
-        std::sort(edges, edges + numEdges);
+        if (tree != NULL && rebuild->m_succeeded
+            && tree->ReplaceSubtree(subtree.m_rootIndex, rebuild->m_nodes.data(), subtree.m_nodeCount))
+        {
+            assignSubtreeLinks(tree, subtree.m_rootIndex, subtree.m_nodeCount);
 
-        TrimeshDataTrianglePointAccessor_OPCODE pointAccessor(m_Mesh);
-        const dReal *const externalNormals = retrieveNormals();
-        IFaceAngleStorageControl *faceAngles = retrieveFaceAngles();
-        meaningfulPreprocess_buildEdgeFlags(useFlags, faceAngles, edges, numEdges, vertices, externalNormals, pointAccessor);
+            // The new boxes are those of the snapshot. Have them all refitted and the cost taken anew.
+            memset(m_nodeDirtyFlags.data() + subtree.m_rootIndex, 1, subtree.m_nodeCount * sizeof(uint8));
+            subtree.m_dirty = true;
+            subtree.m_builtCost = -1.0;
+            markNodePath(m_nodeParents[subtree.m_rootIndex]);
+            m_anyDirty = true;
 
-        dFree(tempBuffer, totalTempMemoryRequired);
-    	
-        if (buildUseFlags)
-        {
-            m_InternalUseFlags = useFlags;
+            ++committedCount;
         }
 
-        result = true;
+        subtree.m_rebuildPending = false;
+        delete rebuild;
+        m_rebuilds.remove(i);
     }
-    while (false);
 
-    if (!result)
+    return committedCount;
+}
+
+void dxTriMeshDeformableState::discardRebuilds()
+{
+    commitRebuilds(NULL, true);
+}
+
+
+bool dxTriMeshData::enableDeformable(unsigned subtreeTriangleCount, dReal rebuildCostRatio)
+{
+    disableDeformable();
+
+    bool result = false;
+
+    // Only the trees built by buildData() can be updated partially. Single triangle meshes have no tree at all.
+    const AABBOptimizedTree *tree = m_BVTree.GetTree();
+    if (tree != NULL && !m_BVTree.HasLeafNodes() && !m_BVTree.IsQuantized() && tree->GetNbNodes() != 0)
     {
-        if (flagsAllocated)
-        {
-            if (anglesAllocated)
-            {
-                if (buildFaceAngles)
-                {
-                    freeFaceAngles();
-                }
-            }
+        const unsigned subtreeTriangleCountToUse = subtreeTriangleCount != 0
+            ? dMACRO_MAX(subtreeTriangleCount, (unsigned)TMD_DEFORMABLE_SUBTREE_TRIANGLES_MIN)
+            : (unsigned)TMD_DEFORMABLE_SUBTREE_TRIANGLES_DEFAULT;
 
-            if (buildUseFlags)
-            {
-                dFree(useFlags, flagsMemoryRequired);
-            }
-        }
+        dxTriMeshDeformableState *deformable = new dxTriMeshDeformableState();
+        deformable->setup((const AABBNoLeafTree *)tree, (const IndexedTriangle *)retrieveTriangleVertexIndices(), retrieveTriangleStride(),
+            retrieveTriangleCount(), retrieveVertexCount(), subtreeTriangleCountToUse, rebuildCostRatio);
+        m_Deformable = deformable;
+
+        result = true;
     }
 
     return result;
 }
 
+void dxTriMeshData::disableDeformable()
+{
+    if (m_Deformable != NULL)
+    {
+        // Waits for the rebuilds still running
+        delete m_Deformable;
+        m_Deformable = NULL;
+    }
+}
 
-void dxTriMeshData::updateData()
+void dxTriMeshData::markVerticesDirty(unsigned firstVertex, unsigned vertexCount)
 {
-    m_BVTree.Refit();
+    dIASSERT(m_Deformable != NULL);
+
+    m_Deformable->markVerticesDirty(firstVertex, vertexCount);
 }
 
+unsigned dxTriMeshData::updateDeformable(const dxThreadingBase *threading)
+{
+    dxTriMeshDeformableState *deformable = m_Deformable;
+    dIASSERT(deformable != NULL);
+
+    AABBNoLeafTree *tree = (AABBNoLeafTree *)m_BVTree.GetTree();
+
+    unsigned committedCount = deformable->commitRebuilds(tree, false);
+    deformable->refitDirtyNodes(tree, &m_Mesh);
+    deformable->startRebuilds(tree, &m_Mesh, threading);
+
+    // Without threads the rebuilds have completed and can be used at once
+    if (threading == NULL)
+    {
+        committedCount += deformable->commitRebuilds(tree, true);
+        deformable->refitDirtyNodes(tree, &m_Mesh);
+    }
+
+    updateDataAABBFromTree();
+
+    return committedCount;
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -712,6 +1671,99 @@ void dGeomTriMeshDataBuildDouble1(dTriMeshDataID g,
 }
 
 
+/*extern */
+dsizeint dGeomTriMeshDataSerialize(dTriMeshDataID g, void *buffer, dsizeint buffer_size)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    const dxTriMeshData *data = g;
+    return data->serializeData(buffer, buffer_size);
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImage(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount, 
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const void *image, dsizeint image_size)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    dxTriMeshData *data = g;
+    return data->buildDataFromImage((const Point *)Vertices, VertexStride, VertexCount, 
+        (const IndexedTriangle *)Indices, IndexCount, TriStride, 
+        (const dReal *)Normals, 
+        image, image_size);
+}
+
+/*extern */
+int dGeomTriMeshDataBuildFromImageFile(dTriMeshDataID g,
+    const void* Vertices, int VertexStride, int VertexCount, 
+    const void* Indices, int IndexCount, int TriStride,
+    const void* Normals,
+    const char *file_name)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    dxTriMeshData *data = g;
+    return data->buildDataFromImageFile((const Point *)Vertices, VertexStride, VertexCount, 
+        (const IndexedTriangle *)Indices, IndexCount, TriStride, 
+        (const dReal *)Normals, 
+        file_name);
+}
+
+
+/*extern */
+int dGeomTriMeshDataEnableDeformable(dTriMeshDataID g, int subtree_triangle_count, dReal rebuild_cost_ratio)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+    dAASSERT(subtree_triangle_count >= 0);
+
+    dxTriMeshData *data = g;
+    return data->enableDeformable((unsigned)subtree_triangle_count, rebuild_cost_ratio);
+}
+
+/*extern */
+void dGeomTriMeshDataDisableDeformable(dTriMeshDataID g)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    dxTriMeshData *data = g;
+    data->disableDeformable();
+}
+
+/*extern */
+void dGeomTriMeshDataMarkVerticesDirty(dTriMeshDataID g, int first_vertex, int vertex_count)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+    dUASSERT(g->isDeformable(), "The trimesh data is not deformable");
+    dAASSERT(first_vertex >= 0 && vertex_count >= 0 && (unsigned)(first_vertex + vertex_count) <= g->retrieveVertexCount());
+
+    dxTriMeshData *data = g;
+    data->markVerticesDirty((unsigned)first_vertex, (unsigned)vertex_count);
+}
+
+/*extern */
+int dGeomTriMeshDataUpdateDeformable(dTriMeshDataID g, dWorldID world)
+{
+    dUASSERT(g, "The argument is not a trimesh data");
+
+    dxTriMeshData *data = g;
+    int result = 0;
+
+    if (data->isDeformable())
+    {
+        result = (int)data->updateDeformable(world);
+    }
+    else
+    {
+        data->updateData();
+    }
+
+    return result;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 
 /*extern */
@@ -42,6 +42,7 @@
 #include <ode/collision_trimesh.h>
 
 #include "collision_trimesh_internal.h"
+#include "file_mapping.h"
 
 #define BAN_OPCODE_AUTOLINK
 #include "Opcode.h"
@@ -166,6 +167,84 @@ struct TrimeshCollidersCache
 };
 
 
+// A subtree rebuild of the deformable mode. The tree is built from the triangle boxes 
+// taken when the rebuild is started, so it can run on another thread while the vertices keep changing.
+struct dxTriMeshSubtreeRebuild:
+    public dBase
+{
+    explicit dxTriMeshSubtreeRebuild(unsigned subtreeIndex):
+        m_subtreeIndex(subtreeIndex),
+        m_callWait(NULL),
+        m_threading(NULL),
+        m_succeeded(false)
+    {
+    }
+
+    void run();
+
+    unsigned m_subtreeIndex;
+    dArray<unsigned> m_triangles;           // the subtree triangles by the primitive indices of the build
+    dArray<AABB> m_triangleBoxes;
+    dArray<AABBNoLeafNode> m_nodes;         // the new subtree nodes with the mesh triangle indices
+    dCallWaitID m_callWait;                 // NULL if the rebuild has run on the calling thread
+    const dxThreadingBase *m_threading;
+    bool m_succeeded;
+};
+
+// A subtree refitted and rebuilt as a unit in the deformable mode. Its nodes occupy 
+// a contiguous range of the tree starting at the root.
+struct dxTriMeshDeformableSubtree
+{
+    unsigned m_rootIndex;
+    unsigned m_nodeCount;
+    double m_areaSum;       // sum of the node box areas
+    double m_builtCost;     // the area sum relative to the root area after the last build, negative to take it at the next refit
+    bool m_dirty;
+    bool m_rebuildPending;
+};
+
+struct dxTriMeshDeformableState:
+    public dBase
+{
+    dxTriMeshDeformableState(): m_rebuildCostRatio(0), m_anyDirty(false) {}
+    ~dxTriMeshDeformableState() { discardRebuilds(); }
+
+    void setup(const AABBNoLeafTree *tree, const IndexedTriangle *triangles, int triangleStride, unsigned triangleCount,
+        unsigned vertexCount, unsigned subtreeTriangleCount, dReal rebuildCostRatio);
+
+    void markVerticesDirty(unsigned firstVertex, unsigned vertexCount);
+    void markAllDirty();
+    bool isAnyDirty() const { return m_anyDirty; }
+
+    void refitDirtyNodes(AABBNoLeafTree *tree, const MeshInterface *mesh);
+    void startRebuilds(const AABBNoLeafTree *tree, const MeshInterface *mesh, const dxThreadingBase *threading);
+    unsigned commitRebuilds(AABBNoLeafTree *tree, bool waitForPending);
+    void discardRebuilds();
+
+private:
+    void markNodePath(unsigned nodeIndex);
+    void assignSubtreeLinks(const AABBNoLeafTree *tree, unsigned rootIndex, unsigned nodeCount);
+    static double calculateNodeArea(const AABBNoLeafNode &node);
+    double sumNodeAreas(const AABBNoLeafNode *nodes, const unsigned *indices, unsigned indexCount) const;
+    static double calculateSubtreeCost(const AABBNoLeafNode *nodes, const dxTriMeshDeformableSubtree &subtree);
+
+private:
+    dArray<unsigned> m_vertexTriangleStarts;    // the triangles using each vertex, compressed by the vertex
+    dArray<unsigned> m_vertexTriangles;
+    dArray<unsigned> m_triangleNodes;           // the node each triangle is a leaf of
+    dArray<unsigned> m_nodeParents;
+    dArray<unsigned> m_nodeSubtrees;
+    dArray<uint8> m_nodeDirtyFlags;
+    dArray<unsigned> m_topNodes;                // the nodes above the subtrees, children first
+    dArray<dxTriMeshDeformableSubtree> m_subtrees;
+    dArray<unsigned> m_degradedSubtrees;
+    dArray<dxTriMeshSubtreeRebuild *> m_rebuilds;
+    dArray<unsigned> m_refitIndices;
+    dReal m_rebuildCostRatio;
+    bool m_anyDirty;
+};
+
+
 typedef dxTriDataBase dxTriMeshData_Parent;
 struct dxTriMeshData:
     public dxTriMeshData_Parent
@@ -174,7 +253,8 @@ public:
     dxTriMeshData():
         dxTriMeshData_Parent(),
         m_ExternalUseFlags(NULL),
-        m_InternalUseFlags(NULL)
+        m_InternalUseFlags(NULL),
+        m_Deformable(NULL)
     {
     }
 
@@ -185,10 +265,31 @@ public:
         const dReal *in_Normals,
         bool Single);
 
+    /* Build with the tree and the preprocessed data used in place from a serialized image */
+    bool buildDataFromImage(const Point *Vertices, int VertexStide, unsigned VertexCount,
+        const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+        const dReal *in_Normals,
+        const void *image, sizeint imageSize);
+    bool buildDataFromImageFile(const Point *Vertices, int VertexStide, unsigned VertexCount,
+        const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+        const dReal *in_Normals,
+        const char *fileName);
+
+    /* Write the serialized image if the buffer is large enough; returns the image size */
+    sizeint serializeData(void *buffer, sizeint bufferSize) const;
+
 private:
+    void setupMeshData(const Point *Vertices, int VertexStide, unsigned VertexCount,
+        const IndexedTriangle *Indices, unsigned IndexCount, int TriStride,
+        const dReal *in_Normals,
+        bool Single);
+
     void calculateDataAABB(dVector3 &AABBMax, dVector3 &AABBMin);
     template<typename treal>
     void templateCalculateDataAABB(dVector3 &AABBMax, dVector3 &AABBMin);
+    void assignDataAABB(const dVector3 AABBMax, const dVector3 AABBMin);
+    /* Take the AABB from the tree root rather than from all the vertices */
+    void updateDataAABBFromTree();
 
 public:
     /* Setup the UseFlags array and/or build face angles*/
@@ -201,6 +302,14 @@ public:
     /* For when app changes the vertices */
     void updateData();
 
+public:
+    /* Deformable mode: refit the marked vertices' subtrees only and rebuild the degraded ones */
+    bool enableDeformable(unsigned subtreeTriangleCount, dReal rebuildCostRatio);
+    void disableDeformable();
+    bool isDeformable() const { return m_Deformable != NULL; }
+    void markVerticesDirty(unsigned firstVertex, unsigned vertexCount);
+    unsigned updateDeformable(const dxThreadingBase *threading);
+
 public:
     const Point *retrieveVertexInstances() const { return (const Point *)dxTriMeshData_Parent::retrieveVertexInstances(); }
 
@@ -227,6 +336,11 @@ public:
     uint8 *m_ExternalUseFlags;
     uint8 *m_InternalUseFlags;
 
+    // the serialized image file the tree and the preprocessed data are used from
+    dxFileMapping m_ImageMapping;
+
+    // partial update state of the deformable mode or NULL
+    dxTriMeshDeformableState *m_Deformable;
 };
 
 
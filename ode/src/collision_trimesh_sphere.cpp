@@ -395,7 +395,10 @@ int dCollideSTL(dxGeom* g1, dxGeom* SphereGeom, int Flags, dContactGeom* Contact
             dir[0] = Position[0]-ContactPos[0];
             dir[1] = Position[1]-ContactPos[1];
             dir[2] = Position[2]-ContactPos[2];
-            dReal dirProj = dCalcVectorDot3(dir, Plane) / dSqrt(dCalcVectorDot3(dir, dir));
+            // With the center lying on the triangle there is no direction to project
+            // and the depth is already the one along the normal.
+            dReal dirLengthSq = dCalcVectorDot3(dir, dir);
+            dReal dirProj = dirLengthSq > REAL(0.0) ? dCalcVectorDot3(dir, Plane) / dSqrt(dirLengthSq) : REAL(1.0);
 
             // Since Depth already had a requirement to be non-negative,
             // negative direction projections should not be allowed as well,
@@ -47,5 +47,33 @@ dReal calculateLargeVectorDot (const dReal *a, const dReal *b, unsigned n)
     return sum;
 }
 
+// Four dot products of the rows a0..a3 with the same vector b. Each sum is accumulated
+// in the same order as calculateLargeVectorDot() does it while b is only traversed once.
+template<unsigned b_stride>
+void calculateLargeVectorDotQuad (dReal sums[4], const dReal *a0, const dReal *a1, const dReal *a2, const dReal *a3, const dReal *b, unsigned n)
+{
+    dReal sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    const unsigned n_end = n & (int)(~3);
+    unsigned k = 0;
+    for (; k != n_end; b += 4 * b_stride, k += 4) {
+        dReal q0 = b[0 * b_stride], q1 = b[1 * b_stride], q2 = b[2 * b_stride], q3 = b[3 * b_stride];
+        sum0 += a0[k] * q0 + a0[k + 1] * q1 + a0[k + 2] * q2 + a0[k + 3] * q3;
+        sum1 += a1[k] * q0 + a1[k + 1] * q1 + a1[k + 2] * q2 + a1[k + 3] * q3;
+        sum2 += a2[k] * q0 + a2[k + 1] * q1 + a2[k + 2] * q2 + a2[k + 3] * q3;
+        sum3 += a3[k] * q0 + a3[k + 1] * q1 + a3[k + 2] * q2 + a3[k + 3] * q3;
+    }
+    for (; k != n; b += b_stride, ++k) {
+        dReal q = *b;
+        sum0 += a0[k] * q;
+        sum1 += a1[k] * q;
+        sum2 += a2[k] * q;
+        sum3 += a3[k] * q;
+    }
+    sums[0] = sum0;
+    sums[1] = sum1;
+    sums[2] = sum2;
+    sums[3] = sum3;
+}
+
 
 #endif
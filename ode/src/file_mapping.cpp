@@ -0,0 +1,141 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+// Read-only memory mapping of a whole file.
+
+#include <ode/common.h>
+#include "config.h"
+#include "file_mapping.h"
+
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+dxFileMapping::dxFileMapping():
+    m_data(NULL),
+    m_size(0)
+#if defined(_WIN32)
+    , m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(NULL)
+#endif
+{
+}
+
+void dxFileMapping::Swap(dxFileMapping &other)
+{
+    dxSwap(m_data, other.m_data);
+    dxSwap(m_size, other.m_size);
+#if defined(_WIN32)
+    dxSwap(m_fileHandle, other.m_fileHandle);
+    dxSwap(m_mappingHandle, other.m_mappingHandle);
+#endif
+}
+
+#if defined(_WIN32)
+
+bool dxFileMapping::Open(const char *fileName)
+{
+    Close();
+
+    HANDLE fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    HANDLE mappingHandle = NULL;
+    const void *data = NULL;
+    if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart != 0 && (ULONGLONG)fileSize.QuadPart <= (ULONGLONG)(~(sizeint)0)
+        && (mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL) {
+        data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (data == NULL) {
+        if (mappingHandle != NULL) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    m_data = data;
+    m_size = (sizeint)fileSize.QuadPart;
+    m_fileHandle = fileHandle;
+    m_mappingHandle = mappingHandle;
+    return true;
+}
+
+void dxFileMapping::Close()
+{
+    if (m_data != NULL) {
+        UnmapViewOfFile(m_data);
+        CloseHandle((HANDLE)m_mappingHandle);
+        CloseHandle((HANDLE)m_fileHandle);
+        m_data = NULL;
+        m_size = 0;
+        m_fileHandle = INVALID_HANDLE_VALUE;
+        m_mappingHandle = NULL;
+    }
+}
+
+#else // #if !defined(_WIN32)
+
+bool dxFileMapping::Open(const char *fileName)
+{
+    Close();
+
+    int fileDescriptor = open(fileName, O_RDONLY);
+    if (fileDescriptor == -1) {
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    struct stat fileStatus;
+    void *data = MAP_FAILED;
+    if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size != 0 && (duint64)fileStatus.st_size <= (duint64)(~(sizeint)0)) {
+        data = mmap(NULL, (sizeint)fileStatus.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    }
+    close(fileDescriptor);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    m_data = data;
+    m_size = (sizeint)fileStatus.st_size;
+    return true;
+}
+
+void dxFileMapping::Close()
+{
+    if (m_data != NULL) {
+        munmap((void *)m_data, m_size);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+#endif // #if !defined(_WIN32)
@@ -0,0 +1,65 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+ * Read-only memory mapping of a whole file.
+ *
+ * The pages are brought in by the system on the first access and may be
+ * dropped again under memory pressure, so large data files can be used
+ * without reading them up front.
+ */
+
+#ifndef _ODE_FILE_MAPPING_H_
+#define _ODE_FILE_MAPPING_H_
+
+#include <ode/common.h>
+#include "common.h"
+
+
+class dxFileMapping
+{
+public:
+    dxFileMapping();
+    ~dxFileMapping() { Close(); }
+
+    // Maps the file, replacing any previous mapping; returns false on failure
+    bool Open(const char *fileName);
+    void Close();
+    // Exchanges the mappings, e.g. to replace a mapping in use only after the new one has been validated
+    void Swap(dxFileMapping &other);
+
+    bool IsOpen() const { return m_data != NULL; }
+    const void *GetData() const { return m_data; }
+    sizeint GetSize() const { return m_size; }
+
+private:
+    const void      *m_data;
+    sizeint         m_size;
+#if defined(_WIN32)
+    void            *m_fileHandle;
+    void            *m_mappingHandle;
+#endif
+};
+
+
+#endif // #ifndef _ODE_FILE_MAPPING_H_
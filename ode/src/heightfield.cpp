@@ -91,6 +91,211 @@
 // #define _HEIGHTFIELDEDGECOLLIDING
 
 
+//////// dxHeightfieldTiles /////////////////////////////////////////////////////////////
+
+dxHeightfieldTiles::dxHeightfieldTiles( int nTileSamples, int nWidthSamples, int nDepthSamples ):
+    m_nTileSamples( nTileSamples ),
+    m_nTilesX( ( nWidthSamples + nTileSamples - 1 ) / nTileSamples ),
+    m_nTilesZ( ( nDepthSamples + nTileSamples - 1 ) / nTileSamples ),
+
+    m_pGetTileCallback( NULL ),
+    m_pUserData( NULL ),
+
+    m_nMaxCachedTiles( 0 ),
+    m_nCachedTiles( 0 ),
+    m_pCacheHeights( NULL ),
+    m_pTileSlots( NULL ),
+    m_pSlotTiles( NULL ),
+    m_pSlotPrev( NULL ),
+    m_pSlotNext( NULL ),
+    m_pSlotPins( NULL ),
+    m_nMostRecentSlot( -1 ),
+    m_nLeastRecentSlot( -1 ),
+    m_nCacheLock( 0 ),
+
+    m_pFileHeights( NULL )
+{
+    dIASSERT( nTileSamples > 0 );
+}
+
+dxHeightfieldTiles::~dxHeightfieldTiles()
+{
+    delete [] m_pCacheHeights;
+    delete [] m_pTileSlots;
+    delete [] m_pSlotTiles;
+    delete [] m_pSlotPrev;
+    delete [] m_pSlotNext;
+    delete [] m_pSlotPins;
+}
+
+void dxHeightfieldTiles::SetCallback( void* pUserData, dHeightfieldGetTile* pCallback, int nMaxCachedTiles )
+{
+    dIASSERT( nMaxCachedTiles > 0 );
+
+    m_pGetTileCallback = pCallback;
+    m_pUserData = pUserData;
+
+    // no more slots than tiles
+    const int nTileCount = m_nTilesX * m_nTilesZ;
+    m_nMaxCachedTiles = dMIN( nMaxCachedTiles, nTileCount );
+    m_pCacheHeights = new dReal[ (sizeint)m_nMaxCachedTiles * m_nTileSamples * m_nTileSamples ];
+    m_pTileSlots = new int[ nTileCount ];
+    m_pSlotTiles = new int[ m_nMaxCachedTiles ];
+    m_pSlotPrev = new int[ m_nMaxCachedTiles ];
+    m_pSlotNext = new int[ m_nMaxCachedTiles ];
+    m_pSlotPins = new int[ m_nMaxCachedTiles ];
+
+    for ( int i = 0; i != nTileCount; i++ )
+        m_pTileSlots[i] = -1;
+    for ( int i = 0; i != m_nMaxCachedTiles; i++ )
+        m_pSlotPins[i] = 0;
+}
+
+bool dxHeightfieldTiles::OpenFile( const char* fileName )
+{
+    const sizeint nRequiredSize = (sizeint)m_nTilesX * m_nTilesZ * m_nTileSamples * m_nTileSamples * sizeof( float );
+    if ( !m_FileMapping.Open( fileName ) )
+        return false;
+
+    if ( m_FileMapping.GetSize() < nRequiredSize )
+    {
+        m_FileMapping.Close();
+        return false;
+    }
+
+    m_pFileHeights = (const float*)m_FileMapping.GetData();
+    return true;
+}
+
+// the cache is only locked while the cursors move between the tiles
+void dxHeightfieldTiles::LockCache()
+{
+    while ( !ThrsafeCompareExchange( &m_nCacheLock, 0, 1 ) )
+    {
+    }
+}
+
+void dxHeightfieldTiles::UnlockCache()
+{
+    ThrsafeExchange( &m_nCacheLock, 0 );
+}
+
+void dxHeightfieldTiles::UnlinkSlot( int nSlot )
+{
+    const int nPrev = m_pSlotPrev[nSlot], nNext = m_pSlotNext[nSlot];
+    if ( nPrev != -1 ) m_pSlotNext[nPrev] = nNext;
+    else m_nMostRecentSlot = nNext;
+    if ( nNext != -1 ) m_pSlotPrev[nNext] = nPrev;
+    else m_nLeastRecentSlot = nPrev;
+}
+
+// moves the cursor to a tile, loading it into the least recently used unpinned cache slot if necessary
+void dxHeightfieldTiles::AcquireTile( int nTile, dxHeightfieldTileCursor &cursor )
+{
+    LockCache();
+
+    if ( cursor.m_nSlot != -1 )
+        m_pSlotPins[cursor.m_nSlot]--;
+
+    int nSlot = m_pTileSlots[nTile];
+
+    if ( nSlot == -1 )
+    {
+        if ( m_nCachedTiles != m_nMaxCachedTiles )
+        {
+            nSlot = m_nCachedTiles++;
+        }
+        else
+        {
+            nSlot = m_nLeastRecentSlot;
+            while ( nSlot != -1 && m_pSlotPins[nSlot] != 0 )
+                nSlot = m_pSlotPrev[nSlot];
+
+            if ( nSlot == -1 )
+            {
+                // all the tiles cached are being read, the cursor gets a copy of its own
+                if ( cursor.m_pOwnHeights == NULL )
+                    cursor.m_pOwnHeights = new dReal[ (sizeint)m_nTileSamples * m_nTileSamples ];
+                m_pGetTileCallback( m_pUserData, nTile % m_nTilesX, nTile / m_nTilesX, cursor.m_pOwnHeights );
+
+                cursor.m_nTile = nTile;
+                cursor.m_nSlot = -1;
+                cursor.m_pHeights = cursor.m_pOwnHeights;
+                UnlockCache();
+                return;
+            }
+
+            m_pTileSlots[ m_pSlotTiles[nSlot] ] = -1;
+            UnlinkSlot( nSlot );
+        }
+
+        m_pTileSlots[nTile] = nSlot;
+        m_pSlotTiles[nSlot] = nTile;
+        m_pGetTileCallback( m_pUserData, nTile % m_nTilesX, nTile / m_nTilesX,
+            m_pCacheHeights + (sizeint)nSlot * m_nTileSamples * m_nTileSamples );
+    }
+    else if ( nSlot != m_nMostRecentSlot )
+    {
+        UnlinkSlot( nSlot );
+    }
+
+    // put the slot at the head of the list
+    if ( nSlot != m_nMostRecentSlot )
+    {
+        m_pSlotPrev[nSlot] = -1;
+        m_pSlotNext[nSlot] = m_nMostRecentSlot;
+        if ( m_nMostRecentSlot != -1 ) m_pSlotPrev[m_nMostRecentSlot] = nSlot;
+        else m_nLeastRecentSlot = nSlot;
+        m_nMostRecentSlot = nSlot;
+    }
+
+    m_pSlotPins[nSlot]++;
+    cursor.m_nTile = nTile;
+    cursor.m_nSlot = nSlot;
+    cursor.m_pHeights = m_pCacheHeights + (sizeint)nSlot * m_nTileSamples * m_nTileSamples;
+
+    UnlockCache();
+}
+
+// unpins the tile read by the cursor
+void dxHeightfieldTiles::ReleaseCursor( dxHeightfieldTileCursor &cursor )
+{
+    if ( cursor.m_nSlot != -1 )
+    {
+        LockCache();
+        m_pSlotPins[cursor.m_nSlot]--;
+        UnlockCache();
+    }
+
+    delete [] cursor.m_pOwnHeights;
+    cursor.m_nTile = -1;
+    cursor.m_nSlot = -1;
+    cursor.m_pHeights = NULL;
+    cursor.m_pOwnHeights = NULL;
+}
+
+// returns the raw sample at the given sample coordinates within the grid
+dReal dxHeightfieldTiles::GetSample( int x, int z, dxHeightfieldTileCursor &cursor )
+{
+    const int nTileX = x / m_nTileSamples;
+    const int nTileZ = z / m_nTileSamples;
+    const int nTile = nTileZ * m_nTilesX + nTileX;
+    const int nTileSample = ( z - nTileZ * m_nTileSamples ) * m_nTileSamples + ( x - nTileX * m_nTileSamples );
+
+    if ( m_pFileHeights != NULL )
+    {
+        return (dReal)m_pFileHeights[ (sizeint)nTile * m_nTileSamples * m_nTileSamples + nTileSample ];
+    }
+
+    // the zone collider reads the samples along Z so they mostly come from the tile the cursor is at
+    if ( nTile != cursor.m_nTile )
+    {
+        AcquireTile( nTile, cursor );
+    }
+    return cursor.m_pHeights[nTileSample];
+}
+
+
 //////// dxHeightfieldData /////////////////////////////////////////////////////////////
 
 // dxHeightfieldData constructor
@@ -120,10 +325,13 @@ dxHeightfieldData::dxHeightfieldData():
 
     m_pHeightData( NULL ),
     m_pUserData( NULL ),
+    m_pTiles( NULL ),
 
-    m_pGetHeightCallback( NULL )
+    m_pGetHeightCallback( NULL ),
+
+    m_pHeightBounds( NULL ),
+    m_nHeightBoundsLevels( 0 )
 {
-    memset( m_contacts, 0, sizeof( m_contacts ) );
 }
 
 // build Heightfield data
@@ -184,6 +392,8 @@ void dxHeightfieldData::ComputeHeightBounds()
 
         // callback
     case 0:
+        // tiles
+    case 5:
         // change nothing, keep using default or user specified bounds
         return;
 
@@ -257,6 +467,267 @@ void dxHeightfieldData::ComputeHeightBounds()
 
     // add thickness
     m_fMinHeight -= m_fThickness;
+
+    BuildHeightBoundsPyramid();
+}
+
+
+// builds the min/max height pyramid from the samples
+void dxHeightfieldData::BuildHeightBoundsPyramid()
+{
+    FreeHeightBoundsPyramid();
+
+    const int nCellsX = m_nWidthSamples - 1;
+    const int nCellsZ = m_nDepthSamples - 1;
+
+    int nWidth = ( nCellsX + ( HEIGHTFIELDBOUNDSBLOCKCELLS - 1 ) ) / HEIGHTFIELDBOUNDSBLOCKCELLS;
+    int nDepth = ( nCellsZ + ( HEIGHTFIELDBOUNDSBLOCKCELLS - 1 ) ) / HEIGHTFIELDBOUNDSBLOCKCELLS;
+    int nTotal = 0;
+    int nLevels = 0;
+    while ( true )
+    {
+        dIASSERT( nLevels < HEIGHTFIELDBOUNDSMAXLEVELS );
+        m_nHeightBoundsOffset[nLevels] = nTotal;
+        m_nHeightBoundsWidth[nLevels] = nWidth;
+        m_nHeightBoundsDepth[nLevels] = nDepth;
+        nTotal += nWidth * nDepth;
+        ++nLevels;
+
+        if ( nWidth == 1 && nDepth == 1 )
+            break;
+
+        nWidth = ( nWidth + 1 ) / 2;
+        nDepth = ( nDepth + 1 ) / 2;
+    }
+
+    m_pHeightBounds = new dReal[ 2 * nTotal ];
+    m_nHeightBoundsLevels = nLevels;
+
+    // finest level from the samples of the block cells
+    dReal *pBounds = m_pHeightBounds;
+    for ( int bz = 0; bz != m_nHeightBoundsDepth[0]; bz++ )
+    {
+        const int nMinZ = bz * HEIGHTFIELDBOUNDSBLOCKCELLS;
+        const int nMaxZ = dMIN( nMinZ + HEIGHTFIELDBOUNDSBLOCKCELLS, nCellsZ );
+        for ( int bx = 0; bx != m_nHeightBoundsWidth[0]; bx++, pBounds += 2 )
+        {
+            const int nMinX = bx * HEIGHTFIELDBOUNDSBLOCKCELLS;
+            const int nMaxX = dMIN( nMinX + HEIGHTFIELDBOUNDSBLOCKCELLS, nCellsX );
+
+            dReal fMin = dInfinity, fMax = -dInfinity;
+            for ( int z = nMinZ; z <= nMaxZ; z++ )
+            {
+                for ( int x = nMinX; x <= nMaxX; x++ )
+                {
+                    const dReal h = GetHeight( x, z );
+                    fMin = dMIN( fMin, h );
+                    fMax = dMAX( fMax, h );
+                }
+            }
+            pBounds[0] = fMin;
+            pBounds[1] = fMax;
+        }
+    }
+
+    // coarser levels from 2 x 2 blocks of the previous ones
+    for ( int nLevel = 1; nLevel != nLevels; nLevel++ )
+    {
+        const dReal *pFiner = m_pHeightBounds + 2 * m_nHeightBoundsOffset[nLevel - 1];
+        const int nFinerWidth = m_nHeightBoundsWidth[nLevel - 1];
+        const int nFinerDepth = m_nHeightBoundsDepth[nLevel - 1];
+        for ( int bz = 0; bz != m_nHeightBoundsDepth[nLevel]; bz++ )
+        {
+            for ( int bx = 0; bx != m_nHeightBoundsWidth[nLevel]; bx++, pBounds += 2 )
+            {
+                dReal fMin = dInfinity, fMax = -dInfinity;
+                for ( int cz = 2 * bz; cz != 2 * bz + 2 && cz != nFinerDepth; cz++ )
+                {
+                    for ( int cx = 2 * bx; cx != 2 * bx + 2 && cx != nFinerWidth; cx++ )
+                    {
+                        const dReal *pChild = pFiner + 2 * ( cz * nFinerWidth + cx );
+                        fMin = dMIN( fMin, pChild[0] );
+                        fMax = dMAX( fMax, pChild[1] );
+                    }
+                }
+                pBounds[0] = fMin;
+                pBounds[1] = fMax;
+            }
+        }
+    }
+}
+
+
+void dxHeightfieldData::FreeHeightBoundsPyramid()
+{
+    delete [] m_pHeightBounds;
+    m_pHeightBounds = NULL;
+    m_nHeightBoundsLevels = 0;
+}
+
+
+// splits a cell range into the ranges within the grid; returns the range count
+static int SplitHeightfieldCellRange( int nMin, int nMax, int nCells, bool bWrap, int *pRanges )
+{
+    if ( !bWrap )
+    {
+        nMin = dMAX( nMin, 0 );
+        nMax = dMIN( nMax, nCells );
+        if ( nMin >= nMax )
+            return 0;
+
+        pRanges[0] = nMin; pRanges[1] = nMax;
+        return 1;
+    }
+
+    if ( nMax - nMin >= nCells )
+    {
+        pRanges[0] = 0; pRanges[1] = nCells;
+        return 1;
+    }
+
+    int nStart = nMin % nCells;
+    if ( nStart < 0 ) nStart += nCells;
+    const int nEnd = nStart + ( nMax - nMin );
+    if ( nEnd <= nCells )
+    {
+        pRanges[0] = nStart; pRanges[1] = nEnd;
+        return 1;
+    }
+
+    pRanges[0] = nStart; pRanges[1] = nCells;
+    pRanges[2] = 0; pRanges[3] = nEnd - nCells;
+    return 2;
+}
+
+// merges the bounds of the pyramid blocks overlapping the cell range (grid coordinates)
+static void MergeHeightBoundsBlock( const dxHeightfieldData *d, int nLevel, int bx, int bz,
+                                   int nMinX, int nMaxX, int nMinZ, int nMaxZ, dReal &fMin, dReal &fMax )
+{
+    const int nBlockCells = HEIGHTFIELDBOUNDSBLOCKCELLS << nLevel;
+    const int nBlockMinX = bx * nBlockCells;
+    const int nBlockMaxX = dMIN( nBlockMinX + nBlockCells, d->m_nWidthSamples - 1 );
+    const int nBlockMinZ = bz * nBlockCells;
+    const int nBlockMaxZ = dMIN( nBlockMinZ + nBlockCells, d->m_nDepthSamples - 1 );
+
+    if ( nBlockMinX >= nMaxX || nBlockMaxX <= nMinX || nBlockMinZ >= nMaxZ || nBlockMaxZ <= nMinZ )
+        return;
+
+    if ( nLevel == 0 || ( nBlockMinX >= nMinX && nBlockMaxX <= nMaxX && nBlockMinZ >= nMinZ && nBlockMaxZ <= nMaxZ ) )
+    {
+        const dReal *pBounds = d->m_pHeightBounds + 2 * ( d->m_nHeightBoundsOffset[nLevel] + bz * d->m_nHeightBoundsWidth[nLevel] + bx );
+        fMin = dMIN( fMin, pBounds[0] );
+        fMax = dMAX( fMax, pBounds[1] );
+        return;
+    }
+
+    const int nFinerWidth = d->m_nHeightBoundsWidth[nLevel - 1];
+    const int nFinerDepth = d->m_nHeightBoundsDepth[nLevel - 1];
+    for ( int cz = 2 * bz; cz != 2 * bz + 2 && cz != nFinerDepth; cz++ )
+    {
+        for ( int cx = 2 * bx; cx != 2 * bx + 2 && cx != nFinerWidth; cx++ )
+        {
+            MergeHeightBoundsBlock( d, nLevel - 1, cx, cz, nMinX, nMaxX, nMinZ, nMaxZ, fMin, fMax );
+        }
+    }
+}
+
+// returns conservative height bounds of the cells [nMinX, nMaxX) x [nMinZ, nMaxZ)
+void dxHeightfieldData::GetCellRangeHeightBounds( int nMinX, int nMaxX, int nMinZ, int nMaxZ,
+                                                 dReal &fMinHeight, dReal &fMaxHeight ) const
+{
+    dIASSERT( HasHeightBoundsPyramid() );
+
+    int aRangesX[4], aRangesZ[4];
+    const int nRangesX = SplitHeightfieldCellRange( nMinX, nMaxX, m_nWidthSamples - 1, m_bWrapMode != 0, aRangesX );
+    const int nRangesZ = SplitHeightfieldCellRange( nMinZ, nMaxZ, m_nDepthSamples - 1, m_bWrapMode != 0, aRangesZ );
+
+    fMinHeight = dInfinity;
+    fMaxHeight = -dInfinity;
+    for ( int i = 0; i != nRangesX; i++ )
+    {
+        for ( int j = 0; j != nRangesZ; j++ )
+        {
+            MergeHeightBoundsBlock( this, m_nHeightBoundsLevels - 1, 0, 0,
+                aRangesX[2 * i], aRangesX[2 * i + 1], aRangesZ[2 * j], aRangesZ[2 * j + 1], fMinHeight, fMaxHeight );
+        }
+    }
+}
+
+// cell counts from a cell to the end of its finest pyramid block and from the block start to the cell
+static inline int CellsToHeightBoundsBlockEnd( int nCell, int nCells, bool bWrap )
+{
+    int nLocal = bWrap ? nCell % nCells : nCell;
+    if ( nLocal < 0 ) nLocal += nCells;
+    return dMIN( HEIGHTFIELDBOUNDSBLOCKCELLS - nLocal % HEIGHTFIELDBOUNDSBLOCKCELLS, nCells - nLocal );
+}
+
+static inline int CellsFromHeightBoundsBlockStart( int nCell, int nCells, bool bWrap )
+{
+    int nLocal = bWrap ? nCell % nCells : nCell;
+    if ( nLocal < 0 ) nLocal += nCells;
+    return nLocal % HEIGHTFIELDBOUNDSBLOCKCELLS + 1;
+}
+
+// Shrinks the zone of samples [nMinX, nMaxX] x [nMinZ, nMaxZ] by the edge cell strips that are
+// lower than the geom bottom by more than dEpsilon (such cells give no triangles in dCollideHeightfieldZone).
+// Returns false if the whole zone is under the geom bottom and no contacts are possible.
+bool dxHeightfieldData::TrimZoneByHeightBounds( int &nMinX, int &nMaxX, int &nMinZ, int &nMaxZ,
+                                               dReal fMinO2Height, bool &bTrimmed ) const
+{
+    dReal fMin, fMax;
+    GetCellRangeHeightBounds( nMinX, nMaxX, nMinZ, nMaxZ, fMin, fMax );
+
+    // the same test as the "totally above heightfield" one of dCollideHeightfieldZone
+    if ( fMinO2Height - fMax > -dEpsilon )
+        return false;
+
+    const dReal fTrimHeight = fMinO2Height - dEpsilon;
+    const int nCellsX = m_nWidthSamples - 1;
+    const int nCellsZ = m_nDepthSamples - 1;
+    const bool bWrap = m_bWrapMode != 0;
+    bTrimmed = false;
+
+    while ( nMaxX - nMinX > 1 )
+    {
+        const int nStrip = dMIN( CellsToHeightBoundsBlockEnd( nMinX, nCellsX, bWrap ), nMaxX - nMinX - 1 );
+        GetCellRangeHeightBounds( nMinX, nMinX + nStrip, nMinZ, nMaxZ, fMin, fMax );
+        if ( !( fMax <= fTrimHeight ) )
+            break;
+        nMinX += nStrip;
+        bTrimmed = true;
+    }
+
+    while ( nMaxX - nMinX > 1 )
+    {
+        const int nStrip = dMIN( CellsFromHeightBoundsBlockStart( nMaxX - 1, nCellsX, bWrap ), nMaxX - nMinX - 1 );
+        GetCellRangeHeightBounds( nMaxX - nStrip, nMaxX, nMinZ, nMaxZ, fMin, fMax );
+        if ( !( fMax <= fTrimHeight ) )
+            break;
+        nMaxX -= nStrip;
+        bTrimmed = true;
+    }
+
+    while ( nMaxZ - nMinZ > 1 )
+    {
+        const int nStrip = dMIN( CellsToHeightBoundsBlockEnd( nMinZ, nCellsZ, bWrap ), nMaxZ - nMinZ - 1 );
+        GetCellRangeHeightBounds( nMinX, nMaxX, nMinZ, nMinZ + nStrip, fMin, fMax );
+        if ( !( fMax <= fTrimHeight ) )
+            break;
+        nMinZ += nStrip;
+        bTrimmed = true;
+    }
+
+    while ( nMaxZ - nMinZ > 1 )
+    {
+        const int nStrip = dMIN( CellsFromHeightBoundsBlockStart( nMaxZ - 1, nCellsZ, bWrap ), nMaxZ - nMinZ - 1 );
+        GetCellRangeHeightBounds( nMinX, nMaxX, nMaxZ - nStrip, nMaxZ, fMin, fMax );
+        if ( !( fMax <= fTrimHeight ) )
+            break;
+        nMaxZ -= nStrip;
+        bTrimmed = true;
+    }
+
+    return true;
 }
 
 
@@ -323,6 +794,13 @@ bool dxHeightfieldData::IsOnHeightfield2 ( const HeightFieldVertex * const CellC
 
 // returns height at given sample coordinates
 dReal dxHeightfieldData::GetHeight( int x, int z )
+{
+    dxHeightfieldTileCursor cursor( m_pTiles );
+    return GetHeight( x, z, cursor );
+}
+
+// returns height at given sample coordinates reading the tiles through the cursor
+dReal dxHeightfieldData::GetHeight( int x, int z, dxHeightfieldTileCursor &cursor )
 {
     dReal h=0;
     unsigned char *data_byte;
@@ -378,6 +856,11 @@ dReal dxHeightfieldData::GetHeight( int x, int z )
         data_double = (double*)m_pHeightData;
         h = (dReal)( data_double[x+(z * m_nWidthSamples)] );
         break;
+
+        // tiles
+    case 5:
+        h = m_pTiles->GetSample(x, z, cursor);
+        break;
     }
 
     return (h * m_fScale) + m_fOffset;
@@ -400,20 +883,21 @@ dReal dxHeightfieldData::GetHeight( dReal x, dReal z )
     //dIASSERT( ( dz + dEpsilon >= 0.0f ) && ( dz - dEpsilon <= 1.0f ) );
 
     dReal y, y0;
+    dxHeightfieldTileCursor cursor( m_pTiles );
 
     if ( dx + dz <= REAL( 1.0 ) ) // Use <= comparison to prefer simpler branch
     {
-        y0 = GetHeight( nX, nZ );
+        y0 = GetHeight( nX, nZ, cursor );
 
-        y = y0 + ( GetHeight( nX + 1, nZ ) - y0 ) * dx
-            + ( GetHeight( nX, nZ + 1 ) - y0 ) * dz;
+        y = y0 + ( GetHeight( nX + 1, nZ, cursor ) - y0 ) * dx
+            + ( GetHeight( nX, nZ + 1, cursor ) - y0 ) * dz;
     }
     else
     {
-        y0 = GetHeight( nX + 1, nZ + 1 );
+        y0 = GetHeight( nX + 1, nZ + 1, cursor );
 
-        y = y0	+ ( GetHeight( nX + 1, nZ ) - y0 ) * ( REAL(1.0) - dz ) +
-            ( GetHeight( nX, nZ + 1 ) - y0 ) * ( REAL(1.0) - dx );
+        y = y0	+ ( GetHeight( nX + 1, nZ, cursor ) - y0 ) * ( REAL(1.0) - dz ) +
+            ( GetHeight( nX, nZ + 1, cursor ) - y0 ) * ( REAL(1.0) - dx );
     }
 
     return y;
@@ -428,6 +912,9 @@ dxHeightfieldData::~dxHeightfieldData()
     float *data_float;
     double *data_double;
 
+    FreeHeightBoundsPyramid();
+    delete m_pTiles;
+
     if ( m_bCopyHeightData )
     {
         switch ( m_nGetHeightMode )
@@ -478,19 +965,15 @@ dxHeightfieldData::~dxHeightfieldData()
 dxHeightfield::dxHeightfield( dSpaceID space,
                              dHeightfieldDataID data,
                              int bPlaceable )			:
-    dxGeom( space, bPlaceable ),
-    tempPlaneBuffer(0),
-    tempPlaneInstances(0),
-    tempPlaneBufferSize(0),
-    tempTriangleBuffer(0),
-    tempTriangleBufferSize(0),
-    tempHeightBuffer(0),
-    tempHeightInstances(0),
-    tempHeightBufferSizeX(0),
-    tempHeightBufferSizeZ(0)
+    dxGeom( space, bPlaceable )
 {
     type = dHeightfieldClass;
     this->m_p_data = data;
+
+    for (int i = 0; i != TEMP_BUFFERS_CACHE_SIZE; ++i)
+    {
+        tempBuffersCache[i] = 0;
+    }
 }
 
 
@@ -626,24 +1109,60 @@ void dxHeightfield::computeAABB()
 // dxHeightfield destructor
 dxHeightfield::~dxHeightfield()
 {
-    resetTriangleBuffer();
-    resetPlaneBuffer();
-    resetHeightBuffer();
+    // No collisions may be running at this time, hence the cache may be read directly.
+    for (int i = 0; i != TEMP_BUFFERS_CACHE_SIZE; ++i)
+    {
+        delete (HeightFieldTempBuffers *)tempBuffersCache[i];
+    }
+}
+
+// take a free set of scratch buffers from the cache or allocate a new one
+HeightFieldTempBuffers *dxHeightfield::acquireTempBuffers()
+{
+    for (int i = 0; i != TEMP_BUFFERS_CACHE_SIZE; ++i)
+    {
+        if (tempBuffersCache[i] != 0)
+        {
+            HeightFieldTempBuffers *buffers = (HeightFieldTempBuffers *)ThrsafeExchangePointer(&tempBuffersCache[i], 0);
+
+            if (buffers != NULL)
+            {
+                return buffers;
+            }
+        }
+    }
+
+    return new HeightFieldTempBuffers();
 }
 
-void dxHeightfield::allocateTriangleBuffer(sizeint numTri)
+// return the buffers to an empty cache slot or free them if the cache is full
+void dxHeightfield::releaseTempBuffers(HeightFieldTempBuffers *buffers)
+{
+    for (int i = 0; i != TEMP_BUFFERS_CACHE_SIZE; ++i)
+    {
+        if (tempBuffersCache[i] == 0 
+            && ThrsafeCompareExchangePointer(&tempBuffersCache[i], 0, (atomicptr)buffers))
+        {
+            return;
+        }
+    }
+
+    delete buffers;
+}
+
+void HeightFieldTempBuffers::allocateTriangleBuffer(sizeint numTri)
 {
     sizeint alignedNumTri = AlignBufferSize(numTri, TEMP_TRIANGLE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
     tempTriangleBufferSize = alignedNumTri;
     tempTriangleBuffer = new HeightFieldTriangle[alignedNumTri];
 }
 
-void dxHeightfield::resetTriangleBuffer()
+void HeightFieldTempBuffers::resetTriangleBuffer()
 {
     delete[] tempTriangleBuffer;
 }
 
-void dxHeightfield::allocatePlaneBuffer(sizeint numTri)
+void HeightFieldTempBuffers::allocatePlaneBuffer(sizeint numTri)
 {
     sizeint alignedNumTri = AlignBufferSize(numTri, TEMP_PLANE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
     tempPlaneBufferSize = alignedNumTri;
@@ -658,13 +1177,13 @@ void dxHeightfield::allocatePlaneBuffer(sizeint numTri)
     }
 }
 
-void dxHeightfield::resetPlaneBuffer()
+void HeightFieldTempBuffers::resetPlaneBuffer()
 {
     delete[] tempPlaneInstances;
     delete[] tempPlaneBuffer;
 }
 
-void dxHeightfield::allocateHeightBuffer(sizeint numX, sizeint numZ)
+void HeightFieldTempBuffers::allocateHeightBuffer(sizeint numX, sizeint numZ)
 {
     sizeint alignedNumX = AlignBufferSize(numX, TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_X);
     sizeint alignedNumZ = AlignBufferSize(numZ, TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_Z);
@@ -682,7 +1201,7 @@ void dxHeightfield::allocateHeightBuffer(sizeint numX, sizeint numZ)
     }
 }
 
-void dxHeightfield::resetHeightBuffer()
+void HeightFieldTempBuffers::resetHeightBuffer()
 {
     delete[] tempHeightInstances;
     delete[] tempHeightBuffer;
@@ -709,6 +1228,7 @@ void dGeomHeightfieldDataBuildCallback( dHeightfieldDataID d,
     // callback
     d->m_nGetHeightMode = 0;
     d->m_pUserData = pUserData;
+    d->FreeHeightBoundsPyramid();
     d->m_pGetHeightCallback = pCallback;
 
     // set info
@@ -720,6 +1240,69 @@ void dGeomHeightfieldDataBuildCallback( dHeightfieldDataID d,
 }
 
 
+void dGeomHeightfieldDataBuildTiled( dHeightfieldDataID d,
+                                    void* pUserData, dHeightfieldGetTile* pTileCallback,
+                                    int tileSamples, int maxCachedTiles,
+                                    dReal width, dReal depth, int widthSamples, int depthSamples,
+                                    dReal scale, dReal offset, dReal thickness, int bWrap )
+{
+    dUASSERT( d, "argument not Heightfield data" );
+    dIASSERT( pTileCallback );
+    dIASSERT( tileSamples >= 1 );
+    dIASSERT( maxCachedTiles >= 1 );
+    dIASSERT( widthSamples >= 2 );	// Ensure we're making something with at least one cell.
+    dIASSERT( depthSamples >= 2 );
+
+    // tiles
+    dxHeightfieldTiles *tiles = new dxHeightfieldTiles( tileSamples, widthSamples, depthSamples );
+    tiles->SetCallback( pUserData, pTileCallback, maxCachedTiles );
+    delete d->m_pTiles;
+    d->m_pTiles = tiles;
+    d->m_nGetHeightMode = 5;
+    d->FreeHeightBoundsPyramid();
+
+    // set info
+    d->SetData( widthSamples, depthSamples, width, depth, scale, offset, thickness, bWrap );
+
+    // default bounds
+    d->m_fMinHeight = -dInfinity;
+    d->m_fMaxHeight = dInfinity;
+}
+
+
+int dGeomHeightfieldDataBuildTiledFile( dHeightfieldDataID d,
+                                       const char* fileName, int tileSamples,
+                                       dReal width, dReal depth, int widthSamples, int depthSamples,
+                                       dReal scale, dReal offset, dReal thickness, int bWrap )
+{
+    dUASSERT( d, "argument not Heightfield data" );
+    dIASSERT( fileName );
+    dIASSERT( tileSamples >= 1 );
+    dIASSERT( widthSamples >= 2 );	// Ensure we're making something with at least one cell.
+    dIASSERT( depthSamples >= 2 );
+
+    // tiles
+    dxHeightfieldTiles *tiles = new dxHeightfieldTiles( tileSamples, widthSamples, depthSamples );
+    if ( !tiles->OpenFile( fileName ) )
+    {
+        delete tiles;
+        return 0;
+    }
+    delete d->m_pTiles;
+    d->m_pTiles = tiles;
+    d->m_nGetHeightMode = 5;
+    d->FreeHeightBoundsPyramid();
+
+    // set info
+    d->SetData( widthSamples, depthSamples, width, depth, scale, offset, thickness, bWrap );
+
+    // default bounds
+    d->m_fMinHeight = -dInfinity;
+    d->m_fMaxHeight = dInfinity;
+    return 1;
+}
+
+
 void dGeomHeightfieldDataBuildByte( dHeightfieldDataID d,
                                    const unsigned char *pHeightData, int bCopyHeightData,
                                    dReal width, dReal depth, int widthSamples, int depthSamples,
@@ -870,6 +1453,9 @@ void dGeomHeightfieldDataSetBounds( dHeightfieldDataID d, dReal minHeight, dReal
     dUASSERT(d, "Argument not Heightfield data");
     d->m_fMinHeight = ( minHeight * d->m_fScale ) + d->m_fOffset - d->m_fThickness;
     d->m_fMaxHeight = ( maxHeight * d->m_fScale ) + d->m_fOffset;
+
+    // the samples may have been changed
+    d->FreeHeightBoundsPyramid();
 }
 
 
@@ -930,7 +1516,7 @@ static inline bool DescendingPlaneSort(const HeightFieldPlane * const A, const H
     return ((A->maxAAAB - B->maxAAAB) > dEpsilon);
 }
 
-void dxHeightfield::sortPlanes(const sizeint numPlanes)
+void HeightFieldTempBuffers::sortPlanes(const sizeint numPlanes)
 {
     bool has_swapped = true;
     do
@@ -970,10 +1556,128 @@ static inline dReal DistancePointToLine(const dVector3 &_point,
 }
 
 
+HeightFieldGeomFrame::HeightFieldGeomFrame(const dxHeightfield *terrain, dxGeom *o2)
+{
+    rotated = (terrain->gflags & GEOM_PLACEABLE) != 0;
+    pos = rotated ? terrain->final_posr->pos : NULL;
+    R = rotated ? terrain->final_posr->R : NULL;
+
+#ifndef DHEIGHTFIELD_CORNER_ORIGIN
+    originX = terrain->m_p_data->m_fHalfWidth;
+    originZ = terrain->m_p_data->m_fHalfDepth;
+    identity = false;
+#else
+    originX = 0;
+    originZ = 0;
+    identity = !rotated;
+#endif // DHEIGHTFIELD_CORNER_ORIGIN
+
+    // The AABB is only recomputed for the geoms moved since the last space collision
+    o2->recomputeAABB();
+    pointToHeightfield(o2Pos, o2->final_posr->pos);
+
+    if (rotated)
+    {
+        // Bound the world space AABB rotated into the heightfield space.
+        // The zero rotation elements are skipped to keep the bounds exact 
+        // for the rotations swapping the axes.
+        dReal lo[3], hi[3];
+        for (int j = 0; j != 3; ++j)
+        {
+            lo[j] = o2->aabb[j * 2] - pos[j];
+            hi[j] = o2->aabb[j * 2 + 1] - pos[j];
+        }
+
+        for (int i = 0; i != 3; ++i)
+        {
+            dReal boundMin = 0, boundMax = 0;
+            for (int j = 0; j != 3; ++j)
+            {
+                const dReal r = R[j * 4 + i];
+                if (r != 0)
+                {
+                    const dReal a = r * lo[j], b = r * hi[j];
+                    boundMin += dMIN(a, b);
+                    boundMax += dMAX(a, b);
+                }
+            }
+            o2AABB[i * 2] = boundMin;
+            o2AABB[i * 2 + 1] = boundMax;
+        }
+    }
+    else
+    {
+        memcpy(o2AABB, o2->aabb, sizeof(o2AABB));
+    }
+
+    o2AABB[0] += originX;
+    o2AABB[1] += originX;
+    o2AABB[4] += originZ;
+    o2AABB[5] += originZ;
+}
+
+void HeightFieldGeomFrame::pointToWorld(dVector3 worldPoint, const dVector3 point) const
+{
+    dVector3 local;
+    dCopyVector3(local, point);
+    local[0] -= originX;
+    local[2] -= originZ;
+
+    if (rotated)
+    {
+        dMultiply0_331(worldPoint, R, local);
+        dAddVectors3(worldPoint, worldPoint, pos);
+    }
+    else
+    {
+        dCopyVector3(worldPoint, local);
+    }
+}
+
+void HeightFieldGeomFrame::pointToHeightfield(dVector3 point, const dVector3 worldPoint) const
+{
+    if (rotated)
+    {
+        dVector3 relative;
+        dSubtractVectors3(relative, worldPoint, pos);
+        dMultiply1_331(point, R, relative);
+    }
+    else
+    {
+        dCopyVector3(point, worldPoint);
+    }
+
+    point[0] += originX;
+    point[2] += originZ;
+}
+
+void HeightFieldGeomFrame::vectorToWorld(dVector3 worldVector, const dVector3 vector) const
+{
+    if (rotated)
+    {
+        dMultiply0_331(worldVector, R, vector);
+    }
+    else
+    {
+        dCopyVector3(worldVector, vector);
+    }
+}
+
+void HeightFieldGeomFrame::planeToWorld(dReal worldPlane[4], const dReal plane[4]) const
+{
+    vectorToWorld(worldPlane, plane);
+    worldPlane[3] = plane[3] - (plane[0] * originX + plane[2] * originZ);
+
+    if (rotated)
+    {
+        worldPlane[3] += dCalcVectorDot3(worldPlane, pos);
+    }
+}
 
 
 int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, const int minZ, const int maxZ, 
-                                           dxGeom* o2, const int numMaxContactsPossible,
+                                           const bool zoneTrimmed, dxGeom* o2, const HeightFieldGeomFrame &o2Frame,
+                                           HeightFieldTempBuffers *buffers, const int numMaxContactsPossible,
                                            int flags, dContactGeom* contact, 
                                            int skip )
 {
@@ -983,21 +1687,25 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
     // while filling a heightmap partial temporary buffer
     const unsigned int numX = (maxX - minX) + 1;
     const unsigned int numZ = (maxZ - minZ) + 1;
-    const dReal minO2Height = o2->aabb[2];
-    const dReal maxO2Height = o2->aabb[3];
+    const dReal minO2Height = o2Frame.o2AABB[2];
+    const dReal maxO2Height = o2Frame.o2AABB[3];
     unsigned int x_local, z_local;
+    HeightFieldVertex **tempHeightBuffer;
     dReal maxY = - dInfinity;
     dReal minY = dInfinity;
     // localize and const for faster access
     const dReal cfSampleWidth = m_p_data->m_fSampleWidth;
     const dReal cfSampleDepth = m_p_data->m_fSampleDepth;
     {
-        if (tempHeightBufferSizeX < numX || tempHeightBufferSizeZ < numZ)
+        if (buffers->tempHeightBufferSizeX < numX || buffers->tempHeightBufferSizeZ < numZ)
         {
-            resetHeightBuffer();
-            allocateHeightBuffer(numX, numZ);
+            buffers->resetHeightBuffer();
+            buffers->allocateHeightBuffer(numX, numZ);
         }
+        tempHeightBuffer = buffers->tempHeightBuffer;
 
+        // the tiles are pinned in the shared cache only while the samples are read
+        dxHeightfieldTileCursor tileCursor( m_p_data->m_pTiles );
         dReal Xpos, Ypos;
 
         for ( x = minX, x_local = 0; x_local < numX; x++, x_local++)
@@ -1010,7 +1718,7 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
             {
                 Ypos = z * cfSampleDepth; // Always calculate pos via multiplication to avoid computational error accumulation during multiple additions
 
-                const dReal h = m_p_data->GetHeight(x, z);
+                const dReal h = m_p_data->GetHeight(x, z, tileCursor);
                 HeightFieldRow[z_local].vertex[0] = c_Xpos;
                 HeightFieldRow[z_local].vertex[1] = h;
                 HeightFieldRow[z_local].vertex[2] = Ypos;
@@ -1026,14 +1734,16 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
             //totally above heightfield
             return 0;
         }
-        if (minY - maxO2Height > -dEpsilon )
+        // the cells trimmed off the zone are lower than the geom, so the original zone
+        // could be neither totally above the geom nor a single plane
+        if (!zoneTrimmed && minY - maxO2Height > -dEpsilon )
         {
             // totally under heightfield
             pContact = CONTACT(contact, 0);
 
-            pContact->pos[0] = o2->final_posr->pos[0];
+            pContact->pos[0] = o2Frame.o2Pos[0];
             pContact->pos[1] = minY;
-            pContact->pos[2] = o2->final_posr->pos[2];
+            pContact->pos[2] = o2Frame.o2Pos[2];
 
             pContact->normal[0] = 0;
             pContact->normal[1] = - 1;
@@ -1117,17 +1827,19 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
     dxPlane myplane(0,0,0,0,0);
     dxPlane* sliding_plane = &myplane;
     dReal triplane[4];
+    dReal worldPlane[4];
 
     // check some trivial case.
     // Vector Up plane
-    if (maxY - minY < dEpsilon)
+    if (!zoneTrimmed && maxY - minY < dEpsilon)
     {
         // it's a single plane.
         triplane[0] = 0;
         triplane[1] = 1;
         triplane[2] = 0;
         triplane[3] =  minY;
-        dGeomPlaneSetNoNormalize (sliding_plane, triplane);
+        o2Frame.planeToWorld(worldPlane, triplane);
+        dGeomPlaneSetNoNormalize (sliding_plane, worldPlane);
         // find collision and compute contact points
         const int numTerrainContacts = geomNPlaneCollider(o2, sliding_plane, flags, contact, skip);
         dIASSERT(numTerrainContacts <= numMaxContactsPossible);
@@ -1135,6 +1847,9 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
         for (int i = 0; i < numTerrainContacts; i++)
         {
             pContact = CONTACT(contact, i*skip);
+            dVector3 worldPos;
+            dCopyVector3(worldPos, pContact->pos);
+            o2Frame.pointToHeightfield(pContact->pos, worldPos);
             dOPESIGN(pContact->normal, =, -, triplane);
         }
         return numTerrainContacts;
@@ -1218,14 +1933,15 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
     */
 
     int numTerrainContacts = 0;
-    dContactGeom *planeContacts = m_p_data->m_contacts;
+    dContactGeom *planeContacts = buffers->planeContacts;
 
     const unsigned int numTriMax = (maxX - minX) * (maxZ - minZ) * 2;
-    if (tempTriangleBufferSize < numTriMax)
+    if (buffers->tempTriangleBufferSize < numTriMax)
     {
-        resetTriangleBuffer();
-        allocateTriangleBuffer(numTriMax);
+        buffers->resetTriangleBuffer();
+        buffers->allocateTriangleBuffer(numTriMax);
     }
+    HeightFieldTriangle * const tempTriangleBuffer = buffers->tempTriangleBuffer;
 
     // Sorting triangle/plane  resulting from heightfield zone
     // Perhaps that would be necessary in case of too much limited
@@ -1248,8 +1964,8 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
     // no further passes are needed in case of ray class
     if (!needFurtherPasses && o2->type != dRayClass)
     {
-        dReal zratio, xratio = (o2->aabb[1] - o2->aabb[0]) * m_p_data->m_fInvSampleWidth;
-        needFurtherPasses = xratio > REAL(1.5) || (zratio = (o2->aabb[5] - o2->aabb[4]) * m_p_data->m_fInvSampleDepth, zratio > REAL(1.5));
+        dReal zratio, xratio = (o2Frame.o2AABB[1] - o2Frame.o2AABB[0]) * m_p_data->m_fInvSampleWidth;
+        needFurtherPasses = xratio > REAL(1.5) || (zratio = (o2Frame.o2AABB[5] - o2Frame.o2AABB[4]) * m_p_data->m_fInvSampleDepth, zratio > REAL(1.5));
     }
 
     unsigned int numTri = 0;
@@ -1402,11 +2118,12 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
         }
 
         // group by Triangles by Planes sharing same plane definition
-        if (tempPlaneBufferSize  < numTri)
+        if (buffers->tempPlaneBufferSize  < numTri)
         {
-            resetPlaneBuffer();
-            allocatePlaneBuffer(numTri);
+            buffers->resetPlaneBuffer();
+            buffers->allocatePlaneBuffer(numTri);
         }
+        HeightFieldPlane ** const tempPlaneBuffer = buffers->tempPlaneBuffer;
 
         unsigned int numPlanes = 0;
         for (unsigned int k = 0; k < numTri; k++)
@@ -1463,7 +2180,7 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
         // sort planes
         if (isContactNumPointsLimited)
         {
-            sortPlanes(numPlanes);
+            buffers->sortPlanes(numPlanes);
         }
 
         /*
@@ -1479,12 +2196,18 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
         int planeTestFlags = (flags & ~NUMC_MASK) | HEIGHTFIELDMAXCONTACTPERCELL;
         dSASSERT((HEIGHTFIELDMAXCONTACTPERCELL & ~NUMC_MASK) == 0);
 
+        // A ray hits the planes at the surface with the depth being the distance along the ray.
+        // If it needs the closest hit, all the planes are tested and only the closest hit is kept.
+        const bool isRay = o2->type == dRayClass;
+        const bool closestRayHit = isRay && (o2->gflags & RAY_CLOSEST_HIT) != 0;
+
         for (unsigned int k = 0; k < numPlanes; k++)
         {
             HeightFieldPlane * const itPlane = tempPlaneBuffer[k];
 
             //set Geom
-            dGeomPlaneSetNoNormalize(sliding_plane, itPlane->planeDef);
+            o2Frame.planeToWorld(worldPlane, itPlane->planeDef);
+            dGeomPlaneSetNoNormalize(sliding_plane, worldPlane);
             //dGeomPlaneSetParams (sliding_plane, triangle_Plane[0], triangle_Plane[1], triangle_Plane[2], triangle_Plane[3]);
 
             // find collision and compute contact points
@@ -1496,10 +2219,14 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
             {
                 dContactGeom *planeCurrContact = planeContacts + i;
                 // Check if contact point found in plane is inside Triangle.
-                const dVector3 &contactPos = planeCurrContact->pos;
+                dVector3 contactPos;
+                o2Frame.pointToHeightfield(contactPos, planeCurrContact->pos);
                 
                 dVector3 triangleTestPos;
-                dAddVectorScaledVector3(triangleTestPos, contactPos, itPlane->planeDef, planeCurrContact->depth);
+                if (isRay)
+                    dCopyVector3(triangleTestPos, contactPos);
+                else
+                    dAddVectorScaledVector3(triangleTestPos, contactPos, itPlane->planeDef, planeCurrContact->depth);
 
                 for (sizeint b = 0; b < planeTriListSize; b++)
                 {
@@ -1509,14 +2236,26 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
                         triangleTestPos,
                         itPlane->trianglelist[b]->isUp))
                     {
-                        pContact = CONTACT(contact, numTerrainContacts*skip);
+                        if (closestRayHit && numTerrainContacts != 0)
+                        {
+                            pContact = CONTACT(contact, 0);
+                            if (planeCurrContact->depth >= pContact->depth)
+                            {
+                                didCollide = true;
+                                break;
+                            }
+                        }
+                        else
+                        {
+                            pContact = CONTACT(contact, numTerrainContacts*skip);
+                            numTerrainContacts++;
+                        }
                         dCopyVector3(pContact->pos, triangleTestPos);
                         dOPESIGN(pContact->normal, =, -, itPlane->planeDef);
                         pContact->depth = planeCurrContact->depth;
                         pContact->side1 = planeCurrContact->side1;
                         pContact->side2 = planeCurrContact->side2;
-                        numTerrainContacts++;
-                        if (numTerrainContacts == numMaxContactsPossible)
+                        if (numTerrainContacts == numMaxContactsPossible && !closestRayHit)
                         {
                             return numTerrainContacts;
                         }
@@ -1567,6 +2306,7 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
 
         dxRay tempRay(0, 1); 
         dReal depth;
+        dVector3 rayOrigin, rayDirection;
 
         // Only one contact is necessary for ray test
         int rayTestFlags = (flags & ~NUMC_MASK) | 1;
@@ -1610,7 +2350,9 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
 
                     //dGeomRaySet( &tempRay, pContact->pos[0], pContact->pos[1], pContact->pos[2],
                     //    - itTriangle->Normal[0], - itTriangle->Normal[1], - itTriangle->Normal[2] );
-                    dGeomRaySetNoNormalize(tempRay, triVertex, itTriangle->planeDef);
+                    o2Frame.pointToWorld(rayOrigin, triVertex);
+                    o2Frame.vectorToWorld(rayDirection, itTriangle->planeDef);
+                    dGeomRaySetNoNormalize(tempRay, rayOrigin, rayDirection);
 
                     if (geomRayNCollider(&tempRay, o2, rayTestFlags, planeContacts, sizeof(dContactGeom)))
                     {
@@ -1647,6 +2389,7 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
     if (needFurtherPasses)
     {
         dVector3 edgeVector;
+        dVector3 rayOrigin, rayDirection;
         dxRay edgeRay(0, 1);
 
         int numMaxContactsPerTri = dMIN(numMaxContactsPossible - numTerrainContacts, HEIGHTFIELDMAXCONTACTPERCELL);
@@ -1681,7 +2424,9 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
                 if (edgeRay.length >= dEpsilon)
                 {
                     dScaleVector3(edgeVector, 1.0f / edgeRay.length);
-                    dGeomRaySetNoNormalize(edgeRay, vertex1->vertex, edgeVector);
+                    o2Frame.pointToWorld(rayOrigin, vertex1->vertex);
+                    o2Frame.vectorToWorld(rayDirection, edgeVector);
+                    dGeomRaySetNoNormalize(edgeRay, rayOrigin, rayDirection);
                     int prevTerrainContacts = numTerrainContacts;
                     pContact = CONTACT(contact, prevTerrainContacts*skip);
                     const int numCollision = geomRayNCollider(&edgeRay, o2, triTestFlags, pContact, skip);
@@ -1694,6 +2439,9 @@ int dxHeightfield::dCollideHeightfieldZone( const int minX, const int maxX, cons
                         do
                         {
                             pContact = CONTACT(contact, prevTerrainContacts*skip);
+                            dVector3 worldPos;
+                            dCopyVector3(worldPos, pContact->pos);
+                            o2Frame.pointToHeightfield(pContact->pos, worldPos);
 
                             //create contact using Plane Normal
                             dOPESIGN(pContact->normal, = , -, itTriangle->planeDef);
@@ -1736,58 +2484,16 @@ int dCollideHeightfield( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contac
 
     dxHeightfield *terrain = (dxHeightfield*) o1;
 
-    dVector3 posbak;
-    dMatrix3 Rbak;
-    dReal aabbbak[6];
-    int gflagsbak;
-    dVector3 pos0,pos1;
-    dMatrix3 R1;
-
     int numTerrainContacts = 0;
     int numTerrainOrigContacts = 0;
 
-    //@@ Should find a way to set reComputeAABB to false in default case
-    // aka DHEIGHTFIELD_CORNER_ORIGIN not defined and terrain not PLACEABLE
-    // so that we can free some memory and speed up things a bit
-    // while saving some precision loss 
-#ifndef DHEIGHTFIELD_CORNER_ORIGIN
-    const bool reComputeAABB = true;
-#else
-    const bool reComputeAABB = ( terrain->gflags & GEOM_PLACEABLE ) ? true : false;
-#endif //DHEIGHTFIELD_CORNER_ORIGIN
-
     //
-    // Transform O2 into Heightfield Space
+    // Map O2 into Heightfield Space.
+    // The geom itself stays in place and the planes and rays colliding it are 
+    // mapped into the world space so that it could be collided concurrently.
     //
-    if (reComputeAABB)
-    {
-        // Backup original o2 position, rotation and AABB.
-        dVector3Copy( o2->final_posr->pos, posbak );
-        dMatrix3Copy( o2->final_posr->R, Rbak );
-        memcpy( aabbbak, o2->aabb, sizeof( dReal ) * 6 );
-        gflagsbak = o2->gflags;
-    }
-
-    if ( terrain->gflags & GEOM_PLACEABLE )
-    {
-        // Transform o2 into heightfield space.
-        dSubtractVectors3( pos0, o2->final_posr->pos, terrain->final_posr->pos );
-        dMultiply1_331( pos1, terrain->final_posr->R, pos0 );
-        dMultiply1_333( R1, terrain->final_posr->R, o2->final_posr->R );
-
-        // Update o2 with transformed position and rotation.
-        dVector3Copy( pos1, o2->final_posr->pos );
-        dMatrix3Copy( R1, o2->final_posr->R );
-    }
-
-#ifndef DHEIGHTFIELD_CORNER_ORIGIN
-    o2->final_posr->pos[ 0 ] += terrain->m_p_data->m_fHalfWidth;
-    o2->final_posr->pos[ 2 ] += terrain->m_p_data->m_fHalfDepth;
-#endif // DHEIGHTFIELD_CORNER_ORIGIN
-
-    // Rebuild AABB for O2
-    if (reComputeAABB)
-        o2->computeAABB();
+    const HeightFieldGeomFrame o2Frame(terrain, o2);
+    const dReal *o2AABB = o2Frame.o2AABB;
 
     //
     // Collide
@@ -1800,22 +2506,22 @@ int dCollideHeightfield( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contac
 
     if ( !wrapped )
     {
-        if (    o2->aabb[0] > terrain->m_p_data->m_fWidth //MinX
-            ||  o2->aabb[4] > terrain->m_p_data->m_fDepth)//MinZ
+        if (    o2AABB[0] > terrain->m_p_data->m_fWidth //MinX
+            ||  o2AABB[4] > terrain->m_p_data->m_fDepth)//MinZ
             goto dCollideHeightfieldExit;
 
-        if (    o2->aabb[1] < 0 //MaxX
-            ||  o2->aabb[5] < 0)//MaxZ
+        if (    o2AABB[1] < 0 //MaxX
+            ||  o2AABB[5] < 0)//MaxZ
             goto dCollideHeightfieldExit;
     }
 
     { // To narrow scope of following variables
         const dReal fInvSampleWidth = terrain->m_p_data->m_fInvSampleWidth;
-        int nMinX = (int)dFloor(dNextAfter(o2->aabb[0] * fInvSampleWidth, -dInfinity));
-        int nMaxX = (int)dCeil(dNextAfter(o2->aabb[1] * fInvSampleWidth, dInfinity));
+        int nMinX = (int)dFloor(dNextAfter(o2AABB[0] * fInvSampleWidth, -dInfinity));
+        int nMaxX = (int)dCeil(dNextAfter(o2AABB[1] * fInvSampleWidth, dInfinity));
         const dReal fInvSampleDepth = terrain->m_p_data->m_fInvSampleDepth;
-        int nMinZ = (int)dFloor(dNextAfter(o2->aabb[4] * fInvSampleDepth, -dInfinity));
-        int nMaxZ = (int)dCeil(dNextAfter(o2->aabb[5] * fInvSampleDepth, dInfinity));
+        int nMinZ = (int)dFloor(dNextAfter(o2AABB[4] * fInvSampleDepth, -dInfinity));
+        int nMaxZ = (int)dCeil(dNextAfter(o2AABB[5] * fInvSampleDepth, dInfinity));
 
         if ( !wrapped )
         {
@@ -1827,11 +2533,21 @@ int dCollideHeightfield( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contac
             dIASSERT ((nMinX < nMaxX) && (nMinZ < nMaxZ));
         }
 
+        // reject the zone or trim the cells under the geom by the pyramid bounds before rasterizing it
+        bool zoneTrimmed = false;
+        if ( terrain->m_p_data->HasHeightBoundsPyramid()
+            && !terrain->m_p_data->TrimZoneByHeightBounds( nMinX, nMaxX, nMinZ, nMaxZ, o2AABB[2], zoneTrimmed ) )
+            goto dCollideHeightfieldExit;
+
+        HeightFieldTempBuffers *buffers = terrain->acquireTempBuffers();
+
         numTerrainOrigContacts = numTerrainContacts;
         numTerrainContacts += terrain->dCollideHeightfieldZone(
-            nMinX,nMaxX,nMinZ,nMaxZ,o2,numMaxTerrainContacts - numTerrainContacts,
+            nMinX,nMaxX,nMinZ,nMaxZ,zoneTrimmed,o2,o2Frame,buffers,numMaxTerrainContacts - numTerrainContacts,
             flags,CONTACT(contact,numTerrainContacts*skip),skip	);
         dIASSERT( numTerrainContacts <= numMaxTerrainContacts );
+
+        terrain->releaseTempBuffers(buffers);
     }
 
     dContactGeom *pContact;
@@ -1849,48 +2565,21 @@ int dCollideHeightfield( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contac
 
 dCollideHeightfieldExit:
 
-    if (reComputeAABB)
+    if (!o2Frame.identity)
     {
-        // Restore o2 position, rotation and AABB
-        dVector3Copy( posbak, o2->final_posr->pos );
-        dMatrix3Copy( Rbak, o2->final_posr->R );
-        memcpy( o2->aabb, aabbbak, sizeof(dReal)*6 );
-        o2->gflags = gflagsbak;
-
         //
         // Transform Contacts to World Space
         //
-        if ( terrain->gflags & GEOM_PLACEABLE )
+        for ( i = 0; i < numTerrainContacts; ++i )
         {
-            for ( i = 0; i < numTerrainContacts; ++i )
-            {
-                pContact = CONTACT(contact,i*skip);
-                dCopyVector3( pos0, pContact->pos );
+            pContact = CONTACT(contact,i*skip);
 
-#ifndef DHEIGHTFIELD_CORNER_ORIGIN
-                pos0[ 0 ] -= terrain->m_p_data->m_fHalfWidth;
-                pos0[ 2 ] -= terrain->m_p_data->m_fHalfDepth;
-#endif // !DHEIGHTFIELD_CORNER_ORIGIN
-
-                dMultiply0_331( pContact->pos, terrain->final_posr->R, pos0 );
-
-                dAddVectors3( pContact->pos, pContact->pos, terrain->final_posr->pos );
-                dCopyVector3( pos0, pContact->normal );
-
-                dMultiply0_331( pContact->normal, terrain->final_posr->R, pos0 );
-            }
-        }
-#ifndef DHEIGHTFIELD_CORNER_ORIGIN
-        else
-        {
-            for ( i = 0; i < numTerrainContacts; ++i )
-            {
-                pContact = CONTACT(contact,i*skip);
-                pContact->pos[ 0 ] -= terrain->m_p_data->m_fHalfWidth;
-                pContact->pos[ 2 ] -= terrain->m_p_data->m_fHalfDepth;
-            }
+            dVector3 localVector;
+            dCopyVector3( localVector, pContact->pos );
+            o2Frame.pointToWorld( pContact->pos, localVector );
+            dCopyVector3( localVector, pContact->normal );
+            o2Frame.vectorToWorld( pContact->normal, localVector );
         }
-#endif // !DHEIGHTFIELD_CORNER_ORIGIN
     }
     // Return contact count.
     return numTerrainContacts;
@@ -31,14 +31,99 @@
 
 #include <ode/common.h>
 #include "collision_kernel.h"
+#include "file_mapping.h"
+#include "threadingutils.h"
 
 
 #define HEIGHTFIELDMAXCONTACTPERCELL 10
 
+// Cell count along each side of the finest blocks of the height bounds pyramid
+#define HEIGHTFIELDBOUNDSBLOCKCELLS 8
+#define HEIGHTFIELDBOUNDSMAXLEVELS 32
+
 
 class HeightFieldVertex;
 class HeightFieldEdge;
 class HeightFieldTriangle;
+struct dxHeightfield;
+struct dxHeightfieldTileCursor;
+
+
+//
+// dxHeightfieldTiles
+//
+// Samples of a tiled heightfield, either loaded on demand by the user callback
+// into a bounded LRU tile cache or read from a memory mapped tile file.
+// The tiles are m_nTileSamples x m_nTileSamples samples (the last ones padded),
+// stored by tile rows along Z and with the samples by rows along Z within a tile.
+// The cache is shared by the threads colliding the heightfields, each of them 
+// reading through its own cursor that pins the tile it reads.
+//
+struct dxHeightfieldTiles
+{
+    int m_nTileSamples;         // Tile side in samples
+    int m_nTilesX;              // Tile count on X axis
+    int m_nTilesZ;              // Tile count on Z axis
+
+    dHeightfieldGetTile* m_pGetTileCallback;
+    void* m_pUserData;
+
+    int m_nMaxCachedTiles;
+    int m_nCachedTiles;
+    dReal* m_pCacheHeights;     // Samples of the cached tiles by cache slot
+    int* m_pTileSlots;          // Cache slot by tile index or -1
+    int* m_pSlotTiles;          // Tile index by cache slot
+    int* m_pSlotPrev;           // LRU list links by cache slot (from the most recently used)
+    int* m_pSlotNext;
+    int* m_pSlotPins;           // Count of the cursors reading the tile by cache slot
+    int m_nMostRecentSlot;
+    int m_nLeastRecentSlot;
+    volatile atomicord32 m_nCacheLock;
+
+    dxFileMapping m_FileMapping;
+    const float* m_pFileHeights;
+
+    dxHeightfieldTiles( int nTileSamples, int nWidthSamples, int nDepthSamples );
+    ~dxHeightfieldTiles();
+
+    void SetCallback( void* pUserData, dHeightfieldGetTile* pCallback, int nMaxCachedTiles );
+    bool OpenFile( const char* fileName );
+
+    dReal GetSample( int x, int z, dxHeightfieldTileCursor &cursor );
+    void ReleaseCursor( dxHeightfieldTileCursor &cursor );
+
+private:
+    void AcquireTile( int nTile, dxHeightfieldTileCursor &cursor );
+    void UnlinkSlot( int nSlot );
+    void LockCache();
+    void UnlockCache();
+};
+
+//
+// dxHeightfieldTileCursor
+//
+// The tile a collision reads the samples from. A cached tile stays pinned in its
+// slot until the cursor moves to another tile or is released, so its samples are
+// read without locking the cache.
+//
+struct dxHeightfieldTileCursor
+{
+    dxHeightfieldTileCursor( dxHeightfieldTiles* pTiles ):
+        m_pTiles( pTiles ), m_nTile( -1 ), m_nSlot( -1 ), m_pHeights( NULL ), m_pOwnHeights( NULL )
+    {
+    }
+
+    ~dxHeightfieldTileCursor()
+    {
+        if ( m_pTiles != NULL ) m_pTiles->ReleaseCursor( *this );
+    }
+
+    dxHeightfieldTiles* m_pTiles;   // NULL for the untiled data
+    int m_nTile;                    // The tile read, -1 if none
+    int m_nSlot;                    // The cache slot pinned, -1 if none
+    const dReal* m_pHeights;
+    dReal* m_pOwnHeights;           // The tile loaded aside while all the slots are pinned
+};
 
 //
 // dxHeightfieldData
@@ -68,15 +153,23 @@ struct dxHeightfieldData
     int	m_nDepthSamples;       // Vertex count on Z axis edge (number of samples)
     int m_bCopyHeightData;     // Do we own the sample data?
     int	m_bWrapMode;           // Heightfield wrapping mode (0=finite, 1=infinite)
-    int m_nGetHeightMode;      // GetHeight mode ( 0=callback, 1=byte, 2=short, 3=float )
+    int m_nGetHeightMode;      // GetHeight mode ( 0=callback, 1=byte, 2=short, 3=float, 4=double, 5=tiles )
 
     const void* m_pHeightData; // Sample data array
     void* m_pUserData;         // Callback user data
-
-    dContactGeom            m_contacts[HEIGHTFIELDMAXCONTACTPERCELL];
+    dxHeightfieldTiles* m_pTiles; // Tiled samples (mode 5)
 
     dHeightfieldGetHeight* m_pGetHeightCallback;		// Callback pointer.
 
+    // Min/max height pyramid over the sample grid (not built for callback data).
+    // Level 0 has the bounds of the blocks of HEIGHTFIELDBOUNDSBLOCKCELLS x HEIGHTFIELDBOUNDSBLOCKCELLS cells,
+    // every next level merges 2 x 2 blocks of the previous one up to a single block.
+    dReal* m_pHeightBounds;    // min,max pairs of all the levels
+    int m_nHeightBoundsLevels;
+    int m_nHeightBoundsOffset[HEIGHTFIELDBOUNDSMAXLEVELS];      // Level start in m_pHeightBounds (in pairs)
+    int m_nHeightBoundsWidth[HEIGHTFIELDBOUNDSMAXLEVELS];       // Level block count on X axis
+    int m_nHeightBoundsDepth[HEIGHTFIELDBOUNDSMAXLEVELS];       // Level block count on Z axis
+
     dxHeightfieldData();
     ~dxHeightfieldData();
 
@@ -87,10 +180,19 @@ struct dxHeightfieldData
 
     void ComputeHeightBounds();
 
+    void BuildHeightBoundsPyramid();
+    void FreeHeightBoundsPyramid();
+    bool HasHeightBoundsPyramid() const { return m_pHeightBounds != NULL; }
+    void GetCellRangeHeightBounds( int nMinX, int nMaxX, int nMinZ, int nMaxZ,
+        dReal &fMinHeight, dReal &fMaxHeight ) const;
+    bool TrimZoneByHeightBounds( int &nMinX, int &nMaxX, int &nMinZ, int &nMaxZ,
+        dReal fMinO2Height, bool &bTrimmed ) const;
+
     bool IsOnHeightfield2  ( const HeightFieldVertex * const CellCorner, 
         const dReal * const pos,  const bool isABC) const;
 
     dReal GetHeight(int x, int z);
+    dReal GetHeight(int x, int z, dxHeightfieldTileCursor &cursor);
     dReal GetHeight(dReal x, dReal z);
 
 };
@@ -190,22 +292,34 @@ public:
 };
 
 //
-// dxHeightfield
+// HeightFieldTempBuffers
 //
-// Heightfield geom structure
+// Scratch buffers of a zone collision. Every collision takes its own buffers
+// from the heightfield cache so that a heightfield may be collided by several
+// threads at a time.
 //
-struct dxHeightfield : public dxGeom
+class HeightFieldTempBuffers
 {
-    dxHeightfieldData* m_p_data;
-
-    dxHeightfield( dSpaceID space, dHeightfieldDataID data, int bPlaceable );
-    ~dxHeightfield();
-
-    void computeAABB();
+public:
+    HeightFieldTempBuffers():
+        tempPlaneBuffer(0),
+        tempPlaneInstances(0),
+        tempPlaneBufferSize(0),
+        tempTriangleBuffer(0),
+        tempTriangleBufferSize(0),
+        tempHeightBuffer(0),
+        tempHeightInstances(0),
+        tempHeightBufferSizeX(0),
+        tempHeightBufferSizeZ(0)
+    {
+    }
 
-    int dCollideHeightfieldZone( const int minX, const int maxX, const int minZ, const int maxZ,  
-        dxGeom *o2, const int numMaxContacts,
-        int flags, dContactGeom *contact, int skip );
+    ~HeightFieldTempBuffers()
+    {
+        resetTriangleBuffer();
+        resetPlaneBuffer();
+        resetHeightBuffer();
+    }
 
     enum
     {
@@ -238,8 +352,67 @@ struct dxHeightfield : public dxGeom
     sizeint             tempHeightBufferSizeX;
     sizeint             tempHeightBufferSizeZ;
 
+    dContactGeom        planeContacts[HEIGHTFIELDMAXCONTACTPERCELL];
 };
 
+//
+// HeightFieldGeomFrame
+//
+// Mapping between the world space and the heightfield space a zone is collided in,
+// with the position and the AABB of the other geom in the heightfield space.
+// The other geom is left in the world space (it may be collided by other threads
+// at the same time) and the planes and rays collided with it are mapped there instead.
+//
+class HeightFieldGeomFrame
+{
+public:
+    HeightFieldGeomFrame(const dxHeightfield *terrain, dxGeom *o2);
+
+    void pointToWorld(dVector3 worldPoint, const dVector3 point) const;
+    void pointToHeightfield(dVector3 point, const dVector3 worldPoint) const;
+    void vectorToWorld(dVector3 worldVector, const dVector3 vector) const;
+    void planeToWorld(dReal worldPlane[4], const dReal plane[4]) const;
+
+    bool    identity;       // The heightfield space matches the world space
+    bool    rotated;        // The heightfield is placeable
+    const dReal *pos;       // Heightfield position and rotation if placeable
+    const dReal *R;
+    dReal   originX;        // Heightfield space origin offset
+    dReal   originZ;
+
+    dVector3 o2Pos;         // The other geom position and AABB in the heightfield space
+    dReal   o2AABB[6];
+};
+
+//
+// dxHeightfield
+//
+// Heightfield geom structure
+//
+struct dxHeightfield : public dxGeom
+{
+    dxHeightfieldData* m_p_data;
+
+    dxHeightfield( dSpaceID space, dHeightfieldDataID data, int bPlaceable );
+    ~dxHeightfield();
+
+    void computeAABB();
+
+    int dCollideHeightfieldZone( const int minX, const int maxX, const int minZ, const int maxZ,  
+        const bool zoneTrimmed, dxGeom *o2, const HeightFieldGeomFrame &o2Frame,
+        HeightFieldTempBuffers *buffers, const int numMaxContacts,
+        int flags, dContactGeom *contact, int skip );
+
+    enum
+    {
+        TEMP_BUFFERS_CACHE_SIZE = 4     // Buffers kept for the concurrent collisions
+    };
+
+    HeightFieldTempBuffers *acquireTempBuffers();
+    void  releaseTempBuffers(HeightFieldTempBuffers *buffers);
+
+    volatile atomicptr  tempBuffersCache[TEMP_BUFFERS_CACHE_SIZE]; // HeightFieldTempBuffers *
+};
 
 //------------------------------------------------------------------------------
 #endif //_DHEIGHTFIELD_H_
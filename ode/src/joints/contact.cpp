@@ -34,6 +34,8 @@
 dxJointContact::dxJointContact(dxWorld *w) :
     dxJoint(w)
 {
+    geom_serials[0] = 0;
+    geom_serials[1] = 0;
 }
 
 
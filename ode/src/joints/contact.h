@@ -31,6 +31,7 @@ struct dxJointContact : public dxJoint
 {
     int the_m;   // number of rows computed by getInfo1
     dContact contact;
+    unsigned geom_serials[2]; // serials of the contact geoms for the warm starting impulse cache, 0 if not known
 
     dxJointContact( dxWorld* w );
     virtual void getSureMaxInfo( SureMaxInfo* info );
@@ -264,6 +264,23 @@ struct dxJointGroup : public dBase
         return j;
     }
 
+    // allocate and construct up to max_count joints in a row, *count is set to the
+    // number of the joints made. they are dEFFICIENT_SIZE(sizeof(T)) bytes apart.
+    template<class T>
+    T *allocSeries(dWorldID w, sizeint max_count, sizeint *count)
+    {
+        char *first = (char *)m_stack.allocSeries(sizeof(T), max_count, count);
+        if (first != NULL) {
+            const sizeint stride = dEFFICIENT_SIZE(sizeof(T));
+            for (sizeint i = 0; i != *count; ++i) {
+                T *j = new(first + i * stride) T(w);
+                j->flags |= dJOINT_INGROUP;
+            }
+            m_num += *count;
+        }
+        return (T *)first;
+    }
+
     sizeint getJointCount() const { return m_num; }
     sizeint exportJoints(dxJoint **jlist);
 
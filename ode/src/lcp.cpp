@@ -133,6 +133,10 @@ rows/columns and manipulate C.
 
 #define NUB_OPTIMIZATIONS // use NUB optimizations
 
+// the minimal size of the index set C (or of the initial unbounded block) 
+// for the triangular solves to be done cooperatively if it's allowed
+#define dLCP_COOPERATIVE_ROWS_MINIMUM 64
+
 
 // option 1 : matrix row pointers (less data copying)
 #define ROWPTRS
@@ -395,11 +399,14 @@ struct dLCP {
     bool *m_state;
     int *const m_findex;
     unsigned *const m_p, *const m_C;
+    const dxLCPCooperationInfo *const m_cooperation;
+    unsigned m_DellIndex, m_nDellValid;     // the index Dell was last computed for and the count of its still valid leading elements
 
     dLCP (unsigned n, unsigned nskip, unsigned nub, dReal *Adata, dReal *pairsbx, dReal *w,
         dReal *pairslh, dReal *L, dReal *d,
         dReal *Dell, dReal *ell, dReal *tmp,
-        int *findex, unsigned *p, unsigned *C, dReal **Arows);
+        int *findex, unsigned *p, unsigned *C, dReal **Arows, 
+        const dxLCPCooperationInfo *cooperation);
     void assignState(bool *state) { dIASSERT(m_state == NULL); m_state = state; }
 
     unsigned getNub() const { return m_nub; }
@@ -423,6 +430,8 @@ struct dLCP {
     void pC_plusequals_s_times_qC (dReal *p, dReal s, dReal *q);
     void pN_plusequals_s_times_qN (dReal *p, dReal s, dReal *q);
     void solve1 (dReal *a, unsigned i, bool dir_positive, int only_transfer=0);
+    void solveL1StraightC (dReal *b, unsigned startRow=0) const;
+    void solveL1TransposedC (dReal *b) const;
     void unpermute_X();
     void unpermute_W();
 };
@@ -431,7 +440,8 @@ struct dLCP {
 dLCP::dLCP (unsigned n, unsigned nskip, unsigned nub, dReal *Adata, dReal *pairsbx, dReal *w,
             dReal *pairslh, dReal *L, dReal *d,
             dReal *Dell, dReal *ell, dReal *tmp,
-            int *findex, unsigned *p, unsigned *C, dReal **Arows):
+            int *findex, unsigned *p, unsigned *C, dReal **Arows, 
+            const dxLCPCooperationInfo *cooperation):
     m_n(n), m_nskip(nskip), m_nub(nub), m_nC(0), m_nN(0),
 # ifdef ROWPTRS
     m_A(Arows),
@@ -440,7 +450,8 @@ dLCP::dLCP (unsigned n, unsigned nskip, unsigned nub, dReal *Adata, dReal *pairs
 #endif
     m_pairsbx(pairsbx), m_w(w), m_pairslh(pairslh), 
     m_L(L), m_d(d), m_Dell(Dell), m_ell(ell), m_tmp(tmp),
-    m_state(NULL), m_findex(findex), m_p(p), m_C(C)
+    m_state(NULL), m_findex(findex), m_p(p), m_C(C), m_cooperation(cooperation),
+    m_DellIndex(n), m_nDellValid(0)
 {
     const dxSwapStateSwapProblemOption state_swap_opt = SPO_DONT_SWAP_STATE; dIASSERT(m_state == NULL);
 
@@ -507,8 +518,20 @@ dLCP::dLCP (unsigned n, unsigned nskip, unsigned nub, dReal *Adata, dReal *pairs
             for (unsigned j = 0; j < currNub; Lrow += nskip, ++j) memcpy(Lrow, AROW(j), (j + 1) * sizeof(dReal));
         }
         transfer_b_to_x<false> (m_pairsbx, currNub);
-        factorMatrixAsLDLT<1> (m_L, m_d, currNub, nskip);
-        solveEquationSystemWithLDLT<1, PBX__MAX> (m_L, m_d, m_pairsbx + PBX_X, currNub, nskip);
+        if (cooperation != NULL && currNub >= dLCP_COOPERATIVE_ROWS_MINIMUM) {
+            // the cooperative solver needs x to be contiguous; tmp is not used yet
+            dxRequiredResourceContainer *resources = cooperation->m_resourceContainer;
+            const unsigned threads = cooperation->m_allowedThreadCount;
+            ThreadedEquationSolverLDLT::cooperativelyFactorLDLT(resources, threads, m_L, m_d, currNub, nskip);
+            dReal *x = m_tmp;
+            for (unsigned k = 0; k != currNub; ++k) x[k] = (m_pairsbx + (sizeint)k * PBX__MAX)[PBX_X];
+            ThreadedEquationSolverLDLT::cooperativelySolveLDLT(resources, threads, m_L, m_d, x, currNub, nskip);
+            for (unsigned k = 0; k != currNub; ++k) (m_pairsbx + (sizeint)k * PBX__MAX)[PBX_X] = x[k];
+        }
+        else {
+            factorMatrixAsLDLT<1> (m_L, m_d, currNub, nskip);
+            solveEquationSystemWithLDLT<1, PBX__MAX> (m_L, m_d, m_pairsbx + PBX_X, currNub, nskip);
+        }
         dSetZero (m_w, currNub);
         {
             unsigned *C = m_C;
@@ -570,6 +593,7 @@ void dLCP::transfer_i_to_C (unsigned i)
 
         m_C[nC] = nC;
         m_nC = nC + 1; // nC value is outdated after this line
+        m_nDellValid = 0; // i is not a driving index any more
     }
 
 # ifdef DEBUG_LCP
@@ -585,9 +609,11 @@ void dLCP::transfer_i_from_N_to_C (unsigned i)
         const unsigned nC = m_nC;
 
         if (nC > 0) {
+            // Dell and ell are kept for the driving index (see solve1()), so
+            // tmp holds Dell of i here and ell goes directly into L
+            dReal *const Dell = m_tmp;
             {
                 dReal *const aptr = AROW(i);
-                dReal *Dell = m_Dell;
                 const unsigned *C = m_C;
 #   ifdef NUB_OPTIMIZATIONS
                 // if nub>0, initial part of aptr unpermuted
@@ -599,14 +625,14 @@ void dLCP::transfer_i_from_N_to_C (unsigned i)
                 for (unsigned j=0; j<nC; ++j) Dell[j] = aptr[C[j]];
 #   endif
             }
-            solveL1Straight<1>(m_L, m_Dell, nC, m_nskip);
+            solveL1StraightC (Dell);
 
             dReal ell_Dell_dot = REAL(0.0);
             dReal *const Ltgt = m_L + (sizeint)m_nskip * nC;
-            dReal *ell = m_ell, *Dell = m_Dell, *d = m_d;
+            dReal *d = m_d;
             for (unsigned j = 0; j < nC; ++j) {
                 dReal ell_j, Dell_j = Dell[j];
-                Ltgt[j] = ell[j] = ell_j = Dell_j * d[j];
+                Ltgt[j] = ell_j = Dell_j * d[j];
                 ell_Dell_dot += ell_j * Dell_j;
             }
             
@@ -653,6 +679,8 @@ void dLCP::transfer_i_from_C_to_N (unsigned i, void *tmpbuf)
             }
             if (C[j] == i) {
                 dxLDLTRemove (m_A, C, m_L, m_d, m_n, nC, j, m_nskip, tmpbuf);
+                // the rows of L above j are unchanged and so are the elements of Dell for them
+                m_nDellValid = dMIN(m_nDellValid, j);
                 unsigned k;
                 if (last_idx == -1) {
                     for (k = j + 1 ; k < nC; ++k) {
@@ -688,15 +716,18 @@ void dLCP::transfer_i_from_C_to_N (unsigned i, void *tmpbuf)
 
 void dLCP::pN_equals_ANC_times_qC (dReal *p, dReal *q)
 {
-    // we could try to make this matrix-vector multiplication faster using
-    // outer product matrix tricks, e.g. with the dMultidotX() functions.
-    // but i tried it and it actually made things slower on random 100x100
-    // problems because of the overhead involved. so we'll stick with the
-    // simple method for now.
+    // the rows are taken four at a time so that q is only streamed through
+    // the cache once for every four rows. each row's sum is accumulated in
+    // the same order as dxDot() does it.
     const unsigned nC = m_nC;
     dReal *ptgt = p + nC;
     const unsigned nN = m_nN;
-    for (unsigned i = 0; i < nN; ++i) {
+    const unsigned nN_end = nN & ~3U;
+    unsigned i = 0;
+    for (; i != nN_end; i += 4) {
+        calculateLargeVectorDotQuad<1> (ptgt + i, AROW(i + nC), AROW(i + nC + 1), AROW(i + nC + 2), AROW(i + nC + 3), q, nC);
+    }
+    for (; i != nN; ++i) {
         ptgt[i] = dxDot (AROW(i + nC), q, nC);
     }
 }
@@ -744,24 +775,54 @@ void dLCP::solve1 (dReal *a, unsigned i, bool dir_positive, int only_transfer)
     //
     // @@@ question: do we need to solve for entire delta_x??? yes, but
     //     only if an x goes below 0 during the step.
+    //
+    // while i is being driven, the index set C only grows at its end (the
+    // leading rows of L and the leading elements of A(i,C) stay the same) or
+    // has an element removed (the rows of L above it stay the same). so the
+    // leading elements of Dell from the previous call are reused and only
+    // the rest of L*Dell=A(i,C) is solved.
 
     const unsigned nC = m_nC;
     if (nC > 0) {
-        {
+        const unsigned nDellValid = m_DellIndex == i ? m_nDellValid : 0;
+        dIASSERT(nDellValid <= nC);
+
+        if (nDellValid != nC) {
             dReal *Dell = m_Dell;
             unsigned *C = m_C;
             dReal *aptr = AROW(i);
 #   ifdef NUB_OPTIMIZATIONS
             // if nub>0, initial part of aptr[] is guaranteed unpermuted
             const unsigned nub = m_nub;
-            unsigned j = 0;
+            unsigned j = nDellValid;
             for ( ; j < nub; ++j) Dell[j] = aptr[j];
             for ( ; j < nC; ++j) Dell[j] = aptr[C[j]];
 #   else
-            for (unsigned j = 0; j < nC; ++j) Dell[j] = aptr[C[j]];
+            for (unsigned j = nDellValid; j < nC; ++j) Dell[j] = aptr[C[j]];
 #   endif
+
+            if (nDellValid != 0) {
+                // eliminate the known leading elements from the rest of the rows
+                const unsigned nskip = m_nskip;
+                const dReal *Lrow = m_L + (sizeint)nskip * nDellValid;
+                unsigned k = nDellValid;
+                for (; nC - k >= 4; Lrow += 4 * (sizeint)nskip, k += 4) {
+                    dReal sums[4];
+                    calculateLargeVectorDotQuad<1> (sums, Lrow, Lrow + nskip, Lrow + 2 * (sizeint)nskip, Lrow + 3 * (sizeint)nskip, Dell, nDellValid);
+                    Dell[k] -= sums[0];
+                    Dell[k + 1] -= sums[1];
+                    Dell[k + 2] -= sums[2];
+                    Dell[k + 3] -= sums[3];
+                }
+                for (; k != nC; Lrow += nskip, ++k) {
+                    Dell[k] -= dxDot (Lrow, Dell, nDellValid);
+                }
+            }
+
+            solveL1StraightC (m_Dell, nDellValid);
+            m_DellIndex = i;
+            m_nDellValid = nC;
         }
-        solveL1Straight<1>(m_L, m_Dell, nC, m_nskip);
         {
             dReal *ell = m_ell, *Dell = m_Dell, *d = m_d;
             for (unsigned j = 0; j < nC; ++j) ell[j] = Dell[j] * d[j];
@@ -772,7 +833,7 @@ void dLCP::solve1 (dReal *a, unsigned i, bool dir_positive, int only_transfer)
             {
                 for (unsigned j = 0; j < nC; ++j) tmp[j] = ell[j];
             }
-            solveL1Transposed<1>(m_L, tmp, nC, m_nskip);
+            solveL1TransposedC (tmp);
             if (dir_positive) {
                 unsigned *C = m_C;
                 dReal *tmp = m_tmp;
@@ -787,6 +848,34 @@ void dLCP::solve1 (dReal *a, unsigned i, bool dir_positive, int only_transfer)
 }
 
 
+// solve L*x=b and L'*x=b in place with the factorization of the set C.
+// the straight solve can be limited to the trailing rows from startRow on
+// if the elements of b before it have been solved and eliminated already.
+
+void dLCP::solveL1StraightC (dReal *b, unsigned startRow/*=0*/) const
+{
+    const unsigned rowCount = m_nC - startRow;
+    const dReal *L = m_L + ((sizeint)m_nskip + 1) * startRow;
+    if (m_cooperation != NULL && rowCount >= dLCP_COOPERATIVE_ROWS_MINIMUM) {
+        ThreadedEquationSolverLDLT::cooperativelySolveL1Straight(m_cooperation->m_resourceContainer, m_cooperation->m_allowedThreadCount, L, b + startRow, rowCount, m_nskip);
+    }
+    else {
+        solveL1Straight<1>(L, b + startRow, rowCount, m_nskip);
+    }
+}
+
+void dLCP::solveL1TransposedC (dReal *b) const
+{
+    const unsigned nC = m_nC;
+    if (m_cooperation != NULL && nC >= dLCP_COOPERATIVE_ROWS_MINIMUM) {
+        ThreadedEquationSolverLDLT::cooperativelySolveL1Transposed(m_cooperation->m_resourceContainer, m_cooperation->m_allowedThreadCount, m_L, b, nC, m_nskip);
+    }
+    else {
+        solveL1Transposed<1>(m_L, b, nC, m_nskip);
+    }
+}
+
+
 void dLCP::unpermute_X()
 {
     unsigned *p = m_p;
@@ -828,21 +917,24 @@ void dLCP::unpermute_W()
 #endif // dLCP_FAST
 
 
-static void dxSolveLCP_AllUnbounded (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX]);
+static void dxSolveLCP_AllUnbounded (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX], 
+                                     const dxLCPCooperationInfo *cooperation);
 static void dxSolveLCP_Generic (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX], 
-                                dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex);
+                                dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex, 
+                                const dxLCPCooperationInfo *cooperation);
 
 /*extern */
 void dxSolveLCP (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX],
-    dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex)
+    dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex, 
+    const dxLCPCooperationInfo *cooperation/*=NULL*/)
 {
     if (nub >= n)
     {
-        dxSolveLCP_AllUnbounded (memarena, n, A, pairsbx);
+        dxSolveLCP_AllUnbounded (memarena, n, A, pairsbx, cooperation);
     }
     else
     {
-        dxSolveLCP_Generic (memarena, n, A, pairsbx, outer_w, nub, pairslh, findex);
+        dxSolveLCP_Generic (memarena, n, A, pairsbx, outer_w, nub, pairslh, findex, cooperation);
     }
 }
 
@@ -850,15 +942,32 @@ void dxSolveLCP (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal p
 // if all the variables are unbounded then we can just factor, solve, and return
 
 static 
-void dxSolveLCP_AllUnbounded (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX])
+void dxSolveLCP_AllUnbounded (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX], 
+                              const dxLCPCooperationInfo *cooperation)
 {
     dAASSERT(A != NULL);
     dAASSERT(pairsbx != NULL);
     dAASSERT(n != 0);
 
+    unsigned nskip = dPAD(n);
+
+    if (cooperation != NULL && n >= dLCP_COOPERATIVE_ROWS_MINIMUM) {
+        // the cooperative solver needs d and x to be contiguous
+        dReal *d = memarena->AllocateArray<dReal> (n);
+        dReal *x = memarena->AllocateArray<dReal> (n);
+        for (unsigned k = 0; k != n; ++k) x[k] = (pairsbx + (sizeint)k * PBX__MAX)[PBX_B];
+
+        dxRequiredResourceContainer *resources = cooperation->m_resourceContainer;
+        const unsigned threads = cooperation->m_allowedThreadCount;
+        ThreadedEquationSolverLDLT::cooperativelyFactorLDLT(resources, threads, A, d, n, nskip);
+        ThreadedEquationSolverLDLT::cooperativelySolveLDLT(resources, threads, A, d, x, n, nskip);
+
+        for (unsigned k = 0; k != n; ++k) (pairsbx + (sizeint)k * PBX__MAX)[PBX_X] = x[k];
+        return;
+    }
+
     transfer_b_to_x<true>(pairsbx, n);    
 
-    unsigned nskip = dPAD(n);
     factorMatrixAsLDLT<PBX__MAX> (A, pairsbx + PBX_B, n, nskip);
     solveEquationSystemWithLDLT<PBX__MAX, PBX__MAX> (A, pairsbx + PBX_B, pairsbx + PBX_X, n, nskip);
 }
@@ -868,7 +977,8 @@ void dxSolveLCP_AllUnbounded (dxWorldProcessMemArena *memarena, unsigned n, dRea
 
 static 
 void dxSolveLCP_Generic (dxWorldProcessMemArena *memarena, unsigned n, dReal *A, dReal pairsbx[PBX__MAX],
-    dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex)
+    dReal *outer_w/*=NULL*/, unsigned nub, dReal pairslh[PLH__MAX], int *findex, 
+    const dxLCPCooperationInfo *cooperation)
 {
     dAASSERT (n > 0 && A && pairsbx && pairslh && nub >= 0 && nub < n);
 # ifndef dNODEBUG
@@ -900,7 +1010,7 @@ void dxSolveLCP_Generic (dxWorldProcessMemArena *memarena, unsigned n, dReal *A,
 
     // create LCP object. note that tmp is set to delta_w to save space, this
     // optimization relies on knowledge of how tmp is used, so be careful!
-    dLCP lcp(n, nskip, nub, A, pairsbx, w, pairslh, L, d, Dell, ell, delta_w, findex, p, C, Arows);
+    dLCP lcp(n, nskip, nub, A, pairsbx, w, pairslh, L, d, Dell, ell, delta_w, findex, p, C, Arows, cooperation);
     // Assign the state array separately so that the dLCP constructor does not manipulate with uninitialized values in the array
     lcp.assignState(state);
     
@@ -1182,6 +1292,15 @@ sizeint dxEstimateSolveLCPMemoryReq(unsigned n, bool outer_w_avail)
     return res;
 }
 
+void dxEstimateCooperativeSolveLCPResourceRequirements(dxResourceRequirementDescriptor *requirementsDescriptor, 
+    unsigned allowedThreadCount, unsigned n)
+{
+    ThreadedEquationSolverLDLT::estimateCooperativeFactoringLDLTResourceRequirements(requirementsDescriptor, allowedThreadCount, n);
+    ThreadedEquationSolverLDLT::estimateCooperativeSolvingLDLTResourceRequirements(requirementsDescriptor, allowedThreadCount, n);
+    ThreadedEquationSolverLDLT::estimateCooperativeSolvingL1StraightResourceRequirements(requirementsDescriptor, allowedThreadCount, n);
+    ThreadedEquationSolverLDLT::estimateCooperativeSolvingL1TransposedResourceRequirements(requirementsDescriptor, allowedThreadCount, n);
+}
+
 
 //***************************************************************************
 // accuracy and timing test
@@ -1339,3 +1458,179 @@ extern "C" ODE_API int dTestSolveLCP()
     dxFreeTemporaryWorldProcessMemArena(arena);
     return 1;
 }
+
+//***************************************************************************
+// consistency test of the Dell cached between the dLCP::solve1() calls
+
+// a check of the Dell that dLCP::solve1() keeps for the driving index and of
+// the factorization of A(C,C) against the ones computed from scratch while the
+// set C grows and shrinks the way dxSolveLCP() changes it. the returned value
+// is the largest difference found relative to the magnitude of the values.
+
+static sizeint EstimateTestLCPCachedDellMemoryReq(unsigned n)
+{
+    const unsigned nskip = dPAD(n);
+
+    sizeint res = 0;
+
+    res += dOVERALIGNED_SIZE(sizeof(dReal) * ((sizeint)n * nskip), LMATRIX_ALIGNMENT); // for L
+    res += 3 * dEFFICIENT_SIZE(sizeof(dReal) * ((sizeint)n * nskip)); // for A, A2, freshL
+    res += 8 * dEFFICIENT_SIZE(sizeof(dReal) * n); // for w, d, Dell, ell, tmp, delta_x, freshd, freshDell
+    res += dEFFICIENT_SIZE(sizeof(dReal) * PBX__MAX * n); // for pairsbx
+    res += dEFFICIENT_SIZE(sizeof(dReal) * PLH__MAX * n); // for pairslh
+#ifdef ROWPTRS
+    res += dEFFICIENT_SIZE(sizeof(dReal *) * n); // for Arows
+#endif
+    res += 2 * dEFFICIENT_SIZE(sizeof(unsigned) * n); // for p, C
+    res += dEFFICIENT_SIZE(sizeof(bool) * n); // for state
+    res += dEFFICIENT_SIZE(dLCP::estimate_transfer_i_from_C_to_N_mem_req(n, nskip)); // for dLCP::transfer_i_from_C_to_N
+
+    return res;
+}
+
+static inline 
+const dReal *testLCPRow (const dLCP &lcp, unsigned i)
+{
+#ifdef ROWPTRS
+    return lcp.m_A[i];
+#else
+    return lcp.m_A + (sizeint)i * lcp.m_nskip;
+#endif
+}
+
+static 
+dReal compareCachedDell (const dLCP &lcp, unsigned i, dReal *freshDell)
+{
+    const unsigned nC = lcp.m_nC;
+    if (nC == 0) return 0;
+
+    const dReal *aptr = testLCPRow (lcp, i);
+    for (unsigned j = 0; j != nC; ++j) freshDell[j] = aptr[lcp.m_C[j]];
+    solveL1Straight<1> (lcp.m_L, freshDell, nC, lcp.m_nskip);
+
+    dReal scale = 1, diff = 0;
+    for (unsigned j = 0; j != nC; ++j) {
+        scale = dMAX(scale, dFabs(freshDell[j]));
+        diff = dMAX(diff, dFabs(freshDell[j] - lcp.m_Dell[j]));
+    }
+    return diff / scale;
+}
+
+static 
+dReal compareFactorization (const dLCP &lcp, dReal *freshL, dReal *freshd)
+{
+    const unsigned nC = lcp.m_nC, nskip = lcp.m_nskip;
+    if (nC == 0) return 0;
+
+    const unsigned *C = lcp.m_C;
+    for (unsigned j = 0; j != nC; ++j) {
+        for (unsigned k = 0; k <= j; ++k) {
+            freshL[(sizeint)j * nskip + k] = C[j] >= C[k] ? testLCPRow (lcp, C[j])[C[k]] : testLCPRow (lcp, C[k])[C[j]];
+        }
+    }
+    factorMatrixAsLDLT<1> (freshL, freshd, nC, nskip);
+
+    dReal scale = 1, diff = 0;
+    for (unsigned j = 0; j != nC; ++j) {
+        for (unsigned k = 0; k < j; ++k) {
+            const dReal fresh = freshL[(sizeint)j * nskip + k];
+            scale = dMAX(scale, dFabs(fresh));
+            diff = dMAX(diff, dFabs(fresh - lcp.m_L[(sizeint)j * nskip + k]));
+        }
+        scale = dMAX(scale, dFabs(freshd[j]));
+        diff = dMAX(diff, dFabs(freshd[j] - lcp.m_d[j]));
+    }
+    return diff / scale;
+}
+
+extern "C" ODE_API dReal dTestLCPCachedDell(unsigned n, unsigned problemCount)
+{
+    sizeint memreq = EstimateTestLCPCachedDellMemoryReq(n);
+    dxWorldProcessMemArena *arena = dxAllocateTemporaryWorldProcessMemArena(memreq, NULL, NULL);
+    if (arena == NULL) {
+        return dInfinity;
+    }
+    arena->ResetState();
+
+    const unsigned nskip = dPAD(n);
+    dReal maxDiff = 0;
+
+    for (unsigned count = 0; count != problemCount; ++count) {
+        BEGIN_STATE_SAVE(arena, saveInner) {
+            dReal *L = arena->AllocateOveralignedArray<dReal> ((sizeint)n * nskip, LMATRIX_ALIGNMENT);
+            dReal *A = arena->AllocateArray<dReal> ((sizeint)n * nskip);
+            dReal *A2 = arena->AllocateArray<dReal> ((sizeint)n * nskip);
+            dReal *freshL = arena->AllocateArray<dReal> ((sizeint)n * nskip);
+            dReal *w = arena->AllocateArray<dReal> (n);
+            dReal *d = arena->AllocateArray<dReal> (n);
+            dReal *Dell = arena->AllocateArray<dReal> (n);
+            dReal *ell = arena->AllocateArray<dReal> (n);
+            dReal *tmp = arena->AllocateArray<dReal> (n);
+            dReal *delta_x = arena->AllocateArray<dReal> (n);
+            dReal *freshd = arena->AllocateArray<dReal> (n);
+            dReal *freshDell = arena->AllocateArray<dReal> (n);
+            dReal *pairsbx = arena->AllocateArray<dReal> ((sizeint)n * PBX__MAX);
+            dReal *pairslh = arena->AllocateArray<dReal> ((sizeint)n * PLH__MAX);
+#ifdef ROWPTRS
+            dReal **Arows = arena->AllocateArray<dReal *> (n);
+#else
+            dReal **Arows = NULL;
+#endif
+            unsigned *p = arena->AllocateArray<unsigned> (n);
+            unsigned *C = arena->AllocateArray<unsigned> (n);
+            bool *state = arena->AllocateArray<bool> (n);
+            void *tmpbuf = arena->AllocateBlock(dLCP::estimate_transfer_i_from_C_to_N_mem_req(n, nskip));
+
+            // form a random positive definite A with some unbounded indexes at the start
+            dMakeRandomMatrix (A2, n, n, 1.0);
+            dMultiply2 (A, A2, A2, n, n, n);
+            for (unsigned i = 0; i != n; ++i) A[(sizeint)i * nskip + i] += REAL(0.1) * n;
+            dClearUpperTriangle (A, n);
+
+            const unsigned nub = dRandInt (n / 4 + 1);
+            for (unsigned i = 0; i != n; ++i) {
+                dReal *currbx = pairsbx + (sizeint)i * PBX__MAX;
+                currbx[PBX_B] = dRandReal() - REAL(0.5);
+                currbx[PBX_X] = 0;
+                dReal *currlh = pairslh + (sizeint)i * PLH__MAX;
+                currlh[PLH_LO] = i < nub ? -dInfinity : REAL(-1.0);
+                currlh[PLH_HI] = i < nub ? dInfinity : REAL(1.0);
+            }
+            dSetZero (w, n);
+
+            dLCP lcp(n, nskip, nub, A, pairsbx, w, pairslh, L, d, Dell, ell, tmp, NULL, p, C, Arows, NULL);
+            lcp.assignState(state);
+
+            for (unsigned i = lcp.getNub(); i != n; ++i) {
+                // drive i while other indexes move between C and N, the unbounded ones staying in C
+                for (unsigned step = dRandInt (4); ; --step) {
+                    lcp.solve1 (delta_x, i, true);
+                    maxDiff = dMAX(maxDiff, compareCachedDell (lcp, i, freshDell));
+                    if (step == 0) break;
+
+                    const unsigned nC = lcp.numC(), nN = lcp.numN(), adj_nub = lcp.getNub();
+                    if (nN != 0 && (nC == adj_nub || dRandInt (2) == 0)) {
+                        lcp.transfer_i_from_N_to_C (lcp.indexN (dRandInt (nN)));
+                    }
+                    else if (nC != adj_nub) {
+                        lcp.transfer_i_from_C_to_N (lcp.indexC (adj_nub + dRandInt (nC - adj_nub)), tmpbuf);
+                    }
+                    maxDiff = dMAX(maxDiff, compareFactorization (lcp, freshL, freshd));
+                }
+
+                if (dRandInt (3) != 0) {
+                    lcp.solve1 (delta_x, i, false, 1);
+                    lcp.transfer_i_to_C (i);
+                    maxDiff = dMAX(maxDiff, compareFactorization (lcp, freshL, freshd));
+                }
+                else {
+                    lcp.transfer_i_to_N (i);
+                }
+            }
+
+        } END_STATE_SAVE(arena, saveInner);
+    }
+
+    dxFreeTemporaryWorldProcessMemArena(arena);
+    return maxDiff;
+}
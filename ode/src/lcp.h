@@ -51,6 +51,8 @@ to be implemented. the first `nub' variables are assumed to have findex < 0.
 #define _ODE_LCP_H_
 
 class dxWorldProcessMemArena;
+class dxResourceRequirementDescriptor;
+class dxRequiredResourceContainer;
 
 enum dxLCPBXElement
 {
@@ -72,10 +74,28 @@ enum dxLCPLHElement
     PLH__MAX,
 };
 
+/*
+
+if the `cooperation' parameter is not NULL, the initial factorization of the
+unbounded variables and the factorization updates of the large index sets are
+performed cooperatively by up to m_allowedThreadCount threads with the resources
+estimated by dxEstimateCooperativeSolveLCPResourceRequirements().
+
+*/
+
+struct dxLCPCooperationInfo
+{
+    dxRequiredResourceContainer *m_resourceContainer;
+    unsigned m_allowedThreadCount;
+};
+
 void dxSolveLCP (dxWorldProcessMemArena *memarena, 
     unsigned n, dReal *A, dReal pairsbx[PBX__MAX], dReal *w,
-    unsigned nub, dReal pairslh[PLH__MAX], int *findex);
+    unsigned nub, dReal pairslh[PLH__MAX], int *findex,
+    const dxLCPCooperationInfo *cooperation=NULL);
 
 sizeint dxEstimateSolveLCPMemoryReq(unsigned n, bool outer_w_avail);
+void dxEstimateCooperativeSolveLCPResourceRequirements(dxResourceRequirementDescriptor *requirementsDescriptor, 
+    unsigned allowedThreadCount, unsigned n);
 
 #endif
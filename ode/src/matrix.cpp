@@ -291,8 +291,21 @@ int dxIsPositiveDefinite(const dReal *A, unsigned n, void *tmpBuf/*[nskip*(n+1)]
 }
 
 
+// One element of the rank-2 update sweep: ell is L(p,j), w1 and w2 are the
+// update vector elements of the row p and the rest are the scalars of the column j.
+static inline 
+void updateLDLTAddTLElement(dReal &ell, dReal &w1, dReal &w2, dReal k1, dReal k2, dReal gamma1, dReal gamma2)
+{
+    dReal Wp = w1 - k1 * ell;
+    ell += gamma1 * Wp;
+    w1 = Wp;
+    Wp = w2 - k2 * ell;
+    ell -= gamma2 * Wp;
+    w2 = Wp;
+}
+
 /*extern */
-void dxLDLTAddTL(dReal *L, dReal *d, const dReal *a, unsigned n, unsigned nskip, void *tmpBuf/*[2*nskip]*/)
+void dxLDLTAddTL(dReal *L, dReal *d, const dReal *a, unsigned n, unsigned nskip, void *tmpBuf/*[4*nskip]*/)
 {
     dAASSERT(L && d && a && n > 0 && nskip >= n);
 
@@ -301,26 +314,26 @@ void dxLDLTAddTL(dReal *L, dReal *d, const dReal *a, unsigned n, unsigned nskip,
     dReal *alloctedBuf = NULL;
     sizeint allocatedSize;
 
-    dReal *W1 = (dReal *)tmpBuf;
+    dReal *K1 = (dReal *)tmpBuf;
     if (tmpBuf == NULL) {
-        allocatedSize = nskip * (2 * sizeof(dReal));
+        allocatedSize = nskip * (4 * sizeof(dReal));
         alloctedBuf = allocatedSize > STACK_ALLOC_MAX ? (dReal *)dAlloc(allocatedSize) : NULL;
-        W1 = alloctedBuf != NULL ? alloctedBuf : (dReal*)ALLOCA(allocatedSize);
+        K1 = alloctedBuf != NULL ? alloctedBuf : (dReal*)ALLOCA(allocatedSize);
     }
 
-    dReal *W2 = W1 + nskip;
+    // The update is applied to L row by row, a block of rows at a time, rather than 
+    // column by column so that the elements are accessed in the order they are stored.
+    // Every element still gets the same operations in the same order. The scalars of 
+    // each column are saved when its diagonal element is reached.
+    dReal *K2 = K1 + nskip, *G1 = K2 + nskip, *G2 = G1 + nskip;
 
-    W1[0] = REAL(0.0);
-    W2[0] = REAL(0.0);
-    for (unsigned j = 1; j < n; ++j) {
-        W1[j] = W2[j] = (dReal) (a[j] * M_SQRT1_2);
-    }
     dReal W11 = (dReal) ((REAL(0.5)*a[0]+1)*M_SQRT1_2);
     dReal W21 = (dReal) ((REAL(0.5)*a[0]-1)*M_SQRT1_2);
 
     dReal alpha1 = REAL(1.0);
     dReal alpha2 = REAL(1.0);
 
+    dReal k1_0, k2_0;
     {
         dReal dee = d[0];
         dReal alphanew = alpha1 + (W11*W11)*dee;
@@ -333,46 +346,76 @@ void dxLDLTAddTL(dReal *L, dReal *d, const dReal *a, unsigned n, unsigned nskip,
         dee /= alphanew;
         //dReal gamma2 = W21 * dee;
         alpha2 = alphanew;
-        dReal k1 = REAL(1.0) - W21*gamma1;
-        dReal k2 = W21*gamma1*W11 - W21;
-        dReal *ll = L + nskip;
-        for (unsigned p = 1; p < n; ll += nskip, ++p) {
-            dReal Wp = W1[p];
-            dReal ell = *ll;
-            W1[p] =    Wp - W11*ell;
-            W2[p] = k1*Wp +  k2*ell;
-        }
+        k1_0 = REAL(1.0) - W21*gamma1;
+        k2_0 = W21*gamma1*W11 - W21;
     }
 
-    dReal *ll = L + (nskip + 1);
-    for (unsigned j = 1; j < n; ll += nskip + 1, ++j) {
-        dReal k1 = W1[j];
-        dReal k2 = W2[j];
+    const unsigned blockRows = 4;
+    for (unsigned p = 1; p < n; p += blockRows) {
+        const unsigned rowCount = n - p < blockRows ? n - p : blockRows;
+        dReal *Lblock = L + (sizeint)p * nskip;
 
-        dReal dee = d[j];
-        dReal alphanew = alpha1 + (k1*k1)*dee;
-        dIASSERT(alphanew != dReal(0.0));
-        dee /= alphanew;
-        dReal gamma1 = k1 * dee;
-        dee *= alpha1;
-        alpha1 = alphanew;
-        alphanew = alpha2 - (k2*k2)*dee;
-        dee /= alphanew;
-        dReal gamma2 = k2 * dee;
-        dee *= alpha2;
-        d[j] = dee;
-        alpha2 = alphanew;
+        dReal W1[blockRows], W2[blockRows];
+        {
+            dReal *ll = Lblock;
+            for (unsigned r = 0; r != rowCount; ll += nskip, ++r) {
+                dReal Wp = (dReal) (a[p + r] * M_SQRT1_2);
+                dReal ell = *ll;
+                W1[r] =      Wp - W11*ell;
+                W2[r] = k1_0*Wp + k2_0*ell;
+            }
+        }
+
+        // the columns before the block
+        if (rowCount == blockRows) {
+            dReal *l0 = Lblock, *l1 = l0 + nskip, *l2 = l1 + nskip, *l3 = l2 + nskip;
+            for (unsigned j = 1; j < p; ++j) {
+                const dReal k1 = K1[j], k2 = K2[j], gamma1 = G1[j], gamma2 = G2[j];
+                updateLDLTAddTLElement(l0[j], W1[0], W2[0], k1, k2, gamma1, gamma2);
+                updateLDLTAddTLElement(l1[j], W1[1], W2[1], k1, k2, gamma1, gamma2);
+                updateLDLTAddTLElement(l2[j], W1[2], W2[2], k1, k2, gamma1, gamma2);
+                updateLDLTAddTLElement(l3[j], W1[3], W2[3], k1, k2, gamma1, gamma2);
+            }
+        }
+        else {
+            dReal *l = Lblock;
+            for (unsigned r = 0; r != rowCount; l += nskip, ++r) {
+                for (unsigned j = 1; j < p; ++j) {
+                    updateLDLTAddTLElement(l[j], W1[r], W2[r], K1[j], K2[j], G1[j], G2[j]);
+                }
+            }
+        }
+
+        // the columns within the block
+        dReal *l = Lblock;
+        for (unsigned r = 0; r != rowCount; l += nskip, ++r) {
+            for (unsigned q = 0; q != r; ++q) {
+                const unsigned j = p + q;
+                updateLDLTAddTLElement(l[j], W1[r], W2[r], K1[j], K2[j], G1[j], G2[j]);
+            }
 
-        dReal *l = ll + nskip;
-        for (unsigned p = j + 1; p < n; l += nskip, ++p) {
-            dReal ell = *l;
-            dReal Wp = W1[p] - k1 * ell;
-            ell += gamma1 * Wp;
-            W1[p] = Wp;
-            Wp = W2[p] - k2 * ell;
-            ell -= gamma2 * Wp;
-            W2[p] = Wp;
-            *l = ell;
+            const unsigned j = p + r;
+            dReal k1 = W1[r];
+            dReal k2 = W2[r];
+
+            dReal dee = d[j];
+            dReal alphanew = alpha1 + (k1*k1)*dee;
+            dIASSERT(alphanew != dReal(0.0));
+            dee /= alphanew;
+            dReal gamma1 = k1 * dee;
+            dee *= alpha1;
+            alpha1 = alphanew;
+            alphanew = alpha2 - (k2*k2)*dee;
+            dee /= alphanew;
+            dReal gamma2 = k2 * dee;
+            dee *= alpha2;
+            d[j] = dee;
+            alpha2 = alphanew;
+
+            K1[j] = k1;
+            K2[j] = k2;
+            G1[j] = gamma1;
+            G2[j] = gamma2;
         }
     }
 
@@ -396,7 +439,7 @@ void dxLDLTAddTL(dReal *L, dReal *d, const dReal *a, unsigned n, unsigned nskip,
 
 /*extern */
 void dxLDLTRemove(dReal **A, const unsigned *p, dReal *L, dReal *d,
-    unsigned n1, unsigned n2, unsigned r, unsigned nskip, void *tmpBuf/*n2 + 2*nskip*/)
+    unsigned n1, unsigned n2, unsigned r, unsigned nskip, void *tmpBuf/*n2 + 4*nskip*/)
 {
     dAASSERT(A && p && L && d && n1 > 0 && n2 > 0 /*&& r >= 0 */&& r < n2 &&
         n1 >= n2 && nskip >= n1);
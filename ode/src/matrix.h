@@ -141,7 +141,7 @@ ODE_PURE_INLINE sizeint dxEstimateIsPositiveDefiniteTmpbufSize(unsigned n)
 
 ODE_PURE_INLINE sizeint dxEstimateLDLTAddTLTmpbufSize(unsigned nskip)
 {
-    return nskip * (2 * sizeof(dReal));
+    return nskip * (4 * sizeof(dReal));
 }
 
 ODE_PURE_INLINE sizeint dxEstimateLDLTRemoveTmpbufSize(unsigned n2, unsigned nskip)
@@ -32,6 +32,8 @@
 #include "threading_impl.h"
 #include "matrix.h"
 #include "util.h"
+#include "quickstep_cache.h"
+#include "step_profile.h"
 
 
 #define dWORLD_DEFAULT_GLOBAL_ERP REAL(0.2)
@@ -80,7 +82,11 @@ dxQuickStepParameters::dxQuickStepParameters(void *) :
     m_maxExtraIterationCount(DeriveExtraIterationCount(dWORLDQUICKSTEP_ITERATION_COUNT_DEFAULT, dWORLDQUICKSTEP_MAXIMAL_EXTRA_ITERATION_COUNT_FACTOR_DEFAULT)),
     m_maxExtraIterationsFactor(dWORLDQUICKSTEP_MAXIMAL_EXTRA_ITERATION_COUNT_FACTOR_DEFAULT),
     m_statistics(&m_internal_statistics),
-    w(REAL(1.3))
+    w(REAL(1.3)),
+    m_warmStartingMode(dWorldQuickStepWarmStartNone),
+    m_warmStartingFactor(dWORLDQUICKSTEP_WARM_STARTING_FACTOR_DEFAULT),
+    m_warmStartingContactTolerance(dWORLDQUICKSTEP_WARM_STARTING_CONTACT_TOLERANCE_DEFAULT),
+    m_iterationScheduling(dWorldQuickStepIterationSchedulingDependencyMap)
 {
     std::copy(g_QuickStepParameters_marginalDeltaValuesInitializer, g_QuickStepParameters_marginalDeltaValuesInitializer + dARRAY_SIZE(g_QuickStepParameters_marginalDeltaValuesInitializer), m_marginalDeltaValues);
     dSASSERT(dARRAY_SIZE(g_QuickStepParameters_marginalDeltaValuesInitializer) == dARRAY_SIZE(m_marginalDeltaValues));
@@ -103,6 +109,8 @@ dxWorld::dxWorld():
     firstjoint(NULL),
     nb(0),
     nj(0),
+    firstawakebody(NULL),
+    island_epoch(0),
     global_erp(dWORLD_DEFAULT_GLOBAL_ERP),
     global_cfm(dWORLD_DEFAULT_GLOBAL_CFM),
     adis(NULL),
@@ -110,6 +118,8 @@ dxWorld::dxWorld():
     islands_max_threads(dWORLDSTEP_THREADCOUNT_UNLIMITED),
     wmem(NULL),
     qs(NULL),
+    qs_contact_cache(NULL),
+    step_profile(NULL),
     contactp(NULL),
     dampingp(NULL),
     max_angular_speed(dInfinity),
@@ -127,6 +137,9 @@ dxWorld::~dxWorld()
         wmem->CleanupWorldReferences(this);
         wmem->Release();
     }
+
+    delete qs_contact_cache;
+    delete step_profile;
 }
 
 
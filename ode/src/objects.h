@@ -41,6 +41,8 @@
 struct dxJointNode;
 class dxStepWorkingMemory;
 class dxWorldProcessContext;
+class dxContactImpulseCache;
+class dxStepProfile;
 
 
 // some body flags
@@ -72,13 +74,14 @@ struct dBase {
 // base class for bodies and joints
 
 struct dObject : public dBase {
-    explicit dObject(dxWorld *w) : world(w), next(NULL), tome(NULL), tag(0), userdata(NULL) {}
+    explicit dObject(dxWorld *w) : world(w), next(NULL), tome(NULL), tag(0), island_epoch(0), userdata(NULL) {}
     virtual ~dObject();
 
     dxWorld *world;		// world this object is in
     dObject *next;		// next object of this type in list
     dObject **tome;		// pointer to previous object's next ptr
     int tag;			// used by dynamics algorithms
+    unsigned island_epoch;	// island building pass the tag was last assigned at
     void *userdata;		// user settable data
 };
 
@@ -173,6 +176,22 @@ public:
     volatile atomicord32 *GetStatisticsProlongedExecutionsStorage() const { dSASSERT(sizeof(atomicord32) == membersize(dWorldQuickStepIterationCount_DynamicAdjustmentStatistics, prolonged_execs)); return _type_cast_union<atomicord32>(&m_statistics->prolonged_execs); }
     volatile atomicord32 *GetStatisticsFullExtraExecutionsStorage() const { dSASSERT(sizeof(atomicord32) == membersize(dWorldQuickStepIterationCount_DynamicAdjustmentStatistics, full_extra_execs)); return _type_cast_union<atomicord32>(&m_statistics->full_extra_execs); }
 
+    void AssignWarmStartingMode(unsigned mode) { dIASSERT((mode & ~(unsigned)dWorldQuickStepWarmStartAll) == 0); m_warmStartingMode = mode; }
+    unsigned GetWarmStartingMode() const { return m_warmStartingMode; }
+    bool GetIsWarmStartingEnabled() const { return m_warmStartingMode != dWorldQuickStepWarmStartNone; }
+    bool GetIsJointsWarmStartingEnabled() const { return (m_warmStartingMode & dWorldQuickStepWarmStartJoints) != 0; }
+    bool GetIsContactsWarmStartingEnabled() const { return (m_warmStartingMode & dWorldQuickStepWarmStartContacts) != 0; }
+
+    void AssignWarmStartingFactor(dReal factor) { dIASSERT(factor >= 0); m_warmStartingFactor = factor; }
+    dReal GetWarmStartingFactor() const { return m_warmStartingFactor; }
+
+    void AssignWarmStartingContactTolerance(dReal tolerance) { dIASSERT(tolerance >= 0); m_warmStartingContactTolerance = tolerance; }
+    dReal GetWarmStartingContactTolerance() const { return m_warmStartingContactTolerance; }
+
+    void AssignIterationScheduling(unsigned scheduling) { dIASSERT(scheduling < dWorldQuickStepIterationScheduling__MAX); m_iterationScheduling = scheduling; }
+    unsigned GetIterationScheduling() const { return m_iterationScheduling; }
+    bool GetIsColoredIterationSchedulingEnabled() const { return m_iterationScheduling == dWorldQuickStepIterationSchedulingColoring; }
+
 private:
     static unsigned DeriveExtraIterationCount(unsigned iterationCount, dReal extraIterationCountFactor)
     {
@@ -196,6 +215,10 @@ public:
     bool m_dynamicIterationCountAdjustmentEnabled;
     dWorldQuickStepIterationCount_DynamicAdjustmentStatistics *m_statistics; // Adjustment statistics (the internal one or an externally assigned)
     dReal w;                               // the SOR over-relaxation parameter
+    unsigned m_warmStartingMode;           // dWorldQuickStepWarmStart... flags
+    dReal m_warmStartingFactor;            // multiplier applied to the impulses of the previous step
+    dReal m_warmStartingContactTolerance;  // maximal distance to match a contact with one of the previous step
+    unsigned m_iterationScheduling;        // dWorldQuickStepIterationScheduling... method for multithreaded SOR iterations
 
 private:
     dWorldQuickStepIterationCount_DynamicAdjustmentStatistics m_internal_statistics; // The internal statistics is used to not have to check m_statistics for NULL; the local instance is used instead of a global one to avoid cache line conflicts between different threads possibly serving separate worlds.
@@ -221,7 +244,11 @@ struct dxPosR {
 struct dxBody : public dObject {
     dxBody(dxWorld *w);
 
+    bool isAwake() const { return awake_tome != NULL; }
+
     dxJointNode *firstjoint;	// list of attached joints
+    dxBody *awake_next;		// next body in the world's awake body list
+    dxBody **awake_tome;		// pointer to previous awake body's next ptr (NULL if not in the list)
     unsigned flags;			// some dxBodyFlagXXX flags
     dGeomID geom;			// first collision geom associated with body
     dMass mass;			// mass parameters about POR
@@ -267,6 +294,28 @@ public:
 
     dxWorldProcessContext *unsafeGetWorldProcessingContext() const;
 
+    // The awake list contains all the enabled bodies of the world. Islands are only
+    // searched from these so that sleeping bodies do not cost anything per step.
+    void addAwakeBody(dxBody *b)
+    {
+        if (!b->isAwake()) {
+            b->awake_next = firstawakebody;
+            b->awake_tome = &firstawakebody;
+            if (firstawakebody != NULL) firstawakebody->awake_tome = &b->awake_next;
+            firstawakebody = b;
+        }
+    }
+
+    void removeAwakeBody(dxBody *b)
+    {
+        if (b->isAwake()) {
+            if (b->awake_next != NULL) b->awake_next->awake_tome = b->awake_tome;
+            *b->awake_tome = b->awake_next;
+            b->awake_next = NULL;
+            b->awake_tome = NULL;
+        }
+    }
+
 private: // dxIThreadingDefaultImplProvider
     virtual const dxThreadingFunctionsInfo *retrieveThreadingDefaultImpl(dThreadingImplementationID &out_defaultImpl);
 
@@ -274,6 +323,8 @@ public:
     dxBody *firstbody;		// body linked list
     dxJoint *firstjoint;		// joint linked list
     int nb, nj;			// number of bodies and joints in lists
+    dxBody *firstawakebody;	// linked list of enabled bodies (see addAwakeBody())
+    unsigned island_epoch;	// number of the last island building pass
     dVector3 gravity;		// gravity vector (m/s/s)
     dReal global_erp;		// global error reduction parameter
     dReal global_cfm;		// global constraint force mixing parameter
@@ -283,6 +334,8 @@ public:
     dxStepWorkingMemory *wmem; // Working memory object for dWorldStep/dWorldQuickStep
 
     dxQuickStepParameters qs;
+    dxContactImpulseCache *qs_contact_cache; // Contact impulses of the last QuickStep for warm starting
+    dxStepProfile *step_profile; // Stage timings of the last step, only allocated while profiling is enabled
     dxContactParameters contactp;
     dxDampingParameters dampingp; // damping parameters
     dReal max_angular_speed;      // limit the angular velocity to this magnitude
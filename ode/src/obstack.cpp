@@ -105,6 +105,26 @@ void *dObStack::alloc (sizeint num_bytes)
 }
 
 
+void *dObStack::allocSeries (sizeint num_bytes, sizeint max_count, sizeint *count)
+{
+    dIASSERT (max_count != 0);
+
+    // the first block may need an arena switch, the rest just extend it
+    char *c = (char *) alloc (num_bytes);
+
+    const sizeint stride = dEFFICIENT_SIZE (num_bytes);
+    const sizeint free_bytes = dOBSTACK_ARENA_SIZE - m_last->m_used;
+    sizeint extra_count = free_bytes >= num_bytes ? (free_bytes - num_bytes) / stride + 1 : 0;
+    if (extra_count > max_count - 1) {
+        extra_count = max_count - 1;
+    }
+
+    m_last->m_used += extra_count * stride;
+    *count = extra_count + 1;
+    return c;
+}
+
+
 void dObStack::freeAll()
 {
     Arena *current = m_first;
@@ -37,6 +37,12 @@ struct dObStack : public dBase {
     // allocate a block in the last arena, allocating a new arena if necessary.
     // it is a runtime error if num_bytes is larger than the arena size.
 
+    void *allocSeries (sizeint num_bytes, sizeint max_count, sizeint *count);
+    // allocate up to max_count blocks of num_bytes each at once, as many as
+    // fit in the last arena (at least one). the blocks are laid out as the
+    // same number of alloc() calls would place them, dEFFICIENT_SIZE(num_bytes)
+    // apart. the number of blocks allocated is returned in *count.
+
     void freeAll();
     // free all blocks in all arenas. this does not deallocate the arenas
     // themselves, so future alloc()s will reuse them.
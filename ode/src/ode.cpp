@@ -34,9 +34,12 @@
 #include "matrix.h"
 #include "odemath.h"
 #include "objects.h"
+#include "collision_kernel.h"
 #include "joints/joints.h"
 #include "step.h"
 #include "quickstep.h"
+#include "quickstep_cache.h"
+#include "step_profile.h"
 #include "util.h"
 #include "odetls.h"
 
@@ -98,6 +101,49 @@ static void removeJointReferencesFromAttachedBodies (dxJoint *j)
     j->node[1].next = NULL;
 }
 
+
+// attach a joint that is not attached to anything to the bodies
+
+static void linkJointToBodies (dxJoint *joint, dxBody *body1, dxBody *body2)
+{
+    // if a body is zero, make sure that it is body2, so 0 --> node[1].body
+    if (body1 == NULL) {
+        body1 = body2;
+        body2 = NULL;
+        joint->flags |= dJOINT_REVERSE;
+    }
+    else {
+        joint->flags &= (~dJOINT_REVERSE);
+    }
+
+    // attach to new bodies
+    joint->node[0].body = body1;
+    joint->node[1].body = body2;
+    
+    if (body1 != NULL) {
+        joint->node[1].next = body1->firstjoint;
+        body1->firstjoint = &joint->node[1];
+    }
+    else {
+        joint->node[1].next = NULL;
+    }
+    
+    if (body2 != NULL) {
+        joint->node[0].next = body2->firstjoint;
+        body2->firstjoint = &joint->node[0];
+    }
+    else {
+        joint->node[0].next = NULL;
+    }
+
+    // Since the bodies are now set.
+    // Calculate the values depending on the bodies.
+    // Only need to calculate relative value if a body exist
+    if (body1 != NULL || body2 != NULL) {
+        joint->setRelativeValues();
+    }
+}
+
 //****************************************************************************
 // debugging
 
@@ -242,6 +288,8 @@ dxBody *dBodyCreate (dxWorld *w)
     dAASSERT (w);
     dxBody *b = new dxBody(w);
     b->firstjoint = NULL;
+    b->awake_next = NULL;
+    b->awake_tome = NULL;
     b->flags = 0;
     b->geom = NULL;
     b->average_lvel_buffer = NULL;
@@ -262,6 +310,7 @@ dxBody *dBodyCreate (dxWorld *w)
     dSetZero (b->tacc,4);
     dSetZero (b->finite_rot_axis,4);
     addObjectToList (b,(dObject **) &w->firstbody);
+    w->addAwakeBody (b);
     w->nb++;
 
     // set auto-disable parameters
@@ -311,6 +360,7 @@ void dBodyDestroy (dxBody *b)
         removeJointReferencesFromAttachedBodies (n->joint);
         n = next;
     }
+    b->world->removeAwakeBody (b);
     removeObjectFromList (b);
     b->world->nb--;
 
@@ -851,6 +901,7 @@ void dBodyEnable (dBodyID b)
 {
     dAASSERT (b);
     b->flags &= ~dxBodyDisabled;
+    b->world->addAwakeBody (b);
     b->adis_stepsleft = b->adis.idle_steps;
     b->adis_timeleft = b->adis.idle_time;
     // no code for average-processing needed here
@@ -861,6 +912,7 @@ void dBodyDisable (dBodyID b)
 {
     dAASSERT (b);
     b->flags |= dxBodyDisabled;
+    b->world->removeAwakeBody (b);
 }
 
 
@@ -997,6 +1049,7 @@ void dBodySetAutoDisableFlag (dBodyID b, int do_auto_disable)
         b->flags &= ~dxBodyAutoDisable;
         // (mg) we should also reset the IsDisabled state to correspond to the DoDisabling flag
         b->flags &= ~dxBodyDisabled;
+        b->world->addAwakeBody (b);
         b->adis.idle_steps = dWorldGetAutoDisableSteps(b->world);
         b->adis.idle_time = dWorldGetAutoDisableTime(b->world);
         // resetting the average calculations too
@@ -1189,6 +1242,18 @@ dxJoint * dJointCreateSlider (dWorldID w, dJointGroupID group)
 }
 
 
+// The geom serials keep the impulses of destroyed geoms from being matched to
+// new geoms at the same addresses. The geoms are only looked at with the contact
+// warm starting so that the contacts made up without valid geoms stay allowed.
+static inline void setContactGeomSerials (dxJointContact *j, const dxWorld *w)
+{
+    if (w->qs.GetIsContactsWarmStartingEnabled()) {
+        const dContactGeom &g = j->contact.geom;
+        j->geom_serials[0] = g.g1 != NULL ? g.g1->serial : 0;
+        j->geom_serials[1] = g.g2 != NULL ? g.g2->serial : 0;
+    }
+}
+
 dxJoint * dJointCreateContact (dWorldID w, dJointGroupID group,
                                const dContact *c)
 {
@@ -1196,10 +1261,61 @@ dxJoint * dJointCreateContact (dWorldID w, dJointGroupID group,
     dxJointContact *j = (dxJointContact *)
         createJoint<dxJointContact> (w,group);
     j->contact = *c;
+    setContactGeomSerials (j, w);
     return j;
 }
 
 
+void dJointCreateContactBatch (dWorldID w, dJointGroupID group,
+                               const dContact *contacts, unsigned contact_count,
+                               const dBodyID *body_pairs, dJointID *joints)
+{
+    dAASSERT (w && (contacts || contact_count == 0));
+
+    const sizeint stride = dEFFICIENT_SIZE(sizeof(dxJointContact));
+
+    unsigned index = 0;
+    while (index != contact_count) {
+        // the group joints are made an arena at a time
+        char *series;
+        sizeint series_count;
+        if (group) {
+            series = (char *)group->allocSeries<dxJointContact>(w, contact_count - index, &series_count);
+            if (series == NULL) break;
+        } else {
+            series = (char *)new dxJointContact(w);
+            series_count = 1;
+        }
+
+        for (sizeint k = 0; k != series_count; ++k, ++index) {
+            dxJointContact *j = (dxJointContact *)(series + k * stride);
+            const dContact &c = contacts[index];
+            j->contact = c;
+            setContactGeomSerials (j, w);
+
+            dxBody *body1, *body2;
+            if (body_pairs != NULL) {
+                body1 = body_pairs[2 * index];
+                body2 = body_pairs[2 * index + 1];
+            } else {
+                body1 = c.geom.g1 != NULL ? dGeomGetBody(c.geom.g1) : NULL;
+                body2 = c.geom.g2 != NULL ? dGeomGetBody(c.geom.g2) : NULL;
+            }
+            dUASSERT (body1 == NULL || body1 != body2, "can't have body1==body2");
+            dUASSERT ((body1 == NULL || body1->world == w) && (body2 == NULL || body2->world == w),
+                "joint and bodies must be in same world");
+
+            // a new joint is not attached anywhere yet
+            linkJointToBodies (j, body1, body2);
+
+            if (joints != NULL) {
+                joints[index] = j;
+            }
+        }
+    }
+}
+
+
 dxJoint * dJointCreateHinge2 (dWorldID w, dJointGroupID group)
 {
     dAASSERT (w);
@@ -1400,44 +1516,10 @@ void dJointAttach (dxJoint *joint, dxBody *body1, dxBody *body2)
         removeJointReferencesFromAttachedBodies (joint);
     }
 
-    // if a body is zero, make sure that it is body2, so 0 --> node[1].body
-    if (body1 == NULL) {
-        body1 = body2;
-        body2 = NULL;
-        joint->flags |= dJOINT_REVERSE;
-    }
-    else {
-        joint->flags &= (~dJOINT_REVERSE);
-    }
-
-    // attach to new bodies
-    joint->node[0].body = body1;
-    joint->node[1].body = body2;
-    
-    if (body1 != NULL) {
-        joint->node[1].next = body1->firstjoint;
-        body1->firstjoint = &joint->node[1];
-    }
-    else {
-        joint->node[1].next = NULL;
-    }
-    
-    if (body2 != NULL) {
-        joint->node[0].next = body2->firstjoint;
-        body2->firstjoint = &joint->node[0];
-    }
-    else {
-        joint->node[0].next = NULL;
-    }
-
-    // Since the bodies are now set.
-    // Calculate the values depending on the bodies.
-    // Only need to calculate relative value if a body exist
-    if (body1 != NULL || body2 != NULL) {
-        joint->setRelativeValues();
-    }
+    linkJointToBodies (joint, body1, body2);
 }
 
+
 void dJointEnable (dxJoint *joint)
 {
     dAASSERT (joint);
@@ -1832,15 +1914,24 @@ int dWorldStep (dWorldID w, dReal stepsize)
 
     bool result = false;
 
-    dxWorldProcessIslandsInfo islandsinfo;
-    if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateStepMemoryRequirements))
+    dxStepProfile *profile = w->step_profile;
+    if (profile != NULL) profile->beginStep();
+
     {
-        if (dxProcessIslands (w, islandsinfo, stepsize, &dxStepIsland, &dxEstimateStepMaxCallCount))
+        dxStepProfileScope profileScope(profile, dStepProfileStageTotal);
+
+        dxWorldProcessIslandsInfo islandsinfo;
+        if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateStepMemoryRequirements))
         {
-            result = true;
+            if (dxProcessIslands (w, islandsinfo, stepsize, &dxStepIsland, &dxEstimateStepMaxCallCount))
+            {
+                result = true;
+            }
         }
     }
 
+    if (profile != NULL) profile->endStep();
+
     return result;
 }
 
@@ -1851,19 +1942,85 @@ int dWorldQuickStep (dWorldID w, dReal stepsize)
 
     bool result = false;
 
-    dxWorldProcessIslandsInfo islandsinfo;
-    if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
+    dxStepProfile *profile = w->step_profile;
+    if (profile != NULL) profile->beginStep();
+
     {
-        if (dxProcessIslands (w, islandsinfo, stepsize, &dxQuickStepIsland, &dxEstimateQuickStepMaxCallCount))
+        dxStepProfileScope profileScope(profile, dStepProfileStageTotal);
+
+        dxWorldProcessIslandsInfo islandsinfo;
+        if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
         {
-            result = true;
+            if (dxProcessIslands (w, islandsinfo, stepsize, &dxQuickStepIsland, &dxEstimateQuickStepMaxCallCount))
+            {
+                if (w->qs.GetIsContactsWarmStartingEnabled())
+                {
+                    dxContactImpulseCache *contactCache = w->qs_contact_cache;
+                    if (contactCache == NULL)
+                    {
+                        w->qs_contact_cache = contactCache = new dxContactImpulseCache();
+                    }
+                    contactCache->rebuild(islandsinfo.GetJointsArray(), islandsinfo.GetJointsCount());
+                }
+
+                result = true;
+            }
         }
     }
 
+    if (profile != NULL) profile->endStep();
+
     return result;
 }
 
 
+void dWorldSetStepProfiling (dWorldID w, int enabled)
+{
+    dAASSERT(w);
+
+    delete w->step_profile;
+    w->step_profile = enabled ? new dxStepProfile() : NULL;
+}
+
+int dWorldGetStepProfiling (dWorldID w)
+{
+    dAASSERT(w);
+    return w->step_profile != NULL;
+}
+
+int dWorldGetStepProfileStage (dWorldID w, int stage, dStepProfileStageInfo *info)
+{
+    dAASSERT(w);
+    dUASSERT(stage >= dStepProfileStageTotal && stage < dStepProfileStage__MAX, "invalid stage");
+    dAASSERT(info);
+
+    const dxStepProfile *profile = w->step_profile;
+    return profile != NULL && profile->getStageInfo(stage, info);
+}
+
+unsigned dWorldGetStepProfileThreadCount (dWorldID w)
+{
+    dAASSERT(w);
+
+    const dxStepProfile *profile = w->step_profile;
+    return profile != NULL ? profile->getThreadCount() : 0;
+}
+
+double dWorldGetStepProfileThreadTime (dWorldID w, unsigned thread_index, int stage)
+{
+    dAASSERT(w);
+    dUASSERT(stage >= dStepProfileStageTotal && stage < dStepProfileStage__MAX, "invalid stage");
+
+    const dxStepProfile *profile = w->step_profile;
+    return profile != NULL ? profile->getThreadTime(thread_index, stage) : 0.0;
+}
+
+const char *dStepProfileStageName (int stage)
+{
+    return dxStepProfile::getStageName(stage);
+}
+
+
 void dWorldImpulseToForce (dWorldID w, dReal stepsize,
                            dReal ix, dReal iy, dReal iz,
                            dVector3 force)
@@ -1877,6 +2034,131 @@ void dWorldImpulseToForce (dWorldID w, dReal stepsize,
 }
 
 
+// bulk body state functions
+
+int dWorldGetBodies (dWorldID w, dBodyID *bodies, int max_count)
+{
+    dAASSERT (w && (bodies || max_count == 0));
+
+    int i = 0;
+    for (dxBody *b = w->firstbody; b != NULL && i < max_count; b = (dxBody *) b->next) {
+        bodies[i++] = b;
+    }
+    return w->nb;
+}
+
+void dWorldGetBodyStates (dWorldID w, const dBodyID *bodies, int count, const dBodyStates *states)
+{
+    dAASSERT (w && (bodies || count == 0) && states);
+
+    // one pass per array keeps the writes sequential
+    if (states->pos) {
+        dReal *pos = states->pos;
+        for (int i = 0; i < count; ++i, pos += 3) {
+            const dxBody *b = bodies[i];
+            dUASSERT (b->world == w, "body must be in the world");
+            dCopyVector3 (pos, b->posr.pos);
+        }
+    }
+    if (states->q) {
+        dReal *q = states->q;
+        for (int i = 0; i < count; ++i, q += 4) {
+            dCopyVector4 (q, bodies[i]->q);
+        }
+    }
+    if (states->R) {
+        dReal *R = states->R;
+        for (int i = 0; i < count; ++i, R += 12) {
+            dCopyMatrix4x4 (R, bodies[i]->posr.R);
+        }
+    }
+    if (states->lvel) {
+        dReal *lvel = states->lvel;
+        for (int i = 0; i < count; ++i, lvel += 3) {
+            dCopyVector3 (lvel, bodies[i]->lvel);
+        }
+    }
+    if (states->avel) {
+        dReal *avel = states->avel;
+        for (int i = 0; i < count; ++i, avel += 3) {
+            dCopyVector3 (avel, bodies[i]->avel);
+        }
+    }
+    if (states->force) {
+        dReal *force = states->force;
+        for (int i = 0; i < count; ++i, force += 3) {
+            dCopyVector3 (force, bodies[i]->facc);
+        }
+    }
+    if (states->torque) {
+        dReal *torque = states->torque;
+        for (int i = 0; i < count; ++i, torque += 3) {
+            dCopyVector3 (torque, bodies[i]->tacc);
+        }
+    }
+    if (states->invMass) {
+        dReal *invMass = states->invMass;
+        for (int i = 0; i < count; ++i) {
+            invMass[i] = bodies[i]->invMass;
+        }
+    }
+    if (states->invI) {
+        dReal *invI = states->invI;
+        for (int i = 0; i < count; ++i, invI += 12) {
+            dCopyMatrix4x4 (invI, bodies[i]->invI);
+        }
+    }
+}
+
+void dWorldSetBodyForces (dWorldID w, const dBodyID *bodies, int count, const dReal *forces, const dReal *torques)
+{
+    dAASSERT (w && (bodies || count == 0));
+
+    for (int i = 0; i < count; ++i) {
+        dxBody *b = bodies[i];
+        dUASSERT (b->world == w, "body must be in the world");
+        if (forces) {
+            dCopyVector3 (b->facc, forces + 3 * i);
+        }
+        if (torques) {
+            dCopyVector3 (b->tacc, torques + 3 * i);
+        }
+    }
+}
+
+void dWorldAddBodyForces (dWorldID w, const dBodyID *bodies, int count, const dReal *forces, const dReal *torques)
+{
+    dAASSERT (w && (bodies || count == 0));
+
+    for (int i = 0; i < count; ++i) {
+        dxBody *b = bodies[i];
+        dUASSERT (b->world == w, "body must be in the world");
+        if (forces) {
+            dAddVectors3 (b->facc, b->facc, forces + 3 * i);
+        }
+        if (torques) {
+            dAddVectors3 (b->tacc, b->tacc, torques + 3 * i);
+        }
+    }
+}
+
+void dWorldSetBodyVelocities (dWorldID w, const dBodyID *bodies, int count, const dReal *lvels, const dReal *avels)
+{
+    dAASSERT (w && (bodies || count == 0));
+
+    for (int i = 0; i < count; ++i) {
+        dxBody *b = bodies[i];
+        dUASSERT (b->world == w, "body must be in the world");
+        if (lvels) {
+            dCopyVector3 (b->lvel, lvels + 3 * i);
+        }
+        if (avels) {
+            dCopyVector3 (b->avel, avels + 3 * i);
+        }
+    }
+}
+
+
 // world auto-disable functions
 
 dReal dWorldGetAutoDisableLinearThreshold (dWorldID w)
@@ -2146,6 +2428,75 @@ dReal dWorldGetQuickStepW (dWorldID w)
 }
 
 
+void dWorldSetQuickStepWarmStarting (dWorldID w, int mode)
+{
+    dAASSERT(w);
+    dUASSERT((mode & ~dWorldQuickStepWarmStartAll) == 0, "invalid warm starting mode");
+
+    w->qs.AssignWarmStartingMode((unsigned)mode & dWorldQuickStepWarmStartAll);
+
+    if (!w->qs.GetIsContactsWarmStartingEnabled() && w->qs_contact_cache != NULL) {
+        delete w->qs_contact_cache;
+        w->qs_contact_cache = NULL;
+    }
+}
+
+
+int dWorldGetQuickStepWarmStarting (dWorldID w)
+{
+    dAASSERT(w);
+    return (int)w->qs.GetWarmStartingMode();
+}
+
+
+void dWorldSetQuickStepWarmStartingFactor (dWorldID w, dReal factor)
+{
+    dAASSERT(w);
+    dUASSERT(factor >= 0, "warm starting factor must not be negative");
+    w->qs.AssignWarmStartingFactor(factor);
+}
+
+
+dReal dWorldGetQuickStepWarmStartingFactor (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.GetWarmStartingFactor();
+}
+
+
+void dWorldSetQuickStepWarmStartingContactTolerance (dWorldID w, dReal tolerance)
+{
+    dAASSERT(w);
+    dUASSERT(tolerance >= 0, "contact tolerance must not be negative");
+    w->qs.AssignWarmStartingContactTolerance(tolerance);
+}
+
+
+dReal dWorldGetQuickStepWarmStartingContactTolerance (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.GetWarmStartingContactTolerance();
+}
+
+
+void dWorldSetQuickStepIterationScheduling (dWorldID w, int scheduling)
+{
+    dAASSERT(w);
+    dUASSERT(dIN_RANGE(scheduling, dWorldQuickStepIterationSchedulingDependencyMap, dWorldQuickStepIterationScheduling__MAX), "invalid iteration scheduling");
+
+    if (dIN_RANGE(scheduling, dWorldQuickStepIterationSchedulingDependencyMap, dWorldQuickStepIterationScheduling__MAX)) {
+        w->qs.AssignIterationScheduling((unsigned)scheduling);
+    }
+}
+
+
+int dWorldGetQuickStepIterationScheduling (dWorldID w)
+{
+    dAASSERT(w);
+    return (int)w->qs.GetIterationScheduling();
+}
+
+
 void dWorldSetContactMaxCorrectingVel (dWorldID w, dReal vel)
 {
     dAASSERT(w);
@@ -30,8 +30,12 @@
 #include "odemath.h"
 #include "objects.h"
 #include "joints/joint.h"
+#include "joints/contact.h"
 #include "lcp.h"
 #include "util.h"
+#include "quickstep_cache.h"
+#include "step_profile.h"
+#include "simd.h"
 #include "threadingutils.h"
 
 #include <new>
@@ -43,12 +47,10 @@
 //***************************************************************************
 // configuration
 
-// for the SOR and CG methods:
-// uncomment the following line to use warm starting. this definitely
-// help for motor-driven joints. unfortunately it appears to hurt
-// with high-friction contacts using the SOR method. use with care
-
-// #define WARM_STARTING 1
+// for the SOR method:
+// warm starting is selected at run time with dWorldSetQuickStepWarmStarting(). 
+// this definitely helps for motor-driven joints. unfortunately it appears 
+// to hurt with high-friction contacts using the SOR method. use with care
 
 
 #define REORDERING_METHOD__DONT_REORDER 0
@@ -107,31 +109,27 @@ struct IndexError;
 #define dxQUICKSTEPISLAND_STAGE2B_STEP  16U
 #define dxQUICKSTEPISLAND_STAGE2C_STEP  32U
 
-#ifdef WARM_STARTING
-#define dxQUICKSTEPISLAND_STAGE4A_STEP  256U
-#else
 #define dxQUICKSTEPISLAND_STAGE4A_STEP  512U
-#endif
+#define dxQUICKSTEPISLAND_STAGE4A_WARM_STEP  256U
 
 #define dxQUICKSTEPISLAND_STAGE4LCP_IMJ_STEP 8U
 #define dxQUICKSTEPISLAND_STAGE4LCP_AD_STEP  8U
 
-#ifdef WARM_STARTING
-#define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP  128U
-#define dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR  4
-#define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_PREPARE  (dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP * dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR)
-#define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_COMPLETE (dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP)
-#define dxQUICKSTEPISLAND_STAGE4LCP_FORCEMAXADJ_STEP (dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_PREPARE * CFE__MAX / FAE__MAX)
-#else
 #define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP  (dxQUICKSTEPISLAND_STAGE4A_STEP / 2) // Average info.m is 3 for stage4a, while there are 6 reals per index in fc
 #define dxQUICKSTEPISLAND_STAGE4LCP_FORCEMAXADJ_STEP (dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP * CFE__MAX / FAE__MAX)
-#endif
+
+#define dxQUICKSTEPISLAND_STAGE4LCP_FC_WARM_STEP  128U
+#define dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR  4
+#define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_PREPARE  (dxQUICKSTEPISLAND_STAGE4LCP_FC_WARM_STEP * dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR)
+#define dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_COMPLETE (dxQUICKSTEPISLAND_STAGE4LCP_FC_WARM_STEP)
+
+#define dxQUICKSTEPISLAND_STAGE4LCP_COLOR_STEP  16U
 
 
 #define dxQUICKSTEPISLAND_STAGE4B_STEP  256U
 
 #define dxQUICKSTEPISLAND_STAGE6A_STEP  16U
-#define dxQUICKSTEPISLAND_STAGE6B_STEP  1U
+#define dxQUICKSTEPISLAND_STAGE6B_STEP  16U
 
 template<unsigned int step_size>
 inline unsigned int CalculateOptimalThreadsCount(unsigned int complexity, unsigned int max_threads)
@@ -699,6 +697,8 @@ struct dxQuickStepperStage4CallContext
         m_mi_Ad = 0;
         m_LCP_iteration = 0;
         m_LCP_extra_num_iterations = 0;
+        m_SOR_colorCount = 0;
+        m_SOR_colorStepIndex = 0;
         m_cf_4b = 0;
         m_ji_4b = 0;
     }
@@ -736,6 +736,16 @@ struct dxQuickStepperStage4CallContext
         m_SOR_reorderThreadsRemaining = reorderThreads;
     }
 
+    void AssignSOR_ColorCount(unsigned int colorCount)
+    {
+        m_SOR_colorCount = colorCount;
+    }
+
+    void ResetSOR_ColorStepIndex()
+    {
+        m_SOR_colorStepIndex = 0;
+    }
+
     void RecordLCP_IterationStart(unsigned int totalThreads, dCallReleaseeID nextReleasee)
     {
         m_LCP_iterationThreadsTotal = totalThreads;
@@ -776,6 +786,8 @@ struct dxQuickStepperStage4CallContext
     volatile atomicord32            m_SOR_mi_zeroHeadTaken;
     volatile atomicord32            m_SOR_mi_zeroTailTaken;
     volatile atomicord32            m_SOR_reorderThreadsRemaining;
+    unsigned int                    m_SOR_colorCount;
+    volatile atomicord32            m_SOR_colorStepIndex;
     volatile atomicord32            m_cf_4b;
     volatile atomicord32            m_ji_4b;
 };
@@ -786,15 +798,15 @@ static int dxQuickStepIsland_Stage4LCP_iMJ_Callback(void *callContext, dcallinde
 static int dxQuickStepIsland_Stage4LCP_iMJSync_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_fcStart_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_fc_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
-#ifdef WARM_STARTING
 static int dxQuickStepIsland_Stage4LCP_fcWarmComplete_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
-#endif
 static int dxQuickStepIsland_Stage4LCP_Ad_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_ReorderPrep_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_IterationStart_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_ConstraintsReordering_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_ConstraintsReorderingSync_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_Iteration_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static int dxQuickStepIsland_Stage4LCP_ColoredIteration_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static int dxQuickStepIsland_Stage4LCP_ColorBatch_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_IterationSync_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4b_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage5_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
@@ -802,14 +814,11 @@ static int dxQuickStepIsland_Stage5_Callback(void *callContext, dcallindex_t cal
 static void dxQuickStepIsland_Stage4a(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_iMJComputation(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation(dxQuickStepperStage4CallContext *stage4CallContext, dCallReleaseeID callThisReleasee);
-#ifdef WARM_STARTING
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation_warm(dxQuickStepperStage4CallContext *stage4CallContext, dCallReleaseeID callThisReleasee);
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmZeroArrays(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmPrepare(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmComplete(dxQuickStepperStage4CallContext *stage4CallContext);
-#else
 static void dxQuickStepIsland_Stage4LCP_MTfcComputation_cold(dxQuickStepperStage4CallContext *stage4CallContext);
-#endif
 static void dxQuickStepIsland_Stage4LCP_MTForceMaxAdjustmentZeroing(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_STfcComputation(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_AdComputation(dxQuickStepperStage4CallContext *stage4CallContext);
@@ -820,6 +829,9 @@ static void dxQuickStepIsland_Stage4LCP_LinksArraysZeroing(dxQuickStepperStage4C
 static void dxQuickStepIsland_Stage4LCP_DependencyMapForNewOrderRebuilding(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_DependencyMapFromSavedLevelsReconstruction(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_MTIteration(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int initiallyKnownToBeCompletedLevel);
+static void dxQuickStepIsland_Stage4LCP_ConstraintsColoring(dxQuickStepperStage4CallContext *stage4CallContext);
+static void dxQuickStepIsland_Stage4LCP_ColoredIteration(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int color);
+static void dxQuickStepIsland_Stage4LCP_ColorBatch(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int color);
 static void dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_IterationStep(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int i);
 static void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContext);
@@ -896,8 +908,6 @@ void compute_invM_JT (volatile atomicord32 *mi_storage, dReal *iMJ,
     }
 }
 
-#ifdef WARM_STARTING
-
 static 
 void multiply_invM_JT_init_array(unsigned int nb, atomicord32 *bi_links/*=[nb]*/)
 {
@@ -968,7 +978,7 @@ void multiply_invM_JT_complete(volatile atomicord32 *bi_storage, dReal *out,
                     businessIndex = mi_links[(sizeint)mi * 2];
                 }
                 else {
-                    dIASSERT(bi == jb[mi].second);
+                    dIASSERT((int)bi == jb[mi].second);
 
                     iMJ_ptr = iMJ + (sizeint)mi * IMJ__MAX + IMJ__2JVE_MIN;
                     businessIndex = mi_links[(sizeint)mi * 2 + 1];
@@ -1016,7 +1026,6 @@ void _multiply_invM_JT (dReal *out,
         iMJ_ptr += IMJ__MAX;
     }
 }
-#endif
 
 // compute out = J*in.
 template<unsigned int step_size, unsigned int in_offset, unsigned int in_stride>
@@ -1175,6 +1184,8 @@ int dxQuickStepIsland_Stage0_Bodies_Callback(void *_callContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage0_Bodies(dxQuickStepperStage0BodiesCallContext *callContext)
 {
+    dxStepProfileScope profileScope(callContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep0);
+
     dxBody * const *body = callContext->m_stepperCallContext->m_islandBodiesStart;
     unsigned int nb = callContext->m_stepperCallContext->m_islandBodiesCount;
 
@@ -1318,6 +1329,8 @@ int dxQuickStepIsland_Stage0_Joints_Callback(void *_callContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage0_Joints(dxQuickStepperStage0JointsCallContext *callContext)
 {
+    dxStepProfileScope profileScope(callContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep0);
+
     dxJoint * const *_joint = callContext->m_stepperCallContext->m_islandJointsStart;
     unsigned int _nj = callContext->m_stepperCallContext->m_islandJointsCount;
 
@@ -1363,6 +1376,8 @@ int dxQuickStepIsland_Stage1_Callback(void *_stage1CallContext, dcallindex_t cal
 static 
 void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext)
 {
+    dxStepProfileScope profileScope(stage1CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep1);
+
     const dxStepperProcessingCallContext *callContext = stage1CallContext->m_stepperCallContext;
     dReal *invI = stage1CallContext->m_invI;
     dJointWithInfo1 *jointinfos = stage1CallContext->m_jointinfos;
@@ -1485,6 +1500,8 @@ int dxQuickStepIsland_Stage2a_Callback(void *_stage2CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage2a(dxQuickStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep2);
+
     const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     dxQuickStepperLocalContext *localContext = stage2CallContext->m_localContext;
     dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
@@ -1643,6 +1660,8 @@ int dxQuickStepIsland_Stage2b_Callback(void *_stage2CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage2b(dxQuickStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep2);
+
     const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage2CallContext->m_localContext;
 
@@ -1726,6 +1745,8 @@ int dxQuickStepIsland_Stage2c_Callback(void *_stage2CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage2c(dxQuickStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep2);
+
     //const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage2CallContext->m_localContext;
 
@@ -1760,6 +1781,8 @@ int dxQuickStepIsland_Stage3_Callback(void *_stage3CallContext, dcallindex_t cal
 static 
 void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext)
 {
+    dxStepProfileScope profileScope(stage3CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep3);
+
     const dxStepperProcessingCallContext *callContext = stage3CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage3CallContext->m_localContext;
 
@@ -1878,21 +1901,24 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
                 NULL, &dxQuickStepIsland_Stage4LCP_IterationStart_Callback, stage4CallContext, 0, "QuickStepIsland Stage4LCP_Iteration Start");
 
             unsigned int nj = localContext->m_nj;
-            unsigned int stage4a_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4A_STEP>(nj, allowedThreads);
+            const bool warmStartingEnabled = world->qs.GetIsWarmStartingEnabled();
+            unsigned int stage4a_allowedThreads = warmStartingEnabled 
+                ? CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4A_WARM_STEP>(nj, allowedThreads)
+                : CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4A_STEP>(nj, allowedThreads);
 
             dCallReleaseeID stage4LCP_fcStartReleasee;
-            // Note: It is unnecessary to make fc dependent on 4a if there is no WARM_STARTING
-            // However I'm doing so to minimize use of preprocessor conditions in sources
+            // Note: It is unnecessary to make fc dependent on 4a if there is no warm starting
+            // However I'm doing so to minimize the number of branches in the code
             unsigned stage4LCP_fcDependenciesCountToUse = stage4a_allowedThreads;
-#ifdef WARM_STARTING
-            // Posted with extra dependency to be removed from dxQuickStepIsland_Stage4LCP_iMJSync_Callback
-            stage4LCP_fcDependenciesCountToUse += 1;
-#endif
+            if (warmStartingEnabled) {
+                // Posted with extra dependency to be removed from dxQuickStepIsland_Stage4LCP_iMJSync_Callback
+                stage4LCP_fcDependenciesCountToUse += 1;
+            }
             world->PostThreadedCall(NULL, &stage4LCP_fcStartReleasee, stage4LCP_fcDependenciesCountToUse, stage4LCP_IterationStartReleasee, 
                 NULL, &dxQuickStepIsland_Stage4LCP_fcStart_Callback, stage4CallContext, 0, "QuickStepIsland Stage4LCP_fc Start");
-#ifdef WARM_STARTING
-            stage4CallContext->AssignLCP_fcStartReleasee(stage4LCP_fcStartReleasee);
-#endif
+            if (warmStartingEnabled) {
+                stage4CallContext->AssignLCP_fcStartReleasee(stage4LCP_fcStartReleasee);
+            }
 
             unsigned stage4LCP_iMJ_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_IMJ_STEP>(m, allowedThreads);
 
@@ -1928,46 +1954,81 @@ int dxQuickStepIsland_Stage4a_Callback(void *_stage4CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage4a(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
+    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
     dReal *lambda = stage4CallContext->m_lambda;
     const dxMIndexItem *mindex = localContext->m_mindex;
-#ifdef WARM_STARTING
-    dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
-#endif
     unsigned int nj = localContext->m_nj;
-    const unsigned int step_size = dxQUICKSTEPISLAND_STAGE4A_STEP;
-    unsigned int nj_steps = (nj + (step_size - 1)) / step_size;
-    
-    unsigned ji_step;
-    while ((ji_step = ThrsafeIncrementIntUpToLimit(&stage4CallContext->m_ji_4a, nj_steps)) != nj_steps) {
-        unsigned int ji = ji_step * step_size;
-        dReal *lambdacurr = lambda + mindex[ji].mIndex;
-#ifdef WARM_STARTING
-        const dJointWithInfo1 *jicurr = jointinfos + ji;
-        const dJointWithInfo1 *const jiend = jicurr + dMIN(step_size, nj - ji);
-        
-        do {
-            const dReal *joint_lambdas = jicurr->joint->lambda;
-            dReal *const lambdsnext = lambdacurr + jicurr->info.m;
-            
-            while (true) {
-                // for warm starting, multiplication by 0.9 seems to be necessary to prevent
-                // jerkiness in motor-driven joints. I have no idea why this works.
-                *lambdacurr = *joint_lambdas * 0.9;
 
-                if (++lambdacurr == lambdsnext) {
-                    break;
+    const dxWorld *world = callContext->m_world;
+    const dxQuickStepParameters *qs = &world->qs;
+
+    if (qs->GetIsWarmStartingEnabled()) {
+        const dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
+        // for warm starting, multiplication by 0.9 seems to be necessary to prevent
+        // jerkiness in motor-driven joints. I have no idea why this works.
+        const dReal warmStartingFactor = qs->GetWarmStartingFactor();
+        const bool jointsWarmStartingEnabled = qs->GetIsJointsWarmStartingEnabled();
+        const dxContactImpulseCache *contactCache = qs->GetIsContactsWarmStartingEnabled() ? world->qs_contact_cache : NULL;
+        const dReal contactTolerance = qs->GetWarmStartingContactTolerance();
+
+        const unsigned int step_size = dxQUICKSTEPISLAND_STAGE4A_WARM_STEP;
+        unsigned int nj_steps = (nj + (step_size - 1)) / step_size;
+
+        unsigned ji_step;
+        while ((ji_step = ThrsafeIncrementIntUpToLimit(&stage4CallContext->m_ji_4a, nj_steps)) != nj_steps) {
+            unsigned int ji = ji_step * step_size;
+            dReal *lambdacurr = lambda + mindex[ji].mIndex;
+            const dJointWithInfo1 *jicurr = jointinfos + ji;
+            const dJointWithInfo1 *const jiend = jicurr + dMIN(step_size, nj - ji);
+
+            do {
+                dxJoint *joint = jicurr->joint;
+                const unsigned int infom = jicurr->info.m;
+
+                const dReal *previous_lambdas = NULL;
+                unsigned int previous_count = 0;
+
+                if (joint->type() == dJointTypeContact) {
+                    // Contact joints are re-created each step. Look the impulse up in the cache.
+                    const dxContactImpulseCacheItem *cachedContact = contactCache != NULL 
+                        ? contactCache->findMatch(static_cast<dxJointContact *>(joint), contactTolerance) : NULL;
+                    if (cachedContact != NULL) {
+                        previous_lambdas = cachedContact->lambda;
+                        // If the friction rows have changed only the normal row can be reused
+                        previous_count = cachedContact->m == infom ? infom : dMIN(1U, infom);
+                    }
+                }
+                else if (jointsWarmStartingEnabled) {
+                    previous_lambdas = joint->lambda;
+                    previous_count = infom;
                 }
 
-                ++joint_lambdas;
-            }
-        } 
-        while (++jicurr != jiend);
-#else
-        dReal *lambdsnext = lambda + mindex[ji + dMIN(step_size, nj - ji)].mIndex;
-        dSetZero(lambdacurr, lambdsnext - lambdacurr);
-#endif
+                dReal *const lambdsnext = lambdacurr + infom;
+                for (dReal *const lambdaswarmend = lambdacurr + previous_count; lambdacurr != lambdaswarmend; ++previous_lambdas, ++lambdacurr) {
+                    *lambdacurr = *previous_lambdas * warmStartingFactor;
+                }
+                for (; lambdacurr != lambdsnext; ++lambdacurr) {
+                    *lambdacurr = REAL(0.0);
+                }
+            } 
+            while (++jicurr != jiend);
+        }
+    }
+    else {
+        const unsigned int step_size = dxQUICKSTEPISLAND_STAGE4A_STEP;
+        unsigned int nj_steps = (nj + (step_size - 1)) / step_size;
+
+        unsigned ji_step;
+        while ((ji_step = ThrsafeIncrementIntUpToLimit(&stage4CallContext->m_ji_4a, nj_steps)) != nj_steps) {
+            unsigned int ji = ji_step * step_size;
+            dReal *lambdacurr = lambda + mindex[ji].mIndex;
+            dReal *lambdsnext = lambda + mindex[ji + dMIN(step_size, nj - ji)].mIndex;
+            dSetZero(lambdacurr, lambdsnext - lambdacurr);
+        }
     }
 }
 
@@ -1984,6 +2045,8 @@ int dxQuickStepIsland_Stage4LCP_iMJ_Callback(void *_stage4CallContext, dcallinde
 static 
 void dxQuickStepIsland_Stage4LCP_iMJComputation(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
@@ -2012,12 +2075,10 @@ int dxQuickStepIsland_Stage4LCP_iMJSync_Callback(void *_stage4CallContext, dcall
 
     unsigned int stage4LCP_Ad_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_AD_STEP>(m, allowedThreads);
 
-#ifdef WARM_STARTING
-    {
+    if (callContext->m_world->qs.GetIsWarmStartingEnabled()) {
         dxWorld *world = callContext->m_world;
         world->AlterThreadedCallDependenciesCount(stage4CallContext->m_LCP_fcStartReleasee, -1);
     }
-#endif
     
     if (stage4LCP_Ad_allowedThreads > 1) {
         dxWorld *world = callContext->m_world;
@@ -2037,22 +2098,26 @@ int dxQuickStepIsland_Stage4LCP_fcStart_Callback(void *_stage4CallContext, dcall
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
-    unsigned int fcPrepareComplexity, fcCompleteComplexity;
-#ifdef WARM_STARTING
-    fcPrepareComplexity = localContext->m_m / dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR;
-    fcCompleteComplexity = callContext->m_islandBodiesCount;
-#else
-    fcPrepareComplexity = localContext->m_m;
-    fcCompleteComplexity = 0;
-#endif
+    const bool warmStartingEnabled = callContext->m_world->qs.GetIsWarmStartingEnabled();
     const unsigned allowedThreads = callContext->m_stepperAllowedThreads;
-    unsigned int stage4LCP_fcPrepare_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP>(fcPrepareComplexity, allowedThreads);
-    unsigned int stage4LCP_fcComplete_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP>(fcCompleteComplexity, allowedThreads);
+
+    unsigned int stage4LCP_fcPrepare_allowedThreads, stage4LCP_fcComplete_allowedThreads;
+    if (warmStartingEnabled) {
+        unsigned int fcPrepareComplexity = localContext->m_m / dxQUICKSTEPISLAND_STAGE4LCP_FC_COMPLETE_TO_PREPARE_COMPLEXITY_DIVISOR;
+        unsigned int fcCompleteComplexity = callContext->m_islandBodiesCount;
+        stage4LCP_fcPrepare_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_FC_WARM_STEP>(fcPrepareComplexity, allowedThreads);
+        stage4LCP_fcComplete_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_FC_WARM_STEP>(fcCompleteComplexity, allowedThreads);
+    }
+    else {
+        unsigned int fcPrepareComplexity = localContext->m_m;
+        stage4LCP_fcPrepare_allowedThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP>(fcPrepareComplexity, allowedThreads);
+        stage4LCP_fcComplete_allowedThreads = 0;
+    }
     stage4CallContext->AssignLCP_fcAllowedThreads(stage4LCP_fcPrepare_allowedThreads, stage4LCP_fcComplete_allowedThreads);
 
-#ifdef WARM_STARTING
-    dxQuickStepIsland_Stage4LCP_MTfcComputation_warmZeroArrays(stage4CallContext);
-#endif
+    if (warmStartingEnabled) {
+        dxQuickStepIsland_Stage4LCP_MTfcComputation_warmZeroArrays(stage4CallContext);
+    }
 
     if (stage4LCP_fcPrepare_allowedThreads > 1) {
         dxWorld *world = callContext->m_world;
@@ -2076,20 +2141,20 @@ int dxQuickStepIsland_Stage4LCP_fc_Callback(void *_stage4CallContext, dcallindex
 static 
 void dxQuickStepIsland_Stage4LCP_MTfcComputation(dxQuickStepperStage4CallContext *stage4CallContext, dCallReleaseeID callThisReleasee)
 {
-#ifdef WARM_STARTING
-    dxQuickStepIsland_Stage4LCP_MTfcComputation_warm(stage4CallContext, callThisReleasee);
-#else
-    (void)callThisReleasee; // unused
-    dxQuickStepIsland_Stage4LCP_MTfcComputation_cold(stage4CallContext);
-#endif
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
+    if (stage4CallContext->m_stepperCallContext->m_world->qs.GetIsWarmStartingEnabled()) {
+        dxQuickStepIsland_Stage4LCP_MTfcComputation_warm(stage4CallContext, callThisReleasee);
+    }
+    else {
+        dxQuickStepIsland_Stage4LCP_MTfcComputation_cold(stage4CallContext);
+    }
 
     // Start the forceMaxAdjustments zeroing after the cforce computation so that, in "warm" case,
     // first threads had a work in parallel while the last one will be finishing the cforce.
     dxQuickStepIsland_Stage4LCP_MTForceMaxAdjustmentZeroing(stage4CallContext);
 }
 
-#ifdef WARM_STARTING
-
 static 
 void dxQuickStepIsland_Stage4LCP_MTfcComputation_warm(dxQuickStepperStage4CallContext *stage4CallContext, dCallReleaseeID callThisReleasee)
 {
@@ -2124,7 +2189,6 @@ void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmZeroArrays(dxQuickStepperSt
 static 
 void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmPrepare(dxQuickStepperStage4CallContext *stage4CallContext)
 {
-    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
     unsigned int m = localContext->m_m;
@@ -2150,6 +2214,8 @@ int dxQuickStepIsland_Stage4LCP_fcWarmComplete_Callback(void *_stage4CallContext
 static 
 void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmComplete(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
@@ -2164,9 +2230,6 @@ void dxQuickStepIsland_Stage4LCP_MTfcComputation_warmComplete(dxQuickStepperStag
     multiply_invM_JT_complete<dxQUICKSTEPISLAND_STAGE4LCP_FC_STEP_COMPLETE, CFE__DYNAMICS_MIN, CFE__MAX>(&stage4CallContext->m_bi_fc, fc, nb, iMJ, jb, lambda, stage4CallContext->m_bi_links_or_mi_levels, stage4CallContext->m_mi_links);
 }
 
-
-#else // #ifndef WARM_STARTING
-
 static 
 void dxQuickStepIsland_Stage4LCP_MTfcComputation_cold(dxQuickStepperStage4CallContext *stage4CallContext)
 {
@@ -2187,9 +2250,6 @@ void dxQuickStepIsland_Stage4LCP_MTfcComputation_cold(dxQuickStepperStage4CallCo
 }
 
 
-#endif // #ifndef WARM_STARTING
-
-
 static 
 void dxQuickStepIsland_Stage4LCP_MTForceMaxAdjustmentZeroing(dxQuickStepperStage4CallContext *stage4CallContext)
 {
@@ -2212,29 +2272,32 @@ void dxQuickStepIsland_Stage4LCP_MTForceMaxAdjustmentZeroing(dxQuickStepperStage
 static 
 void dxQuickStepIsland_Stage4LCP_STfcComputation(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     unsigned int nb = callContext->m_islandBodiesCount;
 
     dReal *forceMaxAdjustments = stage4CallContext->m_forceMaxAdjustments;
     dxSetZero(forceMaxAdjustments, (sizeint)nb * FAE__MAX);
 
-#ifdef WARM_STARTING
-    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+    dReal *fc = stage4CallContext->m_cforce;
 
-    unsigned int m = localContext->m_m;
-    const dxJBodiesItem *jb = localContext->m_jb;
+    if (callContext->m_world->qs.GetIsWarmStartingEnabled()) {
+        const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
-    const dReal *iMJ = stage4CallContext->m_iMJ;
-    dReal *lambda = stage4CallContext->m_lambda;
+        unsigned int m = localContext->m_m;
+        const dxJBodiesItem *jb = localContext->m_jb;
 
-    // compute fc=(inv(M)*J')*lambda. we will incrementally maintain fc
-    // as we change lambda.
-    dReal *fc = stage4CallContext->m_cforce;
-    _multiply_invM_JT<CFE__DYNAMICS_MIN, CFE__MAX>(fc, m, nb, iMJ, jb, lambda);
-#else
-	dReal *fc = stage4CallContext->m_cforce;
-    dSetZero(fc, (sizeint)nb * CFE__MAX);
-#endif
+        const dReal *iMJ = stage4CallContext->m_iMJ;
+        dReal *lambda = stage4CallContext->m_lambda;
+
+        // compute fc=(inv(M)*J')*lambda. we will incrementally maintain fc
+        // as we change lambda.
+        _multiply_invM_JT<CFE__DYNAMICS_MIN, CFE__MAX>(fc, m, nb, iMJ, jb, lambda);
+    }
+    else {
+        dSetZero(fc, (sizeint)nb * CFE__MAX);
+    }
 }
 
 static 
@@ -2250,6 +2313,8 @@ int dxQuickStepIsland_Stage4LCP_Ad_Callback(void *_stage4CallContext, dcallindex
 static 
 void dxQuickStepIsland_Stage4LCP_AdComputation(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
@@ -2328,6 +2393,8 @@ int dxQuickStepIsland_Stage4LCP_ReorderPrep_Callback(void *_stage4CallContext, d
 static 
 void dxQuickStepIsland_Stage4LCP_ReorderPrep(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
     unsigned int m = localContext->m_m;
     unsigned int valid_findices = localContext->m_valid_findices;
@@ -2388,14 +2455,16 @@ int dxQuickStepIsland_Stage4LCP_IterationStart_Callback(void *_stage4CallContext
         dCallReleaseeID stage4LCP_IterationSyncReleasee = stage4CallContext->m_LCP_IterationSyncReleasee;
         unsigned int stage4LCP_Iteration_allowedThreads = stage4CallContext->m_LCP_IterationAllowedThreads;
 
+        // With the colored scheduling the order is only colored once and kept for all the iterations
+        const bool coloredScheduling = world->qs.GetIsColoredIterationSchedulingEnabled();
         bool reorderRequired = false;
 
-        if (IsSORConstraintsReorderRequiredForIteration(iteration))
+        if (!coloredScheduling && IsSORConstraintsReorderRequiredForIteration(iteration))
         {
             reorderRequired = true;
         }
 
-        unsigned syncCallDependencies = reorderRequired ? 1 : stage4LCP_Iteration_allowedThreads;
+        unsigned syncCallDependencies = reorderRequired || coloredScheduling ? 1 : stage4LCP_Iteration_allowedThreads;
 
         // Increment iterations counter in advance as anyway it needs to be incremented 
         // before independent tasks (the reordering or the iteration) are posted
@@ -2429,7 +2498,17 @@ int dxQuickStepIsland_Stage4LCP_IterationStart_Callback(void *_stage4CallContext
             nextReleasee = stage4LCP_IterationSyncReleasee;
         }
 
-        if (reorderRequired) {
+        if (coloredScheduling) {
+            if (iteration == 0) {
+                dxQuickStepIsland_Stage4LCP_ConstraintsColoring(stage4CallContext);
+            }
+
+            stage4CallContext->RecordLCP_IterationStart(stage4LCP_Iteration_allowedThreads, nextReleasee);
+
+            dxQuickStepIsland_Stage4LCP_ColoredIteration(stage4CallContext, 0);
+            world->AlterThreadedCallDependenciesCount(nextReleasee, -1);
+        }
+        else if (reorderRequired) {
             const unsigned int reorderThreads = 2;
             dIASSERT(callContext->m_stepperAllowedThreads >= 2); // Otherwise the single-threaded execution path would be taken
 
@@ -2477,6 +2556,8 @@ int dxQuickStepIsland_Stage4LCP_ConstraintsReordering_Callback(void *_stage4Call
 static 
 void dxQuickStepIsland_Stage4LCP_ConstraintsReordering(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     unsigned int iteration = stage4CallContext->m_LCP_iteration - 1; // Iteration is pre-incremented before scheduled tasks are released for execution
     if (dxQuickStepIsland_Stage4LCP_ConstraintsShuffling(stage4CallContext, iteration)) {
 
@@ -2498,6 +2579,8 @@ void dxQuickStepIsland_Stage4LCP_ConstraintsReordering(dxQuickStepperStage4CallC
 static 
 bool dxQuickStepIsland_Stage4LCP_ConstraintsShuffling(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int iteration)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     bool result = false;
 
 #if CONSTRAINTS_REORDERING_METHOD == REORDERING_METHOD__BY_ERROR
@@ -2706,6 +2789,8 @@ void dxQuickStepIsland_Stage4LCP_DependencyMapForNewOrderRebuilding(dxQuickStepp
 static 
 void dxQuickStepIsland_Stage4LCP_DependencyMapFromSavedLevelsReconstruction(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
     atomicord32 *mi_levels = stage4CallContext->m_bi_links_or_mi_levels;/*=[m]*/
@@ -2763,6 +2848,223 @@ int dxQuickStepIsland_Stage4LCP_ConstraintsReorderingSync_Callback(void *_stage4
     return 1;
 }
 
+/*
+ *  Colors the rows so that the rows of a color share no bodies and
+ *  regroups the order by colors. Every row gets the lowest color
+ *  not yet taken by either of its bodies. A row with a findex is also
+ *  placed into a color after the one of its findex row to still be solved
+ *  after it, like the dependency map would do.
+ *  The body color masks are 32 bit wide and hence the colors are assigned
+ *  in passes of 32. The rows that do not fit into the pass are left for the next one.
+ *
+ *  The links arrays are not used in colored scheduling and are reused here:
+ *  bi_links keeps the body masks (and later the order copy),
+ *  the head of mi_links keeps row colors and the tail keeps color starts in the order.
+ */
+static 
+void dxQuickStepIsland_Stage4LCP_ConstraintsColoring(dxQuickStepperStage4CallContext *stage4CallContext)
+{
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
+    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
+    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+
+    unsigned int nb = callContext->m_islandBodiesCount;
+    unsigned int m = localContext->m_m;
+    dIASSERT(m != 0);
+
+    const dxJBodiesItem *jb = localContext->m_jb;
+    const int *findex = localContext->m_findex;
+    IndexError *order = stage4CallContext->m_order;
+
+    atomicord32 *bi_masks = stage4CallContext->m_bi_links_or_mi_levels;/*=[max(nb, m)]*/
+    atomicord32 *mi_colors = stage4CallContext->m_mi_links;/*=[m]*/
+    atomicord32 *color_starts = stage4CallContext->m_mi_links + m;/*=[colorCount + 1]*/
+
+    const atomicord32 uncolored = ~(atomicord32)0;
+    for (unsigned int index = 0; index != m; ++index) {
+        mi_colors[index] = uncolored;
+    }
+
+    unsigned int colorCount = 0;
+    for (unsigned int passColorBase = 0, rowsRemaining = m; rowsRemaining != 0; passColorBase += 32) {
+        dIASSERT(passColorBase < m);
+        memset(bi_masks, 0, sizeof(bi_masks[0]) * nb);
+
+        for (unsigned int i = 0; i != m; ++i) {
+            unsigned int index = order[i].index;
+            if (mi_colors[index] != uncolored) {
+                continue;
+            }
+
+            int b1 = jb[index].first;
+            int b2 = jb[index].second;
+
+            atomicord32 busyMask = bi_masks[(unsigned int)b1];
+            if (b2 != -1) {
+                busyMask |= bi_masks[(unsigned int)b2];
+            }
+
+            int fi = findex[index];
+            if (fi != -1) {
+                atomicord32 fiColor = mi_colors[(unsigned int)fi];
+                if (fiColor == uncolored) {
+                    // The findex row has been postponed to the next pass -- so must be the dependent row
+                    continue;
+                }
+                if (fiColor >= passColorBase) {
+                    // Take the findex row color and all the colors before it in this pass
+                    busyMask |= ((atomicord32)2 << (fiColor - passColorBase)) - 1;
+                }
+            }
+
+            if (busyMask == ~(atomicord32)0) {
+                continue;
+            }
+
+            unsigned int colorBit = 0;
+            for (atomicord32 freeMask = ~busyMask; (freeMask & 1) == 0; freeMask >>= 1) {
+                ++colorBit;
+            }
+
+            atomicord32 colorMask = (atomicord32)1 << colorBit;
+            bi_masks[(unsigned int)b1] |= colorMask;
+            if (b2 != -1) {
+                bi_masks[(unsigned int)b2] |= colorMask;
+            }
+
+            unsigned int color = passColorBase + colorBit;
+            mi_colors[index] = color;
+            colorCount = dMAX(colorCount, color + 1);
+            --rowsRemaining;
+        }
+    }
+    dIASSERT(colorCount <= m);
+
+    // Regroup the order by colors, keeping the relative order of rows within a color
+    atomicord32 *orderCopy = bi_masks;/*=[m]*/
+    memset(color_starts, 0, sizeof(color_starts[0]) * (colorCount + 1));
+
+    for (unsigned int i = 0; i != m; ++i) {
+        unsigned int index = order[i].index;
+        orderCopy[i] = index;
+        color_starts[mi_colors[index] + 1] += 1;
+    }
+
+    for (unsigned int color = 0; color != colorCount; ++color) {
+        color_starts[color + 1] += color_starts[color];
+    }
+
+    for (unsigned int i = 0; i != m; ++i) {
+        unsigned int index = orderCopy[i];
+        order[color_starts[mi_colors[index]]++].index = index;
+    }
+
+    // The starts have been advanced to the ends of their colors -- shift them back
+    for (unsigned int color = colorCount; color != 0; --color) {
+        color_starts[color] = color_starts[color - 1];
+    }
+    color_starts[0] = 0;
+    dIASSERT(color_starts[colorCount] == m);
+
+    stage4CallContext->AssignSOR_ColorCount(colorCount);
+}
+
+static 
+int dxQuickStepIsland_Stage4LCP_ColoredIteration_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callThisReleasee; // unused
+    dxQuickStepperStage4CallContext *stage4CallContext = (dxQuickStepperStage4CallContext *)_stage4CallContext;
+    unsigned int color = (unsigned int)callInstanceIndex;
+    dIASSERT(color == callInstanceIndex); // A truncation check...
+
+    dxQuickStepIsland_Stage4LCP_ColoredIteration(stage4CallContext, color);
+
+    return 1;
+}
+
+/*
+ *  Sweeps the color in parallel and schedules the next color
+ *  to start after all the threads of the current one have finished.
+ *  The final color releases the iteration's next releasee.
+ */
+static 
+void dxQuickStepIsland_Stage4LCP_ColoredIteration(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int color)
+{
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
+    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
+    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+
+    dxWorld *world = callContext->m_world;
+    dCallReleaseeID nextReleasee = stage4CallContext->m_LCP_iterationNextReleasee;
+
+    unsigned int m = localContext->m_m;
+    const atomicord32 *color_starts = stage4CallContext->m_mi_links + m;/*=[colorCount + 1]*/
+    unsigned int colorRowCount = color_starts[color + 1] - color_starts[color];
+
+    unsigned int colorThreads = CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4LCP_COLOR_STEP>(colorRowCount, stage4CallContext->m_LCP_iterationThreadsTotal);
+
+    // All the threads of the previous color have exited by now
+    stage4CallContext->ResetSOR_ColorStepIndex();
+
+    if (color + 1 != stage4CallContext->m_SOR_colorCount) {
+        dCallReleaseeID nextColorReleasee;
+        world->PostThreadedCallForUnawareReleasee(NULL, &nextColorReleasee, colorThreads, nextReleasee,
+            NULL, &dxQuickStepIsland_Stage4LCP_ColoredIteration_Callback, stage4CallContext, color + 1, "QuickStepIsland Stage4LCP_ColoredIteration");
+
+        if (colorThreads > 1) {
+            world->PostThreadedCallsIndexOverridenGroup(NULL, colorThreads - 1, nextColorReleasee, &dxQuickStepIsland_Stage4LCP_ColorBatch_Callback, stage4CallContext, color, "QuickStepIsland Stage4LCP_ColorBatch");
+        }
+        dxQuickStepIsland_Stage4LCP_ColorBatch(stage4CallContext, color);
+        world->AlterThreadedCallDependenciesCount(nextColorReleasee, -1);
+    }
+    else {
+        if (colorThreads > 1) {
+            world->AlterThreadedCallDependenciesCount(nextReleasee, colorThreads - 1);
+            world->PostThreadedCallsIndexOverridenGroup(NULL, colorThreads - 1, nextReleasee, &dxQuickStepIsland_Stage4LCP_ColorBatch_Callback, stage4CallContext, color, "QuickStepIsland Stage4LCP_ColorBatch");
+        }
+        dxQuickStepIsland_Stage4LCP_ColorBatch(stage4CallContext, color);
+    }
+}
+
+static 
+int dxQuickStepIsland_Stage4LCP_ColorBatch_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callThisReleasee; // unused
+    dxQuickStepperStage4CallContext *stage4CallContext = (dxQuickStepperStage4CallContext *)_stage4CallContext;
+    unsigned int color = (unsigned int)callInstanceIndex;
+    dIASSERT(color == callInstanceIndex); // A truncation check...
+
+    dxQuickStepIsland_Stage4LCP_ColorBatch(stage4CallContext, color);
+
+    return 1;
+}
+
+static 
+void dxQuickStepIsland_Stage4LCP_ColorBatch(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int color)
+{
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
+    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+
+    unsigned int m = localContext->m_m;
+    const atomicord32 *color_starts = stage4CallContext->m_mi_links + m;/*=[colorCount + 1]*/
+    unsigned int colorStart = color_starts[color], colorEnd = color_starts[color + 1];
+
+    const unsigned int step_size = dxQUICKSTEPISLAND_STAGE4LCP_COLOR_STEP;
+    unsigned int color_steps = (colorEnd - colorStart + (step_size - 1)) / step_size;
+
+    unsigned color_step;
+    while ((color_step = ThrsafeIncrementIntUpToLimit(&stage4CallContext->m_SOR_colorStepIndex, color_steps)) != color_steps) {
+        unsigned int i = colorStart + color_step * step_size;
+        unsigned int iend = i + dMIN(step_size, colorEnd - i);
+        for (; i != iend; ++i) {
+            dxQuickStepIsland_Stage4LCP_IterationStep(stage4CallContext, i);
+        }
+    }
+}
+
 static 
 int dxQuickStepIsland_Stage4LCP_Iteration_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
 {
@@ -2806,6 +3108,8 @@ int dxQuickStepIsland_Stage4LCP_Iteration_Callback(void *_stage4CallContext, dca
 static 
 void dxQuickStepIsland_Stage4LCP_MTIteration(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int initiallyKnownToBeCompletedLevel)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     atomicord32 *mi_levels = stage4CallContext->m_bi_links_or_mi_levels;
     atomicord32 *mi_links = stage4CallContext->m_mi_links;
 
@@ -2892,6 +3196,8 @@ void dxQuickStepIsland_Stage4LCP_MTIteration(dxQuickStepperStage4CallContext *st
 static 
 void dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
     unsigned int m = localContext->m_m;
@@ -2942,19 +3248,28 @@ void dxQuickStepIsland_Stage4LCP_IterationStep(dxQuickStepperStage4CallContext *
         b1AsSizeint = jb[index].first;
         int b2 = jb[index].second;
 
-        // @@@ potential optimization: SIMD-ize this and the b2 >= 0 case
         fc_ptr1 = fc + b1AsSizeint * CFE__MAX;
+#if defined(dSIMD_ENABLED)
+        dSASSERT(CFE__DYNAMICS_MAX - CFE__DYNAMICS_MIN == JME__J1_COUNT && CFE_AZ - CFE__DYNAMICS_MIN == JME_J1AZ - JME__J1_MIN);
+        delta -= dxSIMDDot6(fc_ptr1 + CFE__DYNAMICS_MIN, J_ptr + JME__J1_MIN);
+#else
         delta -= fc_ptr1[CFE_LX] * J_ptr[JME_J1LX] + fc_ptr1[CFE_LY] * J_ptr[JME_J1LY] +
             fc_ptr1[CFE_LZ] * J_ptr[JME_J1LZ] + fc_ptr1[CFE_AX] * J_ptr[JME_J1AX] +
             fc_ptr1[CFE_AY] * J_ptr[JME_J1AY] + fc_ptr1[CFE_AZ] * J_ptr[JME_J1AZ];
+#endif
         // @@@ potential optimization: handle 1-body constraints in a separate
         //     loop to avoid the cost of test & jump?
         if (b2 != -1) {
             b1ToB2Offset = (sizeint)(unsigned)b2 - b1AsSizeint;
             fc_ptr2 = fc + (sizeint)(unsigned)b2 * CFE__MAX;
+#if defined(dSIMD_ENABLED)
+            dSASSERT(CFE_AZ - CFE__DYNAMICS_MIN == JME_J2AZ - JME__J2_MIN);
+            delta -= dxSIMDDot6(fc_ptr2 + CFE__DYNAMICS_MIN, J_ptr + JME__J2_MIN);
+#else
             delta -= fc_ptr2[CFE_LX] * J_ptr[JME_J2LX] + fc_ptr2[CFE_LY] * J_ptr[JME_J2LY] +
                 fc_ptr2[CFE_LZ] * J_ptr[JME_J2LZ] + fc_ptr2[CFE_AX] * J_ptr[JME_J2AX] +
                 fc_ptr2[CFE_AY] * J_ptr[JME_J2AY] + fc_ptr2[CFE_AZ] * J_ptr[JME_J2AZ];
+#endif
         }
     }
 
@@ -3006,13 +3321,17 @@ void dxQuickStepIsland_Stage4LCP_IterationStep(dxQuickStepperStage4CallContext *
         dReal *iMJ = stage4CallContext->m_iMJ;
         const dReal *iMJ_ptr = iMJ + (sizeint)index * IMJ__MAX;
         // update fc.
-        // @@@ potential optimization: SIMD for this and the b2 >= 0 case
+#if defined(dSIMD_ENABLED)
+        dSASSERT(CFE_AZ - CFE__DYNAMICS_MIN == IMJ_1AZ - IMJ__1JVE_MIN);
+        dxSIMDAddScaled6(fc_ptr1 + CFE__DYNAMICS_MIN, iMJ_ptr + IMJ__1JVE_MIN, delta);
+#else
         fc_ptr1[CFE_LX] += delta * iMJ_ptr[IMJ_1LX];
         fc_ptr1[CFE_LY] += delta * iMJ_ptr[IMJ_1LY];
         fc_ptr1[CFE_LZ] += delta * iMJ_ptr[IMJ_1LZ];
         fc_ptr1[CFE_AX] += delta * iMJ_ptr[IMJ_1AX];
         fc_ptr1[CFE_AY] += delta * iMJ_ptr[IMJ_1AY];
         fc_ptr1[CFE_AZ] += delta * iMJ_ptr[IMJ_1AZ];
+#endif
 
         dReal *fa1 = faBase + b1AsSizeint * FAE__MAX;
         *fa1 += delta * iMJ_ptr[IMJ_1JVE_MAXABS];
@@ -3022,24 +3341,25 @@ void dxQuickStepIsland_Stage4LCP_IterationStep(dxQuickStepperStage4CallContext *
             dReal *fa2 = fa1 + b1ToB2Offset * FAE__MAX;
             *fa2 += delta * iMJ_ptr[IMJ_2JVE_MAXABS];
 
+#if defined(dSIMD_ENABLED)
+            dSASSERT(CFE_AZ - CFE__DYNAMICS_MIN == IMJ_2AZ - IMJ__2JVE_MIN);
+            dxSIMDAddScaled6(fc_ptr2 + CFE__DYNAMICS_MIN, iMJ_ptr + IMJ__2JVE_MIN, delta);
+#else
             fc_ptr2[CFE_LX] += delta * iMJ_ptr[IMJ_2LX];
             fc_ptr2[CFE_LY] += delta * iMJ_ptr[IMJ_2LY];
             fc_ptr2[CFE_LZ] += delta * iMJ_ptr[IMJ_2LZ];
             fc_ptr2[CFE_AX] += delta * iMJ_ptr[IMJ_2AX];
             fc_ptr2[CFE_AY] += delta * iMJ_ptr[IMJ_2AY];
             fc_ptr2[CFE_AZ] += delta * iMJ_ptr[IMJ_2AZ];
+#endif
         }
     }
 }
 
 static inline 
-bool IsStage4bJointInfosIterationRequired(const dxQuickStepperLocalContext *localContext)
+bool IsStage4bJointInfosIterationRequired(const dxStepperProcessingCallContext *callContext, const dxQuickStepperLocalContext *localContext)
 {
-    return 
-#ifdef WARM_STARTING
-        true ||      
-#endif
-        localContext->m_mfb > 0;
+    return callContext->m_world->qs.GetIsWarmStartingEnabled() || localContext->m_mfb > 0;
 }
 
 static 
@@ -3052,7 +3372,7 @@ int dxQuickStepIsland_Stage4LCP_IterationSync_Callback(void *_stage4CallContext,
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
     
     unsigned int stage4b_allowedThreads = 1;
-    if (IsStage4bJointInfosIterationRequired(localContext)) {
+    if (IsStage4bJointInfosIterationRequired(callContext, localContext)) {
         unsigned int allowedThreads = callContext->m_stepperAllowedThreads;
         dIASSERT(allowedThreads >= stage4b_allowedThreads);
         stage4b_allowedThreads += CalculateOptimalThreadsCount<dxQUICKSTEPISLAND_STAGE4B_STEP>(localContext->m_nj, allowedThreads - stage4b_allowedThreads);
@@ -3081,6 +3401,8 @@ int dxQuickStepIsland_Stage4b_Callback(void *_stage4CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
@@ -3105,12 +3427,13 @@ void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContex
     // note that the SOR method overwrites rhs and J at this point, so
     // they should not be used again.
 
-    if (IsStage4bJointInfosIterationRequired(localContext)) {
+    if (IsStage4bJointInfosIterationRequired(callContext, localContext)) {
         dReal data[JVE__MAX];
         const dReal *Jcopy = localContext->m_Jcopy;
         const dReal *lambda = stage4CallContext->m_lambda;
         const dxMIndexItem *mindex = localContext->m_mindex;
         dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
+        const bool warmStartingEnabled = callContext->m_world->qs.GetIsWarmStartingEnabled();
 
         unsigned int nj = localContext->m_nj;
         const unsigned int step_size = dxQUICKSTEPISLAND_STAGE4B_STEP;
@@ -3134,9 +3457,9 @@ void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContex
                     const dReal *lambdacurr = lambda + mindex[ji].mIndex;
                     dxJoint *joint = jointinfos[ji].joint;
 
-#ifdef WARM_STARTING
-                    memcpy(joint->lambda, lambdacurr, fb_infom * sizeof(dReal));
-#endif
+                    if (warmStartingEnabled) {
+                        memcpy(joint->lambda, lambdacurr, fb_infom * sizeof(dReal));
+                    }
 
                     dJointFeedback *fb = joint->feedback;
 
@@ -3164,13 +3487,11 @@ void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContex
 
                     Jcopycurr += fb_infom * JCE__MAX;
                 }
-                else {
-#ifdef WARM_STARTING
+                else if (warmStartingEnabled) {
                     const dReal *lambdacurr = lambda + mindex[ji].mIndex;
                     const unsigned int infom = mindex[ji + 1].mIndex - mindex[ji].mIndex;
                     dxJoint *joint = jointinfos[ji].joint;
                     memcpy(joint->lambda, lambdacurr, infom * sizeof(dReal));
-#endif
                 }
 
                 if (++ji == jiend) {
@@ -3194,6 +3515,8 @@ int dxQuickStepIsland_Stage5_Callback(void *_stage5CallContext, dcallindex_t cal
 static 
 void dxQuickStepIsland_Stage5(dxQuickStepperStage5CallContext *stage5CallContext)
 {
+    dxStepProfileScope profileScope(stage5CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep5);
+
     const dxStepperProcessingCallContext *callContext = stage5CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage5CallContext->m_localContext;
 
@@ -3298,6 +3621,8 @@ int dxQuickStepIsland_Stage6a_Callback(void *_stage6CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage6a(dxQuickStepperStage6CallContext *stage6CallContext)
 {
+    dxStepProfileScope profileScope(stage6CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep6);
+
     const dxStepperProcessingCallContext *callContext = stage6CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage6CallContext->m_localContext;
 
@@ -3364,6 +3689,8 @@ int dxQuickStepIsland_Stage6aSync_Callback(void *_stage6CallContext, dcallindex_
 static 
 void dxQuickStepIsland_Stage6_VelocityCheck(dxQuickStepperStage6CallContext *stage6CallContext)
 {
+    dxStepProfileScope profileScope(stage6CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageQuickStep6);
+
     (void)stage6CallContext; // can be unused
 #ifdef CHECK_VELOCITY_OBEYS_CONSTRAINT
     const dxQuickStepperLocalContext *localContext = stage6CallContext->m_localContext;
@@ -3408,6 +3735,8 @@ int dxQuickStepIsland_Stage6b_Callback(void *_stage6CallContext, dcallindex_t ca
 static 
 void dxQuickStepIsland_Stage6b(dxQuickStepperStage6CallContext *stage6CallContext)
 {
+    dxStepProfileScope profileScope(stage6CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageBodyIntegration);
+
     const dxStepperProcessingCallContext *callContext = stage6CallContext->m_stepperCallContext;
 
     dReal stepsize = callContext->m_stepSize;
@@ -3425,10 +3754,11 @@ void dxQuickStepIsland_Stage6b(dxQuickStepperStage6CallContext *stage6CallContex
         unsigned int bicnt = dMIN(step_size, nb - bi);
 
         dxBody *const *bodycurr = body + bi;
+        dxStepBodies (bodycurr, bicnt, stepsize);
+
         dxBody *const *bodyend = bodycurr + bicnt;
         while (true) {
             dxBody *b = *bodycurr;
-            dxStepBody (b, stepsize);
             dZeroVector3 (b->facc);
             dZeroVector3 (b->tacc);
             if (++bodycurr == bodyend) {
@@ -0,0 +1,118 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+// Contact impulse cache for QuickStep warm starting.
+
+#include <ode/common.h>
+#include "config.h"
+#include "odemath.h"
+#include "quickstep_cache.h"
+#include "joints/contact.h"
+
+#include <algorithm>
+
+
+struct dxContactImpulseCacheItemLess
+{
+    bool operator ()(const dxContactImpulseCacheItem &item1, const dxContactImpulseCacheItem &item2) const
+    {
+        return (sizeint)item1.g1 != (sizeint)item2.g1 ? (sizeint)item1.g1 < (sizeint)item2.g1 : (sizeint)item1.g2 < (sizeint)item2.g2;
+    }
+};
+
+
+void dxContactImpulseCache::rebuild(dxJoint *const *joints, sizeint jointCount)
+{
+    m_items.setSize(0);
+
+    for (dxJoint *const *jointsEnd = joints + jointCount; joints != jointsEnd; ++joints) {
+        dxJoint *j = *joints;
+
+        if (j->type() == dJointTypeContact) {
+            const dxJointContact *contactJoint = static_cast<const dxJointContact *>(j);
+            const unsigned m = (unsigned)contactJoint->the_m;
+
+            if (m != 0) {
+                const dContactGeom &contactGeom = contactJoint->contact.geom;
+
+                dxContactImpulseCacheItem item;
+                item.g1 = contactGeom.g1;
+                item.g2 = contactGeom.g2;
+                item.serial1 = contactJoint->geom_serials[0];
+                item.serial2 = contactJoint->geom_serials[1];
+                dCopyVector3(item.pos, contactGeom.pos);
+                item.side1 = contactGeom.side1;
+                item.side2 = contactGeom.side2;
+                item.m = m;
+                dSASSERT(sizeof(item.lambda) == sizeof(j->lambda));
+                memcpy(item.lambda, j->lambda, sizeof(item.lambda));
+
+                m_items.push(item);
+            }
+        }
+    }
+
+    dxContactImpulseCacheItem *items = m_items.data();
+    std::sort(items, items + m_items.size(), dxContactImpulseCacheItemLess());
+}
+
+const dxContactImpulseCacheItem *dxContactImpulseCache::findMatch(const dxJointContact *contactJoint, dReal tolerance) const
+{
+    const dxContactImpulseCacheItem *result = NULL;
+
+    const dContactGeom &contactGeom = contactJoint->contact.geom;
+    const unsigned serial1 = contactJoint->geom_serials[0], serial2 = contactJoint->geom_serials[1];
+
+    const dxContactImpulseCacheItem *const items = m_items.data(), *const itemsEnd = items + m_items.size();
+
+    dxContactImpulseCacheItem key;
+    key.g1 = contactGeom.g1;
+    key.g2 = contactGeom.g2;
+
+    const dReal toleranceSquare = tolerance * tolerance;
+    dReal bestScore = dInfinity;
+
+    for (const dxContactImpulseCacheItem *current = std::lower_bound(items, itemsEnd, key, dxContactImpulseCacheItemLess()); 
+        current != itemsEnd && current->g1 == key.g1 && current->g2 == key.g2; ++current) {
+        if (current->serial1 != serial1 || current->serial2 != serial2) {
+            continue;
+        }
+
+        dVector3 offset;
+        dSubtractVectors3(offset, current->pos, contactGeom.pos);
+        
+        dReal distanceSquare = dCalcVectorLengthSquare3(offset);
+        if (distanceSquare <= toleranceSquare) {
+            // Prefer records of the same contact features to just the nearest ones
+            dReal score = current->side1 == contactGeom.side1 && current->side2 == contactGeom.side2 
+                ? distanceSquare : distanceSquare + toleranceSquare;
+
+            if (score < bestScore) {
+                bestScore = score;
+                result = current;
+            }
+        }
+    }
+
+    return result;
+}
+
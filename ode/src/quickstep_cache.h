@@ -0,0 +1,84 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+ * Contact impulse cache for QuickStep warm starting.
+ *
+ * Contact joints are normally re-created on every step and therefore can't
+ * keep their lambdas in dxJoint::lambda between steps. The cache records
+ * the impulses of the contacts solved during the last step keyed by their
+ * geom pair and contact position, and the new contacts of the next step are
+ * matched against those records to seed the SOR iterations. The geom serials
+ * are a part of the key so that the impulses of a destroyed geom are never
+ * matched to a new one allocated at the same address.
+ *
+ * The cache is rebuilt single-threaded after the step has completed and is
+ * only read during the step, so lookups need no synchronization.
+ */
+
+#ifndef _ODE_QUICK_STEP_CACHE_H_
+#define _ODE_QUICK_STEP_CACHE_H_
+
+#include <ode/common.h>
+#include <ode/contact.h>
+#include "objects.h"
+#include "array.h"
+
+
+struct dxJointContact;
+
+struct dxContactImpulseCacheItem
+{
+    // The geom pointers are only used as a key and are never dereferenced:
+    // the geoms might have already been destroyed by the time of lookup.
+    dxGeom          *g1, *g2;
+    unsigned        serial1, serial2;
+    dVector3        pos;
+    int             side1, side2;
+    unsigned        m;              // number of constraint rows the contact had
+    dReal           lambda[6];      // the first row is always the normal one
+};
+
+
+class dxContactImpulseCache:
+    public dBase
+{
+public:
+    dxContactImpulseCache() {}
+
+    void clear() { m_items.setSize(0); }
+    unsigned getItemCount() const { return (unsigned)m_items.size(); }
+
+    // Record impulses of the contact joints of the islands stepped last.
+    // The joints of the sleeping islands are not visited.
+    void rebuild(dxJoint *const *joints, sizeint jointCount);
+
+    // Find the record of the same geoms closest to the contact within the distance tolerance.
+    // Records with different contact features are penalized but still accepted.
+    const dxContactImpulseCacheItem *findMatch(const dxJointContact *contactJoint, dReal tolerance) const;
+
+private:
+    dArray<dxContactImpulseCacheItem> m_items; // sorted by geom pair
+};
+
+
+#endif
@@ -51,7 +51,7 @@ dxRequiredResourceContainer::~dxRequiredResourceContainer()
 }
 
 
-bool dxRequiredResourceContainer::allocateResources(const dxResourceRequirementDescriptor &requirementDescriptor)
+bool dxRequiredResourceContainer::allocateResources(const dxResourceRequirementDescriptor &requirementDescriptor, dCallWaitID dedicatedCallWait/*=NULL*/)
 {
     bool result = false;
     
@@ -88,7 +88,7 @@ bool dxRequiredResourceContainer::allocateResources(const dxResourceRequirementD
 
         if (requirementDescriptor.getIsStockCallWaitRequired())
         {
-             stockCallWait = relatedThreading->AllocateOrRetrieveStockCallWaitID();
+             stockCallWait = dedicatedCallWait != NULL ? dedicatedCallWait : relatedThreading->AllocateOrRetrieveStockCallWaitID();
              if (stockCallWait == NULL)
              {
                  break;
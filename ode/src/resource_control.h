@@ -126,7 +126,9 @@ public:
 
     ~dxRequiredResourceContainer();
 
-    bool allocateResources(const dxResourceRequirementDescriptor &requirementDescriptor);
+    // A dedicated call wait may be given to be used instead of the threading's stock one 
+    // (e.g. within the threaded calls while the stock call wait is being waited on).
+    bool allocateResources(const dxResourceRequirementDescriptor &requirementDescriptor, dCallWaitID dedicatedCallWait=NULL);
     void freeResources();
 
 public:
@@ -0,0 +1,330 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+ * SIMD helpers for the hot solver loops.
+ *
+ * The instruction set is selected at build time from the compiler target
+ * (AVX, SSE2 or AArch64 NEON). Defining dSIMD_DISABLED (--disable-simd or
+ * ODE_NO_SIMD) makes dSIMD_ENABLED undefined and the callers use their
+ * scalar code instead.
+ *
+ * The helpers operate on unaligned 6-element dReal vectors laid out as
+ * the dynamics arrays (dDA_LX..dDA_AZ) are:
+ *   dxSIMDDot6(a, b)                returns the dot product of a and b;
+ *   dxSIMDAddScaled6(a, b, scale)   performs a += b * scale.
+ * The summation order differs from the straightforward scalar loops 
+ * and so may the results in the last bits.
+ *
+ * The lane helpers process dSIMD_LANE_COUNT independent values at once,
+ * e.g. a field of that many bodies gathered into a contiguous array:
+ *   dxSIMDLoadLanes(p), dxSIMDStoreLanes(p, v)  unaligned load and store;
+ *   dxSIMDSetLanes(x)                           all lanes set to x;
+ *   dxSIMDAddLanes, dxSIMDSubLanes, dxSIMDMulLanes, dxSIMDDivLanes(a, b),
+ *   dxSIMDNegLanes(a), dxSIMDSqrtLanes(a)       the lane-wise arithmetics;
+ *   dxSIMDAllLanesPositive(a)                   true if all lanes are > 0.
+ * Being lane-wise, these give the same results as the scalar operations.
+ */
+
+#ifndef _ODE_SIMD_H_
+#define _ODE_SIMD_H_
+
+
+#include <ode/common.h>
+
+
+#if !defined(dSIMD_DISABLED)
+
+#if defined(__AVX__)
+#define dSIMD_AVX 1
+#define dSIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define dSIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define dSIMD_NEON 1
+#endif
+
+#if defined(dSIMD_SSE2) || defined(dSIMD_NEON)
+#define dSIMD_ENABLED 1
+#endif
+
+#endif // #if !defined(dSIMD_DISABLED)
+
+
+#if defined(dSIMD_AVX)
+#include <immintrin.h>
+#elif defined(dSIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(dSIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#if defined(dSIMD_ENABLED)
+
+#if defined(dSIMD_SSE2)
+
+#if defined(dDOUBLE)
+
+#if defined(dSIMD_AVX)
+
+static inline
+dReal dxSIMDDot6(const dReal *a, const dReal *b)
+{
+    __m256d p0123 = _mm256_mul_pd(_mm256_loadu_pd(a), _mm256_loadu_pd(b));
+    __m128d p45 = _mm_mul_pd(_mm_loadu_pd(a + 4), _mm_loadu_pd(b + 4));
+    __m128d s = _mm_add_pd(_mm_add_pd(_mm256_castpd256_pd128(p0123), _mm256_extractf128_pd(p0123, 1)), p45);
+    s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+    return _mm_cvtsd_f64(s);
+}
+
+static inline
+void dxSIMDAddScaled6(dReal *a, const dReal *b, dReal scale)
+{
+    __m256d vscale = _mm256_set1_pd(scale);
+    _mm256_storeu_pd(a, _mm256_add_pd(_mm256_loadu_pd(a), _mm256_mul_pd(_mm256_loadu_pd(b), vscale)));
+    _mm_storeu_pd(a + 4, _mm_add_pd(_mm_loadu_pd(a + 4), _mm_mul_pd(_mm_loadu_pd(b + 4), _mm256_castpd256_pd128(vscale))));
+}
+
+#else // #if !defined(dSIMD_AVX)
+
+static inline
+dReal dxSIMDDot6(const dReal *a, const dReal *b)
+{
+    __m128d p01 = _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b));
+    __m128d p23 = _mm_mul_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2));
+    __m128d p45 = _mm_mul_pd(_mm_loadu_pd(a + 4), _mm_loadu_pd(b + 4));
+    __m128d s = _mm_add_pd(_mm_add_pd(p01, p23), p45);
+    s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+    return _mm_cvtsd_f64(s);
+}
+
+static inline
+void dxSIMDAddScaled6(dReal *a, const dReal *b, dReal scale)
+{
+    __m128d vscale = _mm_set1_pd(scale);
+    _mm_storeu_pd(a, _mm_add_pd(_mm_loadu_pd(a), _mm_mul_pd(_mm_loadu_pd(b), vscale)));
+    _mm_storeu_pd(a + 2, _mm_add_pd(_mm_loadu_pd(a + 2), _mm_mul_pd(_mm_loadu_pd(b + 2), vscale)));
+    _mm_storeu_pd(a + 4, _mm_add_pd(_mm_loadu_pd(a + 4), _mm_mul_pd(_mm_loadu_pd(b + 4), vscale)));
+}
+
+#endif // #if !defined(dSIMD_AVX)
+
+#else // #if !defined(dDOUBLE)
+
+// The trailing pair is moved with 64-bit loads/stores to not touch the memory past the vector
+
+static inline
+dReal dxSIMDDot6(const dReal *a, const dReal *b)
+{
+    __m128 p0123 = _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+    __m128 p45 = _mm_mul_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(a + 4)), _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(b + 4)));
+    __m128 s = _mm_add_ps(p0123, p45);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+static inline
+void dxSIMDAddScaled6(dReal *a, const dReal *b, dReal scale)
+{
+    __m128 vscale = _mm_set1_ps(scale);
+    _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), _mm_mul_ps(_mm_loadu_ps(b), vscale)));
+    __m128 a45 = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(a + 4));
+    __m128 b45 = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(b + 4));
+    _mm_storel_pi((__m64 *)(a + 4), _mm_add_ps(a45, _mm_mul_ps(b45, vscale)));
+}
+
+#endif // #if !defined(dDOUBLE)
+
+
+#elif defined(dSIMD_NEON)
+
+#if defined(dDOUBLE)
+
+static inline
+dReal dxSIMDDot6(const dReal *a, const dReal *b)
+{
+    float64x2_t p01 = vmulq_f64(vld1q_f64(a), vld1q_f64(b));
+    float64x2_t p23 = vmulq_f64(vld1q_f64(a + 2), vld1q_f64(b + 2));
+    float64x2_t p45 = vmulq_f64(vld1q_f64(a + 4), vld1q_f64(b + 4));
+    return vaddvq_f64(vaddq_f64(vaddq_f64(p01, p23), p45));
+}
+
+static inline
+void dxSIMDAddScaled6(dReal *a, const dReal *b, dReal scale)
+{
+    float64x2_t vscale = vdupq_n_f64(scale);
+    vst1q_f64(a, vaddq_f64(vld1q_f64(a), vmulq_f64(vld1q_f64(b), vscale)));
+    vst1q_f64(a + 2, vaddq_f64(vld1q_f64(a + 2), vmulq_f64(vld1q_f64(b + 2), vscale)));
+    vst1q_f64(a + 4, vaddq_f64(vld1q_f64(a + 4), vmulq_f64(vld1q_f64(b + 4), vscale)));
+}
+
+#else // #if !defined(dDOUBLE)
+
+static inline
+dReal dxSIMDDot6(const dReal *a, const dReal *b)
+{
+    float32x4_t p0123 = vmulq_f32(vld1q_f32(a), vld1q_f32(b));
+    float32x2_t p45 = vmul_f32(vld1_f32(a + 4), vld1_f32(b + 4));
+    return vaddvq_f32(p0123) + vaddv_f32(p45);
+}
+
+static inline
+void dxSIMDAddScaled6(dReal *a, const dReal *b, dReal scale)
+{
+    vst1q_f32(a, vaddq_f32(vld1q_f32(a), vmulq_f32(vld1q_f32(b), vdupq_n_f32(scale))));
+    vst1_f32(a + 4, vadd_f32(vld1_f32(a + 4), vmul_f32(vld1_f32(b + 4), vdup_n_f32(scale))));
+}
+
+#endif // #if !defined(dDOUBLE)
+
+
+#endif // #elif defined(dSIMD_NEON)
+
+
+#if defined(dSIMD_SSE2)
+
+#if defined(dDOUBLE)
+
+#if defined(dSIMD_AVX)
+
+#define dSIMD_LANE_COUNT 4
+
+typedef __m256d dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return _mm256_loadu_pd(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { _mm256_storeu_pd(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return _mm256_set1_pd(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_add_pd(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_sub_pd(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_mul_pd(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_div_pd(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return _mm256_sqrt_pd(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return _mm256_movemask_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ)) == 0xF; }
+
+#else // #if !defined(dSIMD_AVX)
+
+#define dSIMD_LANE_COUNT 2
+
+typedef __m128d dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return _mm_loadu_pd(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { _mm_storeu_pd(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return _mm_set1_pd(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_add_pd(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_sub_pd(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_mul_pd(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_div_pd(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return _mm_sqrt_pd(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return _mm_movemask_pd(_mm_cmpgt_pd(a, _mm_setzero_pd())) == 0x3; }
+
+#endif // #if !defined(dSIMD_AVX)
+
+#else // #if !defined(dDOUBLE)
+
+#if defined(dSIMD_AVX)
+
+#define dSIMD_LANE_COUNT 8
+
+typedef __m256 dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return _mm256_loadu_ps(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { _mm256_storeu_ps(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return _mm256_set1_ps(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_add_ps(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_sub_ps(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_mul_ps(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm256_div_ps(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return _mm256_sqrt_ps(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)) == 0xFF; }
+
+#else // #if !defined(dSIMD_AVX)
+
+#define dSIMD_LANE_COUNT 4
+
+typedef __m128 dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return _mm_loadu_ps(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { _mm_storeu_ps(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return _mm_set1_ps(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_add_ps(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_sub_ps(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_mul_ps(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return _mm_div_ps(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return _mm_sqrt_ps(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return _mm_movemask_ps(_mm_cmpgt_ps(a, _mm_setzero_ps())) == 0xF; }
+
+#endif // #if !defined(dSIMD_AVX)
+
+#endif // #if !defined(dDOUBLE)
+
+
+#elif defined(dSIMD_NEON)
+
+#if defined(dDOUBLE)
+
+#define dSIMD_LANE_COUNT 2
+
+typedef float64x2_t dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return vld1q_f64(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { vst1q_f64(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return vdupq_n_f64(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return vaddq_f64(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return vsubq_f64(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return vmulq_f64(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return vdivq_f64(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return vnegq_f64(a); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return vsqrtq_f64(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return vminvq_u32(vreinterpretq_u32_u64(vcgtq_f64(a, vdupq_n_f64(0.0)))) != 0; }
+
+#else // #if !defined(dDOUBLE)
+
+#define dSIMD_LANE_COUNT 4
+
+typedef float32x4_t dxSIMDLanes;
+
+static inline dxSIMDLanes dxSIMDLoadLanes(const dReal *p) { return vld1q_f32(p); }
+static inline void dxSIMDStoreLanes(dReal *p, dxSIMDLanes v) { vst1q_f32(p, v); }
+static inline dxSIMDLanes dxSIMDSetLanes(dReal x) { return vdupq_n_f32(x); }
+static inline dxSIMDLanes dxSIMDAddLanes(dxSIMDLanes a, dxSIMDLanes b) { return vaddq_f32(a, b); }
+static inline dxSIMDLanes dxSIMDSubLanes(dxSIMDLanes a, dxSIMDLanes b) { return vsubq_f32(a, b); }
+static inline dxSIMDLanes dxSIMDMulLanes(dxSIMDLanes a, dxSIMDLanes b) { return vmulq_f32(a, b); }
+static inline dxSIMDLanes dxSIMDDivLanes(dxSIMDLanes a, dxSIMDLanes b) { return vdivq_f32(a, b); }
+static inline dxSIMDLanes dxSIMDNegLanes(dxSIMDLanes a) { return vnegq_f32(a); }
+static inline dxSIMDLanes dxSIMDSqrtLanes(dxSIMDLanes a) { return vsqrtq_f32(a); }
+static inline bool dxSIMDAllLanesPositive(dxSIMDLanes a) { return vminvq_u32(vcgtq_f32(a, vdupq_n_f32(0.0f))) != 0; }
+
+#endif // #if !defined(dDOUBLE)
+
+#endif // #elif defined(dSIMD_NEON)
+
+
+#endif // #if defined(dSIMD_ENABLED)
+
+
+#endif // #ifndef _ODE_SIMD_H_
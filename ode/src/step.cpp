@@ -24,6 +24,7 @@
 #include <ode/rotation.h>
 #include <ode/timer.h>
 #include <ode/error.h>
+#include <ode/matrix_coop.h>
 #include "config.h"
 #include "odemath.h"
 #include "matrix.h"
@@ -32,6 +33,8 @@
 #include "lcp.h"
 #include "util.h"
 #include "threadingutils.h"
+#include "resource_control.h"
+#include "step_profile.h"
 
 #include <new>
 
@@ -51,6 +54,13 @@
 #define IFTIMING(x) ((void)0)
 #endif
 
+// LCPs of at least this many rows are factored cooperatively by the stepper threads
+#define dxSTEPISLAND_COOPERATIVE_LCP_ROWS_MINIMUM 64
+
+// islands of at least this many rows, no more than a quarter of which are bounded
+// or close loops, are solved with the tree-structured solver
+#define dxSTEP_TREE_SOLVER_ROWS_MINIMUM 32
+
 
 struct dJointWithInfo1
 {
@@ -271,7 +281,7 @@ struct dxStepperLocalContext
     void Initialize(dReal *invI, dJointWithInfo1 *jointinfos, unsigned int nj, 
         unsigned int m, unsigned int nub, const unsigned int *mindex, int *findex, 
         dReal *J, dReal *A, dReal *pairsRhsCfm, dReal *pairsLoHi, 
-        atomicord32 *bodyStartJoints, atomicord32 *bodyJointLinks)
+        atomicord32 *bodyStartJoints, atomicord32 *bodyJointLinks, const bool *treeJoints)
     {
         m_invI = invI;
         m_jointinfos = jointinfos;
@@ -286,6 +296,7 @@ struct dxStepperLocalContext
         m_pairsLoHi = pairsLoHi;
         m_bodyStartJoints = bodyStartJoints;
         m_bodyJointLinks = bodyJointLinks;
+        m_treeJoints = treeJoints;
     }
 
     dReal                           *m_invI;
@@ -301,6 +312,7 @@ struct dxStepperLocalContext
     dReal                           *m_pairsLoHi;
     atomicord32                     *m_bodyStartJoints;
     atomicord32                     *m_bodyJointLinks;
+    const bool                      *m_treeJoints; // NULL unless the island is solved with the tree-structured solver (A is NULL then)
 };
 
 struct dxStepperStage2CallContext
@@ -507,6 +519,585 @@ void MultiplyAddJxLambdaToCForce(dReal cforce[CFE__MAX],
 }
 
 
+//****************************************************************************
+// tree-structured islands
+//
+// If the joints with unbounded rows connect the island bodies without loops,
+// the system [M J'; J -C] of those joints is factored and solved in linear
+// time with the bodies and the joints as the nodes of a forest (D. Baraff,
+// "Linear-Time Dynamics using Lagrange Multipliers", SIGGRAPH 1996). The rows
+// of the remaining joints (the bounded ones and the ones closing loops) are
+// solved as a dense LCP with the matrix and the right hand side reduced by
+// the tree rows. The columns of the reduced matrix are computed with a tree
+// solve each.
+
+#define TREE_BLOCK_SIZE 6 // the body block size; joints never have more rows
+
+struct dxStepperTreeNode
+{
+    int                             m_parent;       // the parent node or -1 for roots
+    unsigned int                    m_dim;          // 6 for bodies, 0 for kinematic bodies, row count for joints
+    unsigned int                    m_vecOffset;    // offset of the node elements in the solving vectors
+    dReal                           m_sign;         // -1 for joints as sign*D is factored to be positive definite
+    const dReal                     *m_edgeJ;       // the joint Jacobian rows for the body of the edge to the parent
+    dReal                           m_P[TREE_BLOCK_SIZE * TREE_BLOCK_SIZE]; // Cholesky factor of sign*D
+    dReal                           m_Jp[TREE_BLOCK_SIZE * TREE_BLOCK_SIZE]; // D^-1 * H(node, parent)
+};
+
+struct dxStepperTreeOtherRow
+{
+    const dReal                     *m_J[dJCB__MAX];    // Jacobian rows for the bodies or NULLs
+    unsigned int                    m_vecOffset[dJCB__MAX];
+};
+
+
+static inline
+unsigned int FindTreeBodySet(unsigned int *bodySets, unsigned int bi)
+{
+    while (bodySets[bi] != bi) {
+        bodySets[bi] = bodySets[bodySets[bi]];
+        bi = bodySets[bi];
+    }
+    return bi;
+}
+
+// Selects the joints for the tree-structured solver or returns NULL if the island is to be solved densely.
+
+static
+const bool *dxStepIsland_SelectTreeJoints(dxWorldProcessMemArena *memarena, unsigned int nb,
+    const dJointWithInfo1 *jointinfos, unsigned int nj, unsigned int m)
+{
+    if (m < dxSTEP_TREE_SOLVER_ROWS_MINIMUM) {
+        return NULL;
+    }
+
+    bool *treeJoints = memarena->AllocateArray<bool>(nj);
+    unsigned int *bodySets = memarena->AllocateArray<unsigned int>(nb);
+    for (unsigned int bi = 0; bi != nb; ++bi) bodySets[bi] = bi;
+
+    // kinematic bodies do not move with the joints and act as the world does
+    unsigned int mOther = 0;
+    for (unsigned int ji = 0; ji != nj; ++ji) {
+        const dJointWithInfo1 *jicurr = jointinfos + ji;
+        bool isTreeJoint = false;
+
+        if (jicurr->info.nub == jicurr->info.m) {
+            dxBody *jb0 = jicurr->joint->node[0].body;
+            dxBody *jb1 = jicurr->joint->node[1].body;
+            if (jb0->invMass != 0 && jb1 != NULL && jb1->invMass != 0) {
+                unsigned int set0 = FindTreeBodySet(bodySets, (unsigned)jb0->tag);
+                unsigned int set1 = FindTreeBodySet(bodySets, (unsigned)jb1->tag);
+                if (set0 != set1) {
+                    bodySets[set0] = set1;
+                    isTreeJoint = true;
+                }
+            }
+            else {
+                isTreeJoint = true;
+            }
+        }
+
+        treeJoints[ji] = isTreeJoint;
+        mOther += isTreeJoint ? 0 : jicurr->info.m;
+    }
+
+    return 4 * mOther <= m ? treeJoints : NULL;
+}
+
+
+// Cholesky factorization of a positive definite block; the lower triangle is used.
+
+static
+void FactorTreeBlock(dReal *a, unsigned int n)
+{
+    for (unsigned int j = 0; j != n; ++j) {
+        dReal *rowj = a + (sizeint)j * TREE_BLOCK_SIZE;
+        dReal sum = rowj[j];
+        for (unsigned int k = 0; k != j; ++k) sum -= rowj[k] * rowj[k];
+        // redundant constraints with zero CFM make the block singular; keep the pivot positive
+        const dReal minimum = rowj[j] != 0 ? dEpsilon * dFabs(rowj[j]) : dEpsilon;
+        if (!(sum > minimum)) {
+            sum = minimum;
+        }
+        const dReal ljj = dSqrt(sum);
+        rowj[j] = ljj;
+
+        const dReal ljjRecip = dRecip(ljj);
+        for (unsigned int i = j + 1; i != n; ++i) {
+            dReal *rowi = a + (sizeint)i * TREE_BLOCK_SIZE;
+            dReal s = rowi[j];
+            for (unsigned int k = 0; k != j; ++k) s -= rowi[k] * rowj[k];
+            rowi[j] = s * ljjRecip;
+        }
+    }
+}
+
+// Solves L*L'*x = sign*b in place for a vector with elements bstride apart.
+
+static
+void SolveTreeBlock(const dReal *l, unsigned int n, dReal sign, dReal *b, unsigned int bstride)
+{
+    for (unsigned int i = 0; i != n; ++i) {
+        const dReal *rowi = l + (sizeint)i * TREE_BLOCK_SIZE;
+        dReal s = b[i * bstride];
+        for (unsigned int k = 0; k != i; ++k) s -= rowi[k] * b[k * bstride];
+        b[i * bstride] = s / rowi[i];
+    }
+    for (unsigned int i = n; i != 0; ) {
+        --i;
+        dReal s = b[i * bstride];
+        for (unsigned int k = i + 1; k != n; ++k) s -= l[(sizeint)k * TREE_BLOCK_SIZE + i] * b[k * bstride];
+        b[i * bstride] = s / l[(sizeint)i * TREE_BLOCK_SIZE + i];
+    }
+    if (sign < 0) {
+        for (unsigned int i = 0; i != n; ++i) b[i * bstride] = -b[i * bstride];
+    }
+}
+
+// Builds the block H(node, parent) of the off-diagonal Jacobian elements.
+
+static
+void BuildTreeEdgeBlock(dReal *h, const dxStepperTreeNode *node, const dxStepperTreeNode *parent, bool nodeIsJoint)
+{
+    const dReal *edgeJ = node->m_edgeJ;
+    if (nodeIsJoint) {
+        for (unsigned int r = 0; r != node->m_dim; ++r) {
+            for (unsigned int c = 0; c != dDA__MAX; ++c) h[(sizeint)r * TREE_BLOCK_SIZE + c] = edgeJ[(sizeint)r * JME__MAX + JME__J_MIN + c];
+        }
+    }
+    else {
+        for (unsigned int r = 0; r != parent->m_dim; ++r) {
+            for (unsigned int c = 0; c != dDA__MAX; ++c) h[(sizeint)c * TREE_BLOCK_SIZE + r] = edgeJ[(sizeint)r * JME__MAX + JME__J_MIN + c];
+        }
+    }
+}
+
+// Solves the tree system for the vector v in place; order lists the nodes parents first.
+
+static
+void SolveTree(const dxStepperTreeNode *nodes, const unsigned int *order, unsigned int nodeCount, dReal *v)
+{
+    for (unsigned int q = nodeCount; q != 0; ) {
+        const dxStepperTreeNode *node = nodes + order[--q];
+        if (node->m_parent != -1) {
+            const dxStepperTreeNode *parent = nodes + node->m_parent;
+            const dReal *vnode = v + node->m_vecOffset;
+            dReal *vparent = v + parent->m_vecOffset;
+            for (unsigned int c = 0; c != parent->m_dim; ++c) {
+                dReal sum = 0;
+                for (unsigned int r = 0; r != node->m_dim; ++r) sum += node->m_Jp[(sizeint)r * TREE_BLOCK_SIZE + c] * vnode[r];
+                vparent[c] -= sum;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i != nodeCount; ++i) {
+        const dxStepperTreeNode *node = nodes + i;
+        SolveTreeBlock(node->m_P, node->m_dim, node->m_sign, v + node->m_vecOffset, 1);
+    }
+
+    for (unsigned int q = 0; q != nodeCount; ++q) {
+        const dxStepperTreeNode *node = nodes + order[q];
+        if (node->m_parent != -1) {
+            const dxStepperTreeNode *parent = nodes + node->m_parent;
+            dReal *vnode = v + node->m_vecOffset;
+            const dReal *vparent = v + parent->m_vecOffset;
+            for (unsigned int r = 0; r != node->m_dim; ++r) {
+                dReal sum = 0;
+                for (unsigned int c = 0; c != parent->m_dim; ++c) sum += node->m_Jp[(sizeint)r * TREE_BLOCK_SIZE + c] * vparent[c];
+                vnode[r] -= sum;
+            }
+        }
+    }
+}
+
+// Puts -rhs of the tree rows into the joint node elements of v.
+
+static
+void SetTreeJointsRHS(dReal *v, const dxStepperTreeNode *jointNodes, const unsigned int *nodeJoints, unsigned int treeJointCount,
+    const unsigned int *mindex, const dReal *pairsRhsCfm)
+{
+    for (unsigned int ti = 0; ti != treeJointCount; ++ti) {
+        const dxStepperTreeNode *node = jointNodes + ti;
+        const dReal *rowRhsCfm = pairsRhsCfm + (sizeint)mindex[nodeJoints[ti]] * RCE__RHS_CFM_MAX;
+        dReal *vnode = v + node->m_vecOffset;
+        for (unsigned int r = 0; r != node->m_dim; ++r) vnode[r] = -(rowRhsCfm + (sizeint)r * RCE__RHS_CFM_MAX)[RCE_RHS];
+    }
+}
+
+static inline
+dReal MultiplyTreeOtherRow(const dxStepperTreeOtherRow *row, const dReal *v)
+{
+    dReal sum = 0;
+    for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+        if (row->m_J[jb] != NULL) {
+            const dReal *vbody = v + row->m_vecOffset[jb];
+            for (unsigned int c = 0; c != dDA__MAX; ++c) sum += row->m_J[jb][JME__J_MIN + c] * vbody[c];
+        }
+    }
+    return sum;
+}
+
+static inline
+void AddScaledTreeOtherRow(dReal *v, const dxStepperTreeOtherRow *row, dReal scale)
+{
+    for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+        if (row->m_J[jb] != NULL) {
+            dReal *vbody = v + row->m_vecOffset[jb];
+            for (unsigned int c = 0; c != dDA__MAX; ++c) vbody[c] += row->m_J[jb][JME__J_MIN + c] * scale;
+        }
+    }
+}
+
+static
+sizeint EstimateTreeSolverMemoryRequirements(unsigned int nb, unsigned int nj, unsigned int m)
+{
+    const unsigned int nodeCount = nb + nj;
+    const unsigned int mOther = m / 4;
+
+    sizeint res = 0;
+    res += dEFFICIENT_SIZE(sizeof(dxStepperTreeNode) * nodeCount); // for nodes
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * nodeCount); // for order
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * nj); // for nodeJoints
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * (nb + 1)); // for bodyEdgeStarts
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * dJCB__MAX * nj); // for bodyEdges
+    res += dEFFICIENT_SIZE(sizeof(dReal) * ((sizeint)dDA__MAX * nb + m)); // for v
+    res += dEFFICIENT_SIZE(sizeof(int) * m); // for rowMap
+    res += dEFFICIENT_SIZE(sizeof(dxStepperTreeOtherRow) * mOther); // for otherRows
+    if (mOther != 0) {
+        res += dOVERALIGNED_SIZE(sizeof(dReal) * dPAD(mOther) * mOther, AMATRIX_ALIGNMENT); // for A
+        res += dEFFICIENT_SIZE(sizeof(dReal) * PBX__MAX * mOther); // for pairsbx
+        res += dEFFICIENT_SIZE(sizeof(dReal) * PLH__MAX * mOther); // for pairslh
+        res += dEFFICIENT_SIZE(sizeof(int) * mOther); // for findex
+        res += dxEstimateSolveLCPMemoryReq(mOther, false);
+    }
+    return res;
+}
+
+
+static
+void dxStepIsland_SolveLCP(const dxStepperProcessingCallContext *callContext, unsigned int m, dReal *A,
+    dReal *pairsRhsLambda, unsigned int nub, dReal *pairsLoHi, int *findex)
+{
+    dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
+    const unsigned allowedThreads = callContext->m_stepperAllowedThreads;
+    dxWorldProcessContext *context = callContext->m_world->unsafeGetWorldProcessingContext();
+
+    // Only one island at a time may solve cooperatively: its thread blocks
+    // waiting for the helpers and with several such islands all the threads
+    // could end up waiting for each other.
+    if (allowedThreads > 1 && m >= dxSTEPISLAND_COOPERATIVE_LCP_ROWS_MINIMUM
+        && context->TryAcquiringCooperativeSolving()) {
+        dxResourceRequirementDescriptor requirements(callContext->m_world);
+        dxEstimateCooperativeSolveLCPResourceRequirements(&requirements, allowedThreads, m);
+
+        dxRequiredResourceContainer *resources = context->ObtainCooperativeSolvingResources(requirements);
+
+        dxLCPCooperationInfo cooperation;
+        cooperation.m_resourceContainer = resources;
+        cooperation.m_allowedThreadCount = allowedThreads;
+        dxSolveLCP (memarena, m, A, pairsRhsLambda, NULL, nub, pairsLoHi, findex, resources != NULL ? &cooperation : NULL);
+
+        context->ReleaseCooperativeSolving();
+    }
+    else {
+        dxSolveLCP (memarena, m, A, pairsRhsLambda, NULL, nub, pairsLoHi, findex);
+    }
+}
+
+static
+void dxStepIsland_SolveTreeLCP(const dxStepperProcessingCallContext *callContext, const dxStepperLocalContext *localContext)
+{
+    dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
+    dxBody *const *body = callContext->m_islandBodiesStart;
+    const unsigned int nb = callContext->m_islandBodiesCount;
+    const dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
+    const unsigned int nj = localContext->m_nj;
+    const unsigned int m = localContext->m_m;
+    const unsigned int *mindex = localContext->m_mindex;
+    const bool *treeJoints = localContext->m_treeJoints;
+    const dReal *J = localContext->m_J;
+    dReal *pairsRhsLambda = localContext->m_pairsRhsCfm;
+    const dReal *pairsLoHi = localContext->m_pairsLoHi;
+    const int *findex = localContext->m_findex;
+
+    // create the nodes: the bodies followed by the tree joints
+    unsigned int treeJointCount = 0, mOther = 0;
+    for (unsigned int ji = 0; ji != nj; ++ji) {
+        if (treeJoints[ji]) {
+            ++treeJointCount;
+        }
+        else {
+            mOther += jointinfos[ji].info.m;
+        }
+    }
+
+    const unsigned int nodeCount = nb + treeJointCount;
+    dxStepperTreeNode *nodes = memarena->AllocateArray<dxStepperTreeNode>(nodeCount);
+    unsigned int *order = memarena->AllocateArray<unsigned int>(nodeCount);
+    unsigned int *nodeJoints = memarena->AllocateArray<unsigned int>(treeJointCount);
+    unsigned int *bodyEdgeStarts = memarena->AllocateArray<unsigned int>(nb + 1);
+    unsigned int *bodyEdges = memarena->AllocateArray<unsigned int>((sizeint)treeJointCount * dJCB__MAX);
+
+    const int unvisitedParent = -2;
+    unsigned int vecSize = 0;
+    for (unsigned int bi = 0; bi != nb; ++bi) {
+        dxStepperTreeNode *node = nodes + bi;
+        node->m_parent = unvisitedParent;
+        node->m_dim = body[bi]->invMass != 0 ? dDA__MAX : 0;
+        node->m_vecOffset = vecSize;
+        node->m_sign = REAL(1.0);
+        vecSize += node->m_dim;
+        bodyEdgeStarts[bi] = 0;
+    }
+    for (unsigned int ji = 0, ni = nb; ji != nj; ++ji) {
+        if (treeJoints[ji]) {
+            dxStepperTreeNode *node = nodes + ni;
+            node->m_parent = unvisitedParent;
+            node->m_dim = jointinfos[ji].info.m;
+            node->m_vecOffset = vecSize;
+            node->m_sign = REAL(-1.0);
+            vecSize += node->m_dim;
+            nodeJoints[ni - nb] = ji;
+            ++ni;
+
+            for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+                dxBody *b = jointinfos[ji].joint->node[jb].body;
+                if (b != NULL && b->invMass != 0) ++bodyEdgeStarts[b->tag];
+            }
+        }
+    }
+
+    // link the bodies to their tree joints
+    for (unsigned int bi = 0, edgeStart = 0; bi != nb + 1; ++bi) {
+        unsigned int edgeCount = bi != nb ? bodyEdgeStarts[bi] : 0;
+        bodyEdgeStarts[bi] = edgeStart;
+        edgeStart += edgeCount;
+    }
+    for (unsigned int ni = nb; ni != nodeCount; ++ni) {
+        dxJoint *joint = jointinfos[nodeJoints[ni - nb]].joint;
+        for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+            dxBody *b = joint->node[jb].body;
+            if (b != NULL && b->invMass != 0) bodyEdges[bodyEdgeStarts[b->tag]++] = ni;
+        }
+    }
+    for (unsigned int bi = nb; bi != 0; --bi) bodyEdgeStarts[bi] = bodyEdgeStarts[bi - 1];
+    bodyEdgeStarts[0] = 0;
+
+    // order the nodes breadth first so that parents precede their children
+    unsigned int orderCount = 0;
+    for (unsigned int root = 0; root != nodeCount; ++root) {
+        if (nodes[root].m_parent != unvisitedParent) {
+            continue;
+        }
+        nodes[root].m_parent = -1;
+        nodes[root].m_edgeJ = NULL;
+        order[orderCount++] = root;
+
+        for (unsigned int q = orderCount - 1; q != orderCount; ++q) {
+            const unsigned int ni = order[q];
+            if (ni < nb) {
+                for (unsigned int ei = bodyEdgeStarts[ni]; ei != bodyEdgeStarts[ni + 1]; ++ei) {
+                    const unsigned int child = bodyEdges[ei];
+                    if (nodes[child].m_parent == unvisitedParent) {
+                        const unsigned int ji = nodeJoints[child - nb];
+                        const unsigned int jrowOffset = jointinfos[ji].joint->node[1].body == body[ni] ? nodes[child].m_dim : 0;
+                        nodes[child].m_parent = (int)ni;
+                        nodes[child].m_edgeJ = J + ((sizeint)mindex[ji] * 2 + jrowOffset) * JME__MAX;
+                        order[orderCount++] = child;
+                    }
+                }
+            }
+            else {
+                const unsigned int ji = nodeJoints[ni - nb];
+                dxJoint *joint = jointinfos[ji].joint;
+                for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+                    dxBody *b = joint->node[jb].body;
+                    if (b != NULL && b->invMass != 0 && nodes[b->tag].m_parent == unvisitedParent) {
+                        const unsigned int child = (unsigned)b->tag;
+                        const unsigned int jrowOffset = jb != dJCB__MIN ? nodes[ni].m_dim : 0;
+                        nodes[child].m_parent = (int)ni;
+                        nodes[child].m_edgeJ = J + ((sizeint)mindex[ji] * 2 + jrowOffset) * JME__MAX;
+                        order[orderCount++] = child;
+                    }
+                }
+            }
+        }
+    }
+    dIASSERT(orderCount == nodeCount);
+
+    // initialize the diagonal blocks with M and -C
+    for (unsigned int bi = 0; bi != nb; ++bi) {
+        dxStepperTreeNode *node = nodes + bi;
+        if (node->m_dim != 0) {
+            dxBody *b = body[bi];
+            dMatrix3 tmp, I;
+            dMultiply2_333 (tmp, b->mass.I, b->posr.R);
+            dMultiply0_333 (I, b->posr.R, tmp);
+
+            dReal *P = node->m_P;
+            dSetZero(P, TREE_BLOCK_SIZE * TREE_BLOCK_SIZE);
+            for (unsigned int k = dSA__MIN; k != dSA__MAX; ++k) {
+                P[(sizeint)(dDA__L_MIN + k) * TREE_BLOCK_SIZE + dDA__L_MIN + k] = b->mass.mass;
+                for (unsigned int l = dSA__MIN; l != dSA__MAX; ++l) P[(sizeint)(dDA__A_MIN + k) * TREE_BLOCK_SIZE + dDA__A_MIN + l] = I[k * 4 + l];
+            }
+        }
+    }
+    for (unsigned int ni = nb; ni != nodeCount; ++ni) {
+        dxStepperTreeNode *node = nodes + ni;
+        const dReal *rowRhsCfm = pairsRhsLambda + (sizeint)mindex[nodeJoints[ni - nb]] * RCE__RHS_CFM_MAX;
+        dReal *P = node->m_P;
+        dSetZero(P, TREE_BLOCK_SIZE * TREE_BLOCK_SIZE);
+        for (unsigned int r = 0; r != node->m_dim; ++r) P[(sizeint)r * TREE_BLOCK_SIZE + r] = (rowRhsCfm + (sizeint)r * RCE__RHS_CFM_MAX)[RCE_CFM];
+    }
+
+    // factor the nodes children first: D(parent) -= H(node, parent)' * D(node)^-1 * H(node, parent)
+    for (unsigned int q = nodeCount; q != 0; ) {
+        const unsigned int ni = order[--q];
+        dxStepperTreeNode *node = nodes + ni;
+        FactorTreeBlock(node->m_P, node->m_dim);
+
+        if (node->m_parent != -1) {
+            dxStepperTreeNode *parent = nodes + node->m_parent;
+            dReal H[TREE_BLOCK_SIZE * TREE_BLOCK_SIZE];
+            BuildTreeEdgeBlock(H, node, parent, ni >= nb);
+
+            dReal *Jp = node->m_Jp;
+            memcpy(Jp, H, sizeof(H));
+            for (unsigned int c = 0; c != parent->m_dim; ++c) {
+                SolveTreeBlock(node->m_P, node->m_dim, node->m_sign, Jp + c, TREE_BLOCK_SIZE);
+            }
+
+            dReal *P = parent->m_P;
+            for (unsigned int i = 0; i != parent->m_dim; ++i) {
+                for (unsigned int j = 0; j <= i; ++j) {
+                    dReal sum = 0;
+                    for (unsigned int k = 0; k != node->m_dim; ++k) sum += H[(sizeint)k * TREE_BLOCK_SIZE + i] * Jp[(sizeint)k * TREE_BLOCK_SIZE + j];
+                    P[(sizeint)i * TREE_BLOCK_SIZE + j] -= parent->m_sign * sum;
+                }
+            }
+        }
+    }
+
+    dReal *v = memarena->AllocateArray<dReal>(vecSize);
+
+    dSetZero(v, vecSize);
+    SetTreeJointsRHS(v, nodes + nb, nodeJoints, treeJointCount, mindex, pairsRhsLambda);
+
+    if (mOther != 0) {
+        // gather the other rows; the unbounded ones come first as the joints are sorted so
+        int *rowMap = memarena->AllocateArray<int>(m);
+        dxStepperTreeOtherRow *otherRows = memarena->AllocateArray<dxStepperTreeOtherRow>(mOther);
+        unsigned int nubOther = 0;
+        bool otherUnboundedOnly = true;
+
+        for (unsigned int ji = 0, oi = 0; ji != nj; ++ji) {
+            const unsigned int ofsi = mindex[ji];
+            const unsigned int infom = jointinfos[ji].info.m;
+            if (treeJoints[ji]) {
+                for (unsigned int r = 0; r != infom; ++r) rowMap[ofsi + r] = -1;
+                continue;
+            }
+
+            otherUnboundedOnly = otherUnboundedOnly && jointinfos[ji].info.nub == infom;
+            nubOther += otherUnboundedOnly ? infom : 0;
+
+            dxJoint *joint = jointinfos[ji].joint;
+            for (unsigned int r = 0; r != infom; ++oi, ++r) {
+                rowMap[ofsi + r] = (int)oi;
+                dxStepperTreeOtherRow *row = otherRows + oi;
+                for (unsigned int jb = dJCB__MIN; jb != dJCB__MAX; ++jb) {
+                    dxBody *b = joint->node[jb].body;
+                    const bool bodyMoves = b != NULL && b->invMass != 0;
+                    row->m_J[jb] = bodyMoves ? J + ((sizeint)ofsi * 2 + (jb != dJCB__MIN ? infom : 0) + r) * JME__MAX : NULL;
+                    row->m_vecOffset[jb] = bodyMoves ? nodes[b->tag].m_vecOffset : 0;
+                }
+            }
+        }
+
+        const unsigned int nskip = dPAD(mOther);
+        dReal *A = memarena->AllocateOveralignedArray<dReal>((sizeint)mOther * nskip, AMATRIX_ALIGNMENT);
+        dReal *pairsbx = memarena->AllocateArray<dReal>((sizeint)mOther * PBX__MAX);
+        dReal *pairslh = memarena->AllocateArray<dReal>((sizeint)mOther * PLH__MAX);
+        int *findexOther = memarena->AllocateArray<int>(mOther);
+
+        // with v = [0; -rhs(tree)] the solve gives x = -M^-1 * J(tree)' * lambda(tree)
+        // and rhs(other) is reduced by J(other) * M^-1 * J(tree)' * lambda(tree)
+        SolveTree(nodes, order, nodeCount, v);
+
+        for (unsigned int ji = 0; ji != nj; ++ji) {
+            if (!treeJoints[ji]) {
+                const unsigned int ofsi = mindex[ji];
+                const unsigned int infom = jointinfos[ji].info.m;
+                for (unsigned int r = 0; r != infom; ++r) {
+                    const unsigned int oi = (unsigned)rowMap[ofsi + r];
+                    const dReal *rowRhsCfm = pairsRhsLambda + (sizeint)(ofsi + r) * RCE__RHS_CFM_MAX;
+                    dReal *rowbx = pairsbx + (sizeint)oi * PBX__MAX;
+                    rowbx[PBX_B] = rowRhsCfm[RCE_RHS] + MultiplyTreeOtherRow(otherRows + oi, v);
+
+                    const dReal *rowLoHi = pairsLoHi + (sizeint)(ofsi + r) * LHE__LO_HI_MAX;
+                    dReal *rowlh = pairslh + (sizeint)oi * PLH__MAX;
+                    rowlh[PLH_LO] = rowLoHi[LHE_LO];
+                    rowlh[PLH_HI] = rowLoHi[LHE_HI];
+
+                    const int fival = findex[ofsi + r];
+                    dIASSERT(fival == -1 || rowMap[fival] != -1);
+                    findexOther[oi] = fival != -1 ? rowMap[fival] : -1;
+
+                    A[(sizeint)oi * nskip + oi] = rowRhsCfm[RCE_CFM];
+                }
+            }
+        }
+
+        // with v = [J(row)'; 0] the solve gives x = M^-1 * (J(row)' - J(tree)' * lambda)
+        // where lambda = A(tree)^-1 * A(tree, row) and J(other) * x is the reduced matrix column
+        for (unsigned int oi = 0; oi != mOther; ++oi) {
+            dSetZero(v, vecSize);
+            AddScaledTreeOtherRow(v, otherRows + oi, REAL(1.0));
+            SolveTree(nodes, order, nodeCount, v);
+
+            A[(sizeint)oi * nskip + oi] += MultiplyTreeOtherRow(otherRows + oi, v);
+            for (unsigned int oj = oi + 1; oj != mOther; ++oj) {
+                const dReal value = MultiplyTreeOtherRow(otherRows + oj, v);
+                A[(sizeint)oj * nskip + oi] = value;
+                A[(sizeint)oi * nskip + oj] = value;
+            }
+        }
+
+        dxStepIsland_SolveLCP(callContext, mOther, A, pairsbx, nubOther, pairslh, findexOther);
+
+        // with v = [-J(other)' * lambda(other); -rhs(tree)] the solve gives lambda(tree)
+        dSetZero(v, vecSize);
+        SetTreeJointsRHS(v, nodes + nb, nodeJoints, treeJointCount, mindex, pairsRhsLambda);
+        for (unsigned int oi = 0; oi != mOther; ++oi) {
+            AddScaledTreeOtherRow(v, otherRows + oi, -(pairsbx + (sizeint)oi * PBX__MAX)[PBX_X]);
+        }
+        SolveTree(nodes, order, nodeCount, v);
+
+        for (unsigned int ji = 0; ji != nj; ++ji) {
+            if (!treeJoints[ji]) {
+                const unsigned int ofsi = mindex[ji];
+                const unsigned int infom = jointinfos[ji].info.m;
+                for (unsigned int r = 0; r != infom; ++r) {
+                    const unsigned int oi = (unsigned)rowMap[ofsi + r];
+                    (pairsRhsLambda + (sizeint)(ofsi + r) * RLE__RHS_LAMBDA_MAX)[RLE_LAMBDA] = (pairsbx + (sizeint)oi * PBX__MAX)[PBX_X];
+                }
+            }
+        }
+    }
+    else {
+        SolveTree(nodes, order, nodeCount, v);
+    }
+
+    // the CFMs have been consumed and the lambdas can overwrite them
+    for (unsigned int ni = nb; ni != nodeCount; ++ni) {
+        dReal *rowRhsLambda = pairsRhsLambda + (sizeint)mindex[nodeJoints[ni - nb]] * RLE__RHS_LAMBDA_MAX;
+        const dReal *vnode = v + nodes[ni].m_vecOffset;
+        for (unsigned int r = 0; r != nodes[ni].m_dim; ++r) (rowRhsLambda + (sizeint)r * RLE__RHS_LAMBDA_MAX)[RLE_LAMBDA] = vnode[r];
+    }
+}
+
+
 //****************************************************************************
 
 /*extern */
@@ -575,6 +1166,8 @@ int dxStepIsland_Stage0_Bodies_Callback(void *_callContext, dcallindex_t callIns
 static 
 void dxStepIsland_Stage0_Bodies(dxStepperStage0BodiesCallContext *callContext)
 {
+    dxStepProfileScope profileScope(callContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep0);
+
     dxBody * const *body = callContext->m_stepperCallContext->m_islandBodiesStart;
     unsigned int nb = callContext->m_stepperCallContext->m_islandBodiesCount;
 
@@ -724,6 +1317,8 @@ void dxStepIsland_Stage0_Bodies(dxStepperStage0BodiesCallContext *callContext)
 static 
 void dxStepIsland_Stage0_Joints(dxStepperStage0JointsCallContext *callContext)
 {
+    dxStepProfileScope profileScope(callContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep0);
+
     dxJoint * const *_joint = callContext->m_stepperCallContext->m_islandJointsStart;
     dJointWithInfo1 *jointinfos = callContext->m_jointinfos;
     unsigned int _nj = callContext->m_stepperCallContext->m_islandJointsCount;
@@ -891,6 +1486,8 @@ int dxStepIsland_Stage1_Callback(void *_stage1CallContext, dcallindex_t callInst
 static 
 void dxStepIsland_Stage1(dxStepperStage1CallContext *stage1CallContext)
 {
+    dxStepProfileScope profileScope(stage1CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep1);
+
     const dxStepperProcessingCallContext *callContext = stage1CallContext->m_stepperCallContext;
     dJointWithInfo1 *_jointinfos = stage1CallContext->m_jointinfos;
     dReal *invI = stage1CallContext->m_invI;
@@ -918,6 +1515,7 @@ void dxStepIsland_Stage1(dxStepperStage1CallContext *stage1CallContext)
     dReal *J = NULL, *A = NULL, *pairsRhsCfm = NULL, *pairsLoHi = NULL;
     int *findex = NULL;
     atomicord32 *bodyStartJoints = NULL, *bodyJointLinks = NULL;
+    const bool *treeJoints = NULL;
 
     // if there are constraints, compute constrForce
     if (m > 0) {
@@ -940,26 +1538,30 @@ void dxStepIsland_Stage1(dxStepperStage1CallContext *stage1CallContext)
         // create a constraint equation right hand side vector `c', a constraint
         // force mixing vector `cfm', and LCP low and high bound vectors, and an
         // 'findex' vector.
+        const unsigned int nb = callContext->m_islandBodiesCount;
+        treeJoints = dxStepIsland_SelectTreeJoints(memarena, nb, jointinfos, nj, m);
+
         findex = memarena->AllocateArray<int>(m);
         J = memarena->AllocateArray<dReal>((sizeint)m * (2 * JME__MAX));
-        A = memarena->AllocateOveralignedArray<dReal>((sizeint)m * dPAD(m), AMATRIX_ALIGNMENT);
+        if (treeJoints == NULL) {
+            A = memarena->AllocateOveralignedArray<dReal>((sizeint)m * dPAD(m), AMATRIX_ALIGNMENT);
+        }
         pairsRhsCfm = memarena->AllocateArray<dReal>((sizeint)m * RCE__RHS_CFM_MAX);
         pairsLoHi = memarena->AllocateArray<dReal>((sizeint)m * LHE__LO_HI_MAX);
-        const unsigned int nb = callContext->m_islandBodiesCount;
         bodyStartJoints = memarena->AllocateArray<atomicord32>(nb);
         bodyJointLinks = memarena->AllocateArray<atomicord32>((sizeint)nj * dJCB__MAX);
         dICHECK(nj < ~((atomicord32)0) / dJCB__MAX); // If larger joint counts are to be used, pointers (or sizeint) need to be stored rather than atomicord32 indices
     }
 
     dxStepperLocalContext *localContext = (dxStepperLocalContext *)memarena->AllocateBlock(sizeof(dxStepperLocalContext));
-    localContext->Initialize(invI, jointinfos, nj, m, nub, mindex, findex, J, A, pairsRhsCfm, pairsLoHi, bodyStartJoints, bodyJointLinks);
+    localContext->Initialize(invI, jointinfos, nj, m, nub, mindex, findex, J, A, pairsRhsCfm, pairsLoHi, bodyStartJoints, bodyJointLinks, treeJoints);
 
     void *stage1MemarenaState = memarena->SaveState();
     dxStepperStage3CallContext *stage3CallContext = (dxStepperStage3CallContext*)memarena->AllocateBlock(sizeof(dxStepperStage3CallContext));
     stage3CallContext->Initialize(callContext, localContext, stage1MemarenaState);
 
     if (m > 0) {
-        dReal *JinvM = memarena->AllocateOveralignedArray<dReal>((sizeint)m * (2 * JIM__MAX), JINVM_ALIGNMENT);
+        dReal *JinvM = A != NULL ? memarena->AllocateOveralignedArray<dReal>((sizeint)m * (2 * JIM__MAX), JINVM_ALIGNMENT) : NULL;
         const unsigned int nb = callContext->m_islandBodiesCount;
         dReal *rhs_tmp = memarena->AllocateArray<dReal>((sizeint)nb * dDA__MAX);
 
@@ -1018,6 +1620,8 @@ int dxStepIsland_Stage2a_Callback(void *_stage2CallContext, dcallindex_t callIns
 static 
 void dxStepIsland_Stage2a(dxStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep2);
+
     const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     const dxStepperLocalContext *localContext = stage2CallContext->m_localContext;
     dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
@@ -1137,13 +1741,15 @@ int dxStepIsland_Stage2b_Callback(void *_stage2CallContext, dcallindex_t callIns
 static 
 void dxStepIsland_Stage2b(dxStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep2);
+
     const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     const dxStepperLocalContext *localContext = stage2CallContext->m_localContext;
     dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
     unsigned int nj = localContext->m_nj;
     const unsigned int *mindex = localContext->m_mindex;
 
-    {
+    if (localContext->m_A != NULL) { // A is not needed by the tree-structured solver
         // Warning!!!
         // This code depends on cfm elements and therefore must be in different sub-stage 
         // from Jacobian construction in Stage2a to ensure proper synchronization 
@@ -1170,7 +1776,7 @@ void dxStepIsland_Stage2b(dxStepperStage2CallContext *stage2CallContext)
         }
     }
 
-    {
+    if (localContext->m_A != NULL) { // nor is JinvM
         // Warning!!!
         // This code depends on J elements and therefore must be in different sub-stage 
         // from Jacobian construction in Stage2a to ensure proper synchronization 
@@ -1284,13 +1890,15 @@ int dxStepIsland_Stage2c_Callback(void *_stage2CallContext, dcallindex_t callIns
 static 
 void dxStepIsland_Stage2c(dxStepperStage2CallContext *stage2CallContext)
 {
+    dxStepProfileScope profileScope(stage2CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep2);
+
     //const dxStepperProcessingCallContext *callContext = stage2CallContext->m_stepperCallContext;
     const dxStepperLocalContext *localContext = stage2CallContext->m_localContext;
     dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
     unsigned int nj = localContext->m_nj;
     const unsigned int *mindex = localContext->m_mindex;
 
-    {
+    if (localContext->m_A != NULL) {
         // Warning!!!
         // This code depends on A elements and JinvM elements and therefore 
         // must be in a different sub-stage from A initialization and JinvM calculation in Stage2b 
@@ -1434,6 +2042,8 @@ int dxStepIsland_Stage3_Callback(void *_stage3CallContext, dcallindex_t callInst
 static 
 void dxStepIsland_Stage3(dxStepperStage3CallContext *stage3CallContext)
 {
+    dxStepProfileScope profileScope(stage3CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep3);
+
     const dxStepperProcessingCallContext *callContext = stage3CallContext->m_stepperCallContext;
     const dxStepperLocalContext *localContext = stage3CallContext->m_localContext;
 
@@ -1456,7 +2066,12 @@ void dxStepIsland_Stage3(dxStepperStage3CallContext *stage3CallContext)
 
             // solve the LCP problem and get lambda.
             // this will destroy A but that's OK
-            dxSolveLCP (memarena, m, A, pairsRhsLambda, NULL, nub, pairsLoHi, findex);
+            if (localContext->m_treeJoints != NULL) {
+                dxStepIsland_SolveTreeLCP(callContext, localContext);
+            }
+            else {
+                dxStepIsland_SolveLCP(callContext, m, A, pairsRhsLambda, nub, pairsLoHi, findex);
+            }
             dSASSERT((int)RLE__RHS_LAMBDA_MAX == PBX__MAX && (int)RLE_RHS == PBX_B && (int)RLE_LAMBDA == PBX_X);
             dSASSERT((int)LHE__LO_HI_MAX == PLH__MAX && (int)LHE_LO == PLH_LO && (int)LHE_HI == PLH_HI);
 
@@ -1503,6 +2118,8 @@ int dxStepIsland_Stage4_Callback(void *_stage4CallContext, dcallindex_t callInst
 static 
 void dxStepIsland_Stage4(dxStepperStage4CallContext *stage4CallContext)
 {
+    dxStepProfileScope profileScope(stage4CallContext->m_stepperCallContext->m_world->step_profile, dStepProfileStageStep4);
+
     const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
     const dxStepperLocalContext *localContext = stage4CallContext->m_localContext;
 
@@ -1624,6 +2241,8 @@ sizeint dxEstimateStepMemoryRequirements (dxBody * const *body, unsigned int nb,
             sub1_res2 += dEFFICIENT_SIZE(sizeof(unsigned int) * (nj + 1)); // for mindex
             sub1_res2 += dEFFICIENT_SIZE(sizeof(int) * m); // for findex
             sub1_res2 += dEFFICIENT_SIZE(sizeof(dReal) * 2 * JME__MAX * m); // for J
+            sub1_res2 += dEFFICIENT_SIZE(sizeof(bool) * nj); // for treeJoints
+            sub1_res2 += dEFFICIENT_SIZE(sizeof(unsigned int) * nb); // for the body sets in dxStepIsland_SelectTreeJoints
             unsigned int mskip = dPAD(m);
             sub1_res2 += dOVERALIGNED_SIZE(sizeof(dReal) * mskip * m, AMATRIX_ALIGNMENT); // for A
             sub1_res2 += dEFFICIENT_SIZE(sizeof(dReal) * RCE__RHS_CFM_MAX * m); // for pairsRhsCfm
@@ -1644,7 +2263,7 @@ sizeint dxEstimateStepMemoryRequirements (dxBody * const *body, unsigned int nb,
                 sub2_res1 += dEFFICIENT_SIZE(sizeof(dReal) * dDA__MAX * nb); // for rhs_tmp
                 sub2_res1 += dEFFICIENT_SIZE(sizeof(dxStepperStage2CallContext)); // for dxStepperStage2CallContext
 
-                sub2_res2 += dxEstimateSolveLCPMemoryReq(m, false);
+                sub2_res2 += dMAX(dxEstimateSolveLCPMemoryReq(m, false), EstimateTreeSolverMemoryRequirements(nb, nj, m));
             }
 
             sub1_res2 += dMAX(sub2_res1, dMAX(sub2_res2, sub2_res3));
@@ -1667,6 +2286,7 @@ unsigned dxEstimateStepMaxCallCount(
 {
     unsigned result = 1 // dxStepIsland itself
         + (2 * allowedThreadCount + 2) // (dxStepIsland_Stage2a + dxStepIsland_Stage2b) * allowedThreadCount + 2 * dxStepIsland_Stage2?_Sync
-        + 1; // dxStepIsland_Stage3
+        + 1 // dxStepIsland_Stage3
+        + (2 * allowedThreadCount + 2); // cooperative LCP factoring/solving in dxStepIsland_Stage3
     return result;
 }
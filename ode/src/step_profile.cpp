@@ -0,0 +1,356 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+// Runtime step profiler.
+
+#include <ode/common.h>
+#include "config.h"
+#include "common.h"
+#include "step_profile.h"
+#include "threadingutils.h"
+
+#if defined(_WIN32)
+#include "windows.h"
+#elif defined(__APPLE__) && defined(__MACH__)
+#include <mach/mach_time.h>
+#include <pthread.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+
+//****************************************************************************
+// clock and thread identification (shared with the threading tracer)
+
+#if defined(_WIN32)
+
+duint64 dxQueryProfileTimeNanoseconds()
+{
+    static double nanosecondsPerTick = 0.0;
+    if (nanosecondsPerTick == 0.0) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        nanosecondsPerTick = 1e9 / (double)frequency.QuadPart;
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (duint64)((double)counter.QuadPart * nanosecondsPerTick);
+}
+
+atomicptr dxQueryCurrentThreadKey()
+{
+    // Thread identifiers are never zero, and zero marks free records
+    return (atomicptr)(sizeint)GetCurrentThreadId();
+}
+
+#elif defined(__APPLE__) && defined(__MACH__)
+
+duint64 dxQueryProfileTimeNanoseconds()
+{
+    static mach_timebase_info_data_t timebaseInfo = { 0, 0 };
+    if (timebaseInfo.denom == 0) {
+        mach_timebase_info(&timebaseInfo);
+    }
+    return (duint64)((double)mach_absolute_time() * timebaseInfo.numer / timebaseInfo.denom);
+}
+
+atomicptr dxQueryCurrentThreadKey()
+{
+    return (atomicptr)pthread_self();
+}
+
+#else // POSIX
+
+duint64 dxQueryProfileTimeNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (duint64)ts.tv_sec * 1000000000U + (duint64)ts.tv_nsec;
+}
+
+atomicptr dxQueryCurrentThreadKey()
+{
+    return (atomicptr)pthread_self();
+}
+
+#endif
+
+
+//****************************************************************************
+// dxStepProfile
+
+static const int g_stepProfileStageParents[dStepProfileStage__MAX] = 
+{
+    -1,                                 // dStepProfileStageTotal
+    dStepProfileStageTotal,             // dStepProfileStageAutoDisable
+    dStepProfileStageTotal,             // dStepProfileStageIslandBuild
+    dStepProfileStageTotal,             // dStepProfileStageIslandStepping
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep0
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep1
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep2
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep3
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep4
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep5
+    dStepProfileStageIslandStepping,    // dStepProfileStageQuickStep6
+    dStepProfileStageIslandStepping,    // dStepProfileStageStep0
+    dStepProfileStageIslandStepping,    // dStepProfileStageStep1
+    dStepProfileStageIslandStepping,    // dStepProfileStageStep2
+    dStepProfileStageIslandStepping,    // dStepProfileStageStep3
+    dStepProfileStageIslandStepping,    // dStepProfileStageStep4
+    dStepProfileStageIslandStepping,    // dStepProfileStageBodyIntegration
+};
+
+static const char *const g_stepProfileStageNames[dStepProfileStage__MAX] = 
+{
+    "Total",
+    "AutoDisable",
+    "IslandBuild",
+    "IslandStepping",
+    "QuickStep0",
+    "QuickStep1",
+    "QuickStep2",
+    "QuickStep3",
+    "QuickStep4",
+    "QuickStep5",
+    "QuickStep6",
+    "Step0",
+    "Step1",
+    "Step2",
+    "Step3",
+    "Step4",
+    "BodyIntegration",
+};
+
+
+void dxStepProfileThreadRecord::reset()
+{
+    m_stackDepth = 0;
+    m_currentStageStart = 0;
+
+    for (unsigned stage = 0; stage != dStepProfileStage__MAX; ++stage) {
+        m_callCount[stage] = 0;
+        m_selfTime[stage] = 0;
+        m_firstEntry[stage] = 0;
+        m_lastExit[stage] = 0;
+    }
+}
+
+
+dxStepProfile::dxStepProfile():
+    m_recordsExhausted(0),
+    m_resultsAvailable(false),
+    m_publishedThreadCount(0)
+{
+    for (unsigned threadIndex = 0; threadIndex != dSTEP_PROFILE_MAX_THREADS; ++threadIndex) {
+        m_threadKeys[threadIndex] = NULL;
+        m_threadRecords[threadIndex].reset();
+    }
+}
+
+
+void dxStepProfile::beginStep()
+{
+    // The workers are not running at this point
+    if (m_recordsExhausted != 0) {
+        reclaimIdleThreadRecords();
+    }
+
+    for (unsigned threadIndex = 0; threadIndex != dSTEP_PROFILE_MAX_THREADS; ++threadIndex) {
+        if (m_threadKeys[threadIndex] != NULL) {
+            m_threadRecords[threadIndex].reset();
+        }
+    }
+}
+
+void dxStepProfile::reclaimIdleThreadRecords()
+{
+    // The records still hold the previous step. The threads that worked on it
+    // keep their indices and the others make room for the threads left out.
+    for (unsigned threadIndex = 0; threadIndex != dSTEP_PROFILE_MAX_THREADS; ++threadIndex) {
+        dxStepProfileThreadRecord &record = m_threadRecords[threadIndex];
+
+        unsigned stage = 0;
+        while (stage != dStepProfileStage__MAX && record.m_callCount[stage] == 0) {
+            ++stage;
+        }
+
+        if (stage == dStepProfileStage__MAX) {
+            m_threadKeys[threadIndex] = NULL;
+            record.reset();
+        }
+    }
+
+    m_recordsExhausted = 0;
+}
+
+void dxStepProfile::endStep()
+{
+    // The freed records leave gaps which are published with zero times
+    unsigned threadCount = dSTEP_PROFILE_MAX_THREADS;
+    while (threadCount != 0 && m_threadKeys[threadCount - 1] == NULL) {
+        --threadCount;
+    }
+
+    for (unsigned stage = 0; stage != dStepProfileStage__MAX; ++stage) {
+        unsigned callCount = 0;
+        duint64 selfTime = 0, firstEntry = 0, lastExit = 0;
+
+        for (unsigned threadIndex = 0; threadIndex != threadCount; ++threadIndex) {
+            const dxStepProfileThreadRecord &record = m_threadRecords[threadIndex];
+            const unsigned threadCallCount = record.m_callCount[stage];
+
+            if (threadCallCount != 0) {
+                firstEntry = callCount == 0 || record.m_firstEntry[stage] < firstEntry ? record.m_firstEntry[stage] : firstEntry;
+                lastExit = record.m_lastExit[stage] > lastExit ? record.m_lastExit[stage] : lastExit;
+                callCount += threadCallCount;
+                selfTime += record.m_selfTime[stage];
+            }
+
+            m_publishedThreadTimes[threadIndex][stage] = (double)record.m_selfTime[stage] * 1e-9;
+        }
+
+        dStepProfileStageInfo &info = m_publishedStages[stage];
+        info.parent = g_stepProfileStageParents[stage];
+        info.callCount = callCount;
+        info.wallTime = (double)(lastExit - firstEntry) * 1e-9;
+        info.selfTime = (double)selfTime * 1e-9;
+        info.totalTime = info.selfTime;
+    }
+
+    // The parents always precede their children
+    for (unsigned stage = dStepProfileStage__MAX; --stage != 0; ) {
+        dStepProfileStageInfo &info = m_publishedStages[stage];
+        m_publishedStages[info.parent].totalTime += info.totalTime;
+    }
+
+    m_publishedThreadCount = threadCount;
+    m_resultsAvailable = true;
+}
+
+
+int dxStepProfile::findThreadRecord()
+{
+    const atomicptr threadKey = dxQueryCurrentThreadKey();
+
+    // The records freed by reclaimIdleThreadRecords() leave gaps, so the thread's 
+    // own record is looked for among all of them before a free one is taken
+    for (unsigned threadIndex = 0; threadIndex != dSTEP_PROFILE_MAX_THREADS; ++threadIndex) {
+        if (m_threadKeys[threadIndex] == threadKey) {
+            return threadIndex;
+        }
+    }
+
+    for (unsigned threadIndex = 0; threadIndex != dSTEP_PROFILE_MAX_THREADS; ++threadIndex) {
+        if (m_threadKeys[threadIndex] == NULL 
+            && ThrsafeCompareExchangePointer(&m_threadKeys[threadIndex], NULL, threadKey)) {
+            m_threadRecords[threadIndex].reset();
+            return threadIndex;
+        }
+    }
+
+    ThrsafeExchange(&m_recordsExhausted, 1);
+    return -1;
+}
+
+int dxStepProfile::enterStage(int stage)
+{
+    dIASSERT(dIN_RANGE(stage, 0, dStepProfileStage__MAX));
+
+    int recordIndex = findThreadRecord();
+
+    if (recordIndex != -1) {
+        dxStepProfileThreadRecord &record = m_threadRecords[recordIndex];
+        const unsigned stackDepth = record.m_stackDepth;
+        const int currentStage = stackDepth != 0 ? record.m_stack[(stackDepth < dxSTEP_PROFILE_STACK_DEPTH ? stackDepth : dxSTEP_PROFILE_STACK_DEPTH) - 1] : -1;
+
+        // A helper entered from within its own stage is a part of that stage call
+        if (currentStage == stage) {
+            return -1;
+        }
+
+        const duint64 currentTime = dxQueryProfileTimeNanoseconds();
+
+        if (currentStage != -1) {
+            record.m_selfTime[currentStage] += currentTime - record.m_currentStageStart;
+        }
+
+        if (stackDepth < dxSTEP_PROFILE_STACK_DEPTH) {
+            record.m_stack[stackDepth] = stage;
+        }
+        record.m_stackDepth = stackDepth + 1;
+        record.m_currentStageStart = currentTime;
+
+        if (record.m_callCount[stage]++ == 0) {
+            record.m_firstEntry[stage] = currentTime;
+        }
+    }
+
+    return recordIndex;
+}
+
+void dxStepProfile::leaveStage(int recordIndex)
+{
+    dxStepProfileThreadRecord &record = m_threadRecords[recordIndex];
+    const duint64 currentTime = dxQueryProfileTimeNanoseconds();
+
+    const unsigned stackDepth = record.m_stackDepth;
+    dIASSERT(stackDepth != 0);
+
+    // The stages beyond the stack depth are charged to the deepest one the stack holds
+    const int stage = record.m_stack[(stackDepth < dxSTEP_PROFILE_STACK_DEPTH ? stackDepth : dxSTEP_PROFILE_STACK_DEPTH) - 1];
+    record.m_selfTime[stage] += currentTime - record.m_currentStageStart;
+    record.m_lastExit[stage] = currentTime;
+
+    record.m_stackDepth = stackDepth - 1;
+    record.m_currentStageStart = currentTime;
+}
+
+
+bool dxStepProfile::getStageInfo(int stage, dStepProfileStageInfo *info) const
+{
+    dIASSERT(dIN_RANGE(stage, 0, dStepProfileStage__MAX));
+
+    bool result = false;
+
+    if (m_resultsAvailable) {
+        *info = m_publishedStages[stage];
+        result = true;
+    }
+
+    return result;
+}
+
+double dxStepProfile::getThreadTime(unsigned threadIndex, int stage) const
+{
+    dIASSERT(dIN_RANGE(stage, 0, dStepProfileStage__MAX));
+
+    return m_resultsAvailable && threadIndex < m_publishedThreadCount ? m_publishedThreadTimes[threadIndex][stage] : 0.0;
+}
+
+
+/*static */
+const char *dxStepProfile::getStageName(int stage)
+{
+    return dIN_RANGE(stage, 0, dStepProfileStage__MAX) ? g_stepProfileStageNames[stage] : "";
+}
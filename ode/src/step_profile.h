@@ -0,0 +1,126 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+ * Runtime step profiler (see dWorldSetStepProfiling()).
+ *
+ * Every thread working on a step gets its own record, found by the thread's
+ * system identifier, so the stage timings are accumulated without any
+ * synchronization. A record keeps the stack of the stages the thread is in
+ * and charges the time to the innermost one only. The records are merged
+ * into the published results by the stepping thread after the step, when
+ * the workers are done with it. When a thread finds all the records taken,
+ * the records of the threads that were idle during that step are freed
+ * before the next one.
+ */
+
+#ifndef _ODE_STEP_PROFILE_H_
+#define _ODE_STEP_PROFILE_H_
+
+#include <ode/common.h>
+#include <ode/objects.h>
+#include "objects.h"
+#include "odeou.h"
+
+
+#define dxSTEP_PROFILE_STACK_DEPTH 16
+
+
+// A monotonic clock in nanoseconds and a nonzero identifier of the calling thread
+duint64 dxQueryProfileTimeNanoseconds();
+atomicptr dxQueryCurrentThreadKey();
+
+
+struct dxStepProfileThreadRecord
+{
+    void reset();
+
+    unsigned        m_stackDepth;
+    int             m_stack[dxSTEP_PROFILE_STACK_DEPTH];
+    duint64         m_currentStageStart;
+    unsigned        m_callCount[dStepProfileStage__MAX];
+    duint64         m_selfTime[dStepProfileStage__MAX];
+    duint64         m_firstEntry[dStepProfileStage__MAX];
+    duint64         m_lastExit[dStepProfileStage__MAX];
+};
+
+
+class dxStepProfile:
+    public dBase
+{
+public:
+    dxStepProfile();
+
+    void beginStep();
+    void endStep();
+
+    // Returns the record index to be passed to leaveStage() or -1 if the thread could not get a record
+    int enterStage(int stage);
+    void leaveStage(int recordIndex);
+
+    bool getStageInfo(int stage, dStepProfileStageInfo *info) const;
+    unsigned getThreadCount() const { return m_publishedThreadCount; }
+    double getThreadTime(unsigned threadIndex, int stage) const;
+
+    static const char *getStageName(int stage);
+
+private:
+    int findThreadRecord();
+    void reclaimIdleThreadRecords();
+
+private:
+    volatile atomicptr          m_threadKeys[dSTEP_PROFILE_MAX_THREADS];
+    dxStepProfileThreadRecord   m_threadRecords[dSTEP_PROFILE_MAX_THREADS];
+    volatile atomicord32        m_recordsExhausted;
+
+    bool                        m_resultsAvailable;
+    unsigned                    m_publishedThreadCount;
+    dStepProfileStageInfo       m_publishedStages[dStepProfileStage__MAX];
+    double                      m_publishedThreadTimes[dSTEP_PROFILE_MAX_THREADS][dStepProfileStage__MAX];
+};
+
+
+// Times a stage for the lifetime of the object if the world has the profiler enabled.
+class dxStepProfileScope
+{
+public:
+    dxStepProfileScope(dxStepProfile *profile, int stage):
+        m_profile(profile),
+        m_recordIndex(profile != NULL ? profile->enterStage(stage) : -1)
+    {
+    }
+
+    ~dxStepProfileScope()
+    {
+        if (m_recordIndex != -1) {
+            m_profile->leaveStage(m_recordIndex);
+        }
+    }
+
+private:
+    dxStepProfile   *m_profile;
+    int             m_recordIndex;
+};
+
+
+#endif
@@ -40,6 +40,10 @@
 #include <ode/odeconfig.h>
 #include <ode/error.h>
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
 
 /************************************************************************/
 /* Fake atomics provider class implementation                           */
@@ -67,9 +71,31 @@ public:
         return *value_storage_ptr;
     }
 
+    static void RelaxWhileSpinning()
+    {
+        // Do nothing
+    }
+
     template<unsigned type_size>
     static sizeint AddValueToTarget(volatile void *value_accumulator_ptr, diffint value_addend);
 
+    static bool CompareExchangeTargetValue(volatile atomicord_t *value_storage_ptr, 
+        atomicord_t comparand_value, atomicord_t new_value)
+    {
+        bool exchange_result = false;
+
+        atomicord_t original_value = *value_storage_ptr;
+
+        if (original_value == comparand_value)
+        {
+            *value_storage_ptr = new_value;
+
+            exchange_result = true;
+        }
+
+        return exchange_result;
+    }
+
     static bool CompareExchangeTargetPtr(volatile atomicptr_t *pointer_storage_ptr, 
         atomicptr_t comparand_value, atomicptr_t new_value)
     {
@@ -152,9 +178,32 @@ public:
         return result_value;
     }
 
+    // Hints the CPU that a spin-wait loop is running so that it does not flood 
+    // the memory bus with the speculative reads and lets the sibling hyper-thread run
+    static void RelaxWhileSpinning()
+    {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _mm_pause();
+#elif defined(_MSC_VER) && (defined(_M_ARM) || defined(_M_ARM64))
+        __yield();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+        __asm__ __volatile__("yield" ::: "memory");
+#else
+        // Do nothing
+#endif
+    }
+
     template<unsigned type_size>
     static sizeint AddValueToTarget(volatile void *value_accumulator_ptr, diffint value_addend);
 
+    static bool CompareExchangeTargetValue(volatile atomicord_t *value_storage_ptr, 
+        atomicord_t comparand_value, atomicord_t new_value)
+    {
+        return _OU_NAMESPACE::AtomicCompareExchange(value_storage_ptr, comparand_value, new_value);
+    }
+
     static bool CompareExchangeTargetPtr(volatile atomicptr_t *pointer_storage_ptr, 
         atomicptr_t comparand_value, atomicptr_t new_value)
     {
@@ -63,6 +63,8 @@ public:
 
     bool WaitWakeup(const dThreadedWaitTime *timeout_time_ptr);
 
+    static void YieldTimeSlice() { /* Do nothing */ }
+
 private:
     bool          m_wakeup_state;
     bool          m_state_is_permanent;
@@ -121,6 +121,24 @@ static const dxThreadingFunctionsInfo g_builtin_threading_functions =
     return (dThreadingImplementationID)impl;
 }
 
+/*extern */dThreadingImplementationID dThreadingAllocateWorkStealingMultiThreadedImplementation()
+{
+#if dBUILTIN_THREADING_IMPL_ENABLED
+    dxWorkStealingThreading *threading = new dxWorkStealingThreading();
+
+    if (threading != NULL && !threading->InitializeObject())
+    {
+        delete threading;
+        threading = NULL;
+    }
+#else
+    dxIThreadingImplementation *threading = NULL;
+#endif // #if dBUILTIN_THREADING_IMPL_ENABLED
+
+    dxIThreadingImplementation *impl = threading;
+    return (dThreadingImplementationID)impl;
+}
+
 /*extern */const dThreadingFunctionsInfo *dThreadingImplementationGetFunctions(dThreadingImplementationID impl)
 {
 #if dBUILTIN_THREADING_IMPL_ENABLED
@@ -176,6 +194,24 @@ static const dxThreadingFunctionsInfo g_builtin_threading_functions =
 }
 
 
+/*extern */int dThreadingImplementationSetTracing(dThreadingImplementationID impl, unsigned max_event_count)
+{
+    dAASSERT(impl != NULL);
+
+    bool result = ((dxIThreadingImplementation *)impl)->AssignTracing(max_event_count);
+    return result;
+}
+
+/*extern */int dThreadingImplementationWriteTrace(dThreadingImplementationID impl, FILE *file)
+{
+    dAASSERT(impl != NULL);
+    dAASSERT(file != NULL);
+
+    int result = ((dxIThreadingImplementation *)impl)->WriteTrace(file);
+    return result;
+}
+
+
 /*extern */void dExternalThreadingServeMultiThreadedImplementation(dThreadingImplementationID impl, 
                                                                    dThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/)
 {
@@ -247,9 +283,8 @@ static void PostThreadedCall(
     dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index, 
     const char *call_name/*=NULL*/)
 {
-    (void)call_name; // unused
     ((dxIThreadingImplementation *)impl)->ScheduleNewJob(out_summary_fault, out_post_releasee, 
-        dependencies_count, dependent_releasee, (dxICallWait *)call_wait, call_func, call_context, instance_index);
+        dependencies_count, dependent_releasee, (dxICallWait *)call_wait, call_func, call_context, instance_index, call_name);
 }
 
 static void AlterThreadedCallDependenciesCount(
@@ -264,8 +299,7 @@ static void WaitThreadedCall(
     dCallWaitID call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/, 
     const char *wait_name/*=NULL*/)
 {
-    (void)wait_name; // unused
-    ((dxIThreadingImplementation *)impl)->WaitJobCompletion(out_wait_status, (dxICallWait *)call_wait, timeout_time_ptr);
+    ((dxIThreadingImplementation *)impl)->WaitJobCompletion(out_wait_status, (dxICallWait *)call_wait, timeout_time_ptr, wait_name);
 }
 
 
@@ -47,6 +47,7 @@
 #if dBUILTIN_THREADING_IMPL_ENABLED
 
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
 #include <errno.h>
 
@@ -137,6 +138,8 @@ public:
 
     bool WaitWakeup(const dThreadedWaitTime *timeout_time_ptr);
 
+    static void YieldTimeSlice() { sched_yield(); }
+
 private:
     bool BlockAsAWaiter(const dThreadedWaitTime *timeout_time_ptr);
 
@@ -629,6 +632,15 @@ typedef dxtemplateJobListThreadedHandler<dxCondvarWakeup, dxMultiThreadedJobList
 typedef dxtemplateThreadingImplementation<dxMultiThreadedJobListContainer, dxMultiThreadedJobListHandler> dxMultiThreadedThreading;
 
 
+/************************************************************************/
+/* Work-stealing multi-threaded job container definition                */
+/************************************************************************/
+
+typedef dxtemplateJobStealingContainer<dxtemplateThreadedLull<dxCondvarWakeup, dxOUAtomicsProvider, false>, dxMutexMutex, dxOUAtomicsProvider> dxWorkStealingJobListContainer;
+typedef dxtemplateJobStealingThreadedHandler<dxCondvarWakeup, dxWorkStealingJobListContainer> dxWorkStealingJobListHandler;
+typedef dxtemplateThreadingImplementation<dxWorkStealingJobListContainer, dxWorkStealingJobListHandler> dxWorkStealingThreading;
+
+
 #endif // #if dBUILTIN_THREADING_IMPL_ENABLED
 
 
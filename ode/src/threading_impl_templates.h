@@ -40,6 +40,7 @@
 #include <ode/threading.h>
 
 #include "objects.h"
+#include "threading_trace.h"
 
 #include <new>
 
@@ -169,9 +170,34 @@ struct dxThreadedJobInfo:
         m_call_index = call_index;
     }
 
+    void AssignTraceData(dxThreadingTracer *tracer, const char *call_name, duint64 post_time)
+    {
+        m_tracer = tracer;
+        m_call_name = call_name;
+        m_post_time = post_time;
+    }
+
     bool InvokeCallFunction()
     {
+        dxThreadingTracer *tracer = m_tracer;
+        if (tracer != NULL)
+        {
+            return InvokeCallFunctionTraced(tracer);
+        }
+
+        int call_result = m_call_function(m_call_context, m_call_index, dMAKE_JOBINSTANCE_RELEASEE(this));
+        return call_result != 0;
+    }
+
+    bool InvokeCallFunctionTraced(dxThreadingTracer *tracer)
+    {
+        const char *call_name = m_call_name;
+        duint64 post_time = m_post_time;
+        duint64 begin_time = dxThreadingTracer::QueryCurrentTime();
+
         int call_result = m_call_function(m_call_context, m_call_index, dMAKE_JOBINSTANCE_RELEASEE(this));
+
+        tracer->RecordEvent(dxTTE_CALL, call_name, post_time, begin_time, dxThreadingTracer::QueryCurrentTime());
         return call_result != 0;
     }
 
@@ -187,6 +213,10 @@ struct dxThreadedJobInfo:
     dThreadedCallFunction   *m_call_function;
     void                    *m_call_context;
     dcallindex_t            m_call_index;
+
+    dxThreadingTracer       *m_tracer;
+    const char              *m_call_name;
+    duint64                 m_post_time;
 };
 
 
@@ -205,17 +235,69 @@ private:
     bool                    m_lock_indicator_flag;
 };
 
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+class dxtemplateJobInfoPool
+{
+public:
+    dxtemplateJobInfoPool():
+        m_info_pool((atomicptr_t)NULL),
+        m_pool_access_lock(),
+        m_info_wait_lull(),
+        m_info_count_known_to_be_preallocated(0),
+        m_tracer(NULL)
+    {
+    }
+
+    ~dxtemplateJobInfoPool()
+    {
+        FreeJobInfoPoolInfos();
+        DoFinalizeObject();
+    }
+
+    bool InitializeObject() { return DoInitializeObject(); }
+
+private:
+    bool DoInitializeObject() { return m_pool_access_lock.InitializeObject() && m_info_wait_lull.InitializeObject(); }
+    void DoFinalizeObject() { /* Do nothing */ }
+
+private:
+    typedef typename tAtomicsProvider::atomicptr_t atomicptr_t;
+    typedef dxtemplateThreadingLockHelper<tThreadMutex> dxMutexLockHelper;
+
+public:
+    dxThreadedJobInfo *ExtractJobInfoFromPoolOrAllocate();
+    inline void ReleaseJobInfoIntoPool(dxThreadedJobInfo *job_instance);
+
+private:
+    void FreeJobInfoPoolInfos();
+
+public:
+    bool EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count);
+
+private:
+    bool DoPreallocateJobInfos(ddependencycount_t required_info_count);
+
+public:
+    // The tracer is shared by the objects of an implementation and is kept here for both the container types
+    void AssignTracer(dxThreadingTracer *tracer) { m_tracer = tracer; }
+    dxThreadingTracer *GetTracer() const { return m_tracer; }
+
+private:
+    volatile atomicptr_t    m_info_pool; // dxThreadedJobInfo *
+    tThreadMutex            m_pool_access_lock;
+    tThreadLull             m_info_wait_lull;
+    ddependencycount_t      m_info_count_known_to_be_preallocated;
+    dxThreadingTracer       *m_tracer;
+};
+
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
 class dxtemplateJobListContainer
 {
 public:
     dxtemplateJobListContainer():
         m_job_list(NULL),
-        m_info_pool((atomicptr_t)NULL),
-        m_pool_access_lock(),
         m_list_access_lock(),
-        m_info_wait_lull(),
-        m_info_count_known_to_be_preallocated(0)
+        m_job_info_pool()
     {
     }
 
@@ -223,14 +305,13 @@ public:
     {
         dIASSERT(m_job_list == NULL); // Would not it be nice to wait for jobs to complete before deleting the list?
 
-        FreeJobInfoPoolInfos();
         DoFinalizeObject();
     }
 
     bool InitializeObject() { return DoInitializeObject(); }
 
 private:
-    bool DoInitializeObject() { return m_pool_access_lock.InitializeObject() && m_list_access_lock.InitializeObject() && m_info_wait_lull.InitializeObject(); }
+    bool DoInitializeObject() { return m_list_access_lock.InitializeObject() && m_job_info_pool.InitializeObject(); }
     void DoFinalizeObject() { /* Do nothing */ }
 
 public:
@@ -239,6 +320,7 @@ public:
     typedef typename tAtomicsProvider::atomicptr_t atomicptr_t;
     typedef tThreadMutex dxThreadMutex;
     typedef dxtemplateThreadingLockHelper<tThreadMutex> dxMutexLockHelper;
+    typedef dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider> dxJobInfoPool;
     typedef void dWaitSignallingFunction(void *job_call_wait);
 
 public:
@@ -263,31 +345,194 @@ private:
     inline void InsertJobInfoIntoListHead(dxThreadedJobInfo *job_instance);
     inline void RemoveJobInfoFromList(dxThreadedJobInfo *job_instance);
 
-    dxThreadedJobInfo *ExtractJobInfoFromPoolOrAllocate();
-    inline void ReleaseJobInfoIntoPool(dxThreadedJobInfo *job_instance);
+public:
+    bool EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count) { return m_job_info_pool.EnsureNumberOfJobInfosIsPreallocated(required_info_count); }
+
+    void AssignTracer(dxThreadingTracer *tracer) { m_job_info_pool.AssignTracer(tracer); }
+    dxThreadingTracer *GetTracer() const { return m_job_info_pool.GetTracer(); }
+
+public:
+    bool IsJobListReadyForShutdown() const { return m_job_list == NULL; }
 
 private:
-    void FreeJobInfoPoolInfos();
+    dxThreadedJobInfo       *m_job_list;
+    tThreadMutex            m_list_access_lock;
+    dxJobInfoPool           m_job_info_pool;
+};
+
+
+
+
+#if dBUILTIN_THREADING_IMPL_ENABLED
+
+#if defined(_MSC_VER)
+#define dTHREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define dTHREAD_LOCAL __thread
+#endif
 
+
+// A Chase-Lev deque of ready jobs. The serving thread owning the deque pushes 
+// and pops jobs at the bottom end while the other threads steal them from the top.
+template<class tAtomicsProvider>
+class dxtemplateJobStealingDeque:
+    public dBase
+{
 public:
-    bool EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count);
+    dxtemplateJobStealingDeque(const void *owner_container, unsigned deque_index):
+        m_owner_container(owner_container),
+        m_deque_index(deque_index),
+        m_serving_thread_marker((atomicptr_t)NULL),
+        m_bottom(0),
+        m_top(0)
+    {
+    }
+
+public:
+    enum
+    {
+        CAPACITY = 256, // Must be a power of two
+    };
 
 private:
-    bool DoPreallocateJobInfos(ddependencycount_t required_info_count);
+    typedef typename tAtomicsProvider::atomicord_t atomicord_t;
+    typedef typename tAtomicsProvider::atomicptr_t atomicptr_t;
 
 public:
-    bool IsJobListReadyForShutdown() const { return m_job_list == NULL; }
+    const void *GetOwnerContainer() const { return m_owner_container; }
+    unsigned GetDequeIndex() const { return m_deque_index; }
+
+    bool TryAssigningToThread() { return tAtomicsProvider::CompareExchangeTargetPtr(&m_serving_thread_marker, (atomicptr_t)NULL, (atomicptr_t)this); }
+    void UnassignFromThread() { dIASSERT(IsDequeEmpty()); m_serving_thread_marker = (atomicptr_t)NULL; }
+
+    bool IsDequeEmpty() const { return (int)(m_bottom - m_top) <= 0; }
+
+    inline bool PushJob(dxThreadedJobInfo *job_instance);
+    inline dxThreadedJobInfo *PopJob();
+    inline dxThreadedJobInfo *StealJob();
 
 private:
-    dxThreadedJobInfo       *m_job_list;
-    volatile atomicptr_t    m_info_pool; // dxThreadedJobInfo *
-    tThreadMutex            m_pool_access_lock;
-    tThreadMutex            m_list_access_lock;
-    tThreadLull             m_info_wait_lull;
-    ddependencycount_t      m_info_count_known_to_be_preallocated;
+    const void              *const m_owner_container;
+    unsigned                const m_deque_index;
+    volatile atomicptr_t    m_serving_thread_marker;
+    volatile atomicord_t    m_bottom;
+    char                    m_ends_separator[64]; // Keep the top away from the bottom's cache line
+    volatile atomicord_t    m_top;
+    dxThreadedJobInfo       *volatile m_jobs[CAPACITY];
+};
+
+
+// A lock-free alternative to dxtemplateJobListContainer.
+// The jobs are not kept in any list until they become ready. Then each 
+// serving thread puts them into its own deque and takes them from there 
+// or steals from the other threads' deques when its own one is empty.
+// Jobs that become ready in other threads are put into a shared stack.
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+class dxtemplateJobStealingContainer
+{
+public:
+    dxtemplateJobStealingContainer():
+        m_injected_jobs((atomicptr_t)NULL),
+        m_deque_count(0),
+        m_job_info_pool()
+    {
+        for (unsigned deque_index = 0; deque_index != MAX_DEQUE_COUNT; ++deque_index)
+        {
+            m_job_deques[deque_index] = (atomicptr_t)NULL;
+        }
+    }
+
+    ~dxtemplateJobStealingContainer()
+    {
+        dIASSERT(IsJobListReadyForShutdown());
+
+        FreeJobDeques();
+        DoFinalizeObject();
+    }
+
+    bool InitializeObject() { return DoInitializeObject(); }
+
+private:
+    bool DoInitializeObject() { return m_job_info_pool.InitializeObject(); }
+    void DoFinalizeObject() { /* Do nothing */ }
+
+public:
+    typedef tAtomicsProvider dxAtomicsProvider;
+    typedef typename tAtomicsProvider::atomicord_t atomicord_t;
+    typedef typename tAtomicsProvider::atomicptr_t atomicptr_t;
+    typedef tThreadMutex dxThreadMutex;
+    typedef dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider> dxJobInfoPool;
+    typedef dxtemplateJobStealingDeque<tAtomicsProvider> dxJobDeque;
+    typedef void dWaitSignallingFunction(void *job_call_wait);
+
+    enum
+    {
+        MAX_DEQUE_COUNT = 64, // Threads in excess use the shared stack only
+    };
+
+public:
+    dxThreadedJobInfo *ReleaseAJobAndPickNextPendingOne(
+        dxThreadedJobInfo *job_to_release, bool job_result, dWaitSignallingFunction *wait_signal_proc_ptr, 
+        bool &out_last_job_flag);
+
+private:
+    dxThreadedJobInfo *PickNextPendingJob(bool &out_last_job_flag);
+    void ReleaseAJob(dxThreadedJobInfo *job_instance, bool job_result, dWaitSignallingFunction *wait_signal_proc_ptr);
+
+public:
+    inline dxThreadedJobInfo *AllocateJobInfoFromPool();
+    void QueueJobForProcessing(dxThreadedJobInfo *job_instance);
+
+    void AlterJobProcessingDependencies(dxThreadedJobInfo *job_instance, ddependencychange_t dependencies_count_change, 
+        bool &out_job_has_become_ready);
+
+private:
+    inline ddependencycount_t SmartAddJobDependenciesCount(dxThreadedJobInfo *job_instance, ddependencychange_t dependencies_count_change);
+
+    // The queued jobs have a non-NULL m_prev_job_next_ptr (just as in dxtemplateJobListContainer)
+    static void MarkJobQueued(dxThreadedJobInfo *job_instance) { job_instance->m_prev_job_next_ptr = &job_instance->m_next_job; }
+    static void MarkJobDequeued(dxThreadedJobInfo *job_instance) { job_instance->m_prev_job_next_ptr = NULL; }
+    static bool IsJobDequeued(const dxThreadedJobInfo *job_instance) { return job_instance->m_prev_job_next_ptr == NULL; }
+
+    void PushReadyJob(dxThreadedJobInfo *job_instance);
+    void InjectReadyJob(dxThreadedJobInfo *job_instance);
+    dxThreadedJobInfo *PickInjectedJob(dxJobDeque *thread_deque);
+    dxThreadedJobInfo *StealAJob(dxJobDeque *thread_deque);
+
+    inline dxJobDeque *GetCurrentThreadDeque() const;
+
+public:
+    bool EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count) { return m_job_info_pool.EnsureNumberOfJobInfosIsPreallocated(required_info_count); }
+
+    void AssignTracer(dxThreadingTracer *tracer) { m_job_info_pool.AssignTracer(tracer); }
+    dxThreadingTracer *GetTracer() const { return m_job_info_pool.GetTracer(); }
+
+public:
+    bool AssignADequeToCurrentThread();
+    void UnassignDequeFromCurrentThread();
+
+private:
+    void FreeJobDeques();
+
+public:
+    bool HasAnyJobsReady() const;
+    bool IsJobListReadyForShutdown() const { return !HasAnyJobsReady(); }
+
+private:
+    volatile atomicptr_t    m_injected_jobs; // dxThreadedJobInfo * stack of jobs that have become ready outside of the deque owners
+    volatile atomicptr_t    m_job_deques[MAX_DEQUE_COUNT]; // dxJobDeque *
+    volatile atomicord_t    m_deque_count;
+    dxJobInfoPool           m_job_info_pool;
+
+#if defined(dTHREAD_LOCAL)
+    static dTHREAD_LOCAL dxJobDeque *m_current_thread_deque;
+#endif
 };
 
 
+#endif // #if dBUILTIN_THREADING_IMPL_ENABLED
+
+
 typedef void (dxThreadReadyToServeCallback)(void *callback_context);
 
 
@@ -362,6 +607,89 @@ private:
 #endif // #if dBUILTIN_THREADING_IMPL_ENABLED
 
 
+
+
+#if dBUILTIN_THREADING_IMPL_ENABLED
+
+template<class tThreadWakeup, class tJobListContainer>
+class dxtemplateJobStealingThreadedHandler
+{
+public:
+    dxtemplateJobStealingThreadedHandler(tJobListContainer *list_container_ptr):
+        m_job_list_ptr(list_container_ptr),
+        m_processing_wakeup(),
+        m_active_thread_count(0),
+        m_idle_thread_count(0),
+        m_shutdown_requested(0)
+    {
+    }
+
+    ~dxtemplateJobStealingThreadedHandler()
+    {
+        dIASSERT(m_active_thread_count == 0);
+        dIASSERT(m_idle_thread_count == 0);
+
+        DoFinalizeObject();
+    }
+
+    bool InitializeObject() { return DoInitializeObject(); }
+
+private:
+    bool DoInitializeObject() { return m_processing_wakeup.InitializeObject(); }
+    void DoFinalizeObject() { /* Do nothing */ }
+
+public:
+    typedef dxtemplateCallWait<tThreadWakeup> dxCallWait;
+
+    enum
+    {
+        IDLE_SPIN_COUNT = 2000, // Number of checks for new jobs with a CPU relax hint before an idle thread starts yielding
+        IDLE_YIELD_COUNT = 16, // Number of checks for new jobs with a time slice yield before an idle thread blocks
+    };
+
+public:
+    inline void ProcessActiveJobAddition();
+    inline void PrepareForWaitingAJobCompletion();
+
+public:
+    inline unsigned RetrieveActiveThreadsCount();
+    inline void StickToJobsProcessing(dxThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/);
+
+private:
+    void PerformJobProcessingUntilShutdown();
+    void PerformJobProcessingSession();
+
+    bool SpinWaitingForJobs();
+    void BlockAsIdleThread();
+    void ActivateAnIdleThread();
+
+public:
+    inline void ShutdownProcessing();
+    inline void CleanupForRestart();
+
+private:
+    bool IsShutdownRequested() const { return m_shutdown_requested != 0; }
+
+private:
+    typedef typename tJobListContainer::dxAtomicsProvider dxAtomicsProvider;
+    typedef typename tJobListContainer::atomicord_t atomicord_t;
+
+    atomicord_t GetActiveThreadsCount() const { return m_active_thread_count; }
+    void RegisterAsActiveThread() { dxAtomicsProvider::template AddValueToTarget<sizeof(atomicord_t)>((volatile void *)&m_active_thread_count, 1); }
+    void UnregisterAsActiveThread() { dxAtomicsProvider::template AddValueToTarget<sizeof(atomicord_t)>((volatile void *)&m_active_thread_count, -1); }
+
+private:
+    tJobListContainer       *m_job_list_ptr;
+    tThreadWakeup           m_processing_wakeup;
+    volatile atomicord_t    m_active_thread_count;
+    volatile atomicord_t    m_idle_thread_count; // Threads that are about to block or are blocked
+    int                     m_shutdown_requested;
+};
+
+
+#endif // #if dBUILTIN_THREADING_IMPL_ENABLED
+
+
 template<class tThreadWakeup, class tJobListContainer>
 class dxtemplateJobListSelfHandler
 {
@@ -427,16 +755,22 @@ public:
     virtual void ScheduleNewJob(int *fault_accumulator_ptr/*=NULL*/, 
         dCallReleaseeID *out_post_releasee_ptr/*=NULL*/, ddependencycount_t dependencies_count, dCallReleaseeID dependent_releasee/*=NULL*/, 
         dxICallWait *call_wait/*=NULL*/, 
-        dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index) = 0;
+        dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index, 
+        const char *call_name/*=NULL*/) = 0;
     virtual void AlterJobDependenciesCount(dCallReleaseeID target_releasee, ddependencychange_t dependencies_count_change) = 0;
     virtual void WaitJobCompletion(int *out_wait_status_ptr/*=NULL*/, 
-        dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/) = 0;
+        dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/, 
+        const char *wait_name/*=NULL*/) = 0;
 
 public:
     virtual unsigned RetrieveActiveThreadsCount() = 0;
     virtual void StickToJobsProcessing(dxThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/) = 0;
     virtual void ShutdownProcessing() = 0;
     virtual void CleanupForRestart() = 0;
+
+public:
+    virtual bool AssignTracing(unsigned max_event_count) = 0;
+    virtual int WriteTrace(FILE *file) = 0;
 };
 
 
@@ -449,7 +783,8 @@ public:
     dxtemplateThreadingImplementation():
         dBase(),
         m_list_container(),
-        m_list_handler(&m_list_container)
+        m_list_handler(&m_list_container),
+        m_tracer(NULL)
     {
     }
 
@@ -462,7 +797,7 @@ public:
 
 private:
     bool DoInitializeObject() { return m_list_container.InitializeObject() && m_list_handler.InitializeObject(); }
-    void DoFinalizeObject() { /* Do nothing */ }
+    void DoFinalizeObject() { delete m_tracer; }
 
 protected:
     virtual void FreeInstance();
@@ -488,10 +823,12 @@ protected:
     virtual void ScheduleNewJob(int *fault_accumulator_ptr/*=NULL*/, 
         dCallReleaseeID *out_post_releasee_ptr/*=NULL*/, ddependencycount_t dependencies_count, dCallReleaseeID dependent_releasee/*=NULL*/, 
         dxICallWait *call_wait/*=NULL*/, 
-        dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index);
+        dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index, 
+        const char *call_name/*=NULL*/);
     virtual void AlterJobDependenciesCount(dCallReleaseeID target_releasee, ddependencychange_t dependencies_count_change);
     virtual void WaitJobCompletion(int *out_wait_status_ptr/*=NULL*/, 
-        dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/);
+        dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/, 
+        const char *wait_name/*=NULL*/);
 
 protected:
     virtual unsigned RetrieveActiveThreadsCount();
@@ -499,9 +836,14 @@ protected:
     virtual void ShutdownProcessing();
     virtual void CleanupForRestart();
 
+protected:
+    virtual bool AssignTracing(unsigned max_event_count);
+    virtual int WriteTrace(FILE *file);
+
 private:
     tJobListContainer     m_list_container;
     tJobListHandler       m_list_handler;
+    dxThreadingTracer     *m_tracer;
 };
 
 
@@ -680,7 +1022,7 @@ void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::Re
         }
 
         dxThreadedJobInfo *dependent_job = current_job->m_dependent_job;
-        ReleaseJobInfoIntoPool(current_job);
+        m_job_info_pool.ReleaseJobInfoIntoPool(current_job);
 
         if (dependent_job == NULL)
         {
@@ -702,7 +1044,7 @@ template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
 dxThreadedJobInfo *dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::AllocateJobInfoFromPool()
 {
     // No locking is necessary
-    dxThreadedJobInfo *job_instance = ExtractJobInfoFromPoolOrAllocate();
+    dxThreadedJobInfo *job_instance = m_job_info_pool.ExtractJobInfoFromPoolOrAllocate();
     return job_instance;
 }
 
@@ -768,8 +1110,12 @@ void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::Re
     job_instance->m_prev_job_next_ptr = NULL;
 }
 
+/************************************************************************/
+/* Implementation of dxtemplateJobInfoPool                              */
+/************************************************************************/
+
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
-dxThreadedJobInfo *dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::ExtractJobInfoFromPoolOrAllocate()
+dxThreadedJobInfo *dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider>::ExtractJobInfoFromPoolOrAllocate()
 {
     dxThreadedJobInfo *result_info;
 
@@ -789,7 +1135,10 @@ dxThreadedJobInfo *dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomic
                 break;
             }
 
-            m_info_wait_lull.WaitForLullAlarm();
+            {
+                dxThreadingTraceScope trace_scope(m_tracer, dxTTE_LULL, NULL);
+                m_info_wait_lull.WaitForLullAlarm();
+            }
             waited_lull = true;
         }
 
@@ -823,7 +1172,7 @@ dxThreadedJobInfo *dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomic
 }
 
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
-void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::ReleaseJobInfoIntoPool(
+void dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider>::ReleaseJobInfoIntoPool(
     dxThreadedJobInfo *job_instance)
 {
     while (true)
@@ -841,7 +1190,7 @@ void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::Re
 }
 
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
-void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::FreeJobInfoPoolInfos()
+void dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider>::FreeJobInfoPoolInfos()
 {
     dxThreadedJobInfo *current_info = (dxThreadedJobInfo *)m_info_pool;
 
@@ -857,7 +1206,7 @@ void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::Fr
 }
 
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
-bool dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count)
+bool dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider>::EnsureNumberOfJobInfosIsPreallocated(ddependencycount_t required_info_count)
 {
     bool result = required_info_count <= m_info_count_known_to_be_preallocated 
         || DoPreallocateJobInfos(required_info_count);
@@ -865,7 +1214,7 @@ bool dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::En
 }
 
 template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
-bool dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::DoPreallocateJobInfos(ddependencycount_t required_info_count)
+bool dxtemplateJobInfoPool<tThreadLull, tThreadMutex, tAtomicsProvider>::DoPreallocateJobInfos(ddependencycount_t required_info_count)
 {
     dIASSERT(required_info_count > m_info_count_known_to_be_preallocated); // Also ensures required_info_count > 0
 
@@ -1002,6 +1351,7 @@ void dxtemplateJobListThreadedHandler<tThreadWakeup, tJobListContainer>::Perform
 template<class tThreadWakeup, class tJobListContainer>
 void dxtemplateJobListThreadedHandler<tThreadWakeup, tJobListContainer>::BlockAsIdleThread()
 {
+    dxThreadingTraceScope trace_scope(m_job_list_ptr->GetTracer(), dxTTE_IDLE, NULL);
     m_processing_wakeup.WaitWakeup(NULL);
 }
 
@@ -1030,15 +1380,651 @@ void dxtemplateJobListThreadedHandler<tThreadWakeup, tJobListContainer>::Cleanup
 #endif // #if dBUILTIN_THREADING_IMPL_ENABLED
 
 
+#if dBUILTIN_THREADING_IMPL_ENABLED
+
 /************************************************************************/
-/* Implementation of dxtemplateJobListSelfHandler                       */
+/* Implementation of dxtemplateJobStealingDeque                         */
 /************************************************************************/
 
-template<class tThreadWakeup, class tJobListContainer>
-void dxtemplateJobListSelfHandler<tThreadWakeup, tJobListContainer>::ProcessActiveJobAddition()
+template<class tAtomicsProvider>
+bool dxtemplateJobStealingDeque<tAtomicsProvider>::PushJob(dxThreadedJobInfo *job_instance)
 {
-    // Do nothing
-}
+    bool result = false;
+
+    atomicord_t bottom = m_bottom; // Only the owner thread changes the bottom
+    atomicord_t top = tAtomicsProvider::QueryTargetValue(&m_top);
+
+    if ((atomicord_t)(bottom - top) < (atomicord_t)CAPACITY)
+    {
+        m_jobs[bottom & (CAPACITY - 1)] = job_instance;
+        // The job must be stored before the bottom increment makes it available for stealing
+        tAtomicsProvider::IncrementTargetNoRet(&m_bottom);
+
+        result = true;
+    }
+
+    return result;
+}
+
+template<class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingDeque<tAtomicsProvider>::PopJob()
+{
+    dxThreadedJobInfo *job_instance = NULL;
+
+    // Reserve the bottom job first and only then check if the thieves have left it
+    atomicord_t bottom = (atomicord_t)tAtomicsProvider::template AddValueToTarget<sizeof(atomicord_t)>((volatile void *)&m_bottom, -1) - 1;
+    atomicord_t top = tAtomicsProvider::QueryTargetValue(&m_top);
+
+    int jobs_remaining = (int)(bottom - top);
+
+    if (jobs_remaining >= 0)
+    {
+        job_instance = m_jobs[bottom & (CAPACITY - 1)];
+
+        if (jobs_remaining == 0)
+        {
+            // This is the last job and a thief may be taking it at the moment
+            if (!tAtomicsProvider::CompareExchangeTargetValue(&m_top, top, top + 1))
+            {
+                job_instance = NULL;
+            }
+
+            // Either way, the deque is empty now with bottom equal to top
+            tAtomicsProvider::IncrementTargetNoRet(&m_bottom);
+        }
+    }
+    else
+    {
+        // The deque was empty - restore the bottom
+        tAtomicsProvider::IncrementTargetNoRet(&m_bottom);
+    }
+
+    return job_instance;
+}
+
+template<class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingDeque<tAtomicsProvider>::StealJob()
+{
+    dxThreadedJobInfo *job_instance = NULL;
+
+    atomicord_t top = tAtomicsProvider::QueryTargetValue(&m_top);
+    atomicord_t bottom = tAtomicsProvider::QueryTargetValue(&m_bottom);
+
+    if ((int)(bottom - top) > 0)
+    {
+        dxThreadedJobInfo *top_job = m_jobs[top & (CAPACITY - 1)];
+
+        // The job is only taken if neither the owner nor other thieves got it first
+        if (tAtomicsProvider::CompareExchangeTargetValue(&m_top, top, top + 1))
+        {
+            job_instance = top_job;
+        }
+    }
+
+    return job_instance;
+}
+
+
+/************************************************************************/
+/* Implementation of dxtemplateJobStealingContainer                     */
+/************************************************************************/
+
+#if defined(dTHREAD_LOCAL)
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dTHREAD_LOCAL typename dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::dxJobDeque *
+    dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::m_current_thread_deque = NULL;
+
+#endif // #if defined(dTHREAD_LOCAL)
+
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::ReleaseAJobAndPickNextPendingOne(
+    dxThreadedJobInfo *job_to_release, bool job_result, dWaitSignallingFunction *wait_signal_proc_ptr, bool &out_last_job_flag)
+{
+    if (job_to_release != NULL)
+    {
+        ReleaseAJob(job_to_release, job_result, wait_signal_proc_ptr);
+    }
+
+    dxThreadedJobInfo *picked_job = PickNextPendingJob(out_last_job_flag);
+    return picked_job;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::PickNextPendingJob(
+    bool &out_last_job_flag)
+{
+    dxJobDeque *thread_deque = GetCurrentThreadDeque();
+
+    dxThreadedJobInfo *picked_job = thread_deque != NULL ? thread_deque->PopJob() : NULL;
+
+    if (picked_job == NULL)
+    {
+        picked_job = PickInjectedJob(thread_deque);
+
+        if (picked_job == NULL)
+        {
+            picked_job = StealAJob(thread_deque);
+        }
+    }
+
+    if (picked_job != NULL)
+    {
+        // It is OK to assign in unsafe manner - the job is exclusively owned by current thread
+        picked_job->m_dependencies_count = 1;
+        MarkJobDequeued(picked_job);
+    }
+
+    // The jobs in other threads' deques are not considered -- their owners take care of them
+    out_last_job_flag = (thread_deque == NULL || thread_deque->IsDequeEmpty()) && m_injected_jobs == (atomicptr_t)NULL;
+    return picked_job;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::ReleaseAJob(
+    dxThreadedJobInfo *job_instance, bool job_result, dWaitSignallingFunction *wait_signal_proc_ptr)
+{
+    dxThreadedJobInfo *current_job = job_instance;
+
+    if (!job_result)
+    {
+        // Accumulate call fault (be careful to not reset it!!!)
+        current_job->m_call_fault = 1;
+    }
+
+    bool job_dequeued = true;
+    dIASSERT(IsJobDequeued(current_job));
+
+    while (true)
+    {
+        dIASSERT(current_job->m_dependencies_count != 0);
+
+        ddependencycount_t new_dependencies_count = SmartAddJobDependenciesCount(current_job, -1);
+
+        if (new_dependencies_count != 0)
+        {
+            break;
+        }
+
+        if (!job_dequeued)
+        {
+            // The dependent job has become ready for execution
+            PushReadyJob(current_job);
+            break;
+        }
+
+        int call_fault = current_job->m_call_fault;
+
+        // Assign the accumulated fault state first...
+        if (current_job->m_fault_accumulator_ptr)
+        {
+            *current_job->m_fault_accumulator_ptr = call_fault;
+        }
+
+        // ...and only then release the entity waiting on the job.
+        void *job_call_wait = current_job->m_call_wait;
+
+        if (job_call_wait != NULL)
+        {
+            wait_signal_proc_ptr(job_call_wait);
+        }
+
+        dxThreadedJobInfo *dependent_job = current_job->m_dependent_job;
+        m_job_info_pool.ReleaseJobInfoIntoPool(current_job);
+
+        if (dependent_job == NULL)
+        {
+            break;
+        }
+
+        if (call_fault)
+        {
+            // Accumulate call fault (be careful to not reset it!!!)
+            dependent_job->m_call_fault = 1;
+        }
+
+        current_job = dependent_job;
+        job_dequeued = IsJobDequeued(dependent_job);
+    }
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::AllocateJobInfoFromPool()
+{
+    dxThreadedJobInfo *job_instance = m_job_info_pool.ExtractJobInfoFromPoolOrAllocate();
+    return job_instance;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::QueueJobForProcessing(dxThreadedJobInfo *job_instance)
+{
+    MarkJobQueued(job_instance);
+
+    // The jobs with dependencies are pushed when the last dependency is released
+    if (job_instance->m_dependencies_count == 0)
+    {
+        PushReadyJob(job_instance);
+    }
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::AlterJobProcessingDependencies(dxThreadedJobInfo *job_instance, ddependencychange_t dependencies_count_change, 
+                                                                                                                 bool &out_job_has_become_ready)
+{
+    // Dependencies should not be changed when job has already become ready for execution
+    dIASSERT(job_instance->m_dependencies_count != 0);
+    // It's OK that access is not atomic - that is to be handled by external logic
+    dIASSERT(dependencies_count_change < 0 ? (job_instance->m_dependencies_count >= (ddependencycount_t)(-dependencies_count_change)) : ((ddependencycount_t)(-(ddependencychange_t)job_instance->m_dependencies_count) > (ddependencycount_t)dependencies_count_change));
+
+    ddependencycount_t new_dependencies_count = SmartAddJobDependenciesCount(job_instance, dependencies_count_change);
+    bool job_has_become_ready = new_dependencies_count == 0;
+
+    if (job_has_become_ready)
+    {
+        dIASSERT(!IsJobDequeued(job_instance));
+        PushReadyJob(job_instance);
+    }
+
+    out_job_has_become_ready = job_has_become_ready;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+ddependencycount_t dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::SmartAddJobDependenciesCount(
+    dxThreadedJobInfo *job_instance, ddependencychange_t dependencies_count_change)
+{
+    ddependencycount_t new_dependencies_count = tAtomicsProvider::template AddValueToTarget<sizeof(ddependencycount_t)>((volatile void *)&job_instance->m_dependencies_count, dependencies_count_change) + dependencies_count_change;
+    return new_dependencies_count;
+}
+
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::PushReadyJob(dxThreadedJobInfo *job_instance)
+{
+    dxJobDeque *thread_deque = GetCurrentThreadDeque();
+
+    if (thread_deque == NULL || !thread_deque->PushJob(job_instance))
+    {
+        InjectReadyJob(job_instance);
+    }
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::InjectReadyJob(dxThreadedJobInfo *job_instance)
+{
+    while (true)
+    {
+        dxThreadedJobInfo *next_job = (dxThreadedJobInfo *)m_injected_jobs;
+        job_instance->m_next_job = next_job;
+
+        if (tAtomicsProvider::CompareExchangeTargetPtr(&m_injected_jobs, (atomicptr_t)next_job, (atomicptr_t)job_instance))
+        {
+            break;
+        }
+    }
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::PickInjectedJob(dxJobDeque *thread_deque)
+{
+    dxThreadedJobInfo *picked_job = NULL;
+
+    // The whole stack is extracted at once. Unlike with single item extraction, 
+    // there is no ABA problem with the head's next pointer this way.
+    while (true)
+    {
+        dxThreadedJobInfo *head_job = (dxThreadedJobInfo *)m_injected_jobs;
+
+        if (head_job == NULL)
+        {
+            break;
+        }
+
+        if (tAtomicsProvider::CompareExchangeTargetPtr(&m_injected_jobs, (atomicptr_t)head_job, (atomicptr_t)NULL))
+        {
+            picked_job = head_job;
+            break;
+        }
+    }
+
+    if (picked_job != NULL)
+    {
+        // Keep the first job and move the rest into own deque (or return them to the stack if that is not possible)
+        dxThreadedJobInfo *current_job = picked_job->m_next_job;
+
+        while (current_job != NULL)
+        {
+            dxThreadedJobInfo *next_job = current_job->m_next_job;
+
+            if (thread_deque == NULL || !thread_deque->PushJob(current_job))
+            {
+                InjectReadyJob(current_job);
+            }
+
+            current_job = next_job;
+        }
+    }
+
+    return picked_job;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+dxThreadedJobInfo *dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::StealAJob(dxJobDeque *thread_deque)
+{
+    dxThreadedJobInfo *stolen_job = NULL;
+
+    const unsigned deque_count = (unsigned)m_deque_count;
+    // Start with the neighbor deque so that the thieves do not all go for the same victim
+    const unsigned first_deque_index = thread_deque != NULL ? thread_deque->GetDequeIndex() + 1 : 0;
+
+    for (unsigned deque_step = 0; deque_step != deque_count; ++deque_step)
+    {
+        unsigned deque_index = (first_deque_index + deque_step) % deque_count;
+        dxJobDeque *victim_deque = (dxJobDeque *)m_job_deques[deque_index];
+
+        if (victim_deque != NULL && victim_deque != thread_deque)
+        {
+            stolen_job = victim_deque->StealJob();
+
+            if (stolen_job != NULL)
+            {
+                break;
+            }
+        }
+    }
+
+    return stolen_job;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+typename dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::dxJobDeque *
+    dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::GetCurrentThreadDeque() const
+{
+#if defined(dTHREAD_LOCAL)
+    dxJobDeque *thread_deque = m_current_thread_deque;
+    // A serving thread may be posting calls into another implementation from within a job
+    return thread_deque != NULL && thread_deque->GetOwnerContainer() == this ? thread_deque : NULL;
+#else
+    return NULL;
+#endif
+}
+
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+bool dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::AssignADequeToCurrentThread()
+{
+    bool result = false;
+
+#if defined(dTHREAD_LOCAL)
+    dIASSERT(m_current_thread_deque == NULL);
+
+    for (unsigned deque_index = 0; deque_index != MAX_DEQUE_COUNT; ++deque_index)
+    {
+        dxJobDeque *current_deque = (dxJobDeque *)m_job_deques[deque_index];
+
+        if (current_deque == NULL)
+        {
+            dxJobDeque *new_deque = new dxJobDeque(this, deque_index);
+
+            if (new_deque == NULL)
+            {
+                break;
+            }
+
+            if (tAtomicsProvider::CompareExchangeTargetPtr(&m_job_deques[deque_index], (atomicptr_t)NULL, (atomicptr_t)new_deque))
+            {
+                tAtomicsProvider::IncrementTargetNoRet(&m_deque_count);
+                current_deque = new_deque;
+            }
+            else
+            {
+                delete new_deque;
+                current_deque = (dxJobDeque *)m_job_deques[deque_index];
+            }
+        }
+
+        if (current_deque->TryAssigningToThread())
+        {
+            m_current_thread_deque = current_deque;
+            result = true;
+            break;
+        }
+    }
+#endif // #if defined(dTHREAD_LOCAL)
+
+    return result;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::UnassignDequeFromCurrentThread()
+{
+#if defined(dTHREAD_LOCAL)
+    dxJobDeque *thread_deque = GetCurrentThreadDeque();
+    dIASSERT(thread_deque != NULL);
+
+    m_current_thread_deque = NULL;
+    // The deque is retained for the threads to come
+    thread_deque->UnassignFromThread();
+#endif // #if defined(dTHREAD_LOCAL)
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+void dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::FreeJobDeques()
+{
+    for (unsigned deque_index = 0; deque_index != MAX_DEQUE_COUNT; ++deque_index)
+    {
+        dxJobDeque *current_deque = (dxJobDeque *)m_job_deques[deque_index];
+
+        if (current_deque != NULL)
+        {
+            delete current_deque;
+            m_job_deques[deque_index] = (atomicptr_t)NULL;
+        }
+    }
+
+    m_deque_count = 0;
+}
+
+template<class tThreadLull, class tThreadMutex, class tAtomicsProvider>
+bool dxtemplateJobStealingContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::HasAnyJobsReady() const
+{
+    bool result = m_injected_jobs != (atomicptr_t)NULL;
+
+    const unsigned deque_count = (unsigned)m_deque_count;
+
+    for (unsigned deque_index = 0; !result && deque_index != deque_count; ++deque_index)
+    {
+        const dxJobDeque *current_deque = (const dxJobDeque *)m_job_deques[deque_index];
+        result = current_deque != NULL && !current_deque->IsDequeEmpty();
+    }
+
+    return result;
+}
+
+
+/************************************************************************/
+/* Implementation of dxtemplateJobStealingThreadedHandler               */
+/************************************************************************/
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::ProcessActiveJobAddition()
+{
+    ActivateAnIdleThread();
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::PrepareForWaitingAJobCompletion()
+{
+    // Do nothing
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+unsigned dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::RetrieveActiveThreadsCount()
+{
+    return GetActiveThreadsCount();
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::StickToJobsProcessing(dxThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/)
+{
+    RegisterAsActiveThread();
+    // A thread that did not get a deque still serves the jobs through the shared stack and stealing
+    bool deque_assigned = m_job_list_ptr->AssignADequeToCurrentThread();
+
+    if (readiness_callback != NULL)
+    {
+        (*readiness_callback)(callback_context);
+    }
+
+    PerformJobProcessingUntilShutdown();
+
+    if (deque_assigned)
+    {
+        m_job_list_ptr->UnassignDequeFromCurrentThread();
+    }
+
+    UnregisterAsActiveThread();
+}
+
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::PerformJobProcessingUntilShutdown()
+{
+    while (true)
+    {
+        // It is expected that new jobs will not be queued any longer after shutdown had been requested
+        if (IsShutdownRequested() && m_job_list_ptr->IsJobListReadyForShutdown())
+        {
+            break;
+        }
+
+        PerformJobProcessingSession();
+
+        // It is expected that new jobs will not be queued any longer after shutdown had been requested
+        if (IsShutdownRequested() && m_job_list_ptr->IsJobListReadyForShutdown())
+        {
+            break;
+        }
+
+        if (!SpinWaitingForJobs())
+        {
+            BlockAsIdleThread();
+        }
+    }
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::PerformJobProcessingSession()
+{
+    dxThreadedJobInfo *current_job = NULL;
+    bool job_result = false;
+
+    while (true)
+    {
+        bool last_job_flag;
+        current_job = m_job_list_ptr->ReleaseAJobAndPickNextPendingOne(current_job, job_result, &dxCallWait::AbstractSignalTheWait, last_job_flag);
+
+        if (!current_job)
+        {
+            break;
+        }
+
+        if (!last_job_flag)
+        {
+            ActivateAnIdleThread();
+        }
+
+        job_result = current_job->InvokeCallFunction();
+    }
+}
+
+
+template<class tThreadWakeup, class tJobListContainer>
+bool dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::SpinWaitingForJobs()
+{
+    bool result = false;
+
+    // The jobs of a step often come in bursts with small gaps between them.
+    // Spinning for a while saves the wakeup latency in such gaps. The spinning 
+    // backs off to yielding the time slice so that the other threads (including 
+    // the one that is to add the jobs) are not starved on an oversubscribed CPU.
+    for (unsigned spin_index = 0; spin_index != IDLE_SPIN_COUNT + IDLE_YIELD_COUNT; ++spin_index)
+    {
+        if (m_job_list_ptr->HasAnyJobsReady() || IsShutdownRequested())
+        {
+            result = true;
+            break;
+        }
+
+        if (spin_index < IDLE_SPIN_COUNT)
+        {
+            dxAtomicsProvider::RelaxWhileSpinning();
+        }
+        else
+        {
+            tThreadWakeup::YieldTimeSlice();
+        }
+    }
+
+    return result;
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::BlockAsIdleThread()
+{
+    dxAtomicsProvider::IncrementTargetNoRet(&m_idle_thread_count);
+
+    // The jobs must be re-checked after the idle count increment. Either this check 
+    // finds a job added concurrently or the adding thread sees the idle count and 
+    // issues a wakeup (which is retained if the thread has not started waiting yet).
+    if (!m_job_list_ptr->HasAnyJobsReady() && !IsShutdownRequested())
+    {
+        dxThreadingTraceScope trace_scope(m_job_list_ptr->GetTracer(), dxTTE_IDLE, NULL);
+        m_processing_wakeup.WaitWakeup(NULL);
+    }
+
+    dxAtomicsProvider::DecrementTargetNoRet(&m_idle_thread_count);
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::ActivateAnIdleThread()
+{
+    // The job has been made available with an atomic operation just before this call
+    // and that serves as a memory barrier for the idle count read.
+    if (m_idle_thread_count != 0)
+    {
+        m_processing_wakeup.WakeupAThread();
+    }
+}
+
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::ShutdownProcessing()
+{
+    m_shutdown_requested = true;
+    m_processing_wakeup.WakeupAllThreads();
+}
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobStealingThreadedHandler<tThreadWakeup, tJobListContainer>::CleanupForRestart()
+{
+    m_shutdown_requested = false;
+    m_processing_wakeup.ResetWakeup();
+}
+
+
+#endif // #if dBUILTIN_THREADING_IMPL_ENABLED
+
+
+/************************************************************************/
+/* Implementation of dxtemplateJobListSelfHandler                       */
+/************************************************************************/
+
+template<class tThreadWakeup, class tJobListContainer>
+void dxtemplateJobListSelfHandler<tThreadWakeup, tJobListContainer>::ProcessActiveJobAddition()
+{
+    // Do nothing
+}
 
 template<class tThreadWakeup, class tJobListContainer>
 void dxtemplateJobListSelfHandler<tThreadWakeup, tJobListContainer>::PrepareForWaitingAJobCompletion()
@@ -1186,12 +2172,14 @@ void dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::Sche
     int *fault_accumulator_ptr/*=NULL*/, 
     dCallReleaseeID *out_post_releasee_ptr/*=NULL*/, ddependencycount_t dependencies_count, dCallReleaseeID dependent_releasee/*=NULL*/, 
     dxICallWait *call_wait/*=NULL*/, 
-    dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index)
+    dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index, 
+    const char *call_name/*=NULL*/)
 {
     dxThreadedJobInfo *new_job = m_list_container.AllocateJobInfoFromPool();
     dIASSERT(new_job != NULL);
 
     new_job->AssignJobData(dependencies_count, dMAKE_RELEASEE_JOBINSTANCE(dependent_releasee), (dxCallWait *)call_wait, fault_accumulator_ptr, call_func, call_context, instance_index);
+    new_job->AssignTraceData(m_tracer, call_name, m_tracer != NULL ? dxThreadingTracer::QueryCurrentTime() : 0);
 
     if (out_post_releasee_ptr != NULL)
     {
@@ -1226,10 +2214,14 @@ void dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::Alte
 template<class tJobListContainer, class tJobListHandler>
 void dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::WaitJobCompletion(
     int *out_wait_status_ptr/*=NULL*/, 
-    dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/)
+    dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/, 
+    const char *wait_name/*=NULL*/)
 {
     dIASSERT(call_wait != NULL);
 
+    // The calls the self-threaded handler executes while preparing show up nested into the wait
+    dxThreadingTraceScope trace_scope(m_tracer, dxTTE_WAIT, wait_name);
+
     m_list_handler.PrepareForWaitingAJobCompletion();
 
     bool wait_status = ((dxCallWait *)call_wait)->PerformWaiting(timeout_time_ptr);
@@ -1267,4 +2259,42 @@ void dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::Clea
 }
 
 
+template<class tJobListContainer, class tJobListHandler>
+bool dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::AssignTracing(unsigned max_event_count)
+{
+    // No multithreading protection here!
+    // The tracing is to be changed while there are no calls scheduled or executing.
+    bool result = true;
+
+    dxThreadingTracer *old_tracer = m_tracer;
+    m_tracer = NULL;
+    m_list_container.AssignTracer(NULL);
+    delete old_tracer;
+
+    if (max_event_count != 0)
+    {
+        dxThreadingTracer *new_tracer = new dxThreadingTracer();
+
+        if (new_tracer != NULL && new_tracer->InitializeObject(max_event_count))
+        {
+            m_tracer = new_tracer;
+            m_list_container.AssignTracer(new_tracer);
+        }
+        else
+        {
+            delete new_tracer;
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+template<class tJobListContainer, class tJobListHandler>
+int dxtemplateThreadingImplementation<tJobListContainer, tJobListHandler>::WriteTrace(FILE *file)
+{
+    return m_tracer != NULL ? m_tracer->WriteChromeTrace(file) : 0;
+}
+
+
 #endif // #ifndef _ODE_THREADING_IMPL_TEMPLATES_H_
@@ -79,6 +79,8 @@ public:
 
     bool WaitWakeup(const dThreadedWaitTime *timeout_time_ptr);
 
+    static void YieldTimeSlice() { SwitchToThread(); }
+
 private:
     bool          m_state_is_permanent;
     HANDLE        m_event_handle;  
@@ -264,6 +266,15 @@ typedef dxtemplateJobListThreadedHandler<dxEventWakeup, dxMultiThreadedJobListCo
 typedef dxtemplateThreadingImplementation<dxMultiThreadedJobListContainer, dxMultiThreadedJobListHandler> dxMultiThreadedThreading;
 
 
+/************************************************************************/
+/* Work-stealing multi-threaded job container definition                */
+/************************************************************************/
+
+typedef dxtemplateJobStealingContainer<dxtemplateThreadedLull<dxEventWakeup, dxOUAtomicsProvider, false>, dxCriticalSectionMutex, dxOUAtomicsProvider> dxWorkStealingJobListContainer;
+typedef dxtemplateJobStealingThreadedHandler<dxEventWakeup, dxWorkStealingJobListContainer> dxWorkStealingJobListHandler;
+typedef dxtemplateThreadingImplementation<dxWorkStealingJobListContainer, dxWorkStealingJobListHandler> dxWorkStealingThreading;
+
+
 #endif // #if dBUILTIN_THREADING_IMPL_ENABLED
 
 
@@ -0,0 +1,223 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+// Trace recorder of the built-in threading implementations.
+
+#include <ode/common.h>
+#include "config.h"
+#include "threading_trace.h"
+#include "step_profile.h"
+#include "threadingutils.h"
+
+
+static const char *const g_threading_trace_categories[dxTTE__MAX] = 
+{
+    "call", // dxTTE_CALL
+    "wait", // dxTTE_WAIT
+    "idle", // dxTTE_IDLE
+    "lull", // dxTTE_LULL
+};
+
+static const char *const g_threading_trace_unnamed_events[dxTTE__MAX] = 
+{
+    "Unnamed Call",     // dxTTE_CALL
+    "Unnamed Wait",     // dxTTE_WAIT
+    "Idle",             // dxTTE_IDLE
+    "Job Info Lull",    // dxTTE_LULL
+};
+
+
+dxThreadingTracer::dxThreadingTracer():
+    m_events(NULL),
+    m_max_event_count(0),
+    m_event_count(0),
+    m_start_time(0)
+{
+    for (unsigned thread_index = 0; thread_index != dxTHREADING_TRACE_MAX_THREADS; ++thread_index)
+    {
+        m_thread_keys[thread_index] = NULL;
+    }
+}
+
+dxThreadingTracer::~dxThreadingTracer()
+{
+    if (m_events != NULL)
+    {
+        dFree(m_events, sizeof(dxThreadingTraceEvent) * m_max_event_count);
+    }
+}
+
+bool dxThreadingTracer::InitializeObject(unsigned max_event_count)
+{
+    dIASSERT(m_events == NULL);
+    dIASSERT(max_event_count != 0);
+
+    bool result = false;
+
+    m_events = (dxThreadingTraceEvent *)dAlloc(sizeof(dxThreadingTraceEvent) * max_event_count);
+
+    if (m_events != NULL)
+    {
+        // An event a late thread is recording while the trace is written must not have a stale name
+        memset(m_events, 0, sizeof(dxThreadingTraceEvent) * max_event_count);
+        m_max_event_count = max_event_count;
+        m_start_time = QueryCurrentTime();
+        result = true;
+    }
+
+    return result;
+}
+
+
+/*static */
+duint64 dxThreadingTracer::QueryCurrentTime()
+{
+    return dxQueryProfileTimeNanoseconds();
+}
+
+void dxThreadingTracer::RecordEvent(dxThreadingTraceEventKind event_kind, const char *event_name, duint64 post_time, duint64 begin_time, duint64 end_time)
+{
+    dIASSERT(dIN_RANGE(event_kind, dxTTE__MIN, dxTTE__MAX));
+
+    unsigned event_index = (unsigned)ThrsafeIncrement(&m_event_count) - 1;
+
+    if (event_index < m_max_event_count)
+    {
+        dxThreadingTraceEvent &event = m_events[event_index];
+        event.m_name = event_name;
+        event.m_post_time = post_time;
+        event.m_begin_time = begin_time;
+        event.m_end_time = end_time;
+        event.m_kind = event_kind;
+        event.m_thread_index = FindCurrentThreadIndex();
+    }
+}
+
+unsigned dxThreadingTracer::FindCurrentThreadIndex()
+{
+    const atomicptr thread_key = dxQueryCurrentThreadKey();
+
+    unsigned thread_index = 0;
+    for (; thread_index != dxTHREADING_TRACE_MAX_THREADS; ++thread_index)
+    {
+        atomicptr record_key = m_thread_keys[thread_index];
+
+        if (record_key == NULL)
+        {
+            if (ThrsafeCompareExchangePointer(&m_thread_keys[thread_index], NULL, thread_key))
+            {
+                break;
+            }
+
+            record_key = m_thread_keys[thread_index];
+        }
+
+        if (record_key == thread_key)
+        {
+            break;
+        }
+    }
+
+    // The threads in excess share the last index
+    return thread_index;
+}
+
+
+static 
+void WriteJSONString(FILE *file, const char *text)
+{
+    fputc('"', file);
+
+    for (const char *current = text; *current != '\0'; ++current)
+    {
+        const unsigned char character = (unsigned char)*current;
+
+        if (character == '"' || character == '\\')
+        {
+            fputc('\\', file);
+            fputc(character, file);
+        }
+        else if (character < 0x20)
+        {
+            fprintf(file, "\\u%04x", character);
+        }
+        else
+        {
+            fputc(character, file);
+        }
+    }
+
+    fputc('"', file);
+}
+
+int dxThreadingTracer::WriteChromeTrace(FILE *file) const
+{
+    const unsigned recorded_count = (unsigned)m_event_count;
+    const unsigned event_count = recorded_count < m_max_event_count ? recorded_count : m_max_event_count;
+
+    fputs("{\"traceEvents\":[\n", file);
+
+    bool other_threads_present = false;
+
+    for (unsigned event_index = 0; event_index != event_count; ++event_index)
+    {
+        const dxThreadingTraceEvent &event = m_events[event_index];
+        const char *event_name = event.m_name != NULL ? event.m_name : g_threading_trace_unnamed_events[event.m_kind];
+
+        // The times are given in microseconds from the moment tracing was enabled
+        const double begin_time = (double)(event.m_begin_time - m_start_time) * 1e-3;
+        const double duration = (double)(event.m_end_time - event.m_begin_time) * 1e-3;
+
+        fputs("{\"name\":", file);
+        WriteJSONString(file, event_name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", 
+            g_threading_trace_categories[event.m_kind], event.m_thread_index, begin_time, duration);
+
+        if (event.m_kind == dxTTE_CALL)
+        {
+            const double queued_time = (double)(event.m_begin_time - event.m_post_time) * 1e-3;
+            fprintf(file, ",\"args\":{\"queued_us\":%.3f}", queued_time);
+        }
+
+        fputs("},\n", file);
+        other_threads_present = other_threads_present || event.m_thread_index == dxTHREADING_TRACE_MAX_THREADS;
+    }
+
+    // The thread names go last as there must be no comma after the final array element
+    for (unsigned thread_index = 0; thread_index != dxTHREADING_TRACE_MAX_THREADS && m_thread_keys[thread_index] != NULL; ++thread_index)
+    {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"ODE Thread %u\"}},\n", 
+            thread_index, thread_index);
+    }
+
+    if (other_threads_present)
+    {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"ODE Other Threads\"}},\n", 
+            (unsigned)dxTHREADING_TRACE_MAX_THREADS);
+    }
+
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ODE\"}}", file);
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":%u}}\n", recorded_count - event_count);
+
+    return ferror(file) == 0 ? (int)event_count : -1;
+}
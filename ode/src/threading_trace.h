@@ -0,0 +1,125 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+
+/*
+ * Trace recorder of the built-in threading implementations
+ * (see dThreadingImplementationSetTracing()).
+ *
+ * The events go into a preallocated array at indices obtained with an atomic
+ * increment, so recording does not lock. The events that do not fit are
+ * counted and dropped. The names are stored as pointers and must stay valid
+ * until the trace is written, as the string literals ODE uses for its calls do.
+ */
+
+#ifndef _ODE_THREADING_TRACE_H_
+#define _ODE_THREADING_TRACE_H_
+
+#include <ode/common.h>
+#include "objects.h"
+#include "odeou.h"
+
+
+#define dxTHREADING_TRACE_MAX_THREADS 64
+
+
+enum dxThreadingTraceEventKind
+{
+    dxTTE__MIN,
+
+    dxTTE_CALL = dxTTE__MIN,    // a posted call execution
+    dxTTE_WAIT,                 // a wait for a call completion
+    dxTTE_IDLE,                 // a serving thread blocked for the lack of ready calls
+    dxTTE_LULL,                 // a wait for a call information structure to be released
+
+    dxTTE__MAX,
+};
+
+struct dxThreadingTraceEvent
+{
+    const char      *m_name;
+    duint64         m_post_time; // the time the call was posted at (calls only)
+    duint64         m_begin_time;
+    duint64         m_end_time;
+    unsigned        m_kind;
+    unsigned        m_thread_index;
+};
+
+
+class dxThreadingTracer:
+    public dBase
+{
+public:
+    dxThreadingTracer();
+    ~dxThreadingTracer();
+
+    bool InitializeObject(unsigned max_event_count);
+
+public:
+    static duint64 QueryCurrentTime();
+
+    void RecordEvent(dxThreadingTraceEventKind event_kind, const char *event_name, duint64 post_time, duint64 begin_time, duint64 end_time);
+
+    // Returns the number of events written or -1 on an output error
+    int WriteChromeTrace(FILE *file) const;
+
+private:
+    unsigned FindCurrentThreadIndex();
+
+private:
+    volatile atomicptr      m_thread_keys[dxTHREADING_TRACE_MAX_THREADS];
+    dxThreadingTraceEvent   *m_events;
+    unsigned                m_max_event_count;
+    volatile atomicord32    m_event_count; // Keeps counting beyond m_max_event_count for the dropped events
+    duint64                 m_start_time;
+};
+
+
+// Records an event for the lifetime of the object if tracing is enabled
+class dxThreadingTraceScope
+{
+public:
+    dxThreadingTraceScope(dxThreadingTracer *tracer, dxThreadingTraceEventKind event_kind, const char *event_name):
+        m_tracer(tracer),
+        m_event_name(event_name),
+        m_event_kind(event_kind),
+        m_begin_time(tracer != NULL ? dxThreadingTracer::QueryCurrentTime() : 0)
+    {
+    }
+
+    ~dxThreadingTraceScope()
+    {
+        if (m_tracer != NULL)
+        {
+            m_tracer->RecordEvent(m_event_kind, m_event_name, 0, m_begin_time, dxThreadingTracer::QueryCurrentTime());
+        }
+    }
+
+private:
+    dxThreadingTracer           *m_tracer;
+    const char                  *m_event_name;
+    dxThreadingTraceEventKind   m_event_kind;
+    duint64                     m_begin_time;
+};
+
+
+#endif // #ifndef _ODE_THREADING_TRACE_H_
@@ -26,8 +26,12 @@
 #include "objects.h"
 #include "joints/joint.h"
 #include "threadingutils.h"
+#include "step_profile.h"
+#include "resource_control.h"
+#include "simd.h"
 
 #include <new>
+#include <algorithm>
 
 
 #define dMIN(A,B)  ((A)>(B) ? (B) : (A))
@@ -56,7 +60,11 @@ dxWorldProcessContext::dxWorldProcessContext():
     m_pmaStepperArenas(NULL),
     m_pswObjectsAllocWorld(NULL),
     m_pmgStepperMutexGroup(NULL),
-    m_pcwIslandsSteppingWait(NULL)
+    m_pcwIslandsSteppingWait(NULL),
+    m_pcwCooperativeSolvingWait(NULL),
+    m_aoCooperativeSolvingOwned(0),
+    m_prcCooperativeSolvingResources(NULL),
+    m_uiCooperativeSolvingCalls(0)
 {
     // Do nothing
 }
@@ -70,6 +78,7 @@ dxWorldProcessContext::~dxWorldProcessContext()
     {
         m_pswObjectsAllocWorld->FreeMutexGroup(m_pmgStepperMutexGroup);
         // m_pswObjectsAllocWorld->FreeThreadedCallWait(m_pcwIslandsSteppingWait); -- The stock call wait can not be freed
+        m_pswObjectsAllocWorld->FreeThreadedCallWait(m_pcwCooperativeSolvingWait);
     }
 
     dxWorldProcessMemArena *pmaStepperArenas = m_pmaStepperArenas;
@@ -82,6 +91,8 @@ dxWorldProcessContext::~dxWorldProcessContext()
     {
         dxWorldProcessMemArena::FreeMemArena(m_pmaIslandsArena);
     }
+
+    delete m_prcCooperativeSolvingResources;
 }
 
 void dxWorldProcessContext::CleanupWorldReferences(dxWorld *pswWorldInstance)
@@ -89,17 +100,60 @@ void dxWorldProcessContext::CleanupWorldReferences(dxWorld *pswWorldInstance)
     dIASSERT((m_pswObjectsAllocWorld != NULL) == (m_pmgStepperMutexGroup != NULL));
     dIASSERT((m_pswObjectsAllocWorld != NULL) == (m_pcwIslandsSteppingWait != NULL));
 
+    // The resources refer to the threading and to the call wait that may be about to change
+    if (m_prcCooperativeSolvingResources != NULL)
+    {
+        m_prcCooperativeSolvingResources->freeResources();
+        m_uiCooperativeSolvingCalls = 0;
+    }
+
     if (m_pswObjectsAllocWorld == pswWorldInstance)
     {
         m_pswObjectsAllocWorld->FreeMutexGroup(m_pmgStepperMutexGroup);
         // m_pswObjectsAllocWorld->FreeThreadedCallWait(m_pcwIslandsSteppingWait); -- The stock call wait can not be freed
+        m_pswObjectsAllocWorld->FreeThreadedCallWait(m_pcwCooperativeSolvingWait);
 
         m_pswObjectsAllocWorld = NULL;
         m_pmgStepperMutexGroup = NULL;
         m_pcwIslandsSteppingWait = NULL;
+        m_pcwCooperativeSolvingWait = NULL;
     }
 }
 
+dxRequiredResourceContainer *dxWorldProcessContext::ObtainCooperativeSolvingResources(const dxResourceRequirementDescriptor &requirementDescriptor)
+{
+    dIASSERT(m_aoCooperativeSolvingOwned != 0);
+
+    dxRequiredResourceContainer *prcResources = m_prcCooperativeSolvingResources;
+    if (prcResources == NULL)
+    {
+        prcResources = m_prcCooperativeSolvingResources = new dxRequiredResourceContainer();
+    }
+
+    unsigned uiAlignmentRequirement = requirementDescriptor.getMemoryAlignmentRequirement();
+    bool bResourcesFit = prcResources->getThreadingInstance() == requirementDescriptor.getrelatedThreading()
+        && prcResources->getMemoryBufferSize() >= requirementDescriptor.getMemorySizeRequirement()
+        && (uiAlignmentRequirement == 0 || (sizeint)prcResources->getMemoryBufferPointer() % uiAlignmentRequirement == 0)
+        && m_uiCooperativeSolvingCalls >= requirementDescriptor.getSimultaneousCallRequirement();
+
+    if (!bResourcesFit)
+    {
+        prcResources->freeResources();
+        m_uiCooperativeSolvingCalls = 0;
+
+        if (prcResources->allocateResources(requirementDescriptor, m_pcwCooperativeSolvingWait))
+        {
+            m_uiCooperativeSolvingCalls = requirementDescriptor.getSimultaneousCallRequirement();
+        }
+        else
+        {
+            prcResources = NULL;
+        }
+    }
+
+    return prcResources;
+}
+
 bool dxWorldProcessContext::EnsureStepperSyncObjectsAreAllocated(dxWorld *pswWorldInstance)
 {
     dIASSERT((m_pswObjectsAllocWorld != NULL) == (m_pmgStepperMutexGroup != NULL));
@@ -128,9 +182,16 @@ bool dxWorldProcessContext::EnsureStepperSyncObjectsAreAllocated(dxWorld *pswWor
                 break;
             }
 
+            dCallWaitID pcwCooperativeSolvingWait = pswWorldInstance->AllocThreadedCallWait();
+            if (pcwCooperativeSolvingWait == NULL)
+            {
+                break;
+            }
+
             m_pswObjectsAllocWorld = pswWorldInstance;
             m_pmgStepperMutexGroup = pmbStepperMutexGroup;
             m_pcwIslandsSteppingWait = pcwIslandsSteppingWait;
+            m_pcwCooperativeSolvingWait = pcwCooperativeSolvingWait;
         }
 
         bResult = true;
@@ -383,26 +444,18 @@ struct dxSingleIslandCallContext
     dxSingleIslandCallContext(dxIslandsProcessingCallContext *islandsProcessingContext, 
         dxWorldProcessMemArena *stepperArena, void *arenaInitialState, 
         dxBody *const *islandBodiesStart, dxJoint *const *islandJointsStart):
-        m_islandsProcessingContext(islandsProcessingContext), m_islandIndex(0), 
+        m_islandsProcessingContext(islandsProcessingContext), 
         m_stepperArena(stepperArena), m_arenaInitialState(arenaInitialState), 
         m_stepperCallContext(islandsProcessingContext->m_world, islandsProcessingContext->m_stepSize, islandsProcessingContext->m_stepperAllowedThreads, stepperArena, islandBodiesStart, islandJointsStart)
     {
     }
 
-    void AssignIslandSearchProgress(sizeint islandIndex)
-    {
-        m_islandIndex = islandIndex; 
-    }
-
     void AssignIslandSelection(dxBody *const *islandBodiesStart, dxJoint *const *islandJointsStart, 
         unsigned islandBodiesCount, unsigned islandJointsCount)
     {
         m_stepperCallContext.AssignIslandSelection(islandBodiesStart, islandJointsStart, islandBodiesCount, islandJointsCount);
     }
 
-    dxBody *const *GetSelectedIslandBodiesEnd() const { return m_stepperCallContext.GetSelectedIslandBodiesEnd(); }
-    dxJoint *const *GetSelectedIslandJointsEnd() const { return m_stepperCallContext.GetSelectedIslandJointsEnd(); }
-    
     void RestoreSavedMemArenaStateForStepper()
     {
         m_stepperArena->RestoreState(m_arenaInitialState);
@@ -414,7 +467,6 @@ struct dxSingleIslandCallContext
     }
 
     dxIslandsProcessingCallContext  *m_islandsProcessingContext;
-    sizeint                          m_islandIndex;
     dxWorldProcessMemArena          *m_stepperArena;
     void                            *m_arenaInitialState;
     dxStepperProcessingCallContext  m_stepperCallContext;
@@ -424,140 +476,237 @@ struct dxSingleIslandCallContext
 //****************************************************************************
 // Auto disabling
 
-void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
+// the auto-disable candidates are sampled and tested in blocks of this many bodies
+#define dxAUTODISABLE_BODY_BLOCK_SIZE 64U
+
+// sample the velocities of an auto-disable candidate body and update its idle
+// countdowns. returns true if the body has been idle long enough to be disabled.
+// only the body's own state is touched, so the bodies may be processed in parallel.
+
+static bool sampleBodyIdleness (dxBody *bb, dReal stepsize)
 {
-    dxBody *bb;
-    for ( bb=world->firstbody; bb; bb=(dxBody*)bb->next )
+    //
+    // see if the body is idle
+    //
+
+#ifndef dNODEBUG
+    // sanity check
+    if ( bb->average_counter >= bb->adis.average_samples )
     {
-        // don't freeze objects mid-air (patch 1586738)
-        if ( bb->firstjoint == NULL ) continue;
+        dUASSERT( bb->average_counter < bb->adis.average_samples, "buffer overflow" );
 
-        // nothing to do unless this body is currently enabled and has
-        // the auto-disable flag set
-        if ( (bb->flags & (dxBodyAutoDisable|dxBodyDisabled)) != dxBodyAutoDisable ) continue;
+        // something is going wrong, reset the average-calculations
+        bb->average_ready = 0; // not ready for average calculation
+        bb->average_counter = 0; // reset the buffer index
+    }
+#endif // dNODEBUG
 
-        // if sampling / threshold testing is disabled, we can never sleep.
-        if ( bb->adis.average_samples == 0 ) continue;
+    // sample the linear and angular velocity
+    bb->average_lvel_buffer[bb->average_counter][0] = bb->lvel[0];
+    bb->average_lvel_buffer[bb->average_counter][1] = bb->lvel[1];
+    bb->average_lvel_buffer[bb->average_counter][2] = bb->lvel[2];
+    bb->average_avel_buffer[bb->average_counter][0] = bb->avel[0];
+    bb->average_avel_buffer[bb->average_counter][1] = bb->avel[1];
+    bb->average_avel_buffer[bb->average_counter][2] = bb->avel[2];
+    bb->average_counter++;
+
+    // buffer ready test
+    if ( bb->average_counter >= bb->adis.average_samples )
+    {
+        bb->average_counter = 0; // fill the buffer from the beginning
+        bb->average_ready = 1; // this body is ready now for average calculation
+    }
 
-        //
-        // see if the body is idle
-        //
+    int idle = 0; // Assume it's in motion unless we have samples to disprove it.
 
-#ifndef dNODEBUG
-        // sanity check
-        if ( bb->average_counter >= bb->adis.average_samples )
+    // enough samples?
+    if ( bb->average_ready )
+    {
+        idle = 1; // Initial assumption: IDLE
+
+        // the sample buffers are filled and ready for calculation
+        dVector3 average_lvel, average_avel;
+
+        // Store first velocity samples
+        average_lvel[0] = bb->average_lvel_buffer[0][0];
+        average_avel[0] = bb->average_avel_buffer[0][0];
+        average_lvel[1] = bb->average_lvel_buffer[0][1];
+        average_avel[1] = bb->average_avel_buffer[0][1];
+        average_lvel[2] = bb->average_lvel_buffer[0][2];
+        average_avel[2] = bb->average_avel_buffer[0][2];
+
+        // If we're not in "instantaneous mode"
+        if ( bb->adis.average_samples > 1 )
         {
-            dUASSERT( bb->average_counter < bb->adis.average_samples, "buffer overflow" );
+            // add remaining velocities together
+            for ( unsigned int i = 1; i < bb->adis.average_samples; ++i )
+            {
+                average_lvel[0] += bb->average_lvel_buffer[i][0];
+                average_avel[0] += bb->average_avel_buffer[i][0];
+                average_lvel[1] += bb->average_lvel_buffer[i][1];
+                average_avel[1] += bb->average_avel_buffer[i][1];
+                average_lvel[2] += bb->average_lvel_buffer[i][2];
+                average_avel[2] += bb->average_avel_buffer[i][2];
+            }
+
+            // make average
+            dReal r1 = dReal( 1.0 ) / dReal( bb->adis.average_samples );
 
-            // something is going wrong, reset the average-calculations
-            bb->average_ready = 0; // not ready for average calculation
-            bb->average_counter = 0; // reset the buffer index
+            average_lvel[0] *= r1;
+            average_avel[0] *= r1;
+            average_lvel[1] *= r1;
+            average_avel[1] *= r1;
+            average_lvel[2] *= r1;
+            average_avel[2] *= r1;
         }
-#endif // dNODEBUG
 
-        // sample the linear and angular velocity
-        bb->average_lvel_buffer[bb->average_counter][0] = bb->lvel[0];
-        bb->average_lvel_buffer[bb->average_counter][1] = bb->lvel[1];
-        bb->average_lvel_buffer[bb->average_counter][2] = bb->lvel[2];
-        bb->average_avel_buffer[bb->average_counter][0] = bb->avel[0];
-        bb->average_avel_buffer[bb->average_counter][1] = bb->avel[1];
-        bb->average_avel_buffer[bb->average_counter][2] = bb->avel[2];
-        bb->average_counter++;
-
-        // buffer ready test
-        if ( bb->average_counter >= bb->adis.average_samples )
+        // threshold test
+        dReal av_lspeed, av_aspeed;
+        av_lspeed = dCalcVectorDot3( average_lvel, average_lvel );
+        if ( av_lspeed > bb->adis.linear_average_threshold )
+        {
+            idle = 0; // average linear velocity is too high for idle
+        }
+        else
         {
-            bb->average_counter = 0; // fill the buffer from the beginning
-            bb->average_ready = 1; // this body is ready now for average calculation
+            av_aspeed = dCalcVectorDot3( average_avel, average_avel );
+            if ( av_aspeed > bb->adis.angular_average_threshold )
+            {
+                idle = 0; // average angular velocity is too high for idle
+            }
         }
+    }
+
+    // if it's idle, accumulate steps and time.
+    // these counters won't overflow because this code doesn't run for disabled bodies.
+    if (idle) {
+        bb->adis_stepsleft--;
+        bb->adis_timeleft -= stepsize;
+    }
+    else {
+        // Reset countdowns
+        bb->adis_stepsleft = bb->adis.idle_steps;
+        bb->adis_timeleft = bb->adis.idle_time;
+    }
+
+    return bb->adis_stepsleft <= 0 && bb->adis_timeleft <= 0;
+}
 
-        int idle = 0; // Assume it's in motion unless we have samples to disprove it.
+struct dxAutoDisablingCallContext {
+    dxBody *const *candidates;
+    unsigned char *disable;     // the sampling results by candidate index
+    unsigned candidate_count;
+    unsigned block_count;
+    volatile atomicord32 block_progress;
+    dReal stepsize;
+};
+
+static void sampleCandidateBlocks (dxAutoDisablingCallContext *context)
+{
+    const unsigned candidate_count = context->candidate_count;
+    const unsigned block_count = context->block_count;
+
+    unsigned block_index;
+    while ((block_index = ThrsafeIncrementIntUpToLimit(&context->block_progress, block_count)) != block_count) {
+        unsigned index = block_index * dxAUTODISABLE_BODY_BLOCK_SIZE;
+        unsigned limit = dMACRO_MIN(index + dxAUTODISABLE_BODY_BLOCK_SIZE, candidate_count);
+        for (; index != limit; ++index) {
+            context->disable[index] = sampleBodyIdleness (context->candidates[index], context->stepsize);
+        }
+    }
+}
 
-        // enough samples?
-        if ( bb->average_ready )
+static 
+int autoDisablingWorkerCallback (void *call_context, dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    sampleCandidateBlocks ((dxAutoDisablingCallContext *)call_context);
+    return 1;
+}
+
+static 
+int autoDisablingCompletionCallback (void *dUNUSED(call_context), dcallindex_t dUNUSED(instance_index), dCallReleaseeID dUNUSED(this_releasee))
+{
+    return 1;
+}
+
+// the candidate bodies are collected from the awake list first. their sampling
+// and threshold tests are independent and run in blocks on the world's threading
+// implementation; the bodies found idle are disabled afterwards, in the list order.
+
+static void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize, dxWorldProcessMemArena *memarena)
+{
+    dxStepProfileScope profileScope(world->step_profile, dStepProfileStageAutoDisable);
+
+    BEGIN_STATE_SAVE(memarena, candidatesstate) {
+        dxBody **candidates = memarena->AllocateArray<dxBody *>(world->nb);
+        unsigned candidate_count = 0;
+
+        for (dxBody *bb=world->firstawakebody; bb; bb=bb->awake_next)
         {
-            idle = 1; // Initial assumption: IDLE
+            // don't freeze objects mid-air (patch 1586738)
+            if ( bb->firstjoint == NULL ) continue;
 
-            // the sample buffers are filled and ready for calculation
-            dVector3 average_lvel, average_avel;
+            // nothing to do unless this body is currently enabled and has
+            // the auto-disable flag set
+            if ( (bb->flags & (dxBodyAutoDisable|dxBodyDisabled)) != dxBodyAutoDisable ) continue;
 
-            // Store first velocity samples
-            average_lvel[0] = bb->average_lvel_buffer[0][0];
-            average_avel[0] = bb->average_avel_buffer[0][0];
-            average_lvel[1] = bb->average_lvel_buffer[0][1];
-            average_avel[1] = bb->average_avel_buffer[0][1];
-            average_lvel[2] = bb->average_lvel_buffer[0][2];
-            average_avel[2] = bb->average_avel_buffer[0][2];
+            // if sampling / threshold testing is disabled, we can never sleep.
+            if ( bb->adis.average_samples == 0 ) continue;
 
-            // If we're not in "instantaneous mode"
-            if ( bb->adis.average_samples > 1 )
-            {
-                // add remaining velocities together
-                for ( unsigned int i = 1; i < bb->adis.average_samples; ++i )
-                {
-                    average_lvel[0] += bb->average_lvel_buffer[i][0];
-                    average_avel[0] += bb->average_avel_buffer[i][0];
-                    average_lvel[1] += bb->average_lvel_buffer[i][1];
-                    average_avel[1] += bb->average_avel_buffer[i][1];
-                    average_lvel[2] += bb->average_lvel_buffer[i][2];
-                    average_avel[2] += bb->average_avel_buffer[i][2];
-                }
+            candidates[candidate_count++] = bb;
+        }
 
-                // make average
-                dReal r1 = dReal( 1.0 ) / dReal( bb->adis.average_samples );
+        if (candidate_count != 0) {
+            unsigned char *disable = memarena->AllocateArray<unsigned char>(candidate_count);
 
-                average_lvel[0] *= r1;
-                average_avel[0] *= r1;
-                average_lvel[1] *= r1;
-                average_avel[1] *= r1;
-                average_lvel[2] *= r1;
-                average_avel[2] *= r1;
-            }
+            dxAutoDisablingCallContext context;
+            context.candidates = candidates;
+            context.disable = disable;
+            context.candidate_count = candidate_count;
+            context.block_count = (candidate_count + (dxAUTODISABLE_BODY_BLOCK_SIZE - 1)) / dxAUTODISABLE_BODY_BLOCK_SIZE;
+            context.block_progress = 0;
+            context.stepsize = stepsize;
 
-            // threshold test
-            dReal av_lspeed, av_aspeed;
-            av_lspeed = dCalcVectorDot3( average_lvel, average_lvel );
-            if ( av_lspeed > bb->adis.linear_average_threshold )
-            {
-                idle = 0; // average linear velocity is too high for idle
+            unsigned thread_count = world->calculateThreadingLimitedThreadCount(world->islands_max_threads, true);
+            thread_count = dMACRO_MIN(thread_count, context.block_count);
+
+            dCallWaitID completion_wait = thread_count > 1 ? world->AllocateOrRetrieveStockCallWaitID() : NULL;
+
+            if (completion_wait != NULL && world->PreallocateResourcesForThreadedCalls(thread_count)) {
+                dCallReleaseeID completion_releasee;
+                world->PostThreadedCall(NULL, &completion_releasee, thread_count - 1, NULL, completion_wait, 
+                    &autoDisablingCompletionCallback, NULL, 0, "AutoDisabling Completion");
+                world->PostThreadedCallsGroup(NULL, thread_count - 1, completion_releasee, 
+                    &autoDisablingWorkerCallback, &context, "AutoDisabling Bodies");
+
+                sampleCandidateBlocks (&context);
+
+                world->WaitThreadedCallExclusively(NULL, completion_wait, NULL, "AutoDisabling End Wait");
             }
-            else
-            {
-                av_aspeed = dCalcVectorDot3( average_avel, average_avel );
-                if ( av_aspeed > bb->adis.angular_average_threshold )
-                {
-                    idle = 0; // average angular velocity is too high for idle
-                }
+            else {
+                sampleCandidateBlocks (&context);
             }
-        }
 
-        // if it's idle, accumulate steps and time.
-        // these counters won't overflow because this code doesn't run for disabled bodies.
-        if (idle) {
-            bb->adis_stepsleft--;
-            bb->adis_timeleft -= stepsize;
-        }
-        else {
-            // Reset countdowns
-            bb->adis_stepsleft = bb->adis.idle_steps;
-            bb->adis_timeleft = bb->adis.idle_time;
-        }
-
-        // disable the body if it's idle for a long enough time
-        if ( bb->adis_stepsleft <= 0 && bb->adis_timeleft <= 0 )
-        {
-            bb->flags |= dxBodyDisabled; // set the disable flag
-
-            // disabling bodies should also include resetting the velocity
-            // should prevent jittering in big "islands"
-            bb->lvel[0] = 0;
-            bb->lvel[1] = 0;
-            bb->lvel[2] = 0;
-            bb->avel[0] = 0;
-            bb->avel[1] = 0;
-            bb->avel[2] = 0;
+            for (unsigned i = 0; i != candidate_count; ++i)
+            {
+                if (!disable[i]) continue;
+
+                // disable the body if it's idle for a long enough time
+                dxBody *bb = candidates[i];
+                bb->flags |= dxBodyDisabled; // set the disable flag
+                world->removeAwakeBody(bb);
+
+                // disabling bodies should also include resetting the velocity
+                // should prevent jittering in big "islands"
+                bb->lvel[0] = 0;
+                bb->lvel[1] = 0;
+                bb->lvel[2] = 0;
+                bb->avel[0] = 0;
+                bb->avel[1] = 0;
+                bb->avel[2] = 0;
+            }
         }
-    }
+    } END_STATE_SAVE(memarena, candidatesstate);
 }
 
 
@@ -577,10 +726,10 @@ static inline dReal sinc (dReal x)
 }
 
 
-// given a body b, apply its linear and angular rotation over the time
-// interval h, thereby adjusting its position and orientation.
+// apply the linear and angular velocity of body b over the time interval h,
+// thereby adjusting its position and orientation.
 
-void dxStepBody (dxBody *b, dReal h)
+static void integrateBody (dxBody *b, dReal h)
 {
     // cap the angular velocity
     if (b->flags & dxBodyMaxAngularSpeed) {
@@ -658,15 +807,12 @@ void dxStepBody (dxBody *b, dReal h)
     // normalize the quaternion and convert it to a rotation matrix
     dNormalize4 (b->q);
     dQtoR (b->q,b->posr.R);
+}
 
-    // notify all attached geoms that this body has moved
-    dxWorldProcessContext *world_process_context = b->world->unsafeGetWorldProcessingContext(); 
-    for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom)) {
-        world_process_context->LockForStepbodySerialization();
-        dGeomMoved (geom);
-        world_process_context->UnlockForStepbodySerialization();
-    }
+// notify the user that body b has moved and apply its velocity damping.
 
+static void finishBodyStep (dxBody *b)
+{
     // notify the user
     if (b->moved_callback != NULL) {
         b->moved_callback(b);
@@ -692,6 +838,168 @@ void dxStepBody (dxBody *b, dReal h)
 }
 
 
+
+// given a body b, apply its linear and angular rotation over the time
+// interval h, thereby adjusting its position and orientation.
+
+void dxStepBody (dxBody *b, dReal h)
+{
+    integrateBody (b, h);
+
+    // notify all attached geoms that this body has moved
+    dxWorldProcessContext *world_process_context = b->world->unsafeGetWorldProcessingContext(); 
+    for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom)) {
+        world_process_context->LockForStepbodySerialization();
+        dGeomMoved (geom);
+        world_process_context->UnlockForStepbodySerialization();
+    }
+
+    finishBodyStep (b);
+}
+
+
+#if defined(dSIMD_ENABLED)
+
+// integrate dSIMD_LANE_COUNT bodies with the plain infinitesimal rotation.
+// the fields are gathered into lanes, the arithmetics mirror the scalar
+// dWtoDQ(), dNormalize4() and dQtoR() operation for operation and the
+// results are scattered back. should any quaternion degenerate to zero
+// length, the scalar normalization handles the whole batch.
+
+static void integrateBodyLanes (dxBody *const *bodies, dReal h)
+{
+    dReal lanes[dSIMD_LANE_COUNT];
+    dxSIMDLanes q[4], w[3];
+
+    for (unsigned int j = 0; j != 3; ++j) {
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) lanes[l] = bodies[l]->posr.pos[j];
+        dxSIMDLanes pos = dxSIMDLoadLanes(lanes);
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) lanes[l] = bodies[l]->lvel[j];
+        pos = dxSIMDAddLanes(pos, dxSIMDMulLanes(dxSIMDSetLanes(h), dxSIMDLoadLanes(lanes)));
+        dxSIMDStoreLanes(lanes, pos);
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) bodies[l]->posr.pos[j] = lanes[l];
+
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) lanes[l] = bodies[l]->avel[j];
+        w[j] = dxSIMDLoadLanes(lanes);
+    }
+    for (unsigned int j = 0; j != 4; ++j) {
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) lanes[l] = bodies[l]->q[j];
+        q[j] = dxSIMDLoadLanes(lanes);
+    }
+
+    // dq = dWtoDQ(w, q), q += h * dq
+    const dxSIMDLanes half = dxSIMDSetLanes(REAL(0.5)), vh = dxSIMDSetLanes(h);
+    dxSIMDLanes dq[4];
+    dq[0] = dxSIMDMulLanes(half, dxSIMDSubLanes(dxSIMDSubLanes(dxSIMDMulLanes(dxSIMDNegLanes(w[0]), q[1]), dxSIMDMulLanes(w[1], q[2])), dxSIMDMulLanes(w[2], q[3])));
+    dq[1] = dxSIMDMulLanes(half, dxSIMDSubLanes(dxSIMDAddLanes(dxSIMDMulLanes(w[0], q[0]), dxSIMDMulLanes(w[1], q[3])), dxSIMDMulLanes(w[2], q[2])));
+    dq[2] = dxSIMDMulLanes(half, dxSIMDAddLanes(dxSIMDAddLanes(dxSIMDMulLanes(dxSIMDNegLanes(w[0]), q[3]), dxSIMDMulLanes(w[1], q[0])), dxSIMDMulLanes(w[2], q[1])));
+    dq[3] = dxSIMDMulLanes(half, dxSIMDAddLanes(dxSIMDSubLanes(dxSIMDMulLanes(w[0], q[2]), dxSIMDMulLanes(w[1], q[1])), dxSIMDMulLanes(w[2], q[0])));
+    for (unsigned int j = 0; j != 4; ++j) q[j] = dxSIMDAddLanes(q[j], dxSIMDMulLanes(vh, dq[j]));
+
+    dxSIMDLanes len = dxSIMDAddLanes(dxSIMDAddLanes(dxSIMDAddLanes(dxSIMDMulLanes(q[0], q[0]), dxSIMDMulLanes(q[1], q[1])), dxSIMDMulLanes(q[2], q[2])), dxSIMDMulLanes(q[3], q[3]));
+    if (!dxSIMDAllLanesPositive(len)) {
+        for (unsigned int j = 0; j != 4; ++j) {
+            dxSIMDStoreLanes(lanes, q[j]);
+            for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) bodies[l]->q[j] = lanes[l];
+        }
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) {
+            dNormalize4 (bodies[l]->q);
+            dQtoR (bodies[l]->q, bodies[l]->posr.R);
+        }
+        return;
+    }
+
+    const dxSIMDLanes one = dxSIMDSetLanes(REAL(1.0)), two = dxSIMDSetLanes(REAL(2.0));
+    len = dxSIMDDivLanes(one, dxSIMDSqrtLanes(len));
+    for (unsigned int j = 0; j != 4; ++j) {
+        q[j] = dxSIMDMulLanes(q[j], len);
+        dxSIMDStoreLanes(lanes, q[j]);
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) bodies[l]->q[j] = lanes[l];
+    }
+
+    // R = dQtoR(q)
+    dxSIMDLanes R[12];
+    const dxSIMDLanes qq1 = dxSIMDMulLanes(dxSIMDMulLanes(two, q[1]), q[1]);
+    const dxSIMDLanes qq2 = dxSIMDMulLanes(dxSIMDMulLanes(two, q[2]), q[2]);
+    const dxSIMDLanes qq3 = dxSIMDMulLanes(dxSIMDMulLanes(two, q[3]), q[3]);
+    R[0] = dxSIMDSubLanes(dxSIMDSubLanes(one, qq2), qq3);
+    R[1] = dxSIMDMulLanes(two, dxSIMDSubLanes(dxSIMDMulLanes(q[1], q[2]), dxSIMDMulLanes(q[0], q[3])));
+    R[2] = dxSIMDMulLanes(two, dxSIMDAddLanes(dxSIMDMulLanes(q[1], q[3]), dxSIMDMulLanes(q[0], q[2])));
+    R[4] = dxSIMDMulLanes(two, dxSIMDAddLanes(dxSIMDMulLanes(q[1], q[2]), dxSIMDMulLanes(q[0], q[3])));
+    R[5] = dxSIMDSubLanes(dxSIMDSubLanes(one, qq1), qq3);
+    R[6] = dxSIMDMulLanes(two, dxSIMDSubLanes(dxSIMDMulLanes(q[2], q[3]), dxSIMDMulLanes(q[0], q[1])));
+    R[8] = dxSIMDMulLanes(two, dxSIMDSubLanes(dxSIMDMulLanes(q[1], q[3]), dxSIMDMulLanes(q[0], q[2])));
+    R[9] = dxSIMDMulLanes(two, dxSIMDAddLanes(dxSIMDMulLanes(q[2], q[3]), dxSIMDMulLanes(q[0], q[1])));
+    R[10] = dxSIMDSubLanes(dxSIMDSubLanes(one, qq1), qq2);
+    for (unsigned int j = 0; j != 12; ++j) {
+        if ((j & 3) == 3) {
+            for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) bodies[l]->posr.R[j] = REAL(0.0);
+            continue;
+        }
+        dxSIMDStoreLanes(lanes, R[j]);
+        for (unsigned int l = 0; l != dSIMD_LANE_COUNT; ++l) bodies[l]->posr.R[j] = lanes[l];
+    }
+}
+
+#endif // #if defined(dSIMD_ENABLED)
+
+
+// step a batch of bodies the way dxStepBody() does for each of them.
+// the bodies using the plain infinitesimal rotation are integrated in SIMD
+// lanes; the attached geoms are marked as moved in a single serialized
+// pass before the user callbacks and the damping are applied.
+
+void dxStepBodies (dxBody *const *bodies, unsigned int count, dReal h)
+{
+#if defined(dSIMD_ENABLED)
+    dxBody *lane_bodies[dSIMD_LANE_COUNT];
+    unsigned int lane_count = 0;
+
+    for (unsigned int i = 0; i != count; ++i) {
+        dxBody *b = bodies[i];
+        if ((b->flags & (dxBodyMaxAngularSpeed | dxBodyFlagFiniteRotation)) != 0) {
+            integrateBody (b, h);
+            continue;
+        }
+        lane_bodies[lane_count++] = b;
+        if (lane_count == dSIMD_LANE_COUNT) {
+            integrateBodyLanes (lane_bodies, h);
+            lane_count = 0;
+        }
+    }
+    for (unsigned int i = 0; i != lane_count; ++i) {
+        integrateBody (lane_bodies[i], h);
+    }
+#else
+    for (unsigned int i = 0; i != count; ++i) {
+        integrateBody (bodies[i], h);
+    }
+#endif
+
+    // notify all attached geoms that the bodies have moved
+    dxWorldProcessContext *world_process_context = NULL;
+    for (unsigned int i = 0; i != count; ++i) {
+        dxBody *b = bodies[i];
+        if (b->geom != NULL) {
+            if (world_process_context == NULL) {
+                world_process_context = b->world->unsafeGetWorldProcessingContext();
+                world_process_context->LockForStepbodySerialization();
+            }
+            for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom)) {
+                dGeomMoved (geom);
+            }
+        }
+    }
+    if (world_process_context != NULL) {
+        world_process_context->UnlockForStepbodySerialization();
+    }
+
+    for (unsigned int i = 0; i != count; ++i) {
+        finishBodyStep (bodies[i]);
+    }
+}
+
+
 //****************************************************************************
 // island processing
 
@@ -699,18 +1007,65 @@ enum dxISLANDSIZESELEMENT
 {
     dxISE_BODIES_COUNT,
     dxISE_JOINTS_COUNT,
+    dxISE_BODIES_START, // island offset in the bodies array
+    dxISE_JOINTS_START, // island offset in the joints array
 
     dxISE__MAX
 };
 
+// Islands are processed largest first so that a big island does not get started 
+// last and keep a single thread busy while the others have nothing to do.
+// The cost is estimated as joints (a substitute for the constraint rows which 
+// are not known yet) times bodies.
+static sizeint EstimateIslandCost(unsigned int const *sizes)
+{
+    return (sizeint)sizes[dxISE_BODIES_COUNT] * ((sizeint)sizes[dxISE_JOINTS_COUNT] + 1);
+}
+
+struct dxIslandCostGreater
+{
+    explicit dxIslandCostGreater(unsigned int const *islandsizes): m_islandsizes(islandsizes) {}
+
+    bool operator ()(unsigned int island1, unsigned int island2) const
+    {
+        sizeint cost1 = EstimateIslandCost(m_islandsizes + (sizeint)island1 * dxISE__MAX);
+        sizeint cost2 = EstimateIslandCost(m_islandsizes + (sizeint)island2 * dxISE__MAX);
+        // Order the equal cost islands by index to keep the order deterministic
+        return cost1 != cost2 ? cost1 > cost2 : island1 < island2;
+    }
+
+    unsigned int const *m_islandsizes;
+};
+
+// Starts a new island building pass. Objects whose island_epoch equals the value 
+// returned have been visited (and tagged) during this pass; the tags of all the other 
+// objects are stale. This replaces resetting the tags of all the world objects 
+// which would make the sleeping bodies cost time on each step.
+static unsigned AdvanceIslandEpoch(dxWorld *world)
+{
+    unsigned epoch = ++world->island_epoch;
+
+    if (epoch == 0) {
+        // On wrap-around, reset the objects to make sure no stale epoch matches by accident
+        for (dxBody *b=world->firstbody; b; b=(dxBody*)b->next) b->island_epoch = 0;
+        for (dxJoint *j=world->firstjoint; j; j=(dxJoint*)j->next) j->island_epoch = 0;
+        epoch = world->island_epoch = 1;
+    }
+
+    return epoch;
+}
+
 // This estimates dynamic memory requirements for dxProcessIslands
 static sizeint EstimateIslandProcessingMemoryRequirements(dxWorld *world)
 {
     sizeint res = 0;
 
-    sizeint islandcounts = dEFFICIENT_SIZE((sizeint)(unsigned)world->nb * 2 * sizeof(int));
+    sizeint islandcounts = dEFFICIENT_SIZE((sizeint)(unsigned)world->nb * dxISE__MAX * sizeof(int));
     res += islandcounts;
 
+    sizeint islandorder = dEFFICIENT_SIZE((sizeint)(unsigned)world->nb * sizeof(int));
+    res += islandorder;
+
     sizeint bodiessize = dEFFICIENT_SIZE((sizeint)(unsigned)world->nb * sizeof(dxBody*));
     sizeint jointssize = dEFFICIENT_SIZE((sizeint)(unsigned)world->nj * sizeof(dxJoint*));
     res += bodiessize + jointssize;
@@ -718,6 +1073,10 @@ static sizeint EstimateIslandProcessingMemoryRequirements(dxWorld *world)
     sizeint sesize = (bodiessize < jointssize) ? bodiessize : jointssize;
     res += sesize;
 
+    // the auto-disabling arrays are released before the islands are built
+    sizeint autodisabling = dEFFICIENT_SIZE((sizeint)(unsigned)world->nb * sizeof(dxBody*)) + dEFFICIENT_SIZE((sizeint)(unsigned)world->nb);
+    res = dMACRO_MAX(res, autodisabling);
+
     return res;
 }
 
@@ -728,16 +1087,21 @@ static sizeint BuildIslandsAndEstimateStepperMemoryRequirements(
     sizeint maxreq = 0;
 
     // handle auto-disabling of bodies
-    dInternalHandleAutoDisabling (world,stepsize);
+    dInternalHandleAutoDisabling (world,stepsize,memarena);
+
+    dxStepProfileScope profileScope(world->step_profile, dStepProfileStageIslandBuild);
 
     unsigned int nb = world->nb, nj = world->nj;
-    // Make array for island body/joint counts
-    unsigned int *islandsizes = memarena->AllocateArray<unsigned int>(2 * (sizeint)nb);
+    // Make array for island body/joint counts and offsets
+    unsigned int *islandsizes = memarena->AllocateArray<unsigned int>(dxISE__MAX * (sizeint)nb);
     unsigned int *sizescurr;
+    // Make array for island processing order
+    unsigned int *islandorder = memarena->AllocateArray<unsigned int>(nb);
 
     // make arrays for body and joint lists (for a single island) to go into
     dxBody **body = memarena->AllocateArray<dxBody *>(nb);
     dxJoint **joint = memarena->AllocateArray<dxJoint *>(nj);
+    sizeint jointcount;
 
     BEGIN_STATE_SAVE(memarena, stackstate) {
         // allocate a stack of unvisited bodies in the island. the maximum size of
@@ -747,83 +1111,92 @@ static sizeint BuildIslandsAndEstimateStepperMemoryRequirements(
         unsigned int stackalloc = (nj < nb) ? nj : nb;
         dxBody **stack = memarena->AllocateArray<dxBody *>(stackalloc);
 
-        {
-            // set all body/joint tags to 0
-            for (dxBody *b=world->firstbody; b; b=(dxBody*)b->next) b->tag = 0;
-            for (dxJoint *j=world->firstjoint; j; j=(dxJoint*)j->next) j->tag = 0;
-        }
+        // instead of clearing all the tags, a new epoch is started: only objects 
+        // with the current epoch are considered tagged.
+        const unsigned epoch = AdvanceIslandEpoch(world);
 
         sizescurr = islandsizes;
         dxBody **bodystart = body;
         dxJoint **jointstart = joint;
-        for (dxBody *bb=world->firstbody; bb; bb=(dxBody*)bb->next) {
-            // get bb = the next enabled, untagged body, and tag it
-            if (!bb->tag) {
-                if (!(bb->flags & dxBodyDisabled)) {
-                    bb->tag = 1;
-
-                    dxBody **bodycurr = bodystart;
-                    dxJoint **jointcurr = jointstart;
-
-                    // tag all bodies and joints starting from bb.
-                    *bodycurr++ = bb;
-
-                    unsigned int stacksize = 0;
-                    dxBody *b = bb;
-
-                    while (true) {
-                        // traverse and tag all body's joints, add untagged connected bodies
-                        // to stack
-                        for (dxJointNode *n=b->firstjoint; n; n=n->next) {
-                            dxJoint *njoint = n->joint;
-                            if (!njoint->tag) {
-                                if (njoint->isEnabled()) {
-                                    njoint->tag = 1;
-                                    *jointcurr++ = njoint;
-
-                                    dxBody *nbody = n->body;
-                                    // Body disabled flag is not checked here. This is how auto-enable works.
-                                    if (nbody && nbody->tag <= 0) {
-                                        nbody->tag = 1;
-                                        // Make sure all bodies are in the enabled state.
+        // islands are only searched from the awake bodies. The bodies woken up 
+        // during the search are inserted at the list head and thus are not iterated.
+        for (dxBody *bb=world->firstawakebody; bb; bb=bb->awake_next) {
+            dIASSERT(!(bb->flags & dxBodyDisabled));
+
+            // get bb = the next untagged body, and tag it
+            if (bb->island_epoch != epoch) {
+                bb->island_epoch = epoch;
+                bb->tag = 1;
+
+                dxBody **bodycurr = bodystart;
+                dxJoint **jointcurr = jointstart;
+
+                // tag all bodies and joints starting from bb.
+                *bodycurr++ = bb;
+
+                unsigned int stacksize = 0;
+                dxBody *b = bb;
+
+                while (true) {
+                    // traverse and tag all body's joints, add untagged connected bodies
+                    // to stack
+                    for (dxJointNode *n=b->firstjoint; n; n=n->next) {
+                        dxJoint *njoint = n->joint;
+                        if (njoint->island_epoch != epoch) {
+                            njoint->island_epoch = epoch;
+
+                            if (njoint->isEnabled()) {
+                                njoint->tag = 1;
+                                *jointcurr++ = njoint;
+
+                                dxBody *nbody = n->body;
+                                // Body disabled flag is not checked here. This is how auto-enable works.
+                                if (nbody && nbody->island_epoch != epoch) {
+                                    nbody->island_epoch = epoch;
+                                    nbody->tag = 1;
+                                    // Make sure all bodies are in the enabled state.
+                                    if (nbody->flags & dxBodyDisabled) {
                                         nbody->flags &= ~dxBodyDisabled;
-                                        stack[stacksize++] = nbody;
+                                        world->addAwakeBody(nbody);
                                     }
-                                } else {
-                                    njoint->tag = -1; // Used in Step to prevent search over disabled joints (not needed for QuickStep so far)
+                                    stack[stacksize++] = nbody;
                                 }
+                            } else {
+                                njoint->tag = -1; // Used in Step to prevent search over disabled joints (not needed for QuickStep so far)
                             }
                         }
-                        dIASSERT(stacksize <= (unsigned int)world->nb);
-                        dIASSERT(stacksize <= (unsigned int)world->nj);
-
-                        if (stacksize == 0) {
-                            break;
-                        }
+                    }
+                    dIASSERT(stacksize <= (unsigned int)world->nb);
+                    dIASSERT(stacksize <= (unsigned int)world->nj);
 
-                        b = stack[--stacksize];	// pop body off stack
-                        *bodycurr++ = b;	// put body on body list
+                    if (stacksize == 0) {
+                        break;
                     }
 
-                    unsigned int bcount = (unsigned int)(bodycurr - bodystart);
-                    unsigned int jcount = (unsigned int)(jointcurr - jointstart);
-                    dIASSERT((sizeint)(bodycurr - bodystart) <= (sizeint)UINT_MAX);
-                    dIASSERT((sizeint)(jointcurr - jointstart) <= (sizeint)UINT_MAX);
+                    b = stack[--stacksize];	// pop body off stack
+                    *bodycurr++ = b;	// put body on body list
+                }
+
+                unsigned int bcount = (unsigned int)(bodycurr - bodystart);
+                unsigned int jcount = (unsigned int)(jointcurr - jointstart);
+                dIASSERT((sizeint)(bodycurr - bodystart) <= (sizeint)UINT_MAX);
+                dIASSERT((sizeint)(jointcurr - jointstart) <= (sizeint)UINT_MAX);
 
-                    sizescurr[dxISE_BODIES_COUNT] = bcount;
-                    sizescurr[dxISE_JOINTS_COUNT] = jcount;
-                    sizescurr += dxISE__MAX;
+                sizescurr[dxISE_BODIES_COUNT] = bcount;
+                sizescurr[dxISE_JOINTS_COUNT] = jcount;
+                sizescurr[dxISE_BODIES_START] = (unsigned int)(bodystart - body);
+                sizescurr[dxISE_JOINTS_START] = (unsigned int)(jointstart - joint);
+                sizescurr += dxISE__MAX;
 
-                    sizeint islandreq = stepperestimate(bodystart, bcount, jointstart, jcount);
-                    maxreq = (maxreq > islandreq) ? maxreq : islandreq;
+                sizeint islandreq = stepperestimate(bodystart, bcount, jointstart, jcount);
+                maxreq = (maxreq > islandreq) ? maxreq : islandreq;
 
-                    bodystart = bodycurr;
-                    jointstart = jointcurr;
-                } else {
-                    bb->tag = -1; // Not used so far (assigned to retain consistency with joints)
-                }
+                bodystart = bodycurr;
+                jointstart = jointcurr;
             }
         }
+
+        jointcount = (sizeint)(jointstart - joint);
     } END_STATE_SAVE(memarena, stackstate);
 
 # ifndef dNODEBUG
@@ -831,30 +1204,39 @@ static sizeint BuildIslandsAndEstimateStepperMemoryRequirements(
     // unconnected joints, and joints that are connected to disabled bodies)
     // were tagged.
     {
+        const unsigned epoch = world->island_epoch;
         for (dxBody *b=world->firstbody; b; b=(dxBody*)b->next) {
+            bool tagged = b->island_epoch == epoch && b->tag > 0;
             if (b->flags & dxBodyDisabled) {
-                if (b->tag > 0) dDebug (0,"disabled body tagged");
+                if (tagged) dDebug (0,"disabled body tagged");
+                if (b->isAwake()) dDebug (0,"disabled body in awake list");
             }
             else {
-                if (b->tag <= 0) dDebug (0,"enabled body not tagged");
+                if (!tagged) dDebug (0,"enabled body not tagged");
+                if (!b->isAwake()) dDebug (0,"enabled body not in awake list");
             }
         }
         for (dxJoint *j=world->firstjoint; j; j=(dxJoint*)j->next) {
+            bool tagged = j->island_epoch == epoch && j->tag > 0;
             if ( (( j->node[0].body && (j->node[0].body->flags & dxBodyDisabled)==0 ) ||
                 (j->node[1].body && (j->node[1].body->flags & dxBodyDisabled)==0) )
                 && 
                 j->isEnabled() ) {
-                    if (j->tag <= 0) dDebug (0,"attached enabled joint not tagged");
+                    if (!tagged) dDebug (0,"attached enabled joint not tagged");
             }
             else {
-                if (j->tag > 0) dDebug (0,"unattached or disabled joint tagged");
+                if (tagged) dDebug (0,"unattached or disabled joint tagged");
             }
         }
     }
 # endif
 
     sizeint islandcount = ((sizeint)(sizescurr - islandsizes) / dxISE__MAX);
-    islandsinfo.AssignInfo(islandcount, islandsizes, body, joint);
+
+    for (unsigned int i = 0; i != (unsigned int)islandcount; ++i) islandorder[i] = i;
+    std::sort(islandorder, islandorder + islandcount, dxIslandCostGreater(islandsizes));
+
+    islandsinfo.AssignInfo(islandcount, islandsizes, islandorder, body, joint, jointcount);
 
     return maxreq;
 }
@@ -997,46 +1379,33 @@ void dxIslandsProcessingCallContext::ThreadedProcessIslandSearch(dxSingleIslandC
     unsigned int const *islandSizes = islandsInfo.GetIslandSizes();
 
     const sizeint islandsCount = islandsInfo.GetIslandsCount();
-    sizeint islandToProcess = ObtainNextIslandToBeProcessed(islandsCount);
-
-    if (islandToProcess != islandsCount) {
-        // First time, the counts are zeros and on next passes, adding counts will skip island that has just been processed by stepper
-        dxBody *const *islandBodiesStart = stepperCallContext->GetSelectedIslandBodiesEnd();
-        dxJoint *const *islandJointsStart = stepperCallContext->GetSelectedIslandJointsEnd();
-        sizeint islandIndex = stepperCallContext->m_islandIndex;
+    sizeint orderToProcess = ObtainNextIslandToBeProcessed(islandsCount);
 
-        for (; ; ++islandIndex) {
-            unsigned int bcount = islandSizes[islandIndex * dxISE__MAX + dxISE_BODIES_COUNT];
-            unsigned int jcount = islandSizes[islandIndex * dxISE__MAX + dxISE_JOINTS_COUNT];
+    if (orderToProcess != islandsCount) {
+        // The islands are handed out in the order of decreasing cost.
+        // A job that runs out of islands finishes and its thread is free to execute
+        // the stage calls the steppers of the remaining (big) islands post.
+        sizeint islandIndex = islandsInfo.GetIslandOrder()[orderToProcess];
+        unsigned int const *sizes = islandSizes + islandIndex * dxISE__MAX;
 
-            if (islandIndex == islandToProcess) {
-                // Store selected island details
-                stepperCallContext->AssignIslandSelection(islandBodiesStart, islandJointsStart, bcount, jcount);
+        // Store selected island details
+        dxBody *const *islandBodiesStart = islandsInfo.GetBodiesArray() + sizes[dxISE_BODIES_START];
+        dxJoint *const *islandJointsStart = islandsInfo.GetJointsArray() + sizes[dxISE_JOINTS_START];
+        stepperCallContext->AssignIslandSelection(islandBodiesStart, islandJointsStart, sizes[dxISE_BODIES_COUNT], sizes[dxISE_JOINTS_COUNT]);
 
-                // Store next island index to continue search from
-                ++islandIndex;
-                stepperCallContext->AssignIslandSearchProgress(islandIndex);
+        // Restore saved stepper memory arena position
+        stepperCallContext->RestoreSavedMemArenaStateForStepper();
 
-                // Restore saved stepper memory arena position
-                stepperCallContext->RestoreSavedMemArenaStateForStepper();
+        dCallReleaseeID nextSearchReleasee;
 
-                dCallReleaseeID nextSearchReleasee;
+        // Summary fault flag may be omitted as any failures will automatically propagate to dependent releasee (i.e. to m_groupReleasee)
+        m_world->PostThreadedCallForUnawareReleasee(NULL, &nextSearchReleasee, 1, m_groupReleasee, NULL, 
+            &dxIslandsProcessingCallContext::ThreadedProcessIslandSearch_Callback, (void *)stepperCallContext, 0, "World Islands Stepping Selection");
 
-                // Summary fault flag may be omitted as any failures will automatically propagate to dependent releasee (i.e. to m_groupReleasee)
-                m_world->PostThreadedCallForUnawareReleasee(NULL, &nextSearchReleasee, 1, m_groupReleasee, NULL, 
-                    &dxIslandsProcessingCallContext::ThreadedProcessIslandSearch_Callback, (void *)stepperCallContext, 0, "World Islands Stepping Selection");
+        stepperCallContext->AssignStepperCallFinalReleasee(nextSearchReleasee);
 
-                stepperCallContext->AssignStepperCallFinalReleasee(nextSearchReleasee);
-
-                m_world->PostThreadedCall(NULL, NULL, 0, nextSearchReleasee, NULL, 
-                    &dxIslandsProcessingCallContext::ThreadedProcessIslandStepper_Callback, (void *)stepperCallContext, 0, "Island Stepping Job Start");
-
-                break;
-            }
-
-            islandBodiesStart += bcount;
-            islandJointsStart += jcount;
-        }
+        m_world->PostThreadedCall(NULL, NULL, 0, nextSearchReleasee, NULL, 
+            &dxIslandsProcessingCallContext::ThreadedProcessIslandStepper_Callback, (void *)stepperCallContext, 0, "Island Stepping Job Start");
     }
     else {
         finalizeJob = true;
@@ -1062,6 +1431,7 @@ int dxIslandsProcessingCallContext::ThreadedProcessIslandStepper_Callback(void *
 
 void dxIslandsProcessingCallContext::ThreadedProcessIslandStepper(dxSingleIslandCallContext *stepperCallContext)
 {
+    dxStepProfileScope profileScope(m_world->step_profile, dStepProfileStageIslandStepping);
     m_stepper(&stepperCallContext->m_stepperCallContext);
 }
 
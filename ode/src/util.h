@@ -25,12 +25,17 @@
 
 #include "objects.h"
 #include "common.h"
+#include "threadingutils.h"
+
+
+class dxResourceRequirementDescriptor;
+class dxRequiredResourceContainer;
 
 
 /* utility */
 
-void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize);
 void dxStepBody (dxBody *b, dReal h);
+void dxStepBodies (dxBody *const *bodies, unsigned int count, dReal h);
 
 
 struct dxWorldProcessMemoryManager:
@@ -207,6 +212,16 @@ public:
     bool EnsureStepperSyncObjectsAreAllocated(dxWorld *pswWorldInstance);
     dCallWaitID GetIslandsSteppingWait() const { return m_pcwIslandsSteppingWait; }
 
+    // The cooperative solving is performed within the island stepping calls and thus 
+    // can't use the stock call wait. Also, a thread blocks waiting for the cooperating ones, 
+    // so only a single island at a time is allowed to solve cooperatively.
+    dCallWaitID GetCooperativeSolvingWait() const { return m_pcwCooperativeSolvingWait; }
+    bool TryAcquiringCooperativeSolving() { return ThrsafeCompareExchange(&m_aoCooperativeSolvingOwned, 0, 1); }
+    void ReleaseCooperativeSolving() { dIASSERT(m_aoCooperativeSolvingOwned != 0); ThrsafeExchange(&m_aoCooperativeSolvingOwned, 0); }
+    // The resources are kept between the steps and only reallocated when the requirements grow.
+    // To be called with the cooperative solving acquired. Returns NULL if the allocation fails.
+    dxRequiredResourceContainer *ObtainCooperativeSolvingResources(const dxResourceRequirementDescriptor &requirementDescriptor);
+
 public:
     dxWorldProcessMemArena *ObtainStepperMemArena();
     void ReturnStepperMemArena(dxWorldProcessMemArena *pmaArenaInstance);
@@ -254,28 +269,38 @@ private:
     dxWorld                 *m_pswObjectsAllocWorld;
     dMutexGroupID           m_pmgStepperMutexGroup;
     dCallWaitID             m_pcwIslandsSteppingWait;
+    dCallWaitID             m_pcwCooperativeSolvingWait;
+    volatile atomicord32    m_aoCooperativeSolvingOwned;
+    dxRequiredResourceContainer *m_prcCooperativeSolvingResources;
+    unsigned                m_uiCooperativeSolvingCalls;
 };
 
 struct dxWorldProcessIslandsInfo
 {
-    void AssignInfo(sizeint islandcount, unsigned int const *islandsizes, dxBody *const *bodies, dxJoint *const *joints)
+    void AssignInfo(sizeint islandcount, unsigned int const *islandsizes, unsigned int const *islandorder, dxBody *const *bodies, dxJoint *const *joints, sizeint jointcount)
     {
         m_IslandCount = islandcount;
         m_pIslandSizes = islandsizes;
+        m_pIslandOrder = islandorder;
         m_pBodies = bodies;
         m_pJoints = joints;
+        m_JointCount = jointcount;
     }
 
     sizeint GetIslandsCount() const { return m_IslandCount; }
     unsigned int const *GetIslandSizes() const { return m_pIslandSizes; }
+    unsigned int const *GetIslandOrder() const { return m_pIslandOrder; } // Island indices in the order they are to be processed
     dxBody *const *GetBodiesArray() const { return m_pBodies; }
     dxJoint *const *GetJointsArray() const { return m_pJoints; }
+    sizeint GetJointsCount() const { return m_JointCount; } // The joints of all the islands
 
 private:
     sizeint                  m_IslandCount;
     unsigned int const      *m_pIslandSizes;
+    unsigned int const      *m_pIslandOrder;
     dxBody *const           *m_pBodies;
     dxJoint *const          *m_pJoints;
+    sizeint                  m_JointCount;
 };
 
 struct dxStepperProcessingCallContext
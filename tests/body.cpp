@@ -0,0 +1,177 @@
+/*************************************************************************
+  *                                                                       *
+  * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+  * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+  *                                                                       *
+  * This library is free software; you can redistribute it and/or         *
+  * modify it under the terms of EITHER:                                  *
+  *   (1) The GNU Lesser General Public License as published by the Free  *
+  *       Software Foundation; either version 2.1 of the License, or (at  *
+  *       your option) any later version. The text of the GNU Lesser      *
+  *       General Public License is included with this library in the     *
+  *       file LICENSE.TXT.                                               *
+  *   (2) The BSD-style license that is included with this library in     *
+  *       the file LICENSE-BSD.TXT.                                       *
+  *                                                                       *
+  * This library is distributed in the hope that it will be useful,       *
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+  * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+  *                                                                       *
+  *************************************************************************/
+
+////////////////////////////////////////////////////////////////////////////////
+// This file creates unit tests for the bulk body state and the body
+// auto-disabling functions found in:
+// ode/src/ode.cpp
+// ode/src/util.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <vector>
+#include <UnitTest++.h>
+#include <ode/ode.h>
+
+
+SUITE(BodyStates)
+{
+    TEST(test_dWorldBulkBodyStates)
+    {
+        const int bodyCount = 50;
+
+        dWorldID world = dWorldCreate();
+        for (int i = 0; i != bodyCount; ++i) {
+            dBodyID body = dBodyCreate(world);
+            dBodySetPosition(body, i, 2 * i, 3 * i);
+            dBodySetLinearVel(body, 1, i, 0);
+            dBodySetAngularVel(body, 0, 0, i);
+            dMatrix3 R;
+            dRFromAxisAndAngle(R, 1, 1, 0, REAL(0.1) * i);
+            dBodySetRotation(body, R);
+            dMass mass;
+            dMassSetBoxTotal(&mass, 1 + i, 1, 2, 3);
+            dBodySetMass(body, &mass);
+        }
+
+        CHECK_EQUAL(bodyCount, dWorldGetBodies(world, NULL, 0));
+        std::vector<dBodyID> bodies(bodyCount);
+        CHECK_EQUAL(bodyCount, dWorldGetBodies(world, &bodies[0], bodyCount));
+
+        std::vector<dReal> forces(3 * bodyCount), torques(3 * bodyCount);
+        for (int i = 0; i != 3 * bodyCount; ++i) {
+            forces[i] = i;
+            torques[i] = -i;
+        }
+        dWorldSetBodyForces(world, &bodies[0], bodyCount, &forces[0], &torques[0]);
+        dWorldAddBodyForces(world, &bodies[0], bodyCount, &forces[0], NULL);
+
+        std::vector<dReal> pos(3 * bodyCount), q(4 * bodyCount), R(12 * bodyCount), lvel(3 * bodyCount), avel(3 * bodyCount),
+            force(3 * bodyCount), torque(3 * bodyCount), invMass(bodyCount), invI(12 * bodyCount);
+        dBodyStates states = { &pos[0], &q[0], &R[0], &lvel[0], &avel[0], &force[0], &torque[0], &invMass[0], &invI[0] };
+        dWorldGetBodyStates(world, &bodies[0], bodyCount, &states);
+
+        for (int i = 0; i != bodyCount; ++i) {
+            dBodyID body = bodies[i];
+            for (int k = 0; k != 3; ++k) {
+                CHECK_EQUAL(dBodyGetPosition(body)[k], pos[3 * i + k]);
+                CHECK_EQUAL(dBodyGetLinearVel(body)[k], lvel[3 * i + k]);
+                CHECK_EQUAL(dBodyGetAngularVel(body)[k], avel[3 * i + k]);
+                CHECK_EQUAL(2 * forces[3 * i + k], force[3 * i + k]);
+                CHECK_EQUAL(torques[3 * i + k], torque[3 * i + k]);
+            }
+            for (int k = 0; k != 4; ++k) {
+                CHECK_EQUAL(dBodyGetQuaternion(body)[k], q[4 * i + k]);
+            }
+            for (int k = 0; k != 12; ++k) {
+                if (k % 4 != 3) {
+                    CHECK_EQUAL(dBodyGetRotation(body)[k], R[12 * i + k]);
+                }
+            }
+
+            dMass mass;
+            dBodyGetMass(body, &mass);
+            CHECK_CLOSE(1 / mass.mass, invMass[i], 1e-6);
+            dMatrix3 I;
+            dMultiply0_333(I, mass.I, &invI[12 * i]);
+            CHECK_CLOSE(1, I[0], 1e-6);
+            CHECK_CLOSE(1, I[5], 1e-6);
+            CHECK_CLOSE(0, I[1], 1e-6);
+        }
+
+        // Setting velocities
+        std::vector<dReal> newVel(3 * bodyCount, REAL(0.5));
+        dWorldSetBodyVelocities(world, &bodies[0], bodyCount, NULL, &newVel[0]);
+        CHECK_EQUAL(REAL(0.5), dBodyGetAngularVel(bodies[7])[1]);
+        CHECK_EQUAL(lvel[3 * 7 + 1], dBodyGetLinearVel(bodies[7])[1]);
+
+        dWorldDestroy(world);
+    }
+} // End of SUITE(BodyStates)
+
+
+SUITE(BodyAutoDisable)
+{
+    const int PAIR_COUNT = 150;
+
+    // returns the number of bodies whose enabled state differs from expected after each step
+    static int countMisdisabledBodies(dThreadingImplementationID threading)
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, 0);
+        dWorldSetAutoDisableFlag(world, 1);
+        dWorldSetAutoDisableAverageSamplesCount(world, 3);
+        dWorldSetAutoDisableSteps(world, 5);
+        dWorldSetAutoDisableTime(world, 0);
+
+        dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+        // the bodies are paired with null joints as the bodies without joints are never disabled
+        std::vector<dBodyID> bodies(2 * PAIR_COUNT);
+        for (int i = 0; i != 2 * PAIR_COUNT; ++i) {
+            bodies[i] = dBodyCreate(world);
+            dBodySetPosition(bodies[i], i, 0, 0);
+            if (i % 4 < 2) {
+                dBodySetLinearVel(bodies[i], 0, 1, 0);
+            }
+            if (i % 2 == 1) {
+                dJointAttach(dJointCreateNull(world, 0), bodies[i - 1], bodies[i]);
+            }
+        }
+
+        // the samples are complete on the third step, then five idle steps are required
+        int misdisabledCount = 0;
+        for (int step = 1; step <= 8; ++step) {
+            dWorldQuickStep(world, REAL(0.01));
+            for (int i = 0; i != 2 * PAIR_COUNT; ++i) {
+                bool expectEnabled = i % 4 < 2 || step < 7;
+                if ((dBodyIsEnabled(bodies[i]) != 0) != expectEnabled) {
+                    ++misdisabledCount;
+                }
+            }
+        }
+        for (int i = 0; i != 2 * PAIR_COUNT; ++i) {
+            if (!dBodyIsEnabled(bodies[i]) && dCalcVectorLength3(dBodyGetLinearVel(bodies[i])) != 0) {
+                ++misdisabledCount;
+            }
+        }
+
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dWorldSetStepThreadingImplementation(world, NULL, NULL);
+        dThreadingFreeImplementation(threading);
+        dWorldDestroy(world);
+
+        return misdisabledCount;
+    }
+
+    TEST(test_IdleBodiesDisabled)
+    {
+        CHECK_EQUAL(0, countMisdisabledBodies(dThreadingAllocateMultiThreadedImplementation()));
+    }
+
+    TEST(test_IdleBodiesDisabledWorkStealing)
+    {
+        CHECK_EQUAL(0, countMisdisabledBodies(dThreadingAllocateWorkStealingMultiThreadedImplementation()));
+    }
+}
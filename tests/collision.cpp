@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
 #include <UnitTest++.h>
 #include <ode/ode.h>
 #include "common.h"
@@ -96,6 +99,46 @@ TEST(test_collision_trimesh_sphere_exact)
     }
 }
 
+TEST(test_collision_trimesh_sphere_center_on_triangle)
+{
+    /*
+     * A sphere centered exactly on a triangle has no direction from the
+     * contact point to the center and used to get a NaN depth.
+     */
+    #ifdef dTRIMESH_GIMPACT
+    return;
+    #endif
+
+    {
+        float vertices[3 * 3] = {
+            -1,-1,0,
+            1,-1,0,
+            1,1,0
+        };
+        dTriIndex indices[3] = { 0,1,2 };
+
+        dTriMeshDataID data = dGeomTriMeshDataCreate();
+        dGeomTriMeshDataBuildSingle(data, vertices, 3 * sizeof(float), 3, indices, 3, 3 * sizeof(dTriIndex));
+        dGeomID trimesh = dCreateTriMesh(0, data, 0, 0, 0);
+        const dReal radius = REAL(0.25);
+        dGeomID sphere = dCreateSphere(0, radius);
+        dGeomSetPosition(sphere, REAL(0.5), REAL(-0.5), 0);
+
+        dContactGeom cg[4];
+        int nc = dCollide(trimesh, sphere, 4, &cg[0], sizeof cg[0]);
+        CHECK_EQUAL(1, nc);
+        if (nc == 1) {
+            CHECK_EQUAL(radius, cg[0].depth);
+            dVector3 trinormal = { 0, 0, -1 };
+            CHECK_ARRAY_EQUAL(trinormal, cg[0].normal, 3);
+        }
+
+        dGeomDestroy(sphere);
+        dGeomDestroy(trimesh);
+        dGeomTriMeshDataDestroy(data);
+    }
+}
+
 
 
 TEST(test_collision_heightfield_ray_fail)
@@ -126,6 +169,628 @@ TEST(test_collision_heightfield_ray_fail)
     }
 }
 
+enum { HF_WIDTH_SAMPLES = 61, HF_DEPTH_SAMPLES = 45 };
+
+static dReal getHeightfieldTestSample(void *data, int x, int z)
+{
+    return ((const unsigned char *)data)[z * HF_WIDTH_SAMPLES + x];
+}
+
+// Two NaNs count as the same value as the results are expected to be identical rather than valid
+static bool sameContactValue(dReal expected, dReal actual)
+{
+    return expected == actual || (expected != expected && actual != actual);
+}
+
+static bool sameContactGeoms(const dContactGeom *expected, const dContactGeom *actual, int count)
+{
+    for (int i = 0; i != count; ++i) {
+        const dContactGeom &e = expected[i], &a = actual[i];
+        if (!sameContactValue(e.pos[0], a.pos[0]) || !sameContactValue(e.pos[1], a.pos[1]) || !sameContactValue(e.pos[2], a.pos[2])
+            || !sameContactValue(e.normal[0], a.normal[0]) || !sameContactValue(e.normal[1], a.normal[1]) || !sameContactValue(e.normal[2], a.normal[2])
+            || !sameContactValue(e.depth, a.depth) || e.side1 != a.side1 || e.side2 != a.side2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fillHeightfieldTestSamples(std::vector<unsigned char> &samples)
+{
+    samples.resize(HF_WIDTH_SAMPLES * HF_DEPTH_SAMPLES);
+    for (int z = 0; z != HF_DEPTH_SAMPLES; ++z) {
+        for (int x = 0; x != HF_WIDTH_SAMPLES; ++x) {
+            // low plains with some plateaus and rough hills
+            int h = ((x / 9) * 3 + (z / 11) * 5) % 7 == 0 ? 60 : 10;
+            if ((x / 15 + z / 13) % 3 == 1) h += (x * 37 + z * 53) % 41;
+            samples[z * HF_WIDTH_SAMPLES + x] = (unsigned char)h;
+        }
+    }
+}
+
+// Collides geoms at a grid of positions with both heightfields and returns the contact count or -1 on a mismatch
+static int compareHeightfieldContacts(dGeomID expectedField, dGeomID actualField, bool wrapped)
+{
+    dGeomID geoms[3] = { dCreateSphere(0, REAL(1.7)), dCreateBox(0, REAL(3.0), REAL(0.8), REAL(2.2)), dCreateRay(0, REAL(12.0)) };
+
+    int totalContacts = 0;
+    bool allSame = true;
+    for (int g = 0; g != 3; ++g) {
+        for (int i = 0; i != 24; ++i) {
+            for (int j = 0; j != 18; ++j) {
+                for (int k = 0; k != 5; ++k) {
+                    // for the wrapped fields some of the positions are beyond the data
+                    dReal x = -20 + i * REAL(1.45) - (wrapped ? 0 : 3), z = -14 + j * REAL(1.55) - (wrapped ? 0 : 2);
+                    dReal y = REAL(0.6) + k * REAL(1.3) + (g == 2 ? REAL(6.0) : 0);
+                    if (g == 2) {
+                        dGeomRaySet(geoms[2], x, y, z, REAL(0.3), REAL(-1.0), REAL(0.2) - k * REAL(0.1));
+                    }
+                    else {
+                        dGeomSetPosition(geoms[g], x, y, z);
+                    }
+
+                    dContactGeom expected[20], actual[20];
+                    int expectedCount = dCollide(expectedField, geoms[g], 20, expected, sizeof(dContactGeom));
+                    int actualCount = dCollide(actualField, geoms[g], 20, actual, sizeof(dContactGeom));
+                    if (expectedCount != actualCount || !sameContactGeoms(expected, actual, actualCount)) {
+                        allSame = false;
+                    }
+                    totalContacts += actualCount;
+                }
+            }
+        }
+    }
+
+    for (int g = 0; g != 3; ++g) {
+        dGeomDestroy(geoms[g]);
+    }
+    return allSame ? totalContacts : -1;
+}
+
+TEST(test_collision_heightfield_bounds_pyramid)
+{
+    /*
+     * The sample data get a min/max height pyramid that rejects and trims the collision zones
+     * while the callback data do not. The contacts must be the same.
+     */
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+
+    for (int wrap = 0; wrap != 2; ++wrap) {
+        dHeightfieldDataID sampleData = dGeomHeightfieldDataCreate();
+        dGeomHeightfieldDataBuildByte(sampleData, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap);
+        dHeightfieldDataID callbackData = dGeomHeightfieldDataCreate();
+        dGeomHeightfieldDataBuildCallback(callbackData, &samples[0], &getHeightfieldTestSample, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap);
+        const unsigned char minSample = *std::min_element(samples.begin(), samples.end());
+        const unsigned char maxSample = *std::max_element(samples.begin(), samples.end());
+        dGeomHeightfieldDataSetBounds(callbackData, minSample, maxSample);
+
+        dGeomID sampleField = dCreateHeightfield(0, sampleData, 1);
+        dGeomID callbackField = dCreateHeightfield(0, callbackData, 1);
+
+        CHECK(compareHeightfieldContacts(callbackField, sampleField, wrap != 0) > 100);
+
+        dGeomDestroy(sampleField);
+        dGeomDestroy(callbackField);
+        dGeomHeightfieldDataDestroy(sampleData);
+        dGeomHeightfieldDataDestroy(callbackData);
+    }
+}
+
+enum { HF_TILE_SAMPLES = 16 };
+
+struct HeightfieldTestTiles {
+    const unsigned char *samples;
+    int loads;
+};
+
+static void getHeightfieldTestTile(void *data, int tileX, int tileZ, dReal *heights)
+{
+    HeightfieldTestTiles *tiles = (HeightfieldTestTiles *)data;
+    tiles->loads++;
+    for (int z = 0; z != HF_TILE_SAMPLES; ++z) {
+        for (int x = 0; x != HF_TILE_SAMPLES; ++x) {
+            int sampleX = tileX * HF_TILE_SAMPLES + x, sampleZ = tileZ * HF_TILE_SAMPLES + z;
+            heights[z * HF_TILE_SAMPLES + x] = sampleX < HF_WIDTH_SAMPLES && sampleZ < HF_DEPTH_SAMPLES 
+                ? tiles->samples[sampleZ * HF_WIDTH_SAMPLES + sampleX] : 0;
+        }
+    }
+}
+
+TEST(test_collision_heightfield_tiles)
+{
+    /*
+     * The tiled data, loaded through the callback or from a tile file, must give the same
+     * contacts as the whole sample array.
+     */
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+    const unsigned char minSample = *std::min_element(samples.begin(), samples.end());
+    const unsigned char maxSample = *std::max_element(samples.begin(), samples.end());
+
+    const int tilesX = (HF_WIDTH_SAMPLES + HF_TILE_SAMPLES - 1) / HF_TILE_SAMPLES;
+    const int tilesZ = (HF_DEPTH_SAMPLES + HF_TILE_SAMPLES - 1) / HF_TILE_SAMPLES;
+    const char *fileName = "test_collision_heightfield_tiles.tmp";
+    {
+        HeightfieldTestTiles tiles = { &samples[0], 0 };
+        std::vector<float> fileSamples(tilesX * tilesZ * HF_TILE_SAMPLES * HF_TILE_SAMPLES);
+        std::vector<dReal> tileHeights(HF_TILE_SAMPLES * HF_TILE_SAMPLES);
+        for (int tile = 0; tile != tilesX * tilesZ; ++tile) {
+            getHeightfieldTestTile(&tiles, tile % tilesX, tile / tilesX, &tileHeights[0]);
+            std::copy(tileHeights.begin(), tileHeights.end(), fileSamples.begin() + tile * HF_TILE_SAMPLES * HF_TILE_SAMPLES);
+        }
+        FILE *file = fopen(fileName, "wb");
+        CHECK(file != NULL);
+        if (file != NULL) {
+            fwrite(&fileSamples[0], sizeof(float), fileSamples.size(), file);
+            fclose(file);
+        }
+    }
+
+    for (int wrap = 0; wrap != 2; ++wrap) {
+        dHeightfieldDataID sampleData = dGeomHeightfieldDataCreate();
+        dGeomHeightfieldDataBuildByte(sampleData, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap);
+        dGeomID sampleField = dCreateHeightfield(0, sampleData, 1);
+
+        // A cache of fewer tiles than the heightfield has keeps reloading them
+        HeightfieldTestTiles smallCacheTiles = { &samples[0], 0 };
+        dHeightfieldDataID smallCacheData = dGeomHeightfieldDataCreate();
+        dGeomHeightfieldDataBuildTiled(smallCacheData, &smallCacheTiles, &getHeightfieldTestTile, HF_TILE_SAMPLES, 3, 
+            30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap);
+        dGeomHeightfieldDataSetBounds(smallCacheData, minSample, maxSample);
+        dGeomID smallCacheField = dCreateHeightfield(0, smallCacheData, 1);
+
+        CHECK(compareHeightfieldContacts(sampleField, smallCacheField, wrap != 0) > 100);
+        CHECK(smallCacheTiles.loads > tilesX * tilesZ);
+
+        // All the tiles fit into a larger cache and get loaded once
+        HeightfieldTestTiles largeCacheTiles = { &samples[0], 0 };
+        dHeightfieldDataID largeCacheData = dGeomHeightfieldDataCreate();
+        dGeomHeightfieldDataBuildTiled(largeCacheData, &largeCacheTiles, &getHeightfieldTestTile, HF_TILE_SAMPLES, 100, 
+            30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap);
+        dGeomHeightfieldDataSetBounds(largeCacheData, minSample, maxSample);
+        dGeomID largeCacheField = dCreateHeightfield(0, largeCacheData, 1);
+
+        CHECK(compareHeightfieldContacts(sampleField, largeCacheField, wrap != 0) > 100);
+        CHECK(largeCacheTiles.loads != 0 && largeCacheTiles.loads <= tilesX * tilesZ);
+
+        dHeightfieldDataID fileData = dGeomHeightfieldDataCreate();
+        CHECK_EQUAL(0, dGeomHeightfieldDataBuildTiledFile(fileData, "test_collision_heightfield_tiles.missing", HF_TILE_SAMPLES, 
+            30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap));
+        // The file is too small for a larger tile size
+        CHECK_EQUAL(0, dGeomHeightfieldDataBuildTiledFile(fileData, fileName, HF_TILE_SAMPLES * 2, 
+            30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap));
+        CHECK_EQUAL(1, dGeomHeightfieldDataBuildTiledFile(fileData, fileName, HF_TILE_SAMPLES, 
+            30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, wrap));
+        dGeomHeightfieldDataSetBounds(fileData, minSample, maxSample);
+        dGeomID fileField = dCreateHeightfield(0, fileData, 1);
+
+        CHECK(compareHeightfieldContacts(sampleField, fileField, wrap != 0) > 100);
+
+        dGeomDestroy(fileField);
+        dGeomDestroy(largeCacheField);
+        dGeomDestroy(smallCacheField);
+        dGeomDestroy(sampleField);
+        dGeomHeightfieldDataDestroy(fileData);
+        dGeomHeightfieldDataDestroy(largeCacheData);
+        dGeomHeightfieldDataDestroy(smallCacheData);
+        dGeomHeightfieldDataDestroy(sampleData);
+    }
+
+    remove(fileName);
+}
+
+TEST(test_collision_heightfield_rotated)
+{
+    /*
+     * A heightfield turned Z up and moved must give the contacts of the one in place
+     * with the geoms moved along. The geoms are collided in place and must be left untouched.
+     */
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+
+    dHeightfieldDataID data = dGeomHeightfieldDataCreate();
+    dGeomHeightfieldDataBuildByte(data, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, 0);
+    dGeomID field = dCreateHeightfield(0, data, 1);
+    dGeomID turnedField = dCreateHeightfield(0, data, 1);
+
+    // the quarter turn around X is exact to keep the mapped positions exact
+    dMatrix3 turn;
+    dRSetIdentity(turn);
+    turn[5] = 0; turn[6] = -1;
+    turn[9] = 1; turn[10] = 0;
+    const dVector3 shift = { 5, -3, 2 };
+    dGeomSetRotation(turnedField, turn);
+    dGeomSetPosition(turnedField, shift[0], shift[1], shift[2]);
+
+    dMatrix3 tilt, turnedTilt;
+    dRFromAxisAndAngle(tilt, 1, 1, 0, REAL(0.4));
+    dMultiply0_333(turnedTilt, turn, tilt);
+
+    dGeomID geoms[2] = { dCreateSphere(0, REAL(1.7)), dCreateBox(0, REAL(3.0), REAL(0.8), REAL(2.2)) };
+    dGeomID turnedGeoms[2] = { dCreateSphere(0, REAL(1.7)), dCreateBox(0, REAL(3.0), REAL(0.8), REAL(2.2)) };
+    dGeomSetRotation(geoms[1], tilt);
+    dGeomSetRotation(turnedGeoms[1], turnedTilt);
+
+    int totalContacts = 0;
+    for (int g = 0; g != 2; ++g) {
+        for (int i = 0; i != 20; ++i) {
+            for (int j = 0; j != 16; ++j) {
+                for (int k = 0; k != 4; ++k) {
+                    // off the sample grid, the cell diagonals and the sample heights where a contact could go either way
+                    const dVector3 pos = { REAL(-13.8125) + i * REAL(1.5), REAL(0.78125) + k * REAL(1.25), REAL(-10.875) + j * REAL(1.5) };
+                    dVector3 turnedPos;
+                    dMultiply0_331(turnedPos, turn, pos);
+                    dAddVectors3(turnedPos, turnedPos, shift);
+                    dGeomSetPosition(geoms[g], pos[0], pos[1], pos[2]);
+                    dGeomSetPosition(turnedGeoms[g], turnedPos[0], turnedPos[1], turnedPos[2]);
+
+                    dReal aabbBefore[6], aabbAfter[6];
+                    dGeomGetAABB(turnedGeoms[g], aabbBefore);
+
+                    dContactGeom expected[20], actual[20];
+                    int expectedCount = dCollide(field, geoms[g], 20, expected, sizeof(dContactGeom));
+                    int actualCount = dCollide(turnedField, turnedGeoms[g], 20, actual, sizeof(dContactGeom));
+                    CHECK_EQUAL(expectedCount, actualCount);
+
+                    dGeomGetAABB(turnedGeoms[g], aabbAfter);
+                    CHECK_ARRAY_EQUAL(aabbBefore, aabbAfter, 6);
+                    const dReal *geomPos = dGeomGetPosition(turnedGeoms[g]);
+                    CHECK_ARRAY_EQUAL(turnedPos, geomPos, 3);
+
+                    for (int c = 0; c != std::min(expectedCount, actualCount); ++c) {
+                        dVector3 expectedPos, expectedNormal;
+                        dMultiply0_331(expectedPos, turn, expected[c].pos);
+                        dAddVectors3(expectedPos, expectedPos, shift);
+                        dMultiply0_331(expectedNormal, turn, expected[c].normal);
+                        CHECK_ARRAY_CLOSE(expectedPos, actual[c].pos, 3, 1000 * dEpsilon);
+                        CHECK_ARRAY_CLOSE(expectedNormal, actual[c].normal, 3, 1000 * dEpsilon);
+                        CHECK_CLOSE(expected[c].depth, actual[c].depth, 1000 * dEpsilon);
+                        CHECK(actual[c].g1 == turnedField && actual[c].g2 == turnedGeoms[g]);
+                    }
+                    totalContacts += actualCount;
+                }
+            }
+        }
+    }
+    CHECK(totalContacts > 100);
+
+    for (int g = 0; g != 2; ++g) {
+        dGeomDestroy(geoms[g]);
+        dGeomDestroy(turnedGeoms[g]);
+    }
+    dGeomDestroy(turnedField);
+    dGeomDestroy(field);
+    dGeomHeightfieldDataDestroy(data);
+}
+
+enum { TM_GRID_VERTICES = 24 };
+
+// A bumpy grid in the XZ plane with convex and concave edges
+template<typename treal>
+static void fillTriMeshTestGrid(std::vector<treal> &vertices, std::vector<dTriIndex> &indices)
+{
+    vertices.resize(TM_GRID_VERTICES * TM_GRID_VERTICES * 3);
+    for (int z = 0; z != TM_GRID_VERTICES; ++z) {
+        for (int x = 0; x != TM_GRID_VERTICES; ++x) {
+            treal *v = &vertices[(z * TM_GRID_VERTICES + x) * 3];
+            v[0] = (treal)(x - TM_GRID_VERTICES / 2);
+            v[1] = (treal)(((x * 7 + z * 13) % 5) * 0.3 + ((x / 4 + z / 3) % 2) * 0.8);
+            v[2] = (treal)(z - TM_GRID_VERTICES / 2);
+        }
+    }
+
+    indices.clear();
+    for (int z = 0; z != TM_GRID_VERTICES - 1; ++z) {
+        for (int x = 0; x != TM_GRID_VERTICES - 1; ++x) {
+            dTriIndex i0 = z * TM_GRID_VERTICES + x, i1 = i0 + 1, i2 = i0 + TM_GRID_VERTICES, i3 = i2 + 1;
+            const dTriIndex quad[6] = { i0, i2, i1, i1, i2, i3 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// Collides geoms at a grid of positions with both trimeshes and returns the contact count or -1 on a mismatch
+static int compareTriMeshContacts(dGeomID expectedMesh, dGeomID actualMesh)
+{
+    dGeomID geoms[4] = { dCreateSphere(0, REAL(0.7)), dCreateBox(0, REAL(1.3), REAL(0.6), REAL(0.9)), 
+        dCreateCapsule(0, REAL(0.4), REAL(1.1)), dCreateRay(0, REAL(6.0)) };
+
+    int totalContacts = 0;
+    bool allSame = true;
+    for (int g = 0; g != 4; ++g) {
+        for (int i = 0; i != 17; ++i) {
+            for (int j = 0; j != 15; ++j) {
+                for (int k = 0; k != 4; ++k) {
+                    dReal x = -12 + i * REAL(1.45), z = -11 + j * REAL(1.55), y = REAL(0.2) + k * REAL(0.45);
+                    if (g == 3) {
+                        dGeomRaySet(geoms[3], x, y + REAL(3.0), z, REAL(0.2), REAL(-1.0), REAL(0.3) - k * REAL(0.15));
+                    }
+                    else {
+                        dGeomSetPosition(geoms[g], x, y, z);
+                    }
+
+                    dContactGeom expected[32], actual[32];
+                    int expectedCount = dCollide(expectedMesh, geoms[g], 32, expected, sizeof(dContactGeom));
+                    int actualCount = dCollide(actualMesh, geoms[g], 32, actual, sizeof(dContactGeom));
+                    if (expectedCount != actualCount || !sameContactGeoms(expected, actual, actualCount)) {
+                        allSame = false;
+                    }
+                    totalContacts += actualCount;
+                }
+            }
+        }
+    }
+
+    for (int g = 0; g != 4; ++g) {
+        dGeomDestroy(geoms[g]);
+    }
+    return allSame ? totalContacts : -1;
+}
+
+template<typename treal>
+static void buildTriMeshTestData(dTriMeshDataID data, const std::vector<treal> &vertices, const std::vector<dTriIndex> &indices)
+{
+    if (sizeof(treal) == sizeof(float)) {
+        dGeomTriMeshDataBuildSingle(data, &vertices[0], 3 * sizeof(treal), (int)vertices.size() / 3, &indices[0], (int)indices.size(), 3 * sizeof(dTriIndex));
+    }
+    else {
+        dGeomTriMeshDataBuildDouble(data, &vertices[0], 3 * sizeof(treal), (int)vertices.size() / 3, &indices[0], (int)indices.size(), 3 * sizeof(dTriIndex));
+    }
+}
+
+// Returns a bit mask of the failed checks
+template<typename treal>
+static unsigned checkTriMeshDataImage(const char *fileName)
+{
+    unsigned failures = 0;
+
+    std::vector<treal> vertices;
+    std::vector<dTriIndex> indices;
+    fillTriMeshTestGrid(vertices, indices);
+    const int vertexCount = (int)vertices.size() / 3, indexCount = (int)indices.size();
+
+    dTriMeshDataID builtData = dGeomTriMeshDataCreate();
+    buildTriMeshTestData(builtData, vertices, indices);
+    const dintptr extraData[dTRIDATAPREPROCESS_BUILD__MAX] = { 0, dTRIDATAPREPROCESS_FACE_ANGLES_EXTRA_WORD_ALL };
+    dGeomTriMeshDataPreprocess2(builtData, (1U << dTRIDATAPREPROCESS_BUILD_CONCAVE_EDGES) | (1U << dTRIDATAPREPROCESS_BUILD_FACE_ANGLES), extraData);
+
+    const dsizeint imageSize = dGeomTriMeshDataSerialize(builtData, NULL, 0);
+    std::vector<double> image(imageSize / sizeof(double) + 1), loadedImage(imageSize / sizeof(double) + 1);
+    failures |= imageSize != 0 && dGeomTriMeshDataSerialize(builtData, &image[0], imageSize) == imageSize ? 0 : 0x01;
+
+    dTriMeshDataID loadedData = dGeomTriMeshDataCreate();
+    failures |= dGeomTriMeshDataBuildFromImage(loadedData, &vertices[0], 3 * sizeof(treal), vertexCount, 
+        &indices[0], indexCount, 3 * sizeof(dTriIndex), NULL, &image[0], imageSize) == 1 ? 0 : 0x02;
+    // The loaded data serialize into the same image, face angles and edge flags included
+    failures |= dGeomTriMeshDataSerialize(loadedData, &loadedImage[0], imageSize) == imageSize 
+        && memcmp(&image[0], &loadedImage[0], imageSize) == 0 ? 0 : 0x04;
+
+    // Mismatching meshes, truncated images and other versions are rejected
+    dTriMeshDataID rejectedData = dGeomTriMeshDataCreate();
+    failures |= dGeomTriMeshDataBuildFromImage(rejectedData, &vertices[0], 3 * sizeof(treal), vertexCount, 
+        &indices[0], indexCount - 3, 3 * sizeof(dTriIndex), NULL, &image[0], imageSize) == 0 ? 0 : 0x08;
+    failures |= dGeomTriMeshDataBuildFromImage(rejectedData, &vertices[0], 3 * sizeof(treal), vertexCount, 
+        &indices[0], indexCount, 3 * sizeof(dTriIndex), NULL, &image[0], imageSize - 1) == 0 ? 0 : 0x08;
+    loadedImage = image;
+    ((unsigned char *)&loadedImage[0])[4] ^= 0x80;
+    failures |= dGeomTriMeshDataBuildFromImage(rejectedData, &vertices[0], 3 * sizeof(treal), vertexCount, 
+        &indices[0], indexCount, 3 * sizeof(dTriIndex), NULL, &loadedImage[0], imageSize) == 0 ? 0 : 0x08;
+    dGeomTriMeshDataDestroy(rejectedData);
+
+    FILE *file = fopen(fileName, "wb");
+    if (file != NULL) {
+        fwrite(&image[0], 1, imageSize, file);
+        fclose(file);
+    }
+    dTriMeshDataID mappedData = dGeomTriMeshDataCreate();
+    failures |= dGeomTriMeshDataBuildFromImageFile(mappedData, &vertices[0], 3 * sizeof(treal), vertexCount, 
+        &indices[0], indexCount, 3 * sizeof(dTriIndex), NULL, fileName) == 1 ? 0 : 0x10;
+
+    dGeomID builtMesh = dCreateTriMesh(0, builtData, 0, 0, 0);
+    dGeomID loadedMesh = dCreateTriMesh(0, loadedData, 0, 0, 0);
+    dGeomID mappedMesh = dCreateTriMesh(0, mappedData, 0, 0, 0);
+    failures |= compareTriMeshContacts(builtMesh, loadedMesh) > 100 ? 0 : 0x20;
+    failures |= compareTriMeshContacts(builtMesh, mappedMesh) > 100 ? 0 : 0x20;
+
+    // Refitting copies the mapped tree
+    for (int v = 0; v != vertexCount; v += 3) {
+        vertices[v * 3 + 1] += (treal)0.4;
+    }
+    dGeomTriMeshDataUpdate(builtData);
+    dGeomTriMeshDataUpdate(mappedData);
+    dGeomTriMeshClearTCCache(builtMesh);
+    dGeomTriMeshClearTCCache(mappedMesh);
+    failures |= compareTriMeshContacts(builtMesh, mappedMesh) > 100 ? 0 : 0x40;
+
+    dGeomDestroy(mappedMesh);
+    dGeomDestroy(loadedMesh);
+    dGeomDestroy(builtMesh);
+    dGeomTriMeshDataDestroy(mappedData);
+    dGeomTriMeshDataDestroy(loadedData);
+    dGeomTriMeshDataDestroy(builtData);
+    remove(fileName);
+
+    return failures;
+}
+
+TEST(test_collision_trimesh_data_image)
+{
+    /*
+     * The trimesh data built from a serialized image, in memory or mapped from a file,
+     * must give the same contacts as the data the image has been written from.
+     */
+    #ifdef dTRIMESH_GIMPACT
+    return;
+    #endif
+
+    CHECK_EQUAL(0U, checkTriMeshDataImage<float>("test_collision_trimesh_data_image.tmp"));
+    CHECK_EQUAL(0U, checkTriMeshDataImage<double>("test_collision_trimesh_data_image.tmp"));
+}
+
+// Casts rays and places spheres at a grid of positions over both trimeshes and returns the hit count or -1 on a mismatch.
+// Unlike the contact lists, the closest ray hits and whether the spheres touch do not depend on the tree layout.
+static int compareTriMeshHits(dGeomID expectedMesh, dGeomID actualMesh)
+{
+    dGeomID ray = dCreateRay(0, REAL(20.0));
+    dGeomRaySetClosestHit(ray, 1);
+    dGeomID sphere = dCreateSphere(0, REAL(0.35));
+
+    int totalHits = 0;
+    bool allSame = true;
+    for (int i = 0; i != 47; ++i) {
+        for (int j = 0; j != 45; ++j) {
+            dReal x = -12 + i * REAL(0.5), z = -11 + j * REAL(0.5);
+            dGeomRaySet(ray, x, REAL(8.0), z, REAL(0.05), REAL(-1.0), REAL(0.1));
+            dGeomSetPosition(sphere, x, REAL(0.6), z);
+
+            dContactGeom expected, actual;
+            int expectedCount = dCollide(expectedMesh, ray, 1, &expected, sizeof(dContactGeom));
+            int actualCount = dCollide(actualMesh, ray, 1, &actual, sizeof(dContactGeom));
+            if (expectedCount != actualCount || (actualCount != 0 && expected.depth != actual.depth)) {
+                allSame = false;
+            }
+            totalHits += actualCount;
+
+            expectedCount = dCollide(expectedMesh, sphere, 1, &expected, sizeof(dContactGeom));
+            actualCount = dCollide(actualMesh, sphere, 1, &actual, sizeof(dContactGeom));
+            if (expectedCount != actualCount) {
+                allSame = false;
+            }
+            totalHits += actualCount;
+        }
+    }
+
+    dGeomDestroy(sphere);
+    dGeomDestroy(ray);
+    return allSame ? totalHits : -1;
+}
+
+// Returns a bit mask of the failed checks
+template<typename treal>
+static unsigned checkTriMeshDataDeformable()
+{
+    unsigned failures = 0;
+
+    std::vector<treal> vertices;
+    std::vector<dTriIndex> indices;
+    fillTriMeshTestGrid(vertices, indices);
+    const std::vector<treal> original(vertices);
+    const int vertexCount = (int)vertices.size() / 3;
+
+    // All the data share the vertices: a refitted one, a deformable one never rebuilt, 
+    // and deformable ones rebuilt on the calling thread and with the threading of a world
+    dTriMeshDataID refittedData = dGeomTriMeshDataCreate(), deformableData = dGeomTriMeshDataCreate();
+    dTriMeshDataID rebuiltData = dGeomTriMeshDataCreate(), threadedData = dGeomTriMeshDataCreate();
+    buildTriMeshTestData(refittedData, vertices, indices);
+    buildTriMeshTestData(deformableData, vertices, indices);
+    buildTriMeshTestData(rebuiltData, vertices, indices);
+    buildTriMeshTestData(threadedData, vertices, indices);
+    failures |= dGeomTriMeshDataEnableDeformable(deformableData, 32, dInfinity) == 1 ? 0 : 0x01;
+    failures |= dGeomTriMeshDataEnableDeformable(rebuiltData, 32, REAL(1.25)) == 1 ? 0 : 0x01;
+    failures |= dGeomTriMeshDataEnableDeformable(threadedData, 32, REAL(1.25)) == 1 ? 0 : 0x01;
+
+    dGeomID refittedMesh = dCreateTriMesh(0, refittedData, 0, 0, 0), deformableMesh = dCreateTriMesh(0, deformableData, 0, 0, 0);
+    dGeomID rebuiltMesh = dCreateTriMesh(0, rebuiltData, 0, 0, 0), threadedMesh = dCreateTriMesh(0, threadedData, 0, 0, 0);
+    dWorldID world = dWorldCreate();
+
+    // Have the boxes refitted everywhere first, as the built ones may differ from the refitted ones by rounding
+    dGeomTriMeshDataUpdate(refittedData);
+    dGeomTriMeshDataUpdate(deformableData);
+    dGeomTriMeshDataUpdate(rebuiltData);
+    dGeomTriMeshDataUpdate(threadedData);
+
+    // Refitting the paths of a band of rows only gives the boxes of the whole tree refit
+    for (int v = 5 * TM_GRID_VERTICES; v != 9 * TM_GRID_VERTICES; ++v) {
+        vertices[v * 3 + 1] += (treal)(0.25 * (v % 7));
+    }
+    dGeomTriMeshDataUpdate(refittedData);
+    dGeomTriMeshDataMarkVerticesDirty(deformableData, 5 * TM_GRID_VERTICES, 4 * TM_GRID_VERTICES);
+    failures |= dGeomTriMeshDataUpdateDeformable(deformableData, NULL) == 0 ? 0 : 0x02;
+    dGeomTriMeshClearTCCache(refittedMesh);
+    dGeomTriMeshClearTCCache(deformableMesh);
+    failures |= compareTriMeshContacts(refittedMesh, deformableMesh) > 100 ? 0 : 0x04;
+
+    dReal refittedAABB[6], deformableAABB[6];
+    dGeomGetAABB(refittedMesh, refittedAABB);
+    dGeomGetAABB(deformableMesh, deformableAABB);
+    failures |= memcmp(refittedAABB, deformableAABB, sizeof(refittedAABB)) == 0 && refittedAABB[3] > REAL(1.5) ? 0 : 0x08;
+
+    // Scrambling the vertices stretches the triangles across the grid and degrades the subtrees
+    for (int z = 0; z != TM_GRID_VERTICES; ++z) {
+        for (int x = 0; x != TM_GRID_VERTICES; ++x) {
+            const int source = ((z * 5) % TM_GRID_VERTICES) * TM_GRID_VERTICES + (x * 7) % TM_GRID_VERTICES;
+            for (int axis = 0; axis != 3; ++axis) {
+                vertices[(z * TM_GRID_VERTICES + x) * 3 + axis] = original[source * 3 + axis];
+            }
+        }
+    }
+    dGeomTriMeshDataUpdate(refittedData);
+    dGeomTriMeshDataMarkVerticesDirty(rebuiltData, 0, vertexCount);
+    const int rebuiltCount = dGeomTriMeshDataUpdateDeformable(rebuiltData, NULL);
+    failures |= rebuiltCount > 0 ? 0 : 0x10;
+
+    // The threaded rebuilds are put in place by a later update
+    dGeomTriMeshDataMarkVerticesDirty(threadedData, 0, vertexCount);
+    const int threadedCountAtStart = dGeomTriMeshDataUpdateDeformable(threadedData, world);
+    const int threadedCount = dGeomTriMeshDataUpdateDeformable(threadedData, world);
+    failures |= threadedCountAtStart == 0 && threadedCount == rebuiltCount ? 0 : 0x20;
+
+    dGeomTriMeshClearTCCache(refittedMesh);
+    dGeomTriMeshClearTCCache(rebuiltMesh);
+    dGeomTriMeshClearTCCache(threadedMesh);
+    failures |= compareTriMeshHits(refittedMesh, rebuiltMesh) > 100 ? 0 : 0x40;
+    failures |= compareTriMeshHits(refittedMesh, threadedMesh) > 100 ? 0 : 0x40;
+
+    // The costs are taken anew after the rebuilds, so the unchanged subtrees are not rebuilt again
+    dGeomTriMeshDataMarkVerticesDirty(rebuiltData, 0, vertexCount);
+    failures |= dGeomTriMeshDataUpdateDeformable(rebuiltData, NULL) == 0 ? 0 : 0x80;
+
+    // The AABB taken from the tree root holds all the vertices
+    dReal rebuiltAABB[6];
+    dGeomGetAABB(rebuiltMesh, rebuiltAABB);
+    for (int v = 0; v != vertexCount; ++v) {
+        for (int axis = 0; axis != 3; ++axis) {
+            const dReal coordinate = (dReal)vertices[v * 3 + axis];
+            failures |= coordinate >= rebuiltAABB[axis * 2] && coordinate <= rebuiltAABB[axis * 2 + 1] ? 0 : 0x100;
+        }
+    }
+
+    // Pending rebuilds are waited for on destruction
+    for (int v = 0; v != vertexCount; ++v) {
+        vertices[v * 3 + 1] = original[v * 3 + 1];
+    }
+    dGeomTriMeshDataMarkVerticesDirty(threadedData, 0, vertexCount);
+    dGeomTriMeshDataUpdateDeformable(threadedData, world);
+
+    dGeomDestroy(threadedMesh);
+    dGeomDestroy(rebuiltMesh);
+    dGeomDestroy(deformableMesh);
+    dGeomDestroy(refittedMesh);
+    dGeomTriMeshDataDestroy(threadedData);
+    dGeomTriMeshDataDestroy(rebuiltData);
+    dGeomTriMeshDataDestroy(deformableData);
+    dGeomTriMeshDataDestroy(refittedData);
+    dWorldDestroy(world);
+
+    return failures;
+}
+
+TEST(test_collision_trimesh_data_deformable)
+{
+    /*
+     * Refitting the subtrees of the vertices marked must give the boxes of a whole tree refit,
+     * and rebuilding the degraded subtrees, at once or on the threads of a world, must keep 
+     * the collisions found unchanged.
+     */
+    #ifdef dTRIMESH_GIMPACT
+    return;
+    #endif
+
+    CHECK_EQUAL(0U, checkTriMeshDataDeformable<float>());
+    CHECK_EQUAL(0U, checkTriMeshDataDeformable<double>());
+}
+
 #include "../ode/demo/convex_prism.h"
 
 TEST(test_collision_ray_convex)
@@ -222,3 +887,809 @@ TEST(test_collision_ray_convex)
         dGeomDestroy(ray);
     }
 }
+
+
+struct ThreadedPairCounter
+{
+    enum { MAX_THREAD_COUNT = 4 };
+
+    int pairCount[MAX_THREAD_COUNT];
+    int outOfRangeCount;
+
+    ThreadedPairCounter(): outOfRangeCount(0)
+    {
+        for (int i = 0; i != MAX_THREAD_COUNT; ++i) {
+            pairCount[i] = 0;
+        }
+    }
+
+    int totalPairCount() const
+    {
+        int total = 0;
+        for (int i = 0; i != MAX_THREAD_COUNT; ++i) {
+            total += pairCount[i];
+        }
+        return total;
+    }
+
+    static void countPair(void *data, dGeomID /*o1*/, dGeomID /*o2*/)
+    {
+        ++((ThreadedPairCounter *)data)->pairCount[0];
+    }
+
+    static void countThreadedPair(void *data, unsigned threadIndex, dGeomID /*o1*/, dGeomID /*o2*/)
+    {
+        ThreadedPairCounter *counter = (ThreadedPairCounter *)data;
+        if (threadIndex < MAX_THREAD_COUNT) {
+            ++counter->pairCount[threadIndex];
+        } else {
+            ++counter->outOfRangeCount;
+        }
+    }
+};
+
+TEST(test_collision_space_collide_threaded)
+{
+    dWorldID world = dWorldCreate();
+    dSpaceID space = dHashSpaceCreate(0);
+
+    // A dense grid of overlapping spheres
+    for (int i = 0; i != 20; ++i) {
+        for (int j = 0; j != 20; ++j) {
+            dGeomID sphere = dCreateSphere(space, 1);
+            dGeomSetPosition(sphere, i * REAL(1.5), j * REAL(1.5), 0);
+        }
+    }
+
+    ThreadedPairCounter serialCounter;
+    dSpaceCollide(space, &serialCounter, &ThreadedPairCounter::countPair);
+
+    // Without a threading implementation everything is done on the calling thread
+    ThreadedPairCounter selfCounter;
+    dSpaceCollideThreaded(space, world, ThreadedPairCounter::MAX_THREAD_COUNT, &selfCounter, &ThreadedPairCounter::countThreadedPair);
+    CHECK_EQUAL(serialCounter.totalPairCount(), selfCounter.pairCount[0]);
+
+    dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+    dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateMaskAll, NULL);
+    dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+    ThreadedPairCounter threadedCounter;
+    dSpaceCollideThreaded(space, world, ThreadedPairCounter::MAX_THREAD_COUNT, &threadedCounter, &ThreadedPairCounter::countThreadedPair);
+    CHECK_EQUAL(serialCounter.totalPairCount(), threadedCounter.totalPairCount());
+    CHECK_EQUAL(0, threadedCounter.outOfRangeCount);
+
+    dThreadingImplementationShutdownProcessing(threading);
+    dThreadingFreeThreadPool(pool);
+    dWorldSetStepThreadingImplementation(world, NULL, NULL);
+    dThreadingFreeImplementation(threading);
+
+    dSpaceDestroy(space);
+    dWorldDestroy(world);
+}
+
+
+struct CollectedPairs
+{
+    // The pairs are identified by the geoms' data values to be comparable among spaces
+    std::vector<std::pair<size_t, size_t> > pairs;
+
+    static void collectPair(void *data, dGeomID o1, dGeomID o2)
+    {
+        CollectedPairs *collected = (CollectedPairs *)data;
+        size_t id1 = (size_t)dGeomGetData(o1), id2 = (size_t)dGeomGetData(o2);
+        collected->pairs.push_back(id1 < id2 ? std::make_pair(id1, id2) : std::make_pair(id2, id1));
+    }
+
+    void collect(dSpaceID space)
+    {
+        pairs.clear();
+        dSpaceCollide(space, this, &collectPair);
+        std::sort(pairs.begin(), pairs.end());
+    }
+};
+
+TEST(test_collision_dynamic_tree_space_matches_simple_space)
+{
+    enum { GEOM_COUNT = 200, FRAME_COUNT = 20 };
+
+    dSpaceID simpleSpace = dSimpleSpaceCreate(0);
+    dSpaceID treeSpace = dDynamicTreeSpaceCreate(0);
+    CHECK_EQUAL((int)dDynamicTreeSpaceClass, dSpaceGetClass(treeSpace));
+    CHECK(dGeomIsSpace((dGeomID)treeSpace));
+    // The class follows the user ones which keep their numbers
+    CHECK_EQUAL((int)dQuadTreeSpaceClass + 1, (int)dFirstUserClass);
+    CHECK_EQUAL((int)dLastUserClass + 1, (int)dDynamicTreeSpaceClass);
+
+    dGeomID simpleGeoms[GEOM_COUNT], treeGeoms[GEOM_COUNT];
+    dRandSetSeed(1);
+    for (int i = 0; i != GEOM_COUNT; ++i) {
+        dReal radius = REAL(0.2) + dRandReal();
+        simpleGeoms[i] = dCreateSphere(simpleSpace, radius);
+        treeGeoms[i] = dCreateSphere(treeSpace, radius);
+        dGeomSetData(simpleGeoms[i], (void *)(size_t)i);
+        dGeomSetData(treeGeoms[i], (void *)(size_t)i);
+    }
+    // An infinite geom is kept out of the tree but must be collided with it
+    dGeomSetData(dCreatePlane(simpleSpace, 0, 0, 1, 5), (void *)(size_t)GEOM_COUNT);
+    dGeomSetData(dCreatePlane(treeSpace, 0, 0, 1, 5), (void *)(size_t)GEOM_COUNT);
+
+    CollectedPairs simplePairs, treePairs;
+    for (int frame = 0; frame != FRAME_COUNT; ++frame) {
+        // Teleport some geoms and nudge the others within the fat boxes or just outside them
+        for (int i = 0; i != GEOM_COUNT; ++i) {
+            dReal x, y, z;
+            if (frame == 0 || i % 10 == frame % 10) {
+                x = dRandReal() * 20; y = dRandReal() * 20; z = dRandReal() * 20;
+            } else {
+                const dReal *pos = dGeomGetPosition(simpleGeoms[i]);
+                x = pos[0] + (dRandReal() - REAL(0.5)) * REAL(0.3);
+                y = pos[1] + (dRandReal() - REAL(0.5)) * REAL(0.3);
+                z = pos[2] + (dRandReal() - REAL(0.5)) * REAL(0.3);
+            }
+            dGeomSetPosition(simpleGeoms[i], x, y, z);
+            dGeomSetPosition(treeGeoms[i], x, y, z);
+        }
+
+        // Disabled geoms must be skipped
+        if (frame == FRAME_COUNT / 2) {
+            dGeomDisable(simpleGeoms[0]);
+            dGeomDisable(treeGeoms[0]);
+        }
+
+        simplePairs.collect(simpleSpace);
+        treePairs.collect(treeSpace);
+        CHECK(simplePairs.pairs.size() != 0);
+        CHECK(simplePairs.pairs == treePairs.pairs);
+    }
+
+    // Removal from the tree
+    for (int i = 0; i < GEOM_COUNT; i += 2) {
+        dGeomDestroy(simpleGeoms[i]);
+        dGeomDestroy(treeGeoms[i]);
+    }
+    simplePairs.collect(simpleSpace);
+    treePairs.collect(treeSpace);
+    CHECK(simplePairs.pairs == treePairs.pairs);
+
+    dSpaceDestroy(treeSpace);
+    dSpaceDestroy(simpleSpace);
+}
+
+TEST(test_collision_space_pair_cache)
+{
+    enum { GEOM_COUNT = 150, FRAME_COUNT = 12, SPACE_COUNT = 6 };
+
+    // Each space kind finds the pairs of the moved geoms its own way
+    dSpaceID referenceSpace = dSimpleSpaceCreate(0);
+    const dVector3 quadTreeCenter = { REAL(7.5), REAL(7.5), REAL(7.5) }, quadTreeExtents = { 8, 8, 8 };
+    dSpaceID cachedSpaces[SPACE_COUNT] = { dHashSpaceCreate(0), dDynamicTreeSpaceCreate(0), dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY),
+        dSweepAndPruneSpaceCreate(0, dSAP_AXES_ZYX), dQuadTreeSpaceCreate(0, quadTreeCenter, quadTreeExtents, 3), dSimpleSpaceCreate(0) };
+    dSweepAndPruneSpaceSetIncremental(cachedSpaces[3], 1);
+    for (int s = 0; s != SPACE_COUNT; ++s) {
+        dSpaceSetPairCacheMode(cachedSpaces[s], dSpacePairCacheAllPairs);
+    }
+    CHECK_EQUAL(dSpacePairCacheDisabled, dSpaceGetPairCacheMode(referenceSpace));
+    CHECK_EQUAL(dSpacePairCacheAllPairs, dSpaceGetPairCacheMode(cachedSpaces[1]));
+
+    dGeomID referenceGeoms[GEOM_COUNT], cachedGeoms[SPACE_COUNT][GEOM_COUNT];
+    for (int i = 0; i != GEOM_COUNT; ++i) {
+        // A few large geoms go above the hash cells of the others
+        dReal radius = REAL(0.5) + dRandReal() * (i % 25 == 0 ? 4 : 1);
+        referenceGeoms[i] = dCreateSphere(referenceSpace, radius);
+        dGeomSetData(referenceGeoms[i], (void *)(size_t)i);
+        dGeomSetPosition(referenceGeoms[i], dRandReal() * 15, dRandReal() * 15, dRandReal() * 15);
+        for (int s = 0; s != SPACE_COUNT; ++s) {
+            cachedGeoms[s][i] = dCreateSphere(cachedSpaces[s], radius);
+            dGeomSetData(cachedGeoms[s][i], (void *)(size_t)i);
+            const dReal *pos = dGeomGetPosition(referenceGeoms[i]);
+            dGeomSetPosition(cachedGeoms[s][i], pos[0], pos[1], pos[2]);
+        }
+    }
+    // An infinite geom overlaps everything
+    dGeomSetData(dCreatePlane(referenceSpace, 0, 0, 1, 2), (void *)(size_t)GEOM_COUNT);
+    for (int s = 0; s != SPACE_COUNT; ++s) {
+        dGeomSetData(dCreatePlane(cachedSpaces[s], 0, 0, 1, 2), (void *)(size_t)GEOM_COUNT);
+    }
+
+    CollectedPairs referencePairs, cachedPairs;
+    for (int frame = 0; frame != FRAME_COUNT; ++frame) {
+        // Only a part of the geoms moves in each frame
+        for (int i = frame % 3; i < GEOM_COUNT; i += 3) {
+            dReal x = dRandReal() * 15, y = dRandReal() * 15, z = dRandReal() * 15;
+            dGeomSetPosition(referenceGeoms[i], x, y, z);
+            for (int s = 0; s != SPACE_COUNT; ++s) {
+                dGeomSetPosition(cachedGeoms[s][i], x, y, z);
+            }
+        }
+
+        // The enabled state is checked as the cached pairs are reported
+        if (frame == FRAME_COUNT / 2) {
+            dGeomDisable(referenceGeoms[1]);
+            for (int s = 0; s != SPACE_COUNT; ++s) {
+                dGeomDisable(cachedGeoms[s][1]);
+            }
+        }
+
+        referencePairs.collect(referenceSpace);
+        CHECK(referencePairs.pairs.size() != 0);
+        for (int s = 0; s != SPACE_COUNT; ++s) {
+            cachedPairs.collect(cachedSpaces[s]);
+            CHECK(referencePairs.pairs == cachedPairs.pairs);
+        }
+    }
+
+    // Removed geoms must not be reported anymore
+    for (int i = 0; i < GEOM_COUNT; i += 4) {
+        dGeomDestroy(referenceGeoms[i]);
+        for (int s = 0; s != SPACE_COUNT; ++s) {
+            dGeomDestroy(cachedGeoms[s][i]);
+        }
+    }
+    referencePairs.collect(referenceSpace);
+    for (int s = 0; s != SPACE_COUNT; ++s) {
+        cachedPairs.collect(cachedSpaces[s]);
+        CHECK(referencePairs.pairs == cachedPairs.pairs);
+    }
+
+    // Added geoms are found too, in the second round one of them larger than all the others
+    for (int round = 0; round != 2; ++round) {
+        for (int i = 4 - 4 * round; i < GEOM_COUNT; i += 8) {
+            dReal radius = i == 0 ? 12 : REAL(0.5) + dRandReal();
+            dReal x = dRandReal() * 15, y = dRandReal() * 15, z = dRandReal() * 15;
+            referenceGeoms[i] = dCreateSphere(referenceSpace, radius);
+            dGeomSetData(referenceGeoms[i], (void *)(size_t)i);
+            dGeomSetPosition(referenceGeoms[i], x, y, z);
+            for (int s = 0; s != SPACE_COUNT; ++s) {
+                cachedGeoms[s][i] = dCreateSphere(cachedSpaces[s], radius);
+                dGeomSetData(cachedGeoms[s][i], (void *)(size_t)i);
+                dGeomSetPosition(cachedGeoms[s][i], x, y, z);
+            }
+        }
+        referencePairs.collect(referenceSpace);
+        for (int s = 0; s != SPACE_COUNT; ++s) {
+            cachedPairs.collect(cachedSpaces[s]);
+            CHECK(referencePairs.pairs == cachedPairs.pairs);
+        }
+    }
+
+    // With nothing moved, the moving pairs mode reports nothing...
+    dSpaceSetPairCacheMode(cachedSpaces[0], dSpacePairCacheMovingPairs);
+    CHECK_EQUAL(dSpacePairCacheMovingPairs, dSpaceGetPairCacheMode(cachedSpaces[0]));
+    cachedPairs.collect(cachedSpaces[0]);
+    CHECK(cachedPairs.pairs.empty());
+
+    // ...and then only the pairs of the moved geom (it is put over another one)
+    const dReal *pos = dGeomGetPosition(referenceGeoms[5]);
+    dGeomSetPosition(cachedGeoms[0][3], pos[0], pos[1], pos[2]);
+    dGeomSetPosition(referenceGeoms[3], pos[0], pos[1], pos[2]);
+    referencePairs.collect(referenceSpace);
+    cachedPairs.collect(cachedSpaces[0]);
+    std::vector<std::pair<size_t, size_t> > movedPairs;
+    for (size_t i = 0; i != referencePairs.pairs.size(); ++i) {
+        if (referencePairs.pairs[i].first == 3 || referencePairs.pairs[i].second == 3) {
+            movedPairs.push_back(referencePairs.pairs[i]);
+        }
+    }
+    CHECK(!movedPairs.empty());
+    CHECK(movedPairs == cachedPairs.pairs);
+
+    dSpaceSetPairCacheMode(cachedSpaces[0], dSpacePairCacheDisabled);
+    CHECK_EQUAL(dSpacePairCacheDisabled, dSpaceGetPairCacheMode(cachedSpaces[0]));
+    cachedPairs.collect(cachedSpaces[0]);
+    CHECK(referencePairs.pairs == cachedPairs.pairs);
+
+    for (int s = 0; s != SPACE_COUNT; ++s) {
+        dSpaceDestroy(cachedSpaces[s]);
+    }
+    dSpaceDestroy(referenceSpace);
+}
+
+TEST(test_collision_sap_space_incremental)
+{
+    enum { GEOM_COUNT = 200, FRAME_COUNT = 30 };
+
+    // The plain mode is the reference: the infinite geoms are collided with all the others in it
+    dSpaceID plainSpace = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY);
+    dSpaceID sapSpace = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY);
+    dSweepAndPruneSpaceSetIncremental(sapSpace, 1);
+    CHECK_EQUAL(1, dSweepAndPruneSpaceGetIncremental(sapSpace));
+
+    dGeomID plainGeoms[GEOM_COUNT], sapGeoms[GEOM_COUNT];
+    for (int i = 0; i != GEOM_COUNT; ++i) {
+        dReal lx = REAL(0.2) + dRandReal(), ly = REAL(0.2) + dRandReal(), lz = REAL(0.2) + dRandReal();
+        plainGeoms[i] = dCreateBox(plainSpace, lx, ly, lz);
+        sapGeoms[i] = dCreateBox(sapSpace, lx, ly, lz);
+        dGeomSetData(plainGeoms[i], (void *)(size_t)i);
+        dGeomSetData(sapGeoms[i], (void *)(size_t)i);
+    }
+    dGeomSetData(dCreatePlane(plainSpace, 0, 0, 1, 3), (void *)(size_t)GEOM_COUNT);
+    dGeomSetData(dCreatePlane(sapSpace, 0, 0, 1, 3), (void *)(size_t)GEOM_COUNT);
+
+    CollectedPairs plainPairs, sapPairs;
+    for (int frame = 0; frame != FRAME_COUNT; ++frame) {
+        // Most of the geoms drift a little, some jump far
+        for (int i = 0; i != GEOM_COUNT; ++i) {
+            dReal x, y, z;
+            if (frame == 0 || i % 7 == frame % 7) {
+                x = dRandReal() * 15; y = dRandReal() * 15; z = dRandReal() * 15;
+            } else {
+                const dReal *pos = dGeomGetPosition(plainGeoms[i]);
+                x = pos[0] + (dRandReal() - REAL(0.5)) * REAL(0.5);
+                y = pos[1] + (dRandReal() - REAL(0.5)) * REAL(0.5);
+                z = pos[2] + (dRandReal() - REAL(0.5)) * REAL(0.5);
+            }
+            dGeomSetPosition(plainGeoms[i], x, y, z);
+            dGeomSetPosition(sapGeoms[i], x, y, z);
+        }
+
+        // Touching boxes count as overlapping
+        if (frame == 3) {
+            const dReal *pos = dGeomGetPosition(plainGeoms[1]);
+            dVector3 lengths;
+            dGeomBoxGetLengths(plainGeoms[1], lengths);
+            dReal x = pos[0] + lengths[0];
+            dGeomSetPosition(plainGeoms[2], x, pos[1], pos[2]);
+            dGeomSetPosition(sapGeoms[2], x, pos[1], pos[2]);
+            dGeomBoxSetLengths(plainGeoms[2], lengths[0], lengths[1], lengths[2]);
+            dGeomBoxSetLengths(sapGeoms[2], lengths[0], lengths[1], lengths[2]);
+        }
+
+        if (frame == FRAME_COUNT / 2) {
+            dGeomDisable(plainGeoms[0]);
+            dGeomDisable(sapGeoms[0]);
+        }
+
+        plainPairs.collect(plainSpace);
+        sapPairs.collect(sapSpace);
+        CHECK(plainPairs.pairs.size() != 0);
+        CHECK(plainPairs.pairs == sapPairs.pairs);
+    }
+
+    // Removal and reinsertion of a few boxes (few enough to be inserted one by one)
+    for (int i = 0; i < GEOM_COUNT; i += 3) {
+        dSpaceRemove(plainSpace, plainGeoms[i]);
+        dSpaceRemove(sapSpace, sapGeoms[i]);
+    }
+    plainPairs.collect(plainSpace);
+    sapPairs.collect(sapSpace);
+    CHECK(plainPairs.pairs == sapPairs.pairs);
+
+    for (int i = 0; i < GEOM_COUNT; i += 12) {
+        dSpaceAdd(plainSpace, plainGeoms[i]);
+        dSpaceAdd(sapSpace, sapGeoms[i]);
+    }
+    plainPairs.collect(plainSpace);
+    sapPairs.collect(sapSpace);
+    CHECK(plainPairs.pairs == sapPairs.pairs);
+
+    // Removal of enough boxes to be compacted before the collision, with the others moving
+    // and a few of the removed ones added back in between
+    for (int i = 0; i < GEOM_COUNT; ++i) {
+        if (i % 3 == 1 || i % 6 == 5) {
+            dSpaceRemove(plainSpace, plainGeoms[i]);
+            dSpaceRemove(sapSpace, sapGeoms[i]);
+        }
+    }
+    for (int i = 2; i < GEOM_COUNT; i += 3) {
+        const dReal *pos = dGeomGetPosition(plainGeoms[i]);
+        dReal x = pos[0] + REAL(0.3), y = pos[1] - REAL(0.2), z = pos[2];
+        dGeomSetPosition(plainGeoms[i], x, y, z);
+        dGeomSetPosition(sapGeoms[i], x, y, z);
+    }
+    for (int i = 1; i < GEOM_COUNT; i += 15) {
+        dSpaceAdd(plainSpace, plainGeoms[i]);
+        dSpaceAdd(sapSpace, sapGeoms[i]);
+    }
+    plainPairs.collect(plainSpace);
+    sapPairs.collect(sapSpace);
+    CHECK(plainPairs.pairs.size() != 0);
+    CHECK(plainPairs.pairs == sapPairs.pairs);
+
+    // The results must not change as the mode is switched off
+    dSweepAndPruneSpaceSetIncremental(sapSpace, 0);
+    CHECK_EQUAL(0, dSweepAndPruneSpaceGetIncremental(sapSpace));
+    sapPairs.collect(sapSpace);
+    CHECK(plainPairs.pairs == sapPairs.pairs);
+
+    for (int i = 0; i < GEOM_COUNT; ++i) {
+        if ((i % 3 == 0 && i % 12 != 0) || (i % 3 == 1 && i % 15 != 1) || i % 6 == 5) {
+            dGeomDestroy(plainGeoms[i]);
+            dGeomDestroy(sapGeoms[i]);
+        }
+    }
+    dSpaceDestroy(sapSpace);
+    dSpaceDestroy(plainSpace);
+}
+
+static void collectGeomPair(void *data, dGeomID o1, dGeomID o2)
+{
+    std::vector<dGeomID> *pairs = (std::vector<dGeomID> *)data;
+    pairs->push_back(o1);
+    pairs->push_back(o2);
+}
+
+// The fourth vector elements are not always written by the colliders
+static bool sameContactGeoms(const std::vector<dContactGeom> &expected, const dContactGeom *actual)
+{
+    for (size_t i = 0; i != expected.size(); ++i) {
+        const dContactGeom &e = expected[i], &a = actual[i];
+        if (!sameContactValue(e.pos[0], a.pos[0]) || !sameContactValue(e.pos[1], a.pos[1]) || !sameContactValue(e.pos[2], a.pos[2])
+            || !sameContactValue(e.normal[0], a.normal[0]) || !sameContactValue(e.normal[1], a.normal[1]) || !sameContactValue(e.normal[2], a.normal[2])
+            || !sameContactValue(e.depth, a.depth) || e.g1 != a.g1 || e.g2 != a.g2 || e.side1 != a.side1 || e.side2 != a.side2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(test_collision_collide_batch)
+{
+    enum { MAX_CONTACTS = 4 };
+
+    dWorldID world = dWorldCreate();
+    dSpaceID space = dHashSpaceCreate(0);
+
+    // Spheres and boxes on a grid with some of them overlapping
+    for (int i = 0; i != 12; ++i) {
+        for (int j = 0; j != 12; ++j) {
+            dGeomID geom = (i + j) % 3 == 0 ? dCreateBox(space, REAL(1.2), REAL(1.2), REAL(1.2)) : dCreateSphere(space, REAL(0.7));
+            dGeomSetPosition(geom, i * REAL(1.1), j * REAL(1.1), (i * j) % 2 * REAL(0.3));
+        }
+    }
+    dCreatePlane(space, 0, 0, 1, REAL(0.2));
+
+    // A Z up heightfield under the grid shared by most of the pairs
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+    dHeightfieldDataID heightfieldData = dGeomHeightfieldDataCreate();
+    dGeomHeightfieldDataBuildByte(heightfieldData, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.01), REAL(-0.3), 1, 0);
+    dGeomID field = dCreateHeightfield(space, heightfieldData, 1);
+    dMatrix3 turn;
+    dRSetIdentity(turn);
+    turn[5] = 0; turn[6] = -1;
+    turn[9] = 1; turn[10] = 0;
+    dGeomSetRotation(field, turn);
+    dGeomSetPosition(field, 6, 6, 0);
+
+    std::vector<dGeomID> pairs;
+    dSpaceCollide(space, &pairs, &collectGeomPair);
+    const unsigned pairCount = (unsigned)pairs.size() / 2;
+    CHECK(pairCount != 0);
+
+    // The reference contacts
+    std::vector<dContactGeom> expected;
+    std::vector<unsigned> expectedOffsets;
+    for (unsigned i = 0; i != pairCount; ++i) {
+        dContactGeom pairContacts[MAX_CONTACTS];
+        int n = dCollide(pairs[2 * i], pairs[2 * i + 1], MAX_CONTACTS, pairContacts, sizeof(dContactGeom));
+        expectedOffsets.push_back((unsigned)expected.size());
+        expected.insert(expected.end(), pairContacts, pairContacts + n);
+    }
+    expectedOffsets.push_back((unsigned)expected.size());
+    CHECK(!expected.empty());
+    size_t fieldContacts = 0;
+    for (size_t i = 0; i != expected.size(); ++i) {
+        fieldContacts += expected[i].g1 == field || expected[i].g2 == field;
+    }
+    CHECK(fieldContacts > 20);
+
+    std::vector<dContactGeom> contacts(pairCount * MAX_CONTACTS);
+    std::vector<unsigned> offsets(pairCount + 1);
+
+    unsigned total = dCollideBatch(NULL, 1, &pairs[0], pairCount, MAX_CONTACTS, &contacts[0], &offsets[0]);
+    CHECK_EQUAL(expected.size(), total);
+    CHECK(expectedOffsets == offsets);
+    CHECK(sameContactGeoms(expected, &contacts[0]));
+
+    dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+    dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateMaskAll, NULL);
+    dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+    std::fill(contacts.begin(), contacts.end(), dContactGeom());
+    total = dCollideBatch(world, 5, &pairs[0], pairCount, MAX_CONTACTS, &contacts[0], &offsets[0]);
+    CHECK_EQUAL(expected.size(), total);
+    CHECK(expectedOffsets == offsets);
+    CHECK(sameContactGeoms(expected, &contacts[0]));
+
+    dThreadingImplementationShutdownProcessing(threading);
+    dThreadingFreeThreadPool(pool);
+    dWorldSetStepThreadingImplementation(world, NULL, NULL);
+    dThreadingFreeImplementation(threading);
+
+    dSpaceDestroy(space);
+    dGeomHeightfieldDataDestroy(heightfieldData);
+    dWorldDestroy(world);
+}
+
+TEST(test_collision_collide_batch_trimesh_tc)
+{
+    enum { MAX_CONTACTS = 4 };
+
+    // A flat square the spheres rest on, with the sphere temporal coherence 
+    // caches updated by the colliders
+    float vertices[4 * 3] = {
+        -10,-10,0,
+        10,-10,0,
+        10,10,0,
+        -10,10,0
+    };
+    dTriIndex indices[2 * 3] = {
+        0,1,2,
+        0,2,3
+    };
+    dTriMeshDataID data = dGeomTriMeshDataCreate();
+    dGeomTriMeshDataBuildSingle(data, vertices, 3 * sizeof(float), 4, indices, 2 * 3, 3 * sizeof(dTriIndex));
+    dGeomID trimesh = dCreateTriMesh(0, data, 0, 0, 0);
+    dGeomTriMeshEnableTC(trimesh, dSphereClass, 1);
+
+    std::vector<dGeomID> spheres;
+    std::vector<dGeomID> pairs;
+    for (int i = 0; i != 10; ++i) {
+        for (int j = 0; j != 10; ++j) {
+            dGeomID sphere = dCreateSphere(0, REAL(0.5));
+            dGeomSetPosition(sphere, i * REAL(1.5) - 7, j * REAL(1.5) - 7, REAL(0.4));
+            spheres.push_back(sphere);
+            pairs.push_back(trimesh);
+            pairs.push_back(sphere);
+        }
+    }
+    const unsigned pairCount = (unsigned)pairs.size() / 2;
+
+    std::vector<dContactGeom> expected;
+    std::vector<unsigned> expectedOffsets;
+    for (unsigned i = 0; i != pairCount; ++i) {
+        dContactGeom pairContacts[MAX_CONTACTS];
+        int n = dCollide(pairs[2 * i], pairs[2 * i + 1], MAX_CONTACTS, pairContacts, sizeof(dContactGeom));
+        expectedOffsets.push_back((unsigned)expected.size());
+        expected.insert(expected.end(), pairContacts, pairContacts + n);
+    }
+    expectedOffsets.push_back((unsigned)expected.size());
+    CHECK(expected.size() >= pairCount);
+
+    dWorldID world = dWorldCreate();
+    dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+    dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateMaskAll, NULL);
+    dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+    std::vector<dContactGeom> contacts(pairCount * MAX_CONTACTS);
+    std::vector<unsigned> offsets(pairCount + 1);
+    for (int pass = 0; pass != 3; ++pass) {
+        std::fill(contacts.begin(), contacts.end(), dContactGeom());
+        unsigned total = dCollideBatch(world, 5, &pairs[0], pairCount, MAX_CONTACTS, &contacts[0], &offsets[0]);
+        CHECK_EQUAL(expected.size(), total);
+        CHECK(expectedOffsets == offsets);
+        CHECK(sameContactGeoms(expected, &contacts[0]));
+    }
+
+    dThreadingImplementationShutdownProcessing(threading);
+    dThreadingFreeThreadPool(pool);
+    dWorldSetStepThreadingImplementation(world, NULL, NULL);
+    dThreadingFreeImplementation(threading);
+    dWorldDestroy(world);
+
+    for (size_t i = 0; i != spheres.size(); ++i) {
+        dGeomDestroy(spheres[i]);
+    }
+    dGeomDestroy(trimesh);
+    dGeomTriMeshDataDestroy(data);
+}
+
+TEST(test_collision_heightfield_tiles_threaded)
+{
+    /*
+     * The threads of a batch share the tile cache of the data. With fewer cached tiles than threads
+     * the tiles in use must be kept and the contacts must be those of the whole sample array.
+     */
+    enum { MAX_CONTACTS = 10 };
+
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+    dHeightfieldDataID sampleData = dGeomHeightfieldDataCreate();
+    dGeomHeightfieldDataBuildByte(sampleData, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, 0);
+    dGeomID sampleField = dCreateHeightfield(0, sampleData, 1);
+
+    HeightfieldTestTiles tiles = { &samples[0], 0 };
+    dHeightfieldDataID tiledData = dGeomHeightfieldDataCreate();
+    dGeomHeightfieldDataBuildTiled(tiledData, &tiles, &getHeightfieldTestTile, HF_TILE_SAMPLES, 2, 
+        30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.1), 0, 1, 0);
+    dGeomHeightfieldDataSetBounds(tiledData, *std::min_element(samples.begin(), samples.end()), *std::max_element(samples.begin(), samples.end()));
+    dGeomID tiledField = dCreateHeightfield(0, tiledData, 1);
+
+    std::vector<dGeomID> geoms, pairs;
+    for (int i = 0; i != 20; ++i) {
+        for (int j = 0; j != 14; ++j) {
+            for (int k = 0; k != 2; ++k) {
+                dGeomID geom = (i + j + k) % 2 == 0 ? dCreateSphere(0, REAL(1.7)) : dCreateBox(0, REAL(3.0), REAL(0.8), REAL(2.2));
+                dGeomSetPosition(geom, -14 + i * REAL(1.45), REAL(1.1) + k * REAL(2.6), -10 + j * REAL(1.55));
+                geoms.push_back(geom);
+                pairs.push_back(tiledField);
+                pairs.push_back(geom);
+            }
+        }
+    }
+    const unsigned pairCount = (unsigned)geoms.size();
+
+    std::vector<dContactGeom> expected;
+    std::vector<unsigned> expectedOffsets;
+    for (unsigned i = 0; i != pairCount; ++i) {
+        dContactGeom pairContacts[MAX_CONTACTS];
+        int n = dCollide(sampleField, geoms[i], MAX_CONTACTS, pairContacts, sizeof(dContactGeom));
+        for (int c = 0; c != n; ++c) {
+            pairContacts[c].g1 = tiledField;
+        }
+        expectedOffsets.push_back((unsigned)expected.size());
+        expected.insert(expected.end(), pairContacts, pairContacts + n);
+    }
+    expectedOffsets.push_back((unsigned)expected.size());
+    CHECK(expected.size() > 100);
+
+    dWorldID world = dWorldCreate();
+    dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+    dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateMaskAll, NULL);
+    dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+    std::vector<dContactGeom> contacts(pairCount * MAX_CONTACTS);
+    std::vector<unsigned> offsets(pairCount + 1);
+    for (int run = 0; run != 3; ++run) {
+        std::fill(contacts.begin(), contacts.end(), dContactGeom());
+        unsigned total = dCollideBatch(world, 5, &pairs[0], pairCount, MAX_CONTACTS, &contacts[0], &offsets[0]);
+        CHECK_EQUAL(expected.size(), total);
+        CHECK(expectedOffsets == offsets);
+        CHECK(sameContactGeoms(expected, &contacts[0]));
+    }
+    CHECK(tiles.loads > 4);
+
+    dThreadingImplementationShutdownProcessing(threading);
+    dThreadingFreeThreadPool(pool);
+    dWorldSetStepThreadingImplementation(world, NULL, NULL);
+    dThreadingFreeImplementation(threading);
+    dWorldDestroy(world);
+
+    for (size_t i = 0; i != geoms.size(); ++i) {
+        dGeomDestroy(geoms[i]);
+    }
+    dGeomDestroy(tiledField);
+    dGeomDestroy(sampleField);
+    dGeomHeightfieldDataDestroy(tiledData);
+    dGeomHeightfieldDataDestroy(sampleData);
+}
+
+static bool closeRaycastValue(dReal expected, dReal actual)
+{
+    return dFabs(expected - actual) <= 1000 * dEpsilon;
+}
+
+// The heightfield builds the planes a ray is collided with from the cells its box covers, 
+// so its hits may differ in the last bits for the rays cut short by the closer hits
+static bool sameRaycastHits(const std::vector<dRaycastHit> &expected, const std::vector<dRaycastHit> &actual, dGeomID heightfield)
+{
+    for (size_t i = 0; i != expected.size(); ++i) {
+        const dRaycastHit &e = expected[i], &a = actual[i];
+        if (e.geom != a.geom) {
+            return false;
+        }
+        if (e.geom != NULL && e.geom == heightfield) {
+            if (!closeRaycastValue(e.depth, a.depth) || !closeRaycastValue(e.pos[0], a.pos[0]) || !closeRaycastValue(e.pos[1], a.pos[1]) 
+                || !closeRaycastValue(e.pos[2], a.pos[2]) || !closeRaycastValue(e.normal[0], a.normal[0]) 
+                || !closeRaycastValue(e.normal[1], a.normal[1]) || !closeRaycastValue(e.normal[2], a.normal[2])) {
+                return false;
+            }
+        }
+        else if (e.geom != NULL && (e.depth != a.depth || e.pos[0] != a.pos[0] || e.pos[1] != a.pos[1] || e.pos[2] != a.pos[2]
+            || e.normal[0] != a.normal[0] || e.normal[1] != a.normal[1] || e.normal[2] != a.normal[2])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(test_collision_space_raycast_batch)
+{
+    enum { RAY_COUNT = 203 };
+
+    dWorldID world = dWorldCreate();
+    dSpaceID space = dHashSpaceCreate(0);
+    dSpaceID subspace = dSimpleSpaceCreate(space);
+
+    // Spheres, boxes and capsules on a grid, some of them in a nested space
+    std::vector<dGeomID> geoms;
+    for (int i = 0; i != 10; ++i) {
+        for (int j = 0; j != 10; ++j) {
+            dSpaceID geomSpace = (i + 2 * j) % 5 == 0 ? subspace : space;
+            dGeomID geom = (i + j) % 3 == 0 ? dCreateBox(geomSpace, REAL(0.8), REAL(0.6), REAL(0.7)) 
+                : (i + j) % 3 == 1 ? dCreateSphere(geomSpace, REAL(0.4)) : dCreateCapsule(geomSpace, REAL(0.3), REAL(0.5));
+            dGeomSetPosition(geom, i * REAL(1.5), j * REAL(1.5), (i * j) % 4 * REAL(0.4) + REAL(1.0));
+            geoms.push_back(geom);
+        }
+    }
+    geoms.push_back(dCreatePlane(space, 0, 0, 1, 0));
+    // A Z up heightfield under the grid hit by the rays of all the threads
+    std::vector<unsigned char> samples;
+    fillHeightfieldTestSamples(samples);
+    dHeightfieldDataID heightfieldData = dGeomHeightfieldDataCreate();
+    dGeomHeightfieldDataBuildByte(heightfieldData, &samples[0], 0, 30, 22, HF_WIDTH_SAMPLES, HF_DEPTH_SAMPLES, REAL(0.01), 0, 1, 0);
+    dGeomID field = dCreateHeightfield(space, heightfieldData, 1);
+    dMatrix3 turn;
+    dRSetIdentity(turn);
+    turn[5] = 0; turn[6] = -1;
+    turn[9] = 1; turn[10] = 0;
+    dGeomSetRotation(field, turn);
+    dGeomSetPosition(field, 7, 7, 0);
+    geoms.push_back(field);
+    // A disabled geom and a geom of another category are never hit
+    dGeomID disabled = dCreateSphere(space, REAL(5.0));
+    dGeomSetPosition(disabled, REAL(7.0), REAL(7.0), REAL(2.0));
+    dGeomDisable(disabled);
+    dGeomID filtered = dCreateSphere(space, REAL(5.0));
+    dGeomSetPosition(filtered, REAL(7.0), REAL(7.0), REAL(2.0));
+    dGeomSetCategoryBits(filtered, 2);
+
+    // Rays fanning out from points above the grid, some of them too short to hit anything
+    std::vector<dReal> origins(RAY_COUNT * 3), directions(RAY_COUNT * 3), lengths(RAY_COUNT);
+    for (int r = 0; r != RAY_COUNT; ++r) {
+        origins[r * 3 + 0] = (r % 7) * REAL(2.0);
+        origins[r * 3 + 1] = (r % 11) * REAL(1.3);
+        origins[r * 3 + 2] = REAL(4.0);
+        directions[r * 3 + 0] = REAL(0.1) * (r % 13) - REAL(0.6);
+        directions[r * 3 + 1] = REAL(0.07) * (r % 17) - REAL(0.5);
+        directions[r * 3 + 2] = r % 29 == 0 ? REAL(0.0) : -REAL(1.0);
+        lengths[r] = r % 9 == 0 ? REAL(1.0) : REAL(20.0);
+    }
+
+    // The reference hits
+    std::vector<dRaycastHit> expected(RAY_COUNT);
+    dGeomID ray = dCreateRay(0, 1);
+    dGeomRaySetClosestHit(ray, 1);
+    unsigned expectedCount = 0;
+    for (int r = 0; r != RAY_COUNT; ++r) {
+        dGeomRaySet(ray, origins[r * 3], origins[r * 3 + 1], origins[r * 3 + 2], directions[r * 3], directions[r * 3 + 1], directions[r * 3 + 2]);
+        dGeomRaySetLength(ray, lengths[r]);
+        expected[r].geom = NULL;
+        for (size_t g = 0; g != geoms.size(); ++g) {
+            dContactGeom contact;
+            if (dCollide(ray, geoms[g], 1, &contact, sizeof(dContactGeom)) != 0 
+                && (expected[r].geom == NULL || contact.depth < expected[r].depth)) {
+                expected[r].geom = geoms[g];
+                dCopyVector3(expected[r].pos, contact.pos);
+                dCopyVector3(expected[r].normal, contact.normal);
+                expected[r].depth = contact.depth;
+            }
+        }
+        expectedCount += expected[r].geom != NULL ? 1 : 0;
+    }
+    dGeomDestroy(ray);
+    CHECK(expectedCount != 0 && expectedCount != RAY_COUNT);
+    unsigned fieldHits = 0;
+    for (int r = 0; r != RAY_COUNT; ++r) {
+        fieldHits += expected[r].geom == field ? 1 : 0;
+    }
+    CHECK(fieldHits > 20);
+
+    std::vector<dRaycastHit> hits(RAY_COUNT);
+    unsigned count = dSpaceRaycastBatch(NULL, 1, space, &origins[0], &directions[0], &lengths[0], RAY_COUNT, 1, &hits[0]);
+    CHECK_EQUAL(expectedCount, count);
+    CHECK(sameRaycastHits(expected, hits, field));
+
+    dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+    dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateMaskAll, NULL);
+    dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+    std::fill(hits.begin(), hits.end(), dRaycastHit());
+    count = dSpaceRaycastBatch(world, 5, space, &origins[0], &directions[0], &lengths[0], RAY_COUNT, 1, &hits[0]);
+    CHECK_EQUAL(expectedCount, count);
+    CHECK(sameRaycastHits(expected, hits, field));
+
+    dThreadingImplementationShutdownProcessing(threading);
+    dThreadingFreeThreadPool(pool);
+    dWorldSetStepThreadingImplementation(world, NULL, NULL);
+    dThreadingFreeImplementation(threading);
+
+    dSpaceDestroy(space);
+    dGeomHeightfieldDataDestroy(heightfieldData);
+    dWorldDestroy(world);
+}
@@ -3052,3 +3052,299 @@ SUITE(JointPiston)
 
 
 } // End of SUITE(JointPiston)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Testing the batched Contact Joint creation
+////////////////////////////////////////////////////////////////////////////////
+SUITE(JointContactBatch)
+{
+    // Enough contacts to span several joint group arenas
+    TEST(test_dJointCreateContactBatch)
+    {
+        const unsigned contactCount = 500;
+
+        dWorldID wId = dWorldCreate();
+        dSpaceID sId = dSimpleSpaceCreate(0);
+        dBodyID bId[3];
+        dGeomID gId[3];
+        for (int i = 0; i != 3; ++i) {
+            bId[i] = dBodyCreate(wId);
+            gId[i] = dCreateSphere(sId, 1);
+            dGeomSetBody(gId[i], bId[i]);
+        }
+        dGeomID staticGeom = dCreateSphere(sId, 1);
+
+        dContact contacts[contactCount];
+        dBodyID bodyPairs[2 * contactCount];
+        int b0Joints = 0;
+        for (unsigned i = 0; i != contactCount; ++i) {
+            dContact &c = contacts[i];
+            memset(&c, 0, sizeof(c));
+            c.surface.mode = dContactBounce;
+            c.surface.mu = i;
+            c.geom.g1 = gId[i % 3];
+            c.geom.g2 = i % 5 == 0 ? staticGeom : gId[(i + 1) % 3];
+            c.geom.normal[2] = 1;
+            bodyPairs[2 * i] = dGeomGetBody(c.geom.g1);
+            bodyPairs[2 * i + 1] = dGeomGetBody(c.geom.g2);
+            b0Joints += (bodyPairs[2 * i] == bId[0]) + (bodyPairs[2 * i + 1] == bId[0]);
+        }
+
+        dJointGroupID groupId = dJointGroupCreate(0);
+        dJointID joints[contactCount];
+        dJointCreateContactBatch(wId, groupId, contacts, contactCount, NULL, joints);
+
+        for (unsigned i = 0; i != contactCount; ++i) {
+            CHECK_EQUAL(dJointTypeContact, dJointGetType(joints[i]));
+            CHECK_EQUAL(bodyPairs[2 * i], dJointGetBody(joints[i], 0));
+            CHECK_EQUAL(bodyPairs[2 * i + 1], dJointGetBody(joints[i], 1));
+            CHECK_EQUAL(dReal(i), ((dxJointContact *)joints[i])->contact.surface.mu);
+        }
+
+        // The bodies list the joints just as with dJointAttach
+        CHECK_EQUAL(b0Joints, dBodyGetNumJoints(bId[0]));
+
+        dJointGroupEmpty(groupId);
+        CHECK_EQUAL(0, dBodyGetNumJoints(bId[0]));
+
+        // The same with the explicit body pairs and without a group
+        dJointCreateContactBatch(wId, 0, contacts, contactCount, bodyPairs, joints);
+        CHECK_EQUAL(b0Joints, dBodyGetNumJoints(bId[0]));
+        CHECK_EQUAL(bodyPairs[3], dJointGetBody(joints[1], 1));
+        for (unsigned i = 0; i != contactCount; ++i) {
+            dJointDestroy(joints[i]);
+        }
+        CHECK_EQUAL(0, dBodyGetNumJoints(bId[0]));
+
+        dJointGroupDestroy(groupId);
+        dSpaceDestroy(sId);
+        dWorldDestroy(wId);
+    }
+} // End of SUITE(JointContactBatch)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Testing the cooperative LCP solving of large dWorldStep islands
+//
+////////////////////////////////////////////////////////////////////////////////
+SUITE(JointChainCooperativeStep)
+{
+    const int LINK_COUNT = 40;
+
+    // steps a hanging ball-joint chain and stores the final link positions;
+    // the links are braced to the second previous ones to make loops for the 
+    // island to be solved densely; with motors the LCP has bounded rows as well
+    static void stepChain(bool threaded, bool withMotors, dReal *positions)
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -9.81);
+
+        dThreadingImplementationID threading = NULL;
+        dThreadingThreadPoolID pool = NULL;
+        if (threaded) {
+            threading = dThreadingAllocateMultiThreadedImplementation();
+            pool = dThreadingAllocateThreadPool(4, 0, dAllocateFlagBasicData, NULL);
+            dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+            dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+        }
+
+        dBodyID bodies[LINK_COUNT];
+        dBodyID previous = NULL;
+        for (int i = 0; i != LINK_COUNT; ++i) {
+            dBodyID body = dBodyCreate(world);
+            bodies[i] = body;
+            dMass mass;
+            dMassSetBoxTotal(&mass, 1, 0.2, 0.2, 0.2);
+            dBodySetMass(body, &mass);
+            dBodySetPosition(body, REAL(0.25) * i, 0, 0);
+
+            dJointID ball = dJointCreateBall(world, 0);
+            dJointAttach(ball, body, previous);
+            dJointSetBallAnchor(ball, REAL(0.25) * i - REAL(0.125), 0, 0);
+
+            if (i >= 2) {
+                dJointID brace = dJointCreateBall(world, 0);
+                dJointAttach(brace, body, bodies[i - 2]);
+                dJointSetBallAnchor(brace, REAL(0.25) * (i - 1), 0, 0);
+            }
+
+            if (withMotors) {
+                dJointID motor = dJointCreateAMotor(world, 0);
+                dJointAttach(motor, body, previous);
+                dJointSetAMotorNumAxes(motor, 1);
+                dJointSetAMotorAxis(motor, 0, 1, 0, 1, 0);
+                dJointSetAMotorParam(motor, dParamVel, 0);
+                dJointSetAMotorParam(motor, dParamFMax, 2);
+            }
+            previous = body;
+        }
+
+        for (int step = 0; step != 20; ++step) {
+            dWorldStep(world, REAL(0.01));
+        }
+
+        for (int i = 0; i != LINK_COUNT; ++i) {
+            const dReal *pos = dBodyGetPosition(bodies[i]);
+            positions[3 * i] = pos[0];
+            positions[3 * i + 1] = pos[1];
+            positions[3 * i + 2] = pos[2];
+        }
+
+        if (threaded) {
+            dThreadingImplementationShutdownProcessing(threading);
+            dThreadingFreeThreadPool(pool);
+            dWorldSetStepThreadingImplementation(world, NULL, NULL);
+            dThreadingFreeImplementation(threading);
+        }
+        dWorldDestroy(world);
+    }
+
+    // returns the largest position difference between the single threaded and the threaded steps
+    static dReal calcThreadedStepDeviation(bool withMotors)
+    {
+        dReal expected[3 * LINK_COUNT], actual[3 * LINK_COUNT];
+        stepChain(false, withMotors, expected);
+        stepChain(true, withMotors, actual);
+        dReal deviation = 0;
+        for (int i = 0; i != 3 * LINK_COUNT; ++i) {
+            dReal difference = dFabs(expected[i] - actual[i]);
+            deviation = difference <= deviation ? deviation : difference; // keeps NaNs
+        }
+        return deviation;
+    }
+
+    TEST(test_AllUnboundedChain)
+    {
+        CHECK_CLOSE(0, calcThreadedStepDeviation(false), 1e-4);
+    }
+
+    TEST(test_MotorizedChain)
+    {
+        CHECK_CLOSE(0, calcThreadedStepDeviation(true), 1e-4);
+    }
+} // End of SUITE(JointChainCooperativeStep)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Testing the tree-structured solving of jointed dWorldStep islands
+//
+// The chains are compared to the same chains with extra motors too weak to
+// have any effect but making the islands to be solved densely.
+////////////////////////////////////////////////////////////////////////////////
+SUITE(JointTreeStep)
+{
+    const int LINK_COUNT = 30;
+
+    // The rounding of the two solving orders adds up over the steps,
+    // the chains with loops giving about ten times the deviation.
+#ifdef dDOUBLE
+    const dReal TREE_STEP_TOLERANCE = REAL(1e-6);
+#else
+    const dReal TREE_STEP_TOLERANCE = 1000 * dEpsilon;
+#endif
+
+    enum ChainExtras
+    {
+        CE_NONE         = 0,
+        CE_LOOP         = 1, // the last link is jointed to the first one
+        CE_MOTORS       = 2, // every fifth link is driven by a motor with bounded force
+        CE_DENSE        = 4, // the weak motors forcing the dense solving
+        CE_KINEMATIC    = 8, // the chain hangs from a kinematic body
+    };
+
+    static void stepChain(int extras, dReal *positions)
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -9.81);
+
+        dBodyID bodies[LINK_COUNT];
+        dBodyID previous = NULL;
+        if (extras & CE_KINEMATIC) {
+            previous = dBodyCreate(world);
+            dBodySetKinematic(previous);
+            dBodySetPosition(previous, -REAL(0.25), 0, 0);
+            dBodySetLinearVel(previous, 0, REAL(0.5), 0);
+        }
+        for (int i = 0; i != LINK_COUNT; ++i) {
+            dBodyID body = dBodyCreate(world);
+            bodies[i] = body;
+            dMass mass;
+            dMassSetBoxTotal(&mass, 1, 0.2, 0.1, 0.3);
+            dBodySetMass(body, &mass);
+            dBodySetPosition(body, REAL(0.25) * i, REAL(0.01) * i, 0);
+
+            dJointID hinge = dJointCreateHinge(world, 0);
+            dJointAttach(hinge, body, previous);
+            dJointSetHingeAnchor(hinge, REAL(0.25) * i - REAL(0.125), REAL(0.01) * i, 0);
+            dJointSetHingeAxis(hinge, 0, 1, REAL(0.2) * (i % 3));
+
+            if ((extras & CE_MOTORS) && i % 5 == 0) {
+                dJointSetHingeParam(hinge, dParamVel, 1);
+                dJointSetHingeParam(hinge, dParamFMax, REAL(0.5));
+            }
+            if (extras & CE_DENSE) {
+                dJointID motor = dJointCreateAMotor(world, 0);
+                dJointAttach(motor, body, previous);
+                dJointSetAMotorNumAxes(motor, 2);
+                dJointSetAMotorAxis(motor, 0, 1, 1, 0, 0);
+                dJointSetAMotorAxis(motor, 1, 1, 0, 0, 1);
+                dJointSetAMotorParam(motor, dParamFMax, REAL(1e-12));
+                dJointSetAMotorParam(motor, dParamFMax2, REAL(1e-12));
+            }
+            previous = body;
+        }
+        if (extras & CE_LOOP) {
+            dJointID ball = dJointCreateBall(world, 0);
+            dJointAttach(ball, bodies[LINK_COUNT - 1], bodies[0]);
+            dJointSetBallAnchor(ball, REAL(0.25) * (LINK_COUNT - 1), REAL(0.01) * (LINK_COUNT - 1), 0);
+        }
+
+        for (int step = 0; step != 20; ++step) {
+            dWorldStep(world, REAL(0.01));
+        }
+
+        for (int i = 0; i != LINK_COUNT; ++i) {
+            const dReal *pos = dBodyGetPosition(bodies[i]);
+            positions[3 * i] = pos[0];
+            positions[3 * i + 1] = pos[1];
+            positions[3 * i + 2] = pos[2];
+        }
+
+        dWorldDestroy(world);
+    }
+
+    // returns the largest position difference between the tree-structured and the dense solving
+    static dReal calcTreeStepDeviation(int extras)
+    {
+        dReal expected[3 * LINK_COUNT], actual[3 * LINK_COUNT];
+        stepChain(extras | CE_DENSE, expected);
+        stepChain(extras, actual);
+        dReal deviation = 0;
+        for (int i = 0; i != 3 * LINK_COUNT; ++i) {
+            dReal difference = dFabs(expected[i] - actual[i]);
+            deviation = difference <= deviation ? deviation : difference; // keeps NaNs
+        }
+        return deviation;
+    }
+
+    TEST(test_Chain)
+    {
+        CHECK_CLOSE(0, calcTreeStepDeviation(CE_NONE), TREE_STEP_TOLERANCE);
+    }
+
+    TEST(test_ChainLoop)
+    {
+        CHECK_CLOSE(0, calcTreeStepDeviation(CE_LOOP), 10 * TREE_STEP_TOLERANCE);
+    }
+
+    TEST(test_ChainMotors)
+    {
+        CHECK_CLOSE(0, calcTreeStepDeviation(CE_MOTORS), TREE_STEP_TOLERANCE);
+    }
+
+    TEST(test_KinematicChainLoopMotors)
+    {
+        CHECK_CLOSE(0, calcTreeStepDeviation(CE_KINEMATIC | CE_LOOP | CE_MOTORS), 10 * TREE_STEP_TOLERANCE);
+    }
+} // End of SUITE(JointTreeStep)
@@ -0,0 +1,147 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+//234567890123456789012345678901234567890123456789012345678901234567890123456789
+//        1         2         3         4         5         6         7
+
+////////////////////////////////////////////////////////////////////////////////
+// This file creates unit tests for some of the functions found in:
+// ode/src/matrix.cpp
+// ode/src/lcp.cpp
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <UnitTest++.h>
+#include <ode/ode.h>
+
+#include <cmath>
+#include <vector>
+
+
+// Defined in ode/src/lcp.cpp
+extern "C" ODE_API dReal dTestLCPCachedDell(unsigned n, unsigned problemCount);
+
+
+SUITE(LCPFactorizationUpdates)
+{
+    // The column at a time dLDLTAddTL() the blocked one replaced
+    static void referenceLDLTAddTL(dReal *L, dReal *d, const dReal *a, int n, int nskip)
+    {
+        if (n < 2) return;
+
+        std::vector<dReal> W1(n), W2(n);
+        W1[0] = W2[0] = 0;
+        for (int j = 1; j < n; ++j) {
+            W1[j] = W2[j] = (dReal)(a[j] * M_SQRT1_2);
+        }
+        dReal W11 = (dReal)((REAL(0.5) * a[0] + 1) * M_SQRT1_2);
+        dReal W21 = (dReal)((REAL(0.5) * a[0] - 1) * M_SQRT1_2);
+
+        dReal alpha1 = 1, alpha2 = 1;
+        {
+            dReal dee = d[0];
+            dReal alphanew = alpha1 + (W11 * W11) * dee;
+            dee /= alphanew;
+            dReal gamma1 = W11 * dee;
+            dee *= alpha1;
+            alpha1 = alphanew;
+            alphanew = alpha2 - (W21 * W21) * dee;
+            alpha2 = alphanew;
+            dReal k1 = 1 - W21 * gamma1;
+            dReal k2 = W21 * gamma1 * W11 - W21;
+            for (int p = 1; p < n; ++p) {
+                dReal Wp = W1[p], ell = L[p * nskip];
+                W1[p] = Wp - W11 * ell;
+                W2[p] = k1 * Wp + k2 * ell;
+            }
+        }
+
+        for (int j = 1; j < n; ++j) {
+            dReal k1 = W1[j], k2 = W2[j];
+            dReal dee = d[j];
+            dReal alphanew = alpha1 + (k1 * k1) * dee;
+            dee /= alphanew;
+            dReal gamma1 = k1 * dee;
+            dee *= alpha1;
+            alpha1 = alphanew;
+            alphanew = alpha2 - (k2 * k2) * dee;
+            dee /= alphanew;
+            dReal gamma2 = k2 * dee;
+            dee *= alpha2;
+            d[j] = dee;
+            alpha2 = alphanew;
+
+            for (int p = j + 1; p < n; ++p) {
+                dReal ell = L[p * nskip + j];
+                dReal Wp = W1[p] - k1 * ell;
+                ell += gamma1 * Wp;
+                W1[p] = Wp;
+                Wp = W2[p] - k2 * ell;
+                ell -= gamma2 * Wp;
+                W2[p] = Wp;
+                L[p * nskip + j] = ell;
+            }
+        }
+    }
+
+    TEST(test_dLDLTAddTL_matches_column_update)
+    {
+        dRandSetSeed(1);
+
+        // sizes around the block width cover the partial blocks at both ends
+        for (int n = 1; n <= 23; ++n) {
+            const int nskip = dPAD(n);
+            std::vector<dReal> A(n * nskip), A2(n * nskip), L(n * nskip), d(n), a(n);
+
+            // a positive definite A with eigenvalues above n
+            dMakeRandomMatrix(&A2[0], n, n, 1.0);
+            dMultiply2(&A[0], &A2[0], &A2[0], n, n, n);
+            for (int i = 0; i < n; ++i) A[i * nskip + i] += n;
+
+            L = A;
+            dFactorLDLT(&L[0], &d[0], n, nskip);
+
+            // a small enough top left update keeps the sum positive definite
+            dMakeRandomVector(&a[0], n, 0.5);
+            a[0] = dFabs(a[0]);
+
+            std::vector<dReal> Lref(L), dref(d);
+            referenceLDLTAddTL(&Lref[0], &dref[0], &a[0], n, nskip);
+            dLDLTAddTL(&L[0], &d[0], &a[0], n, nskip);
+
+            for (int i = 1; i < n; ++i) {
+                CHECK_CLOSE(dref[i], d[i], REAL(1e-5) * dFabs(dref[i]));
+                for (int j = 1; j < i; ++j) {
+                    CHECK_CLOSE(Lref[i * nskip + j], L[i * nskip + j], REAL(1e-4));
+                }
+            }
+        }
+    }
+
+    TEST(test_dLCP_cached_Dell_matches_fresh_solve)
+    {
+        dRandSetSeed(1);
+
+        for (unsigned n = 3; n <= 43; n += 8) {
+            CHECK(dTestLCPCachedDell(n, 5) < REAL(1e-4));
+        }
+    }
+}
@@ -0,0 +1,686 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+//234567890123456789012345678901234567890123456789012345678901234567890123456789
+//        1         2         3         4         5         6         7
+
+////////////////////////////////////////////////////////////////////////////////
+// This file creates unit tests for some of the functions found in:
+// ode/src/quickstep.cpp
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <UnitTest++.h>
+#include <ode/ode.h>
+#include "../ode/src/config.h"
+#include "../ode/src/simd.h"
+
+#include <string>
+
+
+// The world with a ground plane and the contact handling shared by the scenes
+// of boxes the suites below set up
+struct BoxSceneSetup
+{
+    dWorldID world;
+    dSpaceID space;
+    dJointGroupID contacts;
+    dThreadingImplementationID threading;
+    dThreadingThreadPoolID pool;
+
+    BoxSceneSetup(): threading(NULL), pool(NULL)
+    {
+        world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -10);
+
+        space = dSimpleSpaceCreate(0);
+        dCreatePlane(space, 0, 0, 1, 0);
+
+        contacts = dJointGroupCreate(0);
+    }
+
+    ~BoxSceneSetup()
+    {
+        dJointGroupDestroy(contacts);
+        dSpaceDestroy(space);
+
+        if (threading != NULL) {
+            dThreadingImplementationShutdownProcessing(threading);
+            dThreadingFreeThreadPool(pool);
+            dWorldSetStepThreadingImplementation(world, NULL, NULL);
+            dThreadingFreeImplementation(threading);
+        }
+
+        dWorldDestroy(world);
+    }
+
+    void useThreads(unsigned threadCount)
+    {
+        threading = dThreadingAllocateMultiThreadedImplementation();
+        pool = dThreadingAllocateThreadPool(threadCount, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+    }
+
+    dBodyID createBox(dReal x, dReal y, dReal z, dReal lx, dReal ly, dReal lz)
+    {
+        dBodyID body = dBodyCreate(world);
+        dMass m;
+        dMassSetBoxTotal(&m, 1, lx, ly, lz);
+        dBodySetMass(body, &m);
+        dBodySetPosition(body, x, y, z);
+
+        dGeomID box = dCreateBox(space, lx, ly, lz);
+        dGeomSetBody(box, body);
+        return body;
+    }
+
+    static void nearCallback(void *data, dGeomID o1, dGeomID o2)
+    {
+        BoxSceneSetup *setup = (BoxSceneSetup *)data;
+
+        dContact contact[4];
+        int n = dCollide(o1, o2, 4, &contact[0].geom, sizeof(contact[0]));
+        for (int i = 0; i != n; ++i) {
+            contact[i].surface.mode = 0;
+            contact[i].surface.mu = 1;
+
+            dJointID joint = dJointCreateContact(setup->world, setup->contacts, contact + i);
+            dJointAttach(joint, dGeomGetBody(o1), dGeomGetBody(o2));
+        }
+    }
+
+    void simulate(int stepCount)
+    {
+        for (int i = 0; i != stepCount; ++i) {
+            dSpaceCollide(space, this, &nearCallback);
+            dWorldQuickStep(world, REAL(0.01));
+            dJointGroupEmpty(contacts);
+        }
+    }
+};
+
+
+SUITE(QuickStepWarmStarting)
+{
+    struct BoxStackSetup: BoxSceneSetup
+    {
+        enum { BOX_COUNT = 8 };
+
+        dBodyID bodies[BOX_COUNT];
+
+        BoxStackSetup()
+        {
+            for (int i = 0; i != BOX_COUNT; ++i) {
+                bodies[i] = createBox(0, 0, REAL(0.5) + i, 1, 1, 1);
+            }
+        }
+    };
+
+    TEST_FIXTURE(BoxStackSetup, test_Parameters)
+    {
+        CHECK_EQUAL((int)dWorldQuickStepWarmStartNone, dWorldGetQuickStepWarmStarting(world));
+        CHECK_CLOSE(dWORLDQUICKSTEP_WARM_STARTING_FACTOR_DEFAULT, dWorldGetQuickStepWarmStartingFactor(world), 1e-6);
+        CHECK_CLOSE(dWORLDQUICKSTEP_WARM_STARTING_CONTACT_TOLERANCE_DEFAULT, dWorldGetQuickStepWarmStartingContactTolerance(world), 1e-6);
+
+        dWorldSetQuickStepWarmStarting(world, dWorldQuickStepWarmStartAll);
+        dWorldSetQuickStepWarmStartingFactor(world, REAL(0.5));
+        dWorldSetQuickStepWarmStartingContactTolerance(world, REAL(0.1));
+
+        CHECK_EQUAL((int)dWorldQuickStepWarmStartAll, dWorldGetQuickStepWarmStarting(world));
+        CHECK_CLOSE(REAL(0.5), dWorldGetQuickStepWarmStartingFactor(world), 1e-6);
+        CHECK_CLOSE(REAL(0.1), dWorldGetQuickStepWarmStartingContactTolerance(world), 1e-6);
+    }
+
+    // returns how far the top box has sunk with the stack solved with few iterations
+    static dReal calcStackSinking(int warmStarting)
+    {
+        BoxStackSetup setup;
+        dWorldSetQuickStepNumIterations(setup.world, 4);
+        dWorldSetQuickStepWarmStarting(setup.world, warmStarting);
+
+        setup.simulate(500);
+
+        const dReal *pos = dBodyGetPosition(setup.bodies[BoxStackSetup::BOX_COUNT - 1]);
+        return REAL(0.5) + (BoxStackSetup::BOX_COUNT - 1) - pos[2];
+    }
+
+    TEST(test_StackSettling)
+    {
+        // A stack solved from zero impulses sinks noticeably
+        // while the impulses carried over from the previous steps keep it upright
+        dReal coldSinking = calcStackSinking(dWorldQuickStepWarmStartNone);
+        dReal warmSinking = calcStackSinking(dWorldQuickStepWarmStartContacts);
+
+        CHECK(warmSinking < REAL(0.5) * coldSinking);
+        CHECK_CLOSE(0, warmSinking, 1e-2);
+    }
+}
+
+SUITE(QuickStepIterationScheduling)
+{
+    struct BrickWallSetup: BoxSceneSetup
+    {
+        enum { WALL_WIDTH = 8, WALL_HEIGHT = 6, BRICK_COUNT = WALL_WIDTH * WALL_HEIGHT };
+
+        dBodyID bodies[BRICK_COUNT];
+
+        BrickWallSetup()
+        {
+            // Layers are shifted by half a brick to tie the wall into a single island
+            for (int layer = 0; layer != WALL_HEIGHT; ++layer) {
+                for (int i = 0; i != WALL_WIDTH; ++i) {
+                    bodies[layer * WALL_WIDTH + i] = createBox(2 * i + (layer % 2), 0, REAL(0.5) + layer, 2, 1, 1);
+                }
+            }
+        }
+    };
+
+    TEST_FIXTURE(BrickWallSetup, test_Parameters)
+    {
+        CHECK_EQUAL((int)dWorldQuickStepIterationSchedulingDependencyMap, dWorldGetQuickStepIterationScheduling(world));
+
+        dWorldSetQuickStepIterationScheduling(world, dWorldQuickStepIterationSchedulingColoring);
+        CHECK_EQUAL((int)dWorldQuickStepIterationSchedulingColoring, dWorldGetQuickStepIterationScheduling(world));
+    }
+
+    TEST_FIXTURE(BrickWallSetup, test_ColoredWallStanding)
+    {
+        useThreads(4);
+        dWorldSetQuickStepIterationScheduling(world, dWorldQuickStepIterationSchedulingColoring);
+        simulate(200);
+
+        // The end bricks of odd layers overhang and fall off -- check the middle ones
+        for (int layer = 0; layer != WALL_HEIGHT; ++layer) {
+            const dReal *pos = dBodyGetPosition(bodies[layer * WALL_WIDTH + WALL_WIDTH / 2]);
+            CHECK_CLOSE(REAL(0.5) + layer, pos[2], 1e-2);
+        }
+    }
+}
+
+SUITE(QuickStepSIMDKernel)
+{
+    TEST(test_Vector6Operations)
+    {
+#if defined(dSIMD_ENABLED)
+        dReal a[6] = { REAL(1.5), REAL(-2.0), REAL(0.25), REAL(3.0), REAL(-0.5), REAL(4.0) };
+        const dReal b[6] = { REAL(2.0), REAL(0.5), REAL(-4.0), REAL(1.0), REAL(6.0), REAL(-0.25) };
+
+        dReal dot = 0;
+        for (int i = 0; i != 6; ++i) dot += a[i] * b[i];
+        CHECK_CLOSE(dot, dxSIMDDot6(a, b), 1e-6);
+
+        dReal expected[6];
+        for (int i = 0; i != 6; ++i) expected[i] = a[i] + b[i] * REAL(0.5);
+
+        // Check the neighbors are not touched
+        dReal padded[8] = { REAL(7.0), a[0], a[1], a[2], a[3], a[4], a[5], REAL(7.0) };
+        dxSIMDAddScaled6(padded + 1, b, REAL(0.5));
+        CHECK_ARRAY_CLOSE(expected, padded + 1, 6, 1e-6);
+        CHECK_EQUAL(REAL(7.0), padded[0]);
+        CHECK_EQUAL(REAL(7.0), padded[7]);
+#endif
+    }
+}
+
+
+SUITE(QuickStepSleepingIslands)
+{
+    struct FallingBoxSetup: BoxSceneSetup
+    {
+        FallingBoxSetup()
+        {
+            dWorldSetAutoDisableFlag(world, 1);
+        }
+    };
+
+    TEST_FIXTURE(FallingBoxSetup, test_SleepAndWakeByContact)
+    {
+        dBodyID lower = createBox(0, 0, REAL(0.5), 1, 1, 1);
+
+        simulate(200);
+        CHECK(!dBodyIsEnabled(lower));
+
+        // A box falling onto the sleeping one must wake it through the contacts
+        dBodyID upper = createBox(0, 0, REAL(3.0), 1, 1, 1);
+        bool lowerWoken = false;
+
+        for (int i = 0; i != 200 && !lowerWoken; ++i) {
+            simulate(1);
+            lowerWoken = dBodyIsEnabled(lower) != 0;
+        }
+        CHECK(lowerWoken);
+
+        simulate(500);
+        CHECK(!dBodyIsEnabled(lower));
+        CHECK(!dBodyIsEnabled(upper));
+
+        const dReal *pos = dBodyGetPosition(upper);
+        CHECK_CLOSE(REAL(1.5), pos[2], 1e-2);
+    }
+
+    TEST_FIXTURE(FallingBoxSetup, test_ManualEnableDisable)
+    {
+        dBodyID first = createBox(0, 0, REAL(0.5), 1, 1, 1);
+        dBodyID second = createBox(0, 0, REAL(5.0), 1, 1, 1);
+        dBodyDisable(second);
+
+        simulate(10);
+        // A disabled body is not simulated
+        CHECK_CLOSE(REAL(5.0), dBodyGetPosition(second)[2], 1e-6);
+
+        dBodyEnable(second);
+        dBodyDisable(second);
+        dBodyEnable(second);
+        simulate(1);
+        CHECK(dBodyGetPosition(second)[2] < REAL(5.0));
+
+        dBodyDisable(first);
+        dBodyDestroy(first);
+        simulate(1);
+        CHECK(dBodyIsEnabled(second));
+    }
+}
+
+
+SUITE(QuickStepIslandsScheduling)
+{
+    static 
+    int countMissteppedBodies(dThreadingImplementationID threading)
+    {
+        // Chains of different lengths make islands of different costs;
+        // each must be stepped exactly once per step whatever order they are processed in
+        enum { CHAIN_COUNT = 12, STEP_COUNT = 10, MAX_BODY_COUNT = 1024 };
+        dBodyID bodies[MAX_BODY_COUNT];
+        int bodyCount = 0;
+
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -10);
+
+        dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+        for (int chain = 0; chain != CHAIN_COUNT; ++chain) {
+            dBodyID previous = NULL;
+            for (int i = 0; i <= chain * chain; ++i) {
+                dBodyID body = dBodyCreate(world);
+                dBodySetPosition(body, 3 * chain, i, 0);
+                bodies[bodyCount++] = body;
+
+                if (previous != NULL) {
+                    dJointID joint = dJointCreateBall(world, 0);
+                    dJointAttach(joint, previous, body);
+                    dJointSetBallAnchor(joint, 3 * chain, i - REAL(0.5), 0);
+                }
+                previous = body;
+            }
+        }
+
+        for (int i = 0; i != STEP_COUNT; ++i) {
+            dWorldQuickStep(world, REAL(0.01));
+        }
+
+        int missteppedCount = 0;
+        for (int i = 0; i != bodyCount; ++i) {
+            if (dFabs(REAL(-10.0) * REAL(0.01) * STEP_COUNT - dBodyGetLinearVel(bodies[i])[2]) > 1e-6) {
+                ++missteppedCount;
+            }
+        }
+
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dWorldSetStepThreadingImplementation(world, NULL, NULL);
+        dThreadingFreeImplementation(threading);
+        dWorldDestroy(world);
+
+        return missteppedCount;
+    }
+
+    TEST(test_AllIslandsStepped)
+    {
+        CHECK_EQUAL(0, countMissteppedBodies(dThreadingAllocateMultiThreadedImplementation()));
+    }
+
+    TEST(test_AllIslandsSteppedWorkStealing)
+    {
+        CHECK_EQUAL(0, countMissteppedBodies(dThreadingAllocateWorkStealingMultiThreadedImplementation()));
+    }
+}
+
+
+SUITE(QuickStepBodyIntegration)
+{
+    const int BODY_COUNT = 23;
+
+    static bool closeVectors(const dReal *a, const dReal *b, int count, dReal tolerance)
+    {
+        for (int i = 0; i != count; ++i) {
+            if (dFabs(a[i] - b[i]) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TEST(test_BatchedIntegrationMatchesScalar)
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, 0);
+        dSpaceID space = dSimpleSpaceCreate(0);
+
+        const dReal stepsize = REAL(0.01);
+        dBodyID bodies[BODY_COUNT];
+        dVector3 positions[BODY_COUNT];
+        dQuaternion orientations[BODY_COUNT];
+        dBodyID previous = NULL;
+        for (int i = 0; i != BODY_COUNT; ++i) {
+            dBodyID body = dBodyCreate(world);
+            dMass mass;
+            dMassSetBoxTotal(&mass, 1, 1, 2, 3);
+            dBodySetMass(body, &mass);
+            dBodySetPosition(body, i, REAL(0.5) * i, -i);
+            dBodySetLinearVel(body, 1, -REAL(0.1) * i, REAL(0.2));
+            dBodySetAngularVel(body, REAL(0.3) * i, 1 - REAL(0.05) * i, REAL(2.0));
+            dQuaternion q;
+            dQFromAxisAndAngle(q, 1, 1, REAL(0.1) * i, REAL(0.2) * i);
+            dBodySetQuaternion(body, q);
+
+            if (i % 7 == 3) {
+                dBodySetFiniteRotationMode(body, 1);
+            }
+            if (i == 5) {
+                dBodySetMaxAngularSpeed(body, REAL(1.0));
+            }
+            // null joints join the bodies into a single island without adding constraints
+            if (previous != NULL) {
+                dJointAttach(dJointCreateNull(world, 0), previous, body);
+            }
+            previous = body;
+            bodies[i] = body;
+        }
+
+        dGeomID box = dCreateBox(space, 1, 1, 1);
+        dGeomSetBody(box, bodies[BODY_COUNT - 2]);
+        dReal aabb[6];
+        dGeomGetAABB(box, aabb);
+
+        for (int step = 0; step != 3; ++step) {
+            for (int i = 0; i != BODY_COUNT; ++i) {
+                dCopyVector3(positions[i], dBodyGetPosition(bodies[i]));
+                dCopyVector4(orientations[i], dBodyGetQuaternion(bodies[i]));
+            }
+
+            dWorldQuickStep(world, stepsize);
+
+            for (int i = 0; i != BODY_COUNT; ++i) {
+                const dReal *lvel = dBodyGetLinearVel(bodies[i]);
+                dVector3 pos;
+                for (int j = 0; j != 3; ++j) pos[j] = positions[i][j] + stepsize * lvel[j];
+                CHECK(closeVectors(pos, dBodyGetPosition(bodies[i]), 3, REAL(1e-5)));
+
+                const dReal *q = dBodyGetQuaternion(bodies[i]);
+                if (i % 7 != 3) {
+                    dQuaternion expected, dq;
+                    dWtoDQ(dBodyGetAngularVel(bodies[i]), orientations[i], dq);
+                    for (int j = 0; j != 4; ++j) expected[j] = orientations[i][j] + stepsize * dq[j];
+                    dNormalize4(expected);
+                    CHECK(closeVectors(expected, q, 4, REAL(1e-5)));
+                }
+
+                dMatrix3 R;
+                dQtoR(q, R);
+                CHECK(closeVectors(R, dBodyGetRotation(bodies[i]), 12, REAL(1e-5)));
+            }
+            CHECK(dCalcVectorLength3(dBodyGetAngularVel(bodies[5])) <= REAL(1.0) + REAL(1e-5));
+
+            const dReal *boxPos = dBodyGetPosition(bodies[BODY_COUNT - 2]);
+            dGeomGetAABB(box, aabb);
+            for (int j = 0; j != 3; ++j) {
+                CHECK(aabb[2 * j] < boxPos[j] && boxPos[j] < aabb[2 * j + 1]);
+                CHECK_CLOSE(boxPos[j], REAL(0.5) * (aabb[2 * j] + aabb[2 * j + 1]), REAL(1e-5));
+            }
+        }
+
+        dSpaceDestroy(space);
+        dWorldDestroy(world);
+    }
+}
+
+
+SUITE(StepProfiling)
+{
+    static 
+    dWorldID createPendulumWorld()
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -10);
+
+        dBodyID previous = NULL;
+        for (int i = 0; i != 8; ++i) {
+            dBodyID body = dBodyCreate(world);
+            dBodySetPosition(body, 0, 0, -i);
+
+            dJointID joint = dJointCreateBall(world, 0);
+            dJointAttach(joint, body, previous);
+            dJointSetBallAnchor(joint, 0, 0, REAL(0.5) - i);
+            previous = body;
+        }
+
+        return world;
+    }
+
+    // Checks the results of the last step against the stage hierarchy
+    static 
+    bool areStageTimesConsistent(dWorldID world, int firstStepperStage, int lastStepperStage)
+    {
+        dStepProfileStageInfo total, stepping;
+        if (!dWorldGetStepProfileStage(world, dStepProfileStageTotal, &total)
+            || !dWorldGetStepProfileStage(world, dStepProfileStageIslandStepping, &stepping)) {
+            return false;
+        }
+        if (total.parent != -1 || total.callCount != 1 
+            || stepping.parent != dStepProfileStageTotal || stepping.callCount == 0) {
+            return false;
+        }
+
+        double childrenTime = 0;
+        for (int stage = firstStepperStage; stage <= lastStepperStage; ++stage) {
+            dStepProfileStageInfo info;
+            if (!dWorldGetStepProfileStage(world, stage, &info)
+                || info.parent != dStepProfileStageIslandStepping || info.callCount == 0
+                || !(info.selfTime >= 0 && info.totalTime >= info.selfTime)) {
+                return false;
+            }
+            childrenTime += info.totalTime;
+        }
+
+        return stepping.totalTime >= childrenTime * (1 - 1e-9)
+            && total.totalTime >= stepping.totalTime * (1 - 1e-9)
+            && dWorldGetStepProfileThreadCount(world) != 0
+            && dWorldGetStepProfileThreadTime(world, 0, dStepProfileStageTotal) > 0;
+    }
+
+    TEST(test_DisabledByDefault)
+    {
+        dWorldID world = createPendulumWorld();
+
+        dWorldQuickStep(world, REAL(0.01));
+
+        dStepProfileStageInfo info;
+        CHECK_EQUAL(0, dWorldGetStepProfiling(world));
+        CHECK_EQUAL(0, dWorldGetStepProfileStage(world, dStepProfileStageTotal, &info));
+        CHECK_EQUAL(0U, dWorldGetStepProfileThreadCount(world));
+
+        dWorldSetStepProfiling(world, 1);
+        CHECK_EQUAL(1, dWorldGetStepProfiling(world));
+        CHECK_EQUAL(0, dWorldGetStepProfileStage(world, dStepProfileStageTotal, &info));
+
+        dWorldSetStepProfiling(world, 0);
+        CHECK_EQUAL(0, dWorldGetStepProfiling(world));
+
+        dWorldDestroy(world);
+    }
+
+    TEST(test_QuickStepStages)
+    {
+        dWorldID world = createPendulumWorld();
+        dWorldSetStepProfiling(world, 1);
+
+        dWorldQuickStep(world, REAL(0.01));
+        CHECK(areStageTimesConsistent(world, dStepProfileStageQuickStep0, dStepProfileStageQuickStep6));
+
+        dStepProfileStageInfo info;
+        CHECK(dWorldGetStepProfileStage(world, dStepProfileStageBodyIntegration, &info));
+        CHECK(info.callCount != 0);
+        CHECK(dWorldGetStepProfileStage(world, dStepProfileStageStep0, &info));
+        CHECK_EQUAL(0U, info.callCount);
+
+        dWorldDestroy(world);
+    }
+
+    TEST(test_StepStages)
+    {
+        dWorldID world = createPendulumWorld();
+        dWorldSetStepProfiling(world, 1);
+
+        dWorldStep(world, REAL(0.01));
+        CHECK(areStageTimesConsistent(world, dStepProfileStageStep0, dStepProfileStageStep4));
+
+        dStepProfileStageInfo info;
+        CHECK(dWorldGetStepProfileStage(world, dStepProfileStageQuickStep0, &info));
+        CHECK_EQUAL(0U, info.callCount);
+
+        dWorldDestroy(world);
+    }
+
+    TEST(test_ThreadedQuickStepStages)
+    {
+        dWorldID world = createPendulumWorld();
+        dWorldSetStepProfiling(world, 1);
+
+        dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+        dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(4, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+
+        for (int i = 0; i != 3; ++i) {
+            dWorldQuickStep(world, REAL(0.01));
+            CHECK(areStageTimesConsistent(world, dStepProfileStageQuickStep0, dStepProfileStageQuickStep6));
+        }
+
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dWorldSetStepThreadingImplementation(world, NULL, NULL);
+        dThreadingFreeImplementation(threading);
+        dWorldDestroy(world);
+    }
+}
+
+
+SUITE(ThreadingTracing)
+{
+    // Steps a chain with a traced thread pool and returns the trace text
+    static 
+    std::string traceQuickSteps(unsigned maxEventCount, int *outWrittenCount)
+    {
+        dWorldID world = dWorldCreate();
+        dWorldSetGravity(world, 0, 0, -10);
+
+        dBodyID previous = NULL;
+        for (int i = 0; i != 16; ++i) {
+            dBodyID body = dBodyCreate(world);
+            dBodySetPosition(body, i, 0, 0);
+
+            if (previous != NULL) {
+                dJointID joint = dJointCreateBall(world, 0);
+                dJointAttach(joint, previous, body);
+                dJointSetBallAnchor(joint, i - REAL(0.5), 0, 0);
+            }
+            previous = body;
+        }
+
+        dThreadingImplementationID threading = dThreadingAllocateMultiThreadedImplementation();
+        dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(2, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+        dThreadingImplementationSetTracing(threading, maxEventCount);
+
+        for (int i = 0; i != 3; ++i) {
+            dWorldQuickStep(world, REAL(0.01));
+        }
+
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+
+        std::string trace;
+        FILE *file = tmpfile();
+        *outWrittenCount = dThreadingImplementationWriteTrace(threading, file);
+        rewind(file);
+        for (int character; (character = fgetc(file)) != EOF; ) {
+            trace += (char)character;
+        }
+        fclose(file);
+
+        dWorldSetStepThreadingImplementation(world, NULL, NULL);
+        dThreadingFreeImplementation(threading);
+        dWorldDestroy(world);
+
+        return trace;
+    }
+
+    TEST(test_TraceContents)
+    {
+        int writtenCount;
+        std::string trace = traceQuickSteps(100000, &writtenCount);
+
+        CHECK(writtenCount > 0);
+        CHECK_EQUAL(0U, trace.find("{\"traceEvents\":["));
+        CHECK(trace.find("\"name\":\"QuickStepIsland Stage1\",\"cat\":\"call\",\"ph\":\"X\"") != std::string::npos);
+        CHECK(trace.find("\"name\":\"World Islands Stepping Wait\",\"cat\":\"wait\"") != std::string::npos);
+        CHECK(trace.find("\"args\":{\"queued_us\":") != std::string::npos);
+        CHECK(trace.find("\"args\":{\"name\":\"ODE Thread 0\"}") != std::string::npos);
+        CHECK(trace.find("\"droppedEvents\":0}}") != std::string::npos);
+    }
+
+    TEST(test_EventsOverCapacityDropped)
+    {
+        int writtenCount;
+        std::string trace = traceQuickSteps(5, &writtenCount);
+
+        CHECK_EQUAL(5, writtenCount);
+        CHECK(trace.find("\"droppedEvents\":0}}") == std::string::npos);
+    }
+
+    TEST(test_DisabledByDefault)
+    {
+        dThreadingImplementationID threading = dThreadingAllocateSelfThreadedImplementation();
+
+        FILE *file = tmpfile();
+        CHECK_EQUAL(0, dThreadingImplementationWriteTrace(threading, file));
+        CHECK_EQUAL(1, dThreadingImplementationSetTracing(threading, 16));
+        CHECK_EQUAL(0, dThreadingImplementationWriteTrace(threading, file));
+        CHECK_EQUAL(1, dThreadingImplementationSetTracing(threading, 0));
+        fclose(file);
+
+        dThreadingFreeImplementation(threading);
+    }
+}
@@ -0,0 +1,113 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+//234567890123456789012345678901234567890123456789012345678901234567890123456789
+//        1         2         3         4         5         6         7
+
+////////////////////////////////////////////////////////////////////////////////
+// This file creates unit tests for some of the functions found in:
+// ode/src/threading_impl_templates.h
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <UnitTest++.h>
+#include <ode/ode.h>
+
+#include <cstring>
+
+
+SUITE(WorkStealingJobDeques)
+{
+    enum { JOB_COUNT = 30000 };
+
+    struct JobTreeContext
+    {
+        const dThreadingFunctionsInfo *functions;
+        dThreadingImplementationID threading;
+        unsigned runCounts[JOB_COUNT];
+    };
+
+    // Each job of the binary tree posts its children from the thread running it.
+    // The thread pushes them into its own deque and pops them back while the
+    // other threads steal from it.
+    static 
+    int runJobTreeNode(void *callContext, dcallindex_t instanceIndex, dCallReleaseeID thisReleasee)
+    {
+        JobTreeContext *context = (JobTreeContext *)callContext;
+        context->runCounts[instanceIndex] += 1;
+
+        unsigned firstChild = 2 * (unsigned)instanceIndex + 1;
+        unsigned childCount = firstChild + 1 < JOB_COUNT ? 2 : firstChild < JOB_COUNT ? 1 : 0;
+        if (childCount != 0) {
+            context->functions->alter_call_dependencies_count(context->threading, thisReleasee, childCount);
+            for (unsigned child = firstChild; child != firstChild + childCount; ++child) {
+                context->functions->post_call(context->threading, NULL, NULL, 0, thisReleasee, NULL, 
+                    &runJobTreeNode, context, child, "JobTreeNode");
+            }
+        }
+        return 1;
+    }
+
+    static 
+    unsigned countWronglyRunJobs(unsigned threadCount)
+    {
+        dThreadingImplementationID threading = dThreadingAllocateWorkStealingMultiThreadedImplementation();
+        dThreadingThreadPoolID pool = dThreadingAllocateThreadPool(threadCount, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+
+        JobTreeContext *context = new JobTreeContext();
+        context->functions = dThreadingImplementationGetFunctions(threading);
+        context->threading = threading;
+
+        unsigned wrongCount = 0;
+        for (int round = 0; round != 10; ++round) {
+            memset(context->runCounts, 0, sizeof(context->runCounts));
+
+            dCallWaitID callWait = context->functions->alloc_call_wait(threading);
+            context->functions->post_call(threading, NULL, NULL, 0, NULL, callWait, &runJobTreeNode, context, 0, "JobTreeRoot");
+            context->functions->wait_call(threading, NULL, callWait, NULL, "JobTreeWait");
+            context->functions->free_call_wait(threading, callWait);
+
+            for (unsigned i = 0; i != JOB_COUNT; ++i) {
+                wrongCount += context->runCounts[i] != 1;
+            }
+        }
+
+        delete context;
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dThreadingFreeImplementation(threading);
+
+        return wrongCount;
+    }
+
+    TEST(test_EveryJobRunOnce)
+    {
+        CHECK_EQUAL(0U, countWronglyRunJobs(6));
+    }
+
+    // More threads than the CPUs have: the idle threads back off from 
+    // spinning to yielding so the threads with the jobs get to run
+    TEST(test_EveryJobRunOnceOversubscribed)
+    {
+        CHECK_EQUAL(0U, countWronglyRunJobs(32));
+    }
+}